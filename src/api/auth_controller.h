@@ -52,6 +52,23 @@ class AuthController
      */
     static std::string extractToken(const httplib::Request &req);
 
+    /**
+     * @class VerifiedScope
+     * @brief Trusts a token already verified, on the calling thread, while the scope lives
+     *
+     * Requests run on behalf of a request that passed verifyAuth (the parts of
+     * a batch) skip verifying the same token again.
+     */
+    class VerifiedScope
+    {
+      public:
+        explicit VerifiedScope(const std::string &token);
+        ~VerifiedScope();
+
+        VerifiedScope(const VerifiedScope &) = delete;
+        VerifiedScope &operator=(const VerifiedScope &) = delete;
+    };
+
     /**
      * @brief Get the login page HTML
      */
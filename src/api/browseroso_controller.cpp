@@ -5,9 +5,34 @@
 
 #include "browseroso_controller.h"
 #include "auth_controller.h"
+#include "core/async_jobs.h"
+#include "core/export_tracker.h"
+#include "core/import_tracker.h"
+#include "data/arrow_ipc.h"
+#include "data/change_feed.h"
 #include "data/connection_manager.h"
+#include "data/connection_pool.h"
+#include "data/db_executor.h"
+#include "data/json_reader.h"
+#include "data/page_cache.h"
+#include "data/page_prefetcher.h"
+#include "data/query_watchdog.h"
+#include "data/row_parser.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <string_view>
+#include <thread>
 
 namespace Tootega
 {
@@ -35,352 +60,3605 @@ static std::string getSessionId(const httplib::Request &req)
     return AuthController::extractToken(req);
 }
 
-// Helper to get database connection for current session
-static Data::DatabaseConnection &getDbConnection(const httplib::Request &req)
+// Helper to get database connection for current session (nullptr if the session never connected)
+static Data::SessionLease getDbConnection(const httplib::Request &req)
 {
     std::string sessionId = getSessionId(req);
-    return Data::ConnectionManager::getInstance().getConnection(sessionId);
+    return Data::ConnectionManager::getInstance().findConnection(sessionId);
+}
+
+// 503 for a call to a database server whose circuit is open, with when it is probed next
+static void refuseUnavailable(httplib::Response &res, int retryAfter)
+{
+    res.set_header("Retry-After", std::to_string(retryAfter));
+    res.set_content("{\"success\": false, \"error\": \"Database server unavailable\", \"retryAfter\": " +
+                        std::to_string(retryAfter) + "}",
+                    "application/json");
+    res.status = 503;
+}
+
+// Refuse a session's call at once while its database server is down, rather than once a lease is refused
+static bool serverAvailable(const Data::DatabaseConnection &db, httplib::Response &res)
+{
+    int retryAfter = 0;
+    if (db.checkServer(retryAfter))
+        return true;
+    refuseUnavailable(res, retryAfter);
+    return false;
+}
+
+// Append a JSON string literal, quotes included
+static void appendJsonString(std::string &out, std::string_view value)
+{
+    out += '"';
+    for (char ch : value)
+    {
+        if (ch == '"')
+            out += "\\\"";
+        else if (ch == '\\')
+            out += "\\\\";
+        else if (ch == '\n')
+            out += "\\n";
+        else if (ch == '\r')
+            out += "\\r";
+        else if (ch == '\t')
+            out += "\\t";
+        else if (static_cast<unsigned char>(ch) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(ch));
+            out += escaped;
+        }
+        else
+            out += ch;
+    }
+    out += '"';
+}
+
+// Largest integer a JavaScript number holds exactly (2^53)
+static constexpr unsigned long long kMaxSafeJsonInteger = 9007199254740992ULL;
+
+// Append a cell as a JSON literal: numbers and booleans unquoted, everything else as a string
+static void appendJsonValue(std::string &out, Data::ValueKind kind, std::string_view value)
+{
+    switch (kind)
+    {
+    case Data::ValueKind::Integer:
+    {
+        // Up to 15 digits always fits; longer values are quoted so clients do not round them
+        std::string_view digits = (!value.empty() && value[0] == '-') ? value.substr(1) : value;
+        bool safe = digits.size() <= 15;
+        if (!safe)
+        {
+            unsigned long long magnitude = 0;
+            auto parsed = std::from_chars(digits.data(), digits.data() + digits.size(), magnitude);
+            safe = parsed.ec == std::errc() && magnitude <= kMaxSafeJsonInteger;
+        }
+        if (!digits.empty() && safe)
+        {
+            out += value;
+            return;
+        }
+        break;
+    }
+    case Data::ValueKind::Float:
+    case Data::ValueKind::Boolean:
+        if (!value.empty())
+        {
+            out += value;
+            return;
+        }
+        out += "null";
+        return;
+    default:
+        break;
+    }
+    appendJsonString(out, value);
+}
+
+// JSON keys ("name":) of the first columnCount columns of a result set, escaped once rather than once per cell
+static std::vector<std::string> jsonKeys(const Data::ResultSet &data, size_t columnCount)
+{
+    std::vector<std::string> keys(columnCount);
+    for (size_t c = 0; c < keys.size(); c++)
+    {
+        appendJsonString(keys[c], data.columnName(c));
+        keys[c] += ":";
+    }
+    return keys;
+}
+
+// Append one row as an object keyed by column name
+static void appendRowJson(std::string &out, const Data::ResultSet &data, size_t row,
+                          const std::vector<std::string> &keys)
+{
+    out += "{";
+    for (size_t c = 0; c < keys.size(); c++)
+    {
+        if (c > 0)
+            out += ",";
+        out += keys[c];
+        if (data.isNull(row, c))
+            out += "null";
+        else
+            appendJsonValue(out, data.columnKind(c), data.value(row, c));
+    }
+    out += "}";
+}
+
+// Append the rows of a result set as an array of objects keyed by column name (its first columnCount columns)
+static void appendRowsJson(std::string &out, const Data::ResultSet &data, size_t columnCount)
+{
+    std::vector<std::string> keys = jsonKeys(data, columnCount);
+
+    out += "[";
+    for (size_t r = 0; r < data.rowCount(); r++)
+    {
+        if (r > 0)
+            out += ",";
+        appendRowJson(out, data, r, keys);
+    }
+    out += "]";
+}
+
+// Tag a metadata response and answer 304 when the client already has this version
+static bool notModified(const httplib::Request &req, httplib::Response &res, const std::string &etag)
+{
+    if (etag.empty())
+        return false;
+
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", "private, no-cache");
+
+    std::string ifNoneMatch = req.get_header_value("If-None-Match");
+    if (ifNoneMatch.find(etag) != std::string::npos)
+    {
+        res.status = 304;
+        return true;
+    }
+    return false;
+}
+
+// How long a "Prefer: respond-async" request waits inline before answering 202
+static constexpr auto kInlineWait = std::chrono::milliseconds(200);
+
+// Deadline of a query request unless X-Request-Timeout says otherwise
+static std::atomic<int> s_requestTimeoutSeconds{BrowserosoController::kDefaultRequestTimeoutSeconds};
+
+// Upper bound for X-Request-Timeout
+static constexpr double kMaxRequestTimeoutSeconds = 600;
+
+// Deadline requested with "X-Request-Timeout: <seconds>" (fractions allowed), else the configured default
+static std::chrono::milliseconds requestTimeout(const httplib::Request &req)
+{
+    double seconds = s_requestTimeoutSeconds.load();
+
+    std::string header = req.get_header_value("X-Request-Timeout");
+    if (!header.empty())
+    {
+        char *end = nullptr;
+        double requested = std::strtod(header.c_str(), &end);
+        if (end != header.c_str() && requested > 0)
+            seconds = std::min(requested, kMaxRequestTimeoutSeconds);
+    }
+
+    return std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+}
+
+// Response for work stopped by its deadline (504) or by the client going away
+static Core::JobResult cancelledResult(const Data::CancellationToken &cancel)
+{
+    // 499 (client closed request) is never actually delivered; it only shows up in logs
+    int status = cancel.deadlineExceeded() ? 504 : 499;
+    return Core::JobResult{status, "{\"success\": false, \"error\": \"" + cancel.reason() + "\"}"};
+}
+
+static void writeJobResult(httplib::Response &res, const Core::JobResult &result)
+{
+    res.status = result.status;
+    res.set_content(result.body, result.contentType);
+}
+
+// Filter parameters of a table request: filterColumn, filterValue and
+// filterMode=contains (default) | prefix | exact | fulltext | auto
+static bool readFilter(const httplib::Request &req, httplib::Response &res, Data::RowFilter &filter)
+{
+    filter.column = req.get_param_value("filterColumn");
+    filter.value = req.get_param_value("filterValue");
+
+    std::string mode = req.get_param_value("filterMode");
+    if (!mode.empty() && !Data::parseFilterMode(mode, filter.mode))
+    {
+        res.set_content("{\"error\": \"Invalid filter mode\"}", "application/json");
+        res.status = 400;
+        return false;
+    }
+    return true;
+}
+
+// Most sort keys a table request may name
+static constexpr size_t kMaxSortKeys = 8;
+
+// Sort parameter of a table request: sort=column[:asc|:desc],... Sets @p spec to its
+// normalized form, which takes part in the page cache key
+static bool readSort(const httplib::Request &req, httplib::Response &res, std::vector<Data::SortKey> &keys,
+                     std::string &spec)
+{
+    std::istringstream ss(req.get_param_value("sort"));
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        Data::SortKey key;
+        auto colon = item.find(':');
+        key.column = item.substr(0, colon);
+        std::string direction = colon == std::string::npos ? "asc" : item.substr(colon + 1);
+        key.descending = direction == "desc";
+
+        if (!Data::isValidIdentifier(key.column) || (direction != "asc" && direction != "desc") ||
+            keys.size() == kMaxSortKeys)
+        {
+            res.set_content("{\"error\": \"Invalid sort\"}", "application/json");
+            res.status = 400;
+            return false;
+        }
+
+        spec += (spec.empty() ? "" : ",") + key.column + ":" + direction;
+        keys.push_back(std::move(key));
+    }
+    return true;
+}
+
+// Most characters a preview may keep per value; a request without preview reads every value whole
+static constexpr int kMaxPreviewLength = 4000;
+
+// Projection parameters of a table request: columns=a,b,... and preview=<characters>. Sets
+// @p spec to their normalized form, which takes part in the page cache key
+static bool readProjection(const httplib::Request &req, httplib::Response &res, Data::RowProjection &projection,
+                           std::string &spec)
+{
+    std::istringstream ss(req.get_param_value("columns"));
+    std::string column;
+    while (std::getline(ss, column, ','))
+    {
+        if (!Data::isValidIdentifier(column))
+        {
+            res.set_content("{\"error\": \"Invalid columns\"}", "application/json");
+            res.status = 400;
+            return false;
+        }
+        spec += (projection.columns.empty() ? "" : ",") + column;
+        projection.columns.push_back(column);
+    }
+
+    std::string preview = req.get_param_value("preview");
+    if (!preview.empty())
+    {
+        auto parsed = std::from_chars(preview.data(), preview.data() + preview.size(), projection.previewLength);
+        if (parsed.ec != std::errc() || parsed.ptr != preview.data() + preview.size() ||
+            projection.previewLength < 1 || projection.previewLength > kMaxPreviewLength)
+        {
+            res.set_content("{\"error\": \"Invalid preview length\"}", "application/json");
+            res.status = 400;
+            return false;
+        }
+        spec += ":" + preview;
+    }
+    return true;
+}
+
+// Most foreign keys one page may expand
+static constexpr size_t kMaxExpansions = 8;
+
+// A foreign key whose referenced rows are read along with a page
+struct Expansion
+{
+    std::string foreignKey;
+    std::vector<std::string> columns; ///< Referencing columns, in table order
+    std::string schema;
+    std::string table;
+    std::vector<std::string> referencedColumns; ///< Matching columns of the referenced table
+};
+
+// expand=a,b,... names foreign key columns (any column of a composite key, or the key's
+// name) whose referenced rows come with the page. Sets @p spec to their normalized form,
+// which takes part in the page cache key
+static bool readExpansions(const httplib::Request &req, httplib::Response &res, Data::DatabaseConnection &db,
+                           const std::string &schema, const std::string &table,
+                           const Data::RowProjection &projection, std::vector<Expansion> &expansions,
+                           std::string &spec)
+{
+    std::string param = req.get_param_value("expand");
+    if (param.empty())
+        return true;
+
+    std::string etag;
+    std::vector<Data::ColumnInfo> columns = db.getColumns(schema, table, etag);
+
+    auto fail = [&](const std::string &message) {
+        std::string body = "{\"error\": ";
+        appendJsonString(body, message);
+        res.set_content(body + "}", "application/json");
+        res.status = 400;
+        return false;
+    };
+
+    std::istringstream ss(param);
+    std::string name;
+    while (std::getline(ss, name, ','))
+    {
+        // A column names every foreign key it is part of
+        std::vector<const Data::ColumnReference *> named;
+        for (const Data::ColumnInfo &column : columns)
+        {
+            for (const Data::ColumnReference &reference : column.references)
+            {
+                if (column.name == name || reference.foreignKey == name)
+                    named.push_back(&reference);
+            }
+        }
+        if (named.empty())
+            return fail("Not a foreign key: " + name);
+
+        for (const Data::ColumnReference *key : named)
+        {
+            if (std::any_of(expansions.begin(), expansions.end(),
+                            [&](const Expansion &expansion) { return expansion.foreignKey == key->foreignKey; }))
+                continue;
+            if (expansions.size() == kMaxExpansions)
+                return fail("Too many foreign keys to expand");
+
+            Expansion expansion;
+            expansion.foreignKey = key->foreignKey;
+            expansion.schema = key->referencedSchema;
+            expansion.table = key->referencedTable;
+            for (const Data::ColumnInfo &column : columns)
+            {
+                auto reference = std::find_if(
+                    column.references.begin(), column.references.end(),
+                    [&](const Data::ColumnReference &other) { return other.foreignKey == key->foreignKey; });
+                if (reference == column.references.end())
+                    continue;
+                // The key's values are read from the page, so its columns must be selected
+                if (!projection.columns.empty() &&
+                    std::find(projection.columns.begin(), projection.columns.end(), column.name) ==
+                        projection.columns.end())
+                    return fail("Foreign key column not selected: " + column.name);
+                expansion.columns.push_back(column.name);
+                expansion.referencedColumns.push_back(reference->referencedColumn);
+            }
+
+            spec += (spec.empty() ? "" : ",") + expansion.foreignKey;
+            expansions.push_back(std::move(expansion));
+        }
+    }
+    return true;
+}
+
+// Read the rows a page's foreign keys reference, one batched query per key, and append them as
+// "expanded": [...], to @p out. Rows whose key is NULL reference nothing
+static bool appendExpansions(std::string &out, Data::DatabaseConnection &db, const std::vector<Expansion> &expansions,
+                             const Data::QueryResult &page, const Data::RowProjection &projection,
+                             Data::CancellationToken &cancel, std::string &error)
+{
+    out += "\"expanded\": [";
+    for (size_t e = 0; e < expansions.size(); e++)
+    {
+        const Expansion &expansion = expansions[e];
+
+        // Referenced rows are previewed like the page, but their keys are read whole to match it
+        Data::RowProjection preview;
+        preview.previewLength = projection.previewLength;
+        preview.whole = expansion.referencedColumns;
+
+        std::vector<size_t> positions;
+        for (const std::string &name : expansion.columns)
+        {
+            size_t position = 0;
+            while (position < page.selectedColumns() && page.data.columnName(position) != name)
+                position++;
+            if (position == page.selectedColumns())
+            {
+                error = "Foreign key column not selected: " + name;
+                return false;
+            }
+            positions.push_back(position);
+        }
+
+        // Distinct keys, in the order the page first references them
+        std::set<std::vector<std::string>> seen;
+        std::vector<std::vector<std::string>> keys;
+        for (size_t r = 0; r < page.data.rowCount(); r++)
+        {
+            std::vector<std::string> key;
+            for (size_t c = 0; c < positions.size(); c++)
+            {
+                if (page.data.isNull(r, positions[c]))
+                    break;
+                key.emplace_back(page.data.value(r, positions[c]));
+            }
+            if (key.size() == positions.size() && seen.insert(key).second)
+                keys.push_back(std::move(key));
+        }
+
+        auto related =
+            db.selectByKeys(expansion.schema, expansion.table, expansion.referencedColumns, keys, preview, cancel);
+        if (!related.success)
+        {
+            error = expansion.foreignKey + ": " + related.error;
+            return false;
+        }
+
+        size_t columnCount = related.selectedColumns();
+        out += e > 0 ? ",{\"foreignKey\": " : "{\"foreignKey\": ";
+        appendJsonString(out, expansion.foreignKey);
+        out += ",\"columns\": [";
+        for (size_t c = 0; c < expansion.columns.size(); c++)
+        {
+            if (c > 0)
+                out += ",";
+            appendJsonString(out, expansion.columns[c]);
+        }
+        out += "],\"schema\": ";
+        appendJsonString(out, expansion.schema);
+        out += ",\"table\": ";
+        appendJsonString(out, expansion.table);
+        out += ",\"referencedColumns\": [";
+        for (size_t c = 0; c < expansion.referencedColumns.size(); c++)
+        {
+            if (c > 0)
+                out += ",";
+            appendJsonString(out, expansion.referencedColumns[c]);
+        }
+        out += "],\"columnTypes\": [";
+        for (size_t c = 0; c < columnCount; c++)
+        {
+            if (c > 0)
+                out += ",";
+            appendJsonString(out, Data::valueKindName(related.data.columnKind(c)));
+        }
+        out += "],\"rows\": ";
+        appendRowsJson(out, related.data, columnCount);
+        out += "}";
+    }
+    out += "],";
+    return true;
+}
+
+// Keyset cursors are opaque to clients: hex of the page they lead to, a digest of the
+// query they continue and the sort key values of the previous page's last row
+static std::string encodeCursor(const std::string &queryKey, int page, const std::vector<Data::KeyValue> &values)
+{
+    std::string payload = std::to_string(std::hash<std::string>{}(queryKey)) + ":" + std::to_string(page);
+    for (const Data::KeyValue &value : values)
+        payload += value ? ":" + std::to_string(value->size()) + ":" + *value : std::string(":n");
+
+    static const char digits[] = "0123456789abcdef";
+    std::string cursor;
+    cursor.reserve(payload.size() * 2);
+    for (unsigned char c : payload)
+    {
+        cursor += digits[c >> 4];
+        cursor += digits[c & 0xF];
+    }
+    return cursor;
+}
+
+// Reverse of encodeCursor; false if @p cursor is malformed or belongs to another query
+static bool decodeCursor(const std::string &cursor, const std::string &queryKey, int &page,
+                         std::vector<Data::KeyValue> &values)
+{
+    if (cursor.size() % 2 != 0)
+        return false;
+
+    std::string payload;
+    payload.reserve(cursor.size() / 2);
+    for (size_t i = 0; i < cursor.size(); i += 2)
+    {
+        unsigned value = 0;
+        auto parsed = std::from_chars(cursor.data() + i, cursor.data() + i + 2, value, 16);
+        if (parsed.ec != std::errc() || parsed.ptr != cursor.data() + i + 2)
+            return false;
+        payload += static_cast<char>(value);
+    }
+
+    // digest:page, then length:value per key, or n for NULL
+    const char *pos = payload.data();
+    const char *end = pos + payload.size();
+    size_t digest = 0;
+    auto parsed = std::from_chars(pos, end, digest);
+    if (parsed.ec != std::errc() || digest != std::hash<std::string>{}(queryKey) || parsed.ptr == end ||
+        *parsed.ptr != ':')
+        return false;
+    parsed = std::from_chars(parsed.ptr + 1, end, page);
+    if (parsed.ec != std::errc() || page < 1)
+        return false;
+
+    values.clear();
+    pos = parsed.ptr;
+    while (pos != end)
+    {
+        size_t length = 0;
+        if (*pos != ':' || pos + 1 == end)
+            return false;
+        if (pos[1] == 'n')
+        {
+            values.emplace_back();
+            pos += 2;
+            continue;
+        }
+        parsed = std::from_chars(pos + 1, end, length);
+        if (parsed.ec != std::errc() || parsed.ptr == end || *parsed.ptr != ':' ||
+            length > static_cast<size_t>(end - parsed.ptr - 1))
+            return false;
+        values.emplace_back(std::string(parsed.ptr + 1, length));
+        pos = parsed.ptr + 1 + length;
+    }
+    return !values.empty();
+}
+
+// Cursor to the page after a cached page body ("nextCursor" comes before any table content,
+// in the JSON body or in the metadata of an Arrow schema)
+static std::string nextCursorOf(const std::string &body)
+{
+    static const std::string field = "\"nextCursor\": ";
+    auto start = body.find(field);
+    if (start == std::string::npos || body.compare(start + field.size(), 1, "\"") != 0)
+        return std::string();
+    start += field.size() + 1;
+    auto end = body.find('"', start);
+    return end == std::string::npos ? std::string() : body.substr(start, end - start);
+}
+
+// What a table data request learned, read by the HTTP worker once the job is done
+struct PageOutcome
+{
+    std::atomic<bool> reusable{false}; ///< Answered with a page that could be cached
+    std::atomic<bool> lastPage{false}; ///< No rows after the page
+};
+
+// Run a query on the database pool instead of the HTTP worker
+//
+// Clients sending "Prefer: respond-async" get 202 with a job id when the work
+// outlasts kInlineWait, which releases the HTTP worker; others wait for the
+// result as before. Either way the work is cancelled at the request deadline,
+// when the client disconnects, or when it stops polling for the job. A 202
+// leaves the work running after the handler returns, so it must capture by
+// value, the session lease included, and never the request or handler locals.
+static void respond(const httplib::Request &req, httplib::Response &res,
+                    std::function<Core::JobResult(Data::CancellationToken &)> work)
+{
+    auto cancel = std::make_shared<Data::CancellationToken>(requestTimeout(req));
+    auto future = Data::DbExecutor::getInstance().submit([work = std::move(work), cancel]() { return work(*cancel); });
+
+    auto &watchdog = Data::QueryWatchdog::getInstance();
+    size_t watchId = watchdog.watch(cancel, [&req]() { return req.is_connection_closed(); });
+
+    bool preferAsync = req.get_header_value("Prefer").find("respond-async") != std::string::npos;
+    if (preferAsync && future.wait_for(kInlineWait) != std::future_status::ready)
+    {
+        // The request object is about to go away: watch the job's polling instead
+        watchdog.unwatch(watchId);
+
+        auto &jobs = Core::AsyncJobs::getInstance();
+        std::string jobId = jobs.start(getSessionId(req), std::move(future), [cancel]() { cancel->cancel(); });
+        watchdog.watch(cancel, [jobId]() { return Core::AsyncJobs::getInstance().isAbandoned(jobId); });
+
+        res.status = 202;
+        res.set_header("Location", "/api/browseroso/jobs?id=" + jobId);
+        res.set_content("{\"jobId\": \"" + jobId + "\", \"status\": \"running\"}", "application/json");
+        return;
+    }
+
+    future.wait();
+    watchdog.unwatch(watchId);
+    writeJobResult(res, future.get());
+}
+
+// Rows an export reads from the database at a time
+static constexpr size_t kExportBatchRows = 500;
+
+// An export's output goes to the client in chunks of about this size; less is buffered between batches
+static constexpr size_t kExportChunkBytes = 64 * 1024;
+
+// How long the row estimate of an unfiltered export may take before the export starts without it
+static constexpr auto kExportEstimateTimeout = std::chrono::seconds(2);
+
+enum class ExportFormat
+{
+    Csv,
+    NdJson,
+    Json,
+    Arrow ///< Arrow IPC stream: one record batch per batch read
+};
+
+// Append a CSV field (RFC 4180), quoted when it holds a separator, quote or line break. An empty
+// string is quoted so it reads back apart from NULL, which is an empty unquoted field
+static void appendCsvField(std::string &out, std::string_view value, bool null)
+{
+    if (null)
+        return;
+    if (!value.empty() && value.find_first_of(",\"\r\n") == std::string_view::npos)
+    {
+        out += value;
+        return;
+    }
+
+    out += '"';
+    for (char ch : value)
+    {
+        out += ch;
+        if (ch == '"')
+            out += '"';
+    }
+    out += '"';
+}
+
+// Formats an export's rows; the header comes from the first batch, which holds the columns.
+// Arrow is written a batch at a time with writeBatch(), the text formats a row at a time
+struct ExportWriter
+{
+    ExportFormat format = ExportFormat::Csv;
+    size_t columnCount = 0; ///< Columns written; sort keys the client left out follow them in the batch
+    bool anyRow = false;
+    std::vector<std::string> keys;
+    Data::ArrowCompression compression = Data::ArrowCompression::None;
+    Data::ArrowStreamWriter arrow;
+
+    // Start of the output, once the columns are known
+    void writeHeader(std::string &out, const Data::ResultSet &batch, size_t requestedColumns)
+    {
+        columnCount = requestedColumns > 0 ? requestedColumns : batch.columnCount();
+        keys = jsonKeys(batch, columnCount);
+        if (format == ExportFormat::Csv)
+        {
+            for (size_t c = 0; c < columnCount; c++)
+            {
+                if (c > 0)
+                    out += ',';
+                appendCsvField(out, batch.columnName(c), false);
+            }
+            out += "\r\n";
+        }
+        else if (format == ExportFormat::Json)
+        {
+            out += "[";
+        }
+        else if (format == ExportFormat::Arrow)
+        {
+            arrow = Data::ArrowStreamWriter(compression);
+            arrow.writeSchema(out, batch, columnCount);
+        }
+    }
+
+    // A whole batch as one Arrow record batch; false if its columns no longer match the schema
+    bool writeBatch(std::string &out, const Data::ResultSet &batch, std::string &error)
+    {
+        if (batch.rowCount() == 0)
+            return true;
+        anyRow = true;
+        return arrow.writeBatch(out, batch, error);
+    }
+
+    void writeRow(std::string &out, const Data::ResultSet &batch, size_t row)
+    {
+        switch (format)
+        {
+        case ExportFormat::Csv:
+            for (size_t c = 0; c < columnCount; c++)
+            {
+                if (c > 0)
+                    out += ',';
+                appendCsvField(out, batch.value(row, c), batch.isNull(row, c));
+            }
+            out += "\r\n";
+            break;
+        case ExportFormat::NdJson:
+            appendRowJson(out, batch, row, keys);
+            out += "\n";
+            break;
+        case ExportFormat::Json:
+            out += anyRow ? ",\n" : "\n";
+            appendRowJson(out, batch, row, keys);
+            break;
+        case ExportFormat::Arrow:
+            break;
+        }
+        anyRow = true;
+    }
+
+    void writeFooter(std::string &out)
+    {
+        if (format == ExportFormat::Json)
+            out += "]\n";
+        else if (format == ExportFormat::Arrow)
+            Data::ArrowStreamWriter::writeEnd(out);
+    }
+};
+
+// A streaming export, owned by the response's content provider
+struct ExportStream
+{
+    ExportWriter writer;
+    bool headerWritten = false;
+    bool firstBatchRead = false; ///< The batch holds the first rows, read before the response started
+
+    std::shared_ptr<Data::CancellationToken> cancel;
+    std::unique_ptr<Data::RowCursor> cursor;
+    std::shared_ptr<Core::ExportProgress> progress;
+    size_t watchId = 0;
+
+    Data::ResultSet batch;
+    std::string buffer;
+
+    ~ExportStream()
+    {
+        Data::QueryWatchdog::getInstance().unwatch(watchId);
+        // Still running here: the client went away or the server is stopping
+        if (progress)
+            Core::ExportTracker::getInstance().finish(progress, Core::ExportState::Aborted);
+    }
+
+    // Hand the buffered output to the client; false once the client is gone
+    bool flush(httplib::DataSink &sink)
+    {
+        if (buffer.empty())
+            return true;
+        if (!sink.write(buffer.data(), buffer.size()))
+            return false;
+        progress->bytes += buffer.size();
+        buffer.clear();
+        return true;
+    }
+};
+
+// Read the next batch of an export; the first one also writes the header, and Arrow encodes each
+// batch at once. False with error set if the read or the encoding failed
+static bool nextExportBatch(ExportStream &stream, size_t requestedColumns, std::string &error)
+{
+    if (!stream.cursor->fetch(stream.batch, kExportBatchRows))
+    {
+        error = stream.cursor->error();
+        return false;
+    }
+
+    if (!stream.headerWritten)
+    {
+        stream.writer.writeHeader(stream.buffer, stream.batch, requestedColumns);
+        stream.headerWritten = true;
+    }
+    return stream.writer.format != ExportFormat::Arrow || stream.writer.writeBatch(stream.buffer, stream.batch, error);
+}
+
+// Produce the next part of an export: one batch of rows, written out whenever kExportChunkBytes
+// are buffered. httplib only asks for more once the previous chunks were sent, so a slow client
+// slows down the reads instead of letting output pile up in memory
+static bool streamExport(ExportStream &stream, size_t requestedColumns, httplib::DataSink &sink)
+{
+    auto &tracker = Core::ExportTracker::getInstance();
+    if (!sink.is_writable())
+        return false;
+
+    // The first batch was read before the response started
+    std::string error;
+    if (stream.firstBatchRead)
+    {
+        stream.firstBatchRead = false;
+    }
+    else if (!nextExportBatch(stream, requestedColumns, error))
+    {
+        // Aborting leaves the response without its last chunk, so the client sees it is incomplete
+        if (stream.cancel->isCancelled())
+            tracker.finish(stream.progress, Core::ExportState::Aborted, stream.cancel->reason());
+        else
+            tracker.finish(stream.progress, Core::ExportState::Failed, error);
+        return false;
+    }
+
+    size_t rows = stream.batch.rowCount();
+    if (stream.writer.format == ExportFormat::Arrow)
+    {
+        if (stream.buffer.size() >= kExportChunkBytes && !stream.flush(sink))
+            return false;
+    }
+    else
+    {
+        for (size_t r = 0; r < rows; r++)
+        {
+            stream.writer.writeRow(stream.buffer, stream.batch, r);
+            if (stream.buffer.size() >= kExportChunkBytes && !stream.flush(sink))
+                return false;
+        }
+    }
+    stream.progress->rows += rows;
+
+    if (rows > 0)
+        return true;
+
+    stream.writer.writeFooter(stream.buffer);
+    if (!stream.flush(sink))
+        return false;
+
+    sink.done_with_trailer({{"X-Export-Rows", std::to_string(stream.progress->rows.load())}});
+    tracker.finish(stream.progress, Core::ExportState::Completed);
+    return true;
+}
+
+// Most connections a parallel export reads on: the pool's cap per target, less two left for the tabs
+// browsing through the same pool meanwhile
+static constexpr size_t kMaxExportParallelism = Data::ConnectionPool::kMaxPerTarget - 2;
+
+// Key ranges per connection, so connections done with a short range pick up another one
+static constexpr size_t kExportRangesPerWorker = 4;
+
+// Times a range is read before the export gives up on it
+static constexpr int kExportRangeAttempts = 3;
+
+// Pause before reading a failed range again, multiplied by the attempt
+static constexpr auto kExportRetryDelay = std::chrono::seconds(1);
+
+// How often a worker or the response waiting on the other side checks for cancellation
+static constexpr auto kExportPollInterval = std::chrono::milliseconds(200);
+
+// Size of a tar block: headers, and the padding after each file
+static constexpr size_t kTarBlock = 512;
+
+// Append a ustar header of a regular file. Sizes past the 11 octal digits of the
+// format (8 GiB) use the base-256 form GNU tar and libarchive read
+static void appendTarHeader(std::string &out, const std::string &name, uint64_t size)
+{
+    char header[kTarBlock] = {};
+    std::snprintf(header, 100, "%s", name.c_str());
+    std::memcpy(header + 100, "0000644", 8);
+    std::memcpy(header + 108, "0000000", 8);
+    std::memcpy(header + 116, "0000000", 8);
+    if (size <= 077777777777ULL)
+    {
+        std::snprintf(header + 124, 12, "%011llo", static_cast<unsigned long long>(size));
+    }
+    else
+    {
+        header[124] = static_cast<char>(0x80);
+        for (int i = 11; i >= 4; i--, size >>= 8)
+            header[124 + i] = static_cast<char>(size & 0xff);
+    }
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::snprintf(header + 136, 12, "%011llo", static_cast<unsigned long long>(now));
+    header[156] = '0';
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+
+    // The checksum is summed with its own field as spaces
+    std::memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (char ch : header)
+        checksum += static_cast<unsigned char>(ch);
+    std::snprintf(header + 148, 8, "%06o", checksum);
+    header[155] = ' ';
+
+    out.append(header, kTarBlock);
+}
+
+/**
+ * @brief An export read over several key ranges at once, each on a pooled connection of its own
+ *
+ * Workers take the ranges in turn and format their rows. Merged, the
+ * formatted chunks queue up for the response, a few per worker, in the order
+ * they were read: a slow client still holds back the reads. As an archive,
+ * each range is spooled to a temporary file and sent as a file of a tar once
+ * complete. A range that fails is read again from after its last row read.
+ */
+struct ParallelExport
+{
+    struct FileCloser
+    {
+        void operator()(std::FILE *file) const
+        {
+            std::fclose(file);
+        }
+    };
+
+    // A range's rows ready to be sent: formatted rows (merged) or its spooled file (archive)
+    struct Chunk
+    {
+        size_t range = 0;
+        std::string header;
+        std::string rows;
+        size_t rowCount = 0;
+        std::unique_ptr<std::FILE, FileCloser> file;
+        uint64_t fileBytes = 0;
+    };
+
+    ExportFormat format = ExportFormat::Csv;
+    Data::ArrowCompression compression = Data::ArrowCompression::None;
+    std::string extension;
+    bool archive = false;
+
+    Data::SessionLease db;
+    std::string schema;
+    std::string table;
+    Data::RowFilter filter;
+    std::vector<Data::SortKey> keyOrder;
+    std::vector<std::string> columns;
+    size_t requestedColumns = 0;
+    std::vector<Data::KeyRange> ranges;
+
+    std::shared_ptr<Data::CancellationToken> cancel;
+    std::shared_ptr<Core::ExportProgress> progress;
+    size_t watchId = 0;
+    std::vector<std::thread> workers;
+    size_t maxQueued = 0;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Chunk> ready;
+    size_t nextRange = 0;
+    size_t rangesDone = 0;
+    std::string error; ///< Set when a range failed for good
+
+    // Response side
+    bool headerWritten = false;
+    std::string header; ///< Sent by the first range; an Arrow schema every other range must match
+    bool anyChunk = false;
+    Chunk sending;
+    std::string buffer;
+
+    ~ParallelExport()
+    {
+        cancel->cancel();
+        changed.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+
+        Data::QueryWatchdog::getInstance().unwatch(watchId);
+        // Still running here: the client went away or the server is stopping
+        Core::ExportTracker::getInstance().finish(progress, Core::ExportState::Aborted);
+    }
+
+    void start(size_t workerCount)
+    {
+        // Room for two chunks per worker: enough to keep the response busy, little to hold in memory
+        maxQueued = 2 * workerCount;
+        for (size_t i = 0; i < workerCount; i++)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    bool stopped()
+    {
+        return cancel->isCancelled() || !error.empty();
+    }
+
+    void work()
+    {
+        for (;;)
+        {
+            size_t range;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopped() || nextRange == ranges.size())
+                    return;
+                range = nextRange++;
+            }
+
+            std::string rangeError;
+            if (readRange(range, rangeError))
+                continue;
+
+            // One range lost fails the export; the other workers stop at their next batch
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error.empty() && !cancel->isCancelled())
+                error = rangeError;
+            changed.notify_all();
+            return;
+        }
+    }
+
+    bool readRange(size_t index, std::string &rangeError)
+    {
+        Data::KeyRange range = ranges[index];
+        ExportWriter writer;
+        writer.format = format;
+        writer.compression = compression;
+
+        Chunk chunk;
+        chunk.range = index;
+        if (archive)
+        {
+            chunk.file.reset(std::tmpfile());
+            if (!chunk.file)
+            {
+                rangeError = "Failed to create a temporary file";
+                return false;
+            }
+        }
+
+        bool headerDone = false;
+        bool resumable = true;
+        uint64_t rowsRead = 0;
+        Data::ResultSet batch;
+        std::vector<Data::KeyValue> lastKey;
+
+        for (int attempt = 1;; attempt++)
+        {
+            std::unique_ptr<Data::RowCursor> cursor =
+                db->openCursor(schema, table, filter, range, keyOrder, columns, *cancel, rangeError);
+            if (cursor && format == ExportFormat::Arrow && !cursor->settleKinds())
+            {
+                rangeError = cursor->error();
+                cursor.reset();
+            }
+
+            bool done = false;
+            while (cursor)
+            {
+                if (!cursor->fetch(batch, kExportBatchRows))
+                {
+                    rangeError = cursor->error();
+                    break;
+                }
+
+                if (!headerDone)
+                {
+                    writer.writeHeader(archive ? chunk.rows : chunk.header, batch, requestedColumns);
+                    headerDone = true;
+                }
+
+                size_t rows = batch.rowCount();
+                if (rows == 0)
+                {
+                    done = true;
+                    break;
+                }
+
+                // Reading it again would not change the batch's columns: that fails the export right away
+                if (format == ExportFormat::Arrow && !writer.writeBatch(chunk.rows, batch, rangeError))
+                    return false;
+                for (size_t r = 0; r < rows && format != ExportFormat::Arrow; r++)
+                {
+                    // Merged, every chunk is a fresh run of rows the response joins
+                    if (!archive)
+                        writer.anyRow = chunk.rowCount > 0;
+                    writer.writeRow(chunk.rows, batch, r);
+                }
+                chunk.rowCount += rows;
+                rowsRead += rows;
+
+                // A retry continues after the last row read, which needs its key
+                if (Data::readLastKey(batch, keyOrder, lastKey) && lastKey[0])
+                    range.lower = lastKey[0];
+                else
+                    resumable = false;
+
+                if (chunk.rows.size() >= kExportChunkBytes && !deliver(chunk, false))
+                    return true;
+            }
+
+            if (done)
+            {
+                if (archive)
+                    writer.writeFooter(chunk.rows);
+                deliver(chunk, true);
+                return true;
+            }
+
+            if (cancel->isCancelled())
+                return true;
+            if (attempt == kExportRangeAttempts || (rowsRead > 0 && !resumable))
+            {
+                rangeError = "Range " + std::to_string(index + 1) + " of the export failed: " + rangeError;
+                return false;
+            }
+
+            progress->retries++;
+            waitOrCancel(kExportRetryDelay * attempt);
+        }
+    }
+
+    void waitOrCancel(std::chrono::milliseconds delay)
+    {
+        auto until = std::chrono::steady_clock::now() + delay;
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_until(lock, until, [this]() { return stopped(); });
+    }
+
+    // Pass a range's rows on: merged, queue them once there is room; as an archive, append them
+    // to the range's file and queue the file once the range is done. false once the export stopped
+    bool deliver(Chunk &chunk, bool last)
+    {
+        if (archive)
+        {
+            if (std::fwrite(chunk.rows.data(), 1, chunk.rows.size(), chunk.file.get()) != chunk.rows.size())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error.empty())
+                    error = "Failed to write a temporary file";
+                changed.notify_all();
+                return false;
+            }
+            chunk.fileBytes += chunk.rows.size();
+            chunk.rows.clear();
+            if (!last)
+                return true;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!archive && ready.size() >= maxQueued && !stopped())
+            changed.wait_for(lock, kExportPollInterval);
+        if (stopped())
+            return false;
+
+        if (!chunk.header.empty() || !chunk.rows.empty() || chunk.file)
+        {
+            size_t range = chunk.range;
+            ready.push_back(std::move(chunk));
+            chunk = Chunk();
+            chunk.range = range;
+        }
+        if (last)
+        {
+            rangesDone++;
+            progress->rangesDone++;
+        }
+        changed.notify_all();
+        return true;
+    }
+
+    bool flush(httplib::DataSink &sink)
+    {
+        if (buffer.empty())
+            return true;
+        if (!sink.write(buffer.data(), buffer.size()))
+            return false;
+        progress->bytes += buffer.size();
+        buffer.clear();
+        return true;
+    }
+
+    // Produce the next part of the response: a chunk of rows, or a piece of an archived file
+    bool stream(httplib::DataSink &sink)
+    {
+        auto &tracker = Core::ExportTracker::getInstance();
+        if (!sink.is_writable())
+            return false;
+
+        if (sending.file)
+            return sendFile(sink);
+
+        bool finished = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (ready.empty() && rangesDone < ranges.size() && !stopped())
+                changed.wait_for(lock, kExportPollInterval);
+
+            if (!error.empty() || cancel->isCancelled())
+            {
+                // Aborting leaves the response without its last chunk, so the client sees it is incomplete
+                if (!error.empty())
+                    tracker.finish(progress, Core::ExportState::Failed, error);
+                else
+                    tracker.finish(progress, Core::ExportState::Aborted, cancel->reason());
+                return false;
+            }
+
+            if (!ready.empty())
+            {
+                sending = std::move(ready.front());
+                ready.pop_front();
+                changed.notify_all();
+            }
+            else
+            {
+                finished = true;
+            }
+        }
+
+        if (finished)
+        {
+            if (archive)
+                buffer.append(2 * kTarBlock, '\0');
+            else if (headerWritten)
+            {
+                ExportWriter writer;
+                writer.format = format;
+                writer.writeFooter(buffer);
+            }
+            if (!flush(sink))
+                return false;
+
+            sink.done_with_trailer({{"X-Export-Rows", std::to_string(progress->rows.load())}});
+            tracker.finish(progress, Core::ExportState::Completed);
+            return true;
+        }
+
+        if (archive)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "part-%04zu.", sending.range + 1);
+            appendTarHeader(buffer, name + extension, sending.fileBytes);
+            std::rewind(sending.file.get());
+            progress->rows += sending.rowCount;
+            return sendFile(sink);
+        }
+
+        if (!headerWritten)
+        {
+            header = sending.header;
+            buffer += header;
+            headerWritten = true;
+        }
+        else if (format == ExportFormat::Arrow && !sending.header.empty() && sending.header != header)
+        {
+            tracker.finish(progress, Core::ExportState::Failed, "Key ranges of the export read different column types");
+            return false;
+        }
+        if (format == ExportFormat::Json && !sending.rows.empty())
+            buffer += anyChunk ? "," : "";
+        anyChunk = anyChunk || !sending.rows.empty();
+        buffer += sending.rows;
+        progress->rows += sending.rowCount;
+        sending = Chunk();
+        return flush(sink);
+    }
+
+    // Send the next piece of the archived file being sent, and its padding after the last one
+    bool sendFile(httplib::DataSink &sink)
+    {
+        size_t start = buffer.size();
+        buffer.resize(start + kExportChunkBytes);
+        size_t read = std::fread(&buffer[start], 1, kExportChunkBytes, sending.file.get());
+        buffer.resize(start + read);
+
+        if (read < kExportChunkBytes)
+        {
+            if (std::ferror(sending.file.get()))
+            {
+                Core::ExportTracker::getInstance().finish(progress, Core::ExportState::Failed,
+                                                          "Failed to read a temporary file");
+                return false;
+            }
+            size_t padding = (kTarBlock - sending.fileBytes % kTarBlock) % kTarBlock;
+            buffer.append(padding, '\0');
+            sending = Chunk();
+        }
+        return flush(sink);
+    }
+};
+
+// Row changes one edit request may carry
+static constexpr size_t kMaxEditChanges = 10000;
+
+// Largest edit body; read up to this and refused past it, rather than held whole whatever its size
+static constexpr size_t kMaxEditBodyBytes = 16 * 1024 * 1024;
+
+// Answer 413 to an edit body over kMaxEditBodyBytes
+static void refuseLargeEdit(httplib::Response &res)
+{
+    res.set_content("{\"error\": \"Edit body larger than " + std::to_string(kMaxEditBodyBytes) + " bytes\"}",
+                    "application/json");
+    res.status = 413;
+}
+
+// Parse an edit body: {"changes": [{"op": "update", "key": {...}, "values": {...}, "version": "0x..."}, ...]}
+static bool readChanges(const std::string &body, std::vector<Data::RowChange> &changes, std::string &error)
+{
+    Data::JsonReader reader(body);
+    std::string name;
+    std::string value;
+    bool null = false;
+
+    auto readColumns = [&](std::vector<Data::ColumnValue> &columns) {
+        if (!reader.beginObject())
+            return false;
+        std::string column;
+        while (reader.nextKey(column))
+        {
+            if (!reader.readValue(value, null))
+                return false;
+            columns.emplace_back(column, null ? Data::KeyValue() : Data::KeyValue(value));
+        }
+        return !reader.failed();
+    };
+
+    if (!reader.beginObject())
+    {
+        error = reader.error();
+        return false;
+    }
+    while (reader.nextKey(name))
+    {
+        if (name != "changes")
+        {
+            error = "Unknown field: " + name;
+            return false;
+        }
+        if (!reader.beginArray())
+            break;
+        while (reader.nextElement())
+        {
+            std::string where = "Change " + std::to_string(changes.size()) + ": ";
+            if (changes.size() == kMaxEditChanges)
+            {
+                error = "At most " + std::to_string(kMaxEditChanges) + " changes per edit";
+                return false;
+            }
+
+            Data::RowChange change;
+            bool hasKind = false;
+            if (!reader.beginObject())
+                break;
+            while (reader.nextKey(name))
+            {
+                if (name == "op")
+                {
+                    if (!reader.readValue(value, null))
+                        break;
+                    hasKind = true;
+                    if (value == "insert")
+                        change.kind = Data::ChangeKind::Insert;
+                    else if (value == "update")
+                        change.kind = Data::ChangeKind::Update;
+                    else if (value == "delete")
+                        change.kind = Data::ChangeKind::Delete;
+                    else
+                        hasKind = false;
+                    if (!hasKind)
+                    {
+                        error = where + "op must be insert, update or delete";
+                        return false;
+                    }
+                }
+                else if (name == "key" || name == "values")
+                {
+                    if (!readColumns(name == "key" ? change.key : change.values))
+                        break;
+                }
+                else if (name == "version")
+                {
+                    if (!reader.readValue(value, null))
+                        break;
+                    if (!null)
+                        change.version = value;
+                }
+                else
+                {
+                    error = where + "unknown field " + name;
+                    return false;
+                }
+            }
+            if (reader.failed())
+            {
+                error = where + reader.error();
+                return false;
+            }
+            if (!hasKind)
+            {
+                error = where + "op is required";
+                return false;
+            }
+            changes.push_back(std::move(change));
+        }
+    }
+
+    if (reader.failed())
+        error = reader.error();
+    else if (!reader.atEnd())
+        error = "Unexpected text after the body";
+    else if (changes.empty())
+        error = "No changes";
+    return error.empty();
+}
+
+// Rows per transaction of an import when the request does not say, and the most it may ask for
+static constexpr size_t kDefaultImportBatchRows = 1000;
+static constexpr size_t kMaxImportBatchRows = 100000;
+
+// Cell bytes after which a batch is queued whatever its rows, so wide rows do not make huge transactions
+static constexpr size_t kMaxImportBatchBytes = 32 * 1024 * 1024;
+
+// Batches parsed ahead of the database: enough to keep the writer busy, little to hold in memory
+static constexpr size_t kImportQueueBatches = 2;
+
+/**
+ * @brief A bulk import in flight
+ *
+ * The request's thread parses the upload into batches as it arrives while a
+ * writer thread inserts the previous ones, so parsing overlaps the database
+ * round trips. Each batch is one transaction: a failed batch is rolled back
+ * whole and either stops the import (onError=abort) or is reported and
+ * skipped (onError=continue).
+ */
+struct ImportPipeline
+{
+    struct Batch
+    {
+        Data::ResultSet rows;
+        uint64_t number = 0;   ///< 1-based
+        uint64_t firstRow = 0; ///< Upload data row of its first row, 1-based
+    };
+
+    struct FailedBatch
+    {
+        uint64_t number = 0;
+        uint64_t firstRow = 0;
+        size_t rows = 0;
+        long long failedRow = -1; ///< Upload data row the engine rejected, -1 when it does not tell
+        std::string error;
+    };
+
+    // Declared before the writer, which keeps a reference to it
+    std::shared_ptr<Data::CancellationToken> cancel;
+    size_t watchId = 0;
+    std::unique_ptr<Data::RowWriter> writer;
+    bool stopOnError = true;
+    size_t batchRows = kDefaultImportBatchRows;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Batch> queued;
+    std::vector<Data::ResultSet> spare; ///< Written batches, their memory reused
+    size_t inFlight = 0;                ///< Batches queued or being written
+    bool closed = false;                ///< No more batches will be queued
+    bool stopped = false;               ///< A batch failed and onError=abort
+
+    // Filled by the writer thread, read once it is joined
+    uint64_t rows = 0;
+    uint64_t batches = 0;
+    uint64_t failedRows = 0;
+    std::vector<FailedBatch> failed;
+
+    // Parser side
+    Batch next;
+    size_t nextBytes = 0; ///< Cell bytes of next
+    uint64_t queuedRows = 0;
+
+    ~ImportPipeline()
+    {
+        close();
+        Data::QueryWatchdog::getInstance().unwatch(watchId);
+    }
+
+    void start(const std::vector<std::string> &columns)
+    {
+        for (const std::string &column : columns)
+            next.rows.addColumn(column);
+        next.number = 1;
+        next.firstRow = 1;
+        thread = std::thread([this]() { run(); });
+    }
+
+    /**
+     * @brief Queue the batch being filled, waiting while the writer is kImportQueueBatches behind
+     * @return false when the import stopped: a batch failed with onError=abort, or the client went away
+     */
+    bool submit()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (inFlight >= kImportQueueBatches && !stopped && !cancel->isCancelled())
+            changed.wait_for(lock, kExportPollInterval);
+        if (stopped || cancel->isCancelled())
+            return false;
+
+        queuedRows += next.rows.rowCount();
+        uint64_t number = next.number + 1;
+        queued.push_back(std::move(next));
+        inFlight++;
+
+        next = Batch();
+        nextBytes = 0;
+        if (!spare.empty())
+        {
+            next.rows = std::move(spare.back());
+            spare.pop_back();
+        }
+        else
+        {
+            for (size_t i = 0; i < queued.back().rows.columnCount(); i++)
+                next.rows.addColumn(queued.back().rows.columnName(i));
+        }
+        next.number = number;
+        next.firstRow = queuedRows + 1;
+        changed.notify_all();
+        return true;
+    }
+
+    // Let the writer drain what is queued and wait for it
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            changed.wait(lock, [this]() { return !queued.empty() || closed; });
+            if (queued.empty())
+                return;
+
+            Batch batch = std::move(queued.front());
+            queued.pop_front();
+
+            // Once stopped, or once the client is gone, what is left is dropped rather than written
+            bool skip = stopped || cancel->isCancelled();
+            lock.unlock();
+            bool written = false;
+            std::string thrown;
+            try
+            {
+                written = !skip && writer->write(batch.rows);
+            }
+            catch (const std::exception &e)
+            {
+                thrown = e.what();
+            }
+            catch (...)
+            {
+                thrown = "Unknown error";
+            }
+            lock.lock();
+
+            if (written)
+            {
+                rows += batch.rows.rowCount();
+                batches++;
+            }
+            else if (!skip)
+            {
+                FailedBatch failure;
+                failure.number = batch.number;
+                failure.firstRow = batch.firstRow;
+                failure.rows = batch.rows.rowCount();
+                if (thrown.empty() && writer->failedRow() >= 0)
+                    failure.failedRow = static_cast<long long>(batch.firstRow) + writer->failedRow();
+                failure.error = thrown.empty() ? writer->error() : thrown;
+                failedRows += failure.rows;
+                failed.push_back(std::move(failure));
+                // A throw leaves the writer in no known state, so the import stops whatever onError says
+                if (stopOnError || !thrown.empty())
+                    stopped = true;
+            }
+
+            batch.rows.clearRows();
+            spare.push_back(std::move(batch.rows));
+            inFlight--;
+            changed.notify_all();
+        }
+    }
+};
+
+// A watcher that hears nothing gets a comment this often, so proxies keep the stream open and a
+// client that went away is noticed
+static constexpr auto kWatchKeepAlive = std::chrono::seconds(15);
+
+// How often a waiting watch checks that its client is still there
+static constexpr auto kWatchCheckInterval = std::chrono::milliseconds(1000);
+
+// Rows a watcher is shown: those whose key lies within [from, to], either bound optional
+struct WatchWindow
+{
+    std::string keyColumn;
+    std::string from;
+    std::string to;
+    bool hasFrom = false;
+    bool hasTo = false;
+};
+
+// Compare a key cell with a bound: numerically for numeric keys, byte by byte otherwise
+static int compareKey(Data::ValueKind kind, std::string_view value, const std::string &bound)
+{
+    if (kind == Data::ValueKind::Integer || kind == Data::ValueKind::Float || kind == Data::ValueKind::Decimal)
+    {
+        double left = std::strtod(std::string(value).c_str(), nullptr);
+        double right = std::strtod(bound.c_str(), nullptr);
+        return left < right ? -1 : (left > right ? 1 : 0);
+    }
+    int order = value.compare(bound);
+    return order < 0 ? -1 : (order > 0 ? 1 : 0);
+}
+
+// Whether a row of changes lies in the window; rows without the key column always do
+static bool inWindow(const WatchWindow &window, const Data::ResultSet &rows, size_t row, size_t keyIndex)
+{
+    if (keyIndex >= rows.columnCount() || rows.isNull(row, keyIndex))
+        return !window.hasFrom && !window.hasTo;
+
+    Data::ValueKind kind = rows.columnKind(keyIndex);
+    std::string_view value = rows.value(row, keyIndex);
+    if (window.hasFrom && compareKey(kind, value, window.from) < 0)
+        return false;
+    if (window.hasTo && compareKey(kind, value, window.to) > 0)
+        return false;
+    return true;
+}
+
+static size_t columnIndex(const Data::ResultSet &rows, const std::string &name)
+{
+    for (size_t c = 0; c < rows.columnCount(); c++)
+    {
+        if (rows.columnName(c) == name)
+            return c;
+    }
+    return rows.columnCount();
+}
+
+// Append the rows of changes within the window as a JSON array; counts the others in outside
+static void appendWindowRows(std::string &out, const WatchWindow &window, const Data::ResultSet &rows,
+                             size_t &outside)
+{
+    std::vector<std::string> keys = jsonKeys(rows, rows.columnCount());
+    size_t keyIndex = columnIndex(rows, window.keyColumn);
+
+    out += "[";
+    bool first = true;
+    for (size_t r = 0; r < rows.rowCount(); r++)
+    {
+        if (!inWindow(window, rows, r, keyIndex))
+        {
+            outside++;
+            continue;
+        }
+        if (!first)
+            out += ",";
+        appendRowJson(out, rows, r, keys);
+        first = false;
+    }
+    out += "]";
+}
+
+// Append one Server-Sent Event
+static void appendEvent(std::string &out, const char *event, const std::string &data, uint64_t id = 0)
+{
+    out += "event: ";
+    out += event;
+    out += "\n";
+    if (id > 0)
+        out += "id: " + std::to_string(id) + "\n";
+    out += "data: " + data + "\n\n";
+}
+
+// Encode one update of a watched table as the event a client receives
+static std::string watchEvent(const Data::ChangeFeed::Update &update, const WatchWindow &window)
+{
+    std::string out;
+    if (!update.changes)
+    {
+        std::string data = "{\"error\": ";
+        appendJsonString(data, update.error);
+        appendEvent(out, "error", data + "}", update.sequence);
+        return out;
+    }
+    if (update.changes->stale)
+    {
+        // What the client shows has to be reread: the changes are too many or not known row by row
+        appendEvent(out, "stale", "{}", update.sequence);
+        return out;
+    }
+
+    size_t outside = 0;
+    std::string data = "{\"rows\": ";
+    appendWindowRows(data, window, update.changes->rows, outside);
+    data += ", \"deleted\": ";
+    appendWindowRows(data, window, update.changes->deleted, outside);
+    data += ", \"outside\": " + std::to_string(outside) + "}";
+    appendEvent(out, "changes", data, update.sequence);
+    return out;
+}
+
+// A client following a table, owned by the response's content provider
+struct WatchStream
+{
+    std::shared_ptr<Data::ChangeFeed::Watcher> watcher;
+    WatchWindow window;
+    bool started = false;
+};
+
+// Send the next event of a watch: waits for the table's next update, or sends a keep-alive comment
+static bool streamWatch(WatchStream &stream, httplib::DataSink &sink)
+{
+    if (!sink.is_writable())
+        return false;
+
+    std::string out;
+    if (!stream.started)
+    {
+        std::string data = "{\"method\": ";
+        appendJsonString(data, stream.watcher->method());
+        data += ", \"interval\": " + std::to_string(Data::ChangeFeed::getInstance().pollSeconds());
+        data += ", \"keyColumn\": ";
+        if (stream.window.keyColumn.empty())
+            data += "null";
+        else
+            appendJsonString(data, stream.window.keyColumn);
+        out = "retry: 5000\n\n";
+        appendEvent(out, "ready", data + "}");
+        stream.started = true;
+    }
+    else
+    {
+        // Waiting in slices notices a client that went away before its slot is held for a whole keep-alive
+        Data::ChangeFeed::Update update;
+        auto waited = std::chrono::milliseconds(0);
+        while (!stream.watcher->next(update, kWatchCheckInterval))
+        {
+            waited += kWatchCheckInterval;
+            if (!sink.is_writable())
+                return false;
+            if (waited >= kWatchKeepAlive)
+                break;
+        }
+        out = waited >= kWatchKeepAlive ? ": keepalive\n\n" : watchEvent(update, stream.window);
+    }
+    return sink.write(out.data(), out.size());
+}
+
+// Parts a batch may hold
+static constexpr size_t kMaxBatchParts = 16;
+
+// Largest batch body, read up to this like an edit body: a batch holding an edit carries it escaped inside the JSON
+static constexpr size_t kMaxBatchBodyBytes = 2 * kMaxEditBodyBytes;
+
+// Threads a batch runs its parts on; parts past them wait for one to be free
+static constexpr size_t kBatchWorkers = 4;
+
+// One request of a batch, and once it ran, its response
+struct BatchPart
+{
+    std::string id;
+    std::string method = "GET";
+    std::string path;
+    httplib::Params params;
+    std::string body;
+    std::vector<std::string> dependsOn;
+    std::vector<size_t> dependencies; ///< Indexes of the parts named by dependsOn
+    httplib::Server::Handler handler;
+
+    httplib::Response response;
+    bool done = false;
+    bool failed = false; ///< An error status or {"success": false}: parts depending on it do not run
+};
+
+// Read the parts of a batch: {"requests": [{"id", "method", "path", "params", "body", "dependsOn"}, ...]}
+static bool readBatch(const std::string &body, std::vector<BatchPart> &parts, std::string &error)
+{
+    Data::JsonReader reader(body);
+    std::string key;
+    std::string value;
+    bool null = false;
+    bool found = false;
+
+    if (!reader.beginObject())
+    {
+        error = reader.error();
+        return false;
+    }
+    while (reader.nextKey(key))
+    {
+        if (key != "requests")
+        {
+            if (!reader.readValue(value, null))
+                break;
+            continue;
+        }
+        found = true;
+        if (!reader.beginArray())
+            break;
+        while (reader.nextElement())
+        {
+            if (parts.size() == kMaxBatchParts)
+            {
+                error = "A batch holds at most " + std::to_string(kMaxBatchParts) + " requests";
+                return false;
+            }
+            BatchPart part;
+            if (!reader.beginObject())
+                break;
+            while (reader.nextKey(key))
+            {
+                if (key == "params")
+                {
+                    if (!reader.beginObject())
+                        break;
+                    std::string name;
+                    while (reader.nextKey(name))
+                    {
+                        if (!reader.readValue(value, null))
+                            break;
+                        if (!null)
+                            part.params.emplace(name, value);
+                    }
+                }
+                else if (key == "dependsOn")
+                {
+                    if (!reader.beginArray())
+                        break;
+                    while (reader.nextElement() && reader.readValue(value, null))
+                        part.dependsOn.push_back(value);
+                }
+                else if (reader.readValue(value, null))
+                {
+                    // An object body is sent as its JSON text, a string body as it is
+                    if (key == "id")
+                        part.id = value;
+                    else if (key == "method")
+                        part.method = value;
+                    else if (key == "path")
+                        part.path = value;
+                    else if (key == "body" && !null)
+                        part.body = value;
+                }
+            }
+            if (reader.failed())
+                break;
+            parts.push_back(std::move(part));
+        }
+    }
+    if (reader.failed() || !reader.atEnd())
+    {
+        error = reader.failed() ? reader.error() : "Unexpected text after the batch";
+        return false;
+    }
+    if (!found || parts.empty())
+    {
+        error = "No requests";
+        return false;
+    }
+
+    // A part depends only on parts listed before it, which rules out cycles
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        BatchPart &part = parts[i];
+        if (part.id.empty())
+            part.id = std::to_string(i);
+        for (const std::string &name : part.dependsOn)
+        {
+            size_t d = 0;
+            while (d < i && parts[d].id != name)
+                d++;
+            if (d == i)
+            {
+                error = "Request " + part.id + " depends on " + name + ", which is not listed before it";
+                return false;
+            }
+            part.dependencies.push_back(d);
+        }
+    }
+    return true;
+}
+
+// Run one part of a batch as a request of its own, with the batch's credentials, session and deadline
+static void runBatchPart(const httplib::Request &req, BatchPart &part)
+{
+    httplib::Request sub;
+    sub.method = part.method;
+    sub.path = part.path;
+    sub.params = req.params;
+    for (const auto &param : part.params)
+    {
+        sub.params.erase(param.first);
+        sub.params.emplace(param.first, param.second);
+    }
+    for (const char *header : {"Authorization", "X-Request-Timeout", "Cache-Control"})
+    {
+        if (req.has_header(header))
+            sub.set_header(header, req.get_header_value(header));
+    }
+    if (!part.body.empty())
+        sub.set_header("Content-Type", "application/json");
+    sub.body = part.body;
+    sub.remote_addr = req.remote_addr;
+    sub.is_connection_closed = req.is_connection_closed;
+
+    AuthController::VerifiedScope verified(AuthController::extractToken(req));
+    part.handler(sub, part.response);
+    if (part.response.status == -1)
+        part.response.status = 200;
+}
+
+// Run the parts of a batch, each as soon as the parts it depends on are done
+static void runBatch(const httplib::Request &req, std::vector<BatchPart> &parts)
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    auto run = [&](BatchPart &part) {
+        std::string failedDependency;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() {
+                return std::all_of(part.dependencies.begin(), part.dependencies.end(),
+                                   [&](size_t d) { return parts[d].done; });
+            });
+            for (size_t d : part.dependencies)
+            {
+                if (parts[d].failed && failedDependency.empty())
+                    failedDependency = parts[d].id;
+            }
+        }
+
+        if (failedDependency.empty())
+        {
+            // A part that throws fails alone instead of taking the process down with its thread
+            std::string thrown;
+            try
+            {
+                runBatchPart(req, part);
+            }
+            catch (const std::exception &e)
+            {
+                thrown = e.what();
+            }
+            catch (...)
+            {
+                thrown = "Unknown error";
+            }
+            if (!thrown.empty())
+            {
+                std::string body = "{\"error\": ";
+                appendJsonString(body, thrown);
+                part.response = httplib::Response();
+                part.response.set_content(body + "}", "application/json");
+                part.response.status = 500;
+            }
+        }
+        else
+        {
+            std::string body = "{\"error\": ";
+            appendJsonString(body, "Dependency failed: " + failedDependency);
+            part.response.set_content(body + "}", "application/json");
+            part.response.status = 424;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        part.done = true;
+        part.failed = part.response.status >= 400 || part.response.body.rfind("{\"success\": false", 0) == 0;
+        changed.notify_all();
+    };
+
+    // Workers take the parts in list order, so the parts one waits for are already taken: it never waits on a part
+    // no worker runs
+    size_t next = 0;
+    auto work = [&]() {
+        while (true)
+        {
+            BatchPart *part = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (next == parts.size())
+                    return;
+                part = &parts[next++];
+            }
+            run(*part);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(kBatchWorkers, parts.size()); i++)
+        workers.emplace_back(work);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// Append the responses of a batch's parts, in the order they were listed
+static void appendBatchResponses(std::string &out, const std::vector<BatchPart> &parts)
+{
+    out += "{\"responses\": [";
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        const BatchPart &part = parts[i];
+        const httplib::Response &response = part.response;
+        if (i > 0)
+            out += ",";
+        out += "{\"id\": ";
+        appendJsonString(out, part.id);
+        out += ", \"status\": " + std::to_string(response.status);
+
+        std::string contentType;
+        out += ", \"headers\": {";
+        bool first = true;
+        for (const auto &header : response.headers)
+        {
+            if (header.first == "Content-Type")
+            {
+                contentType = header.second;
+                continue;
+            }
+            if (!first)
+                out += ",";
+            appendJsonString(out, header.first);
+            out += ":";
+            appendJsonString(out, header.second);
+            first = false;
+        }
+        out += "}, \"body\": ";
+
+        // JSON responses are embedded as they are, anything else as a string
+        if (response.body.empty())
+            out += "null";
+        else if (contentType.rfind("application/json", 0) == 0)
+            out += response.body;
+        else
+            appendJsonString(out, response.body);
+        out += "}";
+    }
+    out += "]}";
+}
+
+void BrowserosoController::setRequestTimeout(int seconds)
+{
+    if (seconds > 0)
+        s_requestTimeoutSeconds = seconds;
 }
 
 void BrowserosoController::registerRoutes(httplib::Server &server)
 {
-    // Note: /browseroso page is served by StaticController
-    // Here we only register the API endpoints
-    server.Post("/api/browseroso/connect", connectDatabase);
-    server.Post("/api/browseroso/disconnect", disconnectDatabase);
-    server.Get("/api/browseroso/status", getConnectionStatus);
-    server.Get("/api/browseroso/databases", getDatabases);
-    server.Post("/api/browseroso/database", changeDatabase);
-    server.Get("/api/browseroso/tables", getTables);
-    server.Get("/api/browseroso/columns", getTableColumns);
-    server.Get("/api/browseroso/data", getTableData);
+    // Note: /browseroso page is served by StaticController
+    // Here we only register the API endpoints
+    server.Post("/api/browseroso/connect", connectDatabase);
+    server.Post("/api/browseroso/disconnect", disconnectDatabase);
+    server.Get("/api/browseroso/status", getConnectionStatus);
+    server.Get("/api/browseroso/databases", getDatabases);
+    server.Post("/api/browseroso/database", changeDatabase);
+    server.Get("/api/browseroso/tables", getTables);
+    server.Get("/api/browseroso/columns", getTableColumns);
+    server.Get("/api/browseroso/data", getTableData);
+    server.Get("/api/browseroso/count", getTableCount);
+    server.Get("/api/browseroso/export", exportTable);
+    server.Get("/api/browseroso/exports", getExports);
+    server.Post("/api/browseroso/import", importTable);
+    server.Post("/api/browseroso/edit", editRows);
+    server.Get("/api/browseroso/watch", watchTable);
+    server.Post("/api/browseroso/batch", runBatchRequests);
+    server.Get("/api/browseroso/jobs", getJobResult);
+    server.Delete("/api/browseroso/jobs", cancelJob);
+    server.Get("/api/browseroso/metrics", getMetrics);
+}
+
+void BrowserosoController::getBrowserosoUI(const httplib::Request &req, httplib::Response &res)
+{
+    // Check authentication - redirect to login if not authenticated
+    std::string token = AuthController::extractToken(req);
+    if (token.empty())
+    {
+        // Check for token in cookies or session storage (via query param for redirect)
+        res.set_content(generateBrowserosoHTML(), "text/html; charset=utf-8");
+        return;
+    }
+    res.set_content(generateBrowserosoHTML(), "text/html; charset=utf-8");
+}
+
+void BrowserosoController::connectDatabase(const httplib::Request &req, httplib::Response &res)
+{
+    // Verify JWT authentication
+    if (!AuthController::verifyAuth(req, res))
+    {
+        return;
+    }
+
+    auto db = Data::ConnectionManager::getInstance().getConnection(getSessionId(req));
+
+    std::string connStr = "Data Source=localhost;Initial Catalog=master;Integrated Security=True;"
+                          "Persist Security Info=False;Pooling=False;MultipleActiveResultSets=False;"
+                          "Encrypt=False;TrustServerCertificate=True";
+
+    if (!req.body.empty())
+    {
+        auto pos = req.body.find("\"connectionString\"");
+        if (pos != std::string::npos)
+        {
+            auto start = req.body.find(':', pos) + 1;
+            auto quote1 = req.body.find('"', start);
+            auto quote2 = req.body.find('"', quote1 + 1);
+            if (quote1 != std::string::npos && quote2 != std::string::npos)
+            {
+                connStr = req.body.substr(quote1 + 1, quote2 - quote1 - 1);
+            }
+        }
+    }
+
+    // A server whose circuit is open is refused at once instead of holding this worker for the login timeout
+    int retryAfter = 0;
+    if (!Data::ConnectionPool::getInstance().checkCircuit(connStr, retryAfter))
+    {
+        refuseUnavailable(res, retryAfter);
+        return;
+    }
+
+    bool success = db->connect(connStr);
+
+    std::ostringstream json;
+    json << "{\"success\": " << (success ? "true" : "false") << ",";
+    json << "\"message\": \"" << (success ? "Connected successfully" : "Connection failed") << "\",";
+    std::string info;
+    appendJsonString(info, db->getConnectionInfo());
+    json << "\"info\": " << info << "}";
+
+    res.set_content(json.str(), "application/json");
+}
+
+void BrowserosoController::disconnectDatabase(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    std::string sessionId = getSessionId(req);
+    Data::PagePrefetcher::getInstance().discard(sessionId);
+    Data::ConnectionManager::getInstance().removeConnection(sessionId);
+    res.set_content("{\"success\": true, \"message\": \"Disconnected\"}", "application/json");
+}
+
+void BrowserosoController::getConnectionStatus(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+    bool connected = db && db->isConnected();
+    std::string info = connected ? db->getConnectionInfo() : "Not connected";
+
+    std::ostringstream json;
+    json << "{\"connected\": " << (connected ? "true" : "false") << ",";
+    json << "\"info\": \"" << info << "\"}";
+    res.set_content(json.str(), "application/json");
+}
+
+void BrowserosoController::getDatabases(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    std::string etag;
+    auto databases = db->getDatabases(etag);
+    if (notModified(req, res, etag))
+        return;
+
+    std::ostringstream json;
+    json << "{\"databases\": [";
+    for (size_t i = 0; i < databases.size(); i++)
+    {
+        if (i > 0)
+            json << ",";
+        json << "\"" << databases[i] << "\"";
+    }
+    json << "]}";
+    res.set_content(json.str(), "application/json");
+}
+
+void BrowserosoController::changeDatabase(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    // Parse database name from request body
+    std::string databaseName;
+    if (!req.body.empty())
+    {
+        auto pos = req.body.find("\"database\"");
+        if (pos != std::string::npos)
+        {
+            auto start = req.body.find(':', pos) + 1;
+            auto quote1 = req.body.find('"', start);
+            auto quote2 = req.body.find('"', quote1 + 1);
+            if (quote1 != std::string::npos && quote2 != std::string::npos)
+            {
+                databaseName = req.body.substr(quote1 + 1, quote2 - quote1 - 1);
+            }
+        }
+    }
+
+    if (databaseName.empty())
+    {
+        res.set_content("{\"error\": \"Database name required\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    // Pages prefetched or still loading belong to the old database
+    Data::PagePrefetcher::getInstance().discard(getSessionId(req));
+
+    bool success = db->useDatabase(databaseName);
+    std::ostringstream json;
+    json << "{\"success\": " << (success ? "true" : "false") << ",";
+    json << "\"message\": \"" << (success ? "Changed to " + databaseName : "Failed to change database") << "\",";
+    json << "\"info\": \"" << db->getConnectionInfo() << "\"}";
+    res.set_content(json.str(), "application/json");
+}
+
+void BrowserosoController::getTables(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    std::string etag;
+    auto tables = db->getTables(etag);
+    if (notModified(req, res, etag))
+        return;
+
+    std::ostringstream json;
+    json << "{\"tables\": [";
+    for (size_t i = 0; i < tables.size(); i++)
+    {
+        if (i > 0)
+            json << ",";
+        json << "{\"schema\": \"" << tables[i].schema << "\",\"name\": \"" << tables[i].name << "\"}";
+    }
+    json << "]}";
+    res.set_content(json.str(), "application/json");
+}
+
+void BrowserosoController::getTableColumns(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+
+    if (table.empty())
+    {
+        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    std::string etag;
+    auto columns = db->getColumns(schema, table, etag);
+    if (notModified(req, res, etag))
+        return;
+
+    std::ostringstream json;
+    json << "{\"columns\": [";
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        if (i > 0)
+            json << ",";
+        json << "{\"name\": \"" << columns[i].name << "\",";
+        json << "\"type\": \"" << columns[i].type << "\",";
+        json << "\"nullable\": " << (columns[i].nullable ? "true" : "false") << ",";
+        json << "\"isPrimaryKey\": " << (columns[i].isPrimaryKey ? "true" : "false") << ",";
+        json << "\"isIndexed\": " << (columns[i].isIndexed ? "true" : "false") << ",";
+        json << "\"isFullTextIndexed\": " << (columns[i].isFullTextIndexed ? "true" : "false") << ",";
+        json << "\"references\": [";
+        for (size_t r = 0; r < columns[i].references.size(); r++)
+        {
+            const Data::ColumnReference &reference = columns[i].references[r];
+            json << (r > 0 ? "," : "") << "{\"foreignKey\": \"" << reference.foreignKey << "\",\"schema\": \""
+                 << reference.referencedSchema << "\",\"table\": \"" << reference.referencedTable
+                 << "\",\"column\": \"" << reference.referencedColumn << "\"}";
+        }
+        json << "]}";
+    }
+    json << "]}";
+    res.set_content(json.str(), "application/json");
+}
+
+void BrowserosoController::getTableData(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+    Data::RowFilter filter;
+    if (!readFilter(req, res, filter))
+        return;
+
+    std::vector<Data::SortKey> sortKeys;
+    std::string sortSpec;
+    if (!readSort(req, res, sortKeys, sortSpec))
+        return;
+
+    Data::RowProjection projection;
+    std::string projectionSpec;
+    if (!readProjection(req, res, projection, projectionSpec))
+        return;
+
+    int page = 1, pageSize = 50;
+    if (!req.get_param_value("page").empty())
+        page = std::stoi(req.get_param_value("page"));
+    if (!req.get_param_value("pageSize").empty())
+        pageSize = std::stoi(req.get_param_value("pageSize"));
+
+    // count=auto (default) | exact | deferred
+    Data::CountMode countMode = Data::CountMode::Auto;
+    std::string countParam = req.get_param_value("count");
+    if (countParam == "exact")
+        countMode = Data::CountMode::Exact;
+    else if (countParam == "deferred")
+        countMode = Data::CountMode::Deferred;
+
+    // "Accept: application/vnd.apache.arrow.stream" answers with an Arrow IPC stream: the page
+    // metadata in the schema's "browseroso.page" entry, the rows as one record batch whose buffers
+    // are compressed with compression=lz4|zstd
+    bool arrow = req.get_header_value("Accept").find(Data::kArrowStreamContentType) != std::string::npos;
+    Data::ArrowCompression compression = Data::ArrowCompression::None;
+    std::string compressionParam = req.get_param_value("compression");
+    if (!Data::parseArrowCompression(compressionParam, compression))
+    {
+        res.set_content("{\"error\": \"Unsupported compression\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    std::string format = arrow ? "arrow:" + compressionParam : "json";
+    std::string contentType = arrow ? Data::kArrowStreamContentType : "application/json";
+    res.set_header("Vary", "Accept");
+
+    if (table.empty())
+    {
+        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    std::vector<Expansion> expansions;
+    std::string expandSpec;
+    if (!readExpansions(req, res, *db, schema, table, projection, expansions, expandSpec))
+        return;
+    for (const Expansion &expansion : expansions)
+        projection.whole.insert(projection.whole.end(), expansion.columns.begin(), expansion.columns.end());
+
+    // Pages are shared across sessions reading the same target with the same credentials
+    auto &pageCache = Data::PageCache::getInstance();
+    std::string targetKey = db->getTargetKey();
+    std::string tableKey = Data::PageCache::makeTableKey(targetKey, schema, table);
+    std::string queryKey =
+        Data::PageCache::makeKey(tableKey, {std::to_string(pageSize), countParam, filter.column,
+                                            Data::filterModeName(filter.mode), filter.value, sortSpec,
+                                            projectionSpec, expandSpec});
+
+    // A page read from a keyset cursor is cached apart from the same page read at an OFFSET:
+    // the cursor is client input, so it must not decide what other requests for the page get.
+    // Each format is cached apart too; cursors stay valid across formats
+    auto pageKey = [queryKey, format](int number, const std::string &cursor) {
+        return Data::PageCache::makeKey(queryKey, {std::to_string(number), cursor, format});
+    };
+
+    // cursor=<nextCursor of the previous page> reads the page from after that page's last row
+    std::string cursor = req.get_param_value("cursor");
+    if (!cursor.empty())
+    {
+        int cursorPage = 0;
+        std::vector<Data::KeyValue> after;
+        if (!decodeCursor(cursor, queryKey, cursorPage, after) ||
+            (!req.get_param_value("page").empty() && cursorPage != page))
+        {
+            res.set_content("{\"error\": \"Invalid cursor\"}", "application/json");
+            res.status = 400;
+            return;
+        }
+        page = cursorPage;
+    }
+    std::string cacheKey = pageKey(page, cursor);
+
+    std::string sessionId = getSessionId(req);
+    auto &prefetcher = Data::PagePrefetcher::getInstance();
+    std::shared_future<Data::PageCache::Page> prefetched;
+
+    // "Cache-Control: no-cache" (a refresh) drops the table's cached and prefetched pages first
+    if (req.get_header_value("Cache-Control").find("no-cache") != std::string::npos)
+    {
+        pageCache.invalidateTable(tableKey);
+        prefetcher.discard(sessionId);
+    }
+    else
+    {
+        prefetched = prefetcher.claim(sessionId, queryKey, cacheKey);
+    }
+
+    auto load = [=](int number, const std::string &cursor, Data::CancellationToken &cancel, bool &cacheable,
+                    bool &lastPage) {
+        cacheable = false;
+        Data::RowOrder order;
+        order.keys = sortKeys;
+        int cursorPage = 0;
+        if (!cursor.empty())
+            decodeCursor(cursor, queryKey, cursorPage, order.after);
+
+        auto result = db->selectData(schema, table, filter, order, projection, number, pageSize, countMode, cancel);
+        if (!result.success && cancel.isCancelled())
+            return cancelledResult(cancel);
+
+        std::ostringstream json;
+        json << "{\"success\": " << (result.success ? "true" : "false") << ",";
+
+        if (!result.success)
+        {
+            std::string escapedError;
+            for (char c : result.error)
+            {
+                if (c == '"')
+                    escapedError += "\\\"";
+                else if (c == '\\')
+                    escapedError += "\\\\";
+                else if (c == '\n')
+                    escapedError += "\\n";
+                else if (c == '\r')
+                    escapedError += "\\r";
+                else
+                    escapedError += c;
+            }
+            json << "\"error\": \"" << escapedError << "\"}";
+            return Core::JobResult{200, json.str()};
+        }
+
+        if (result.totalRowsPending)
+        {
+            json << "\"totalRows\": null,\"totalPages\": null,\"countPending\": true,";
+        }
+        else
+        {
+            json << "\"totalRows\": " << result.totalRows << ",";
+            json << "\"totalPages\": " << ((result.totalRows + pageSize - 1) / pageSize) << ",";
+            json << "\"countPending\": false,";
+        }
+        json << "\"totalRowsApproximate\": " << (result.totalRowsApproximate ? "true" : "false") << ",";
+        json << "\"page\": " << number << ",\"pageSize\": " << pageSize << ",";
+        if (!result.lastKey.empty())
+            json << "\"nextCursor\": \"" << encodeCursor(queryKey, number + 1, result.lastKey) << "\",";
+        else
+            json << "\"nextCursor\": null,";
+        json << "\"sort\": [";
+        for (size_t i = 0; i < sortKeys.size() && i < result.order.size(); i++)
+        {
+            const Data::SortKey &key = result.order[i];
+            json << (i > 0 ? "," : "") << "{\"column\": \"" << key.column << "\",\"direction\": \""
+                 << (key.descending ? "desc" : "asc") << "\",\"indexed\": " << (key.indexed ? "true" : "false")
+                 << "}";
+        }
+        json << "],";
+        if (filter.isActive())
+            json << "\"filterMode\": \"" << Data::filterModeName(result.filterMode) << "\",";
+        else
+            json << "\"filterMode\": null,";
+        if (projection.previewLength > 0)
+            json << "\"preview\": " << projection.previewLength << ",";
+        else
+            json << "\"preview\": null,";
+        size_t columnCount = result.selectedColumns();
+        json << "\"columns\": [";
+        for (size_t i = 0; i < columnCount; i++)
+        {
+            if (i > 0)
+                json << ",";
+            json << "\"" << result.data.columnName(i) << "\"";
+        }
+        json << "],\"columnTypes\": [";
+        for (size_t i = 0; i < columnCount; i++)
+        {
+            if (i > 0)
+                json << ",";
+            json << "\"" << Data::valueKindName(result.data.columnKind(i)) << "\"";
+        }
+        json << "],";
+
+        // Referenced rows go with the page metadata, so Arrow responses carry them too
+        if (!expansions.empty())
+        {
+            std::string expanded;
+            std::string error;
+            if (!appendExpansions(expanded, *db, expansions, result, projection, cancel, error))
+            {
+                if (cancel.isCancelled())
+                    return cancelledResult(cancel);
+                std::string body = "{\"success\": false, \"error\": ";
+                appendJsonString(body, error);
+                return Core::JobResult{200, body + "}"};
+            }
+            json << expanded;
+        }
+
+        // Cells a preview cut, with their full length, so clients can fetch those values whole on demand
+        std::string truncated = "\"truncated\": [";
+        bool firstCut = true;
+        for (size_t r = 0; r < result.data.rowCount(); r++)
+        {
+            for (const Data::PreviewColumn &preview : result.previews)
+            {
+                if (result.data.isNull(r, preview.lengthColumn))
+                    continue;
+                truncated += firstCut ? "{\"row\": " : ",{\"row\": ";
+                truncated += std::to_string(r) + ",\"column\": ";
+                appendJsonString(truncated, result.data.columnName(preview.column));
+                truncated += ",\"length\": ";
+                truncated += result.data.value(r, preview.lengthColumn);
+                truncated += "}";
+                firstCut = false;
+            }
+        }
+        truncated += "]}";
+
+        Core::JobResult response{200, json.str()};
+        if (arrow)
+        {
+            std::string metadata = response.body + truncated;
+            std::string error;
+            Data::ArrowStreamWriter writer(compression);
+            response.body.clear();
+            writer.writeSchema(response.body, result.data, columnCount, {{"browseroso.page", metadata}});
+            if (!writer.writeBatch(response.body, result.data, error))
+            {
+                response.body = "{\"success\": false, \"error\": ";
+                appendJsonString(response.body, error);
+                response.body += "}";
+                return response;
+            }
+            Data::ArrowStreamWriter::writeEnd(response.body);
+            response.contentType = contentType;
+        }
+        else
+        {
+            response.body += "\"rows\": ";
+            appendRowsJson(response.body, result.data, columnCount);
+            response.body += "," + truncated;
+        }
+
+        lastPage = result.data.rowCount() < static_cast<size_t>(pageSize) ||
+                   (!result.totalRowsPending && static_cast<long long>(number) * pageSize >= result.totalRows);
+
+        // A pending count would be served stale; a database switched meanwhile would be cached under the old one
+        cacheable = !result.totalRowsPending && db->getTargetKey() == targetKey;
+        return response;
+    };
+
+    // Read a page through the shared cache; uncached gets the response when it cannot be reused
+    auto fill = [=](int number, const std::string &cursor, Data::CancellationToken &cancel,
+                    Core::JobResult &uncached, bool &lastPage) {
+        bool filled = false;
+        auto cached = Data::PageCache::getInstance().getOrFill(
+            tableKey, pageKey(number, cursor),
+            [&]() -> Data::PageCache::Page {
+                bool cacheable = false;
+                Core::JobResult response = load(number, cursor, cancel, cacheable, lastPage);
+                filled = true;
+                if (!cacheable)
+                {
+                    uncached = std::move(response);
+                    return nullptr;
+                }
+                return std::make_shared<const std::string>(std::move(response.body));
+            },
+            cancel);
+
+        if (!cached && !filled)
+            uncached = cancelledResult(cancel);
+        return cached;
+    };
+
+    // Once this page is answered, load the ones the session will likely ask for next; the next
+    // page is read from this one's cursor, under the key a client following that cursor asks for
+    auto prefetchNext = [&](bool lastPage, const std::string &body) {
+        std::string next = nextCursorOf(body);
+        int current = page;
+        auto cursorOf = [next, current](int number) { return number == current + 1 ? next : std::string(); };
+        auto keyOf = [pageKey, cursorOf](int number) { return pageKey(number, cursorOf(number)); };
+        prefetcher.prefetch(sessionId, queryKey, page, lastPage, keyOf,
+                            [fill, cursorOf](int number, Data::CancellationToken &cancel) {
+                                Core::JobResult uncached;
+                                bool lastPage = false;
+                                return fill(number, cursorOf(number), cancel, uncached, lastPage);
+                            });
+    };
+
+    auto served = [&](const char *source, const Data::PageCache::Page &cached) {
+        res.set_header("X-Cache", source);
+        res.set_content(*cached, contentType);
+        prefetchNext(false, *cached);
+    };
+
+    // A finished prefetch answers right away; one still loading is waited for on the database pool
+    if (prefetched.valid() && prefetched.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        if (auto cached = prefetched.get())
+        {
+            served("PREFETCH", cached);
+            return;
+        }
+        prefetched = {};
+    }
+    if (!prefetched.valid())
+    {
+        if (auto cached = pageCache.lookup(cacheKey))
+        {
+            served("HIT", cached);
+            return;
+        }
+    }
+
+    auto outcome = std::make_shared<PageOutcome>();
+    respond(req, res, [=](Data::CancellationToken &cancel) {
+        // The prefetch of this page is running: its result beats starting the query again
+        if (prefetched.valid())
+        {
+            if (auto cached = Data::PagePrefetcher::waitFor(prefetched, cancel))
+            {
+                outcome->reusable = true;
+                return Core::JobResult{200, *cached, contentType};
+            }
+            if (cancel.isCancelled())
+                return cancelledResult(cancel);
+        }
+
+        Core::JobResult uncached;
+        bool lastPage = false;
+        auto cached = fill(page, cursor, cancel, uncached, lastPage);
+        outcome->lastPage = lastPage;
+        if (!cached)
+            return uncached;
+
+        outcome->reusable = true;
+        return Core::JobResult{200, *cached, contentType};
+    });
+
+    // Answers left to a 202 job, errors and uncacheable pages are not worth prefetching from
+    if (res.status == 200 && outcome->reusable)
+        prefetchNext(outcome->lastPage, res.body);
 }
 
-void BrowserosoController::getBrowserosoUI(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::getTableCount(const httplib::Request &req, httplib::Response &res)
 {
-    // Check authentication - redirect to login if not authenticated
-    std::string token = AuthController::extractToken(req);
-    if (token.empty())
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+    Data::RowFilter filter;
+    if (!readFilter(req, res, filter))
+        return;
+    bool exact = req.get_param_value("exact") == "true";
+
+    if (table.empty())
+    {
+        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    respond(req, res, [=](Data::CancellationToken &cancel) {
+        Data::RowCount count;
+        if (!db->countRows(schema, table, filter, exact, count, cancel))
+        {
+            if (cancel.isCancelled())
+                return cancelledResult(cancel);
+            return Core::JobResult{500, "{\"success\": false, \"error\": \"Failed to count rows\"}"};
+        }
+
+        std::ostringstream json;
+        json << "{\"success\": true,";
+        json << "\"totalRows\": " << count.value << ",";
+        json << "\"totalRowsApproximate\": " << (count.approximate ? "true" : "false") << "}";
+        return Core::JobResult{200, json.str()};
+    });
+}
+
+void BrowserosoController::exportTable(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto db = getDbConnection(req);
+
+    if (!db || !db->isConnected())
+    {
+        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+    if (!serverAvailable(*db, res))
+        return;
+
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+    if (table.empty())
+    {
+        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    // format=csv (default) | ndjson | json | arrow, an Arrow IPC stream compressed with compression=lz4|zstd
+    ExportFormat exportFormat = ExportFormat::Csv;
+    std::string format = req.get_param_value("format");
+    const char *contentType = "text/csv; charset=utf-8";
+    if (format.empty() || format == "csv")
+    {
+        format = "csv";
+    }
+    else if (format == "ndjson")
+    {
+        exportFormat = ExportFormat::NdJson;
+        contentType = "application/x-ndjson";
+    }
+    else if (format == "json")
+    {
+        exportFormat = ExportFormat::Json;
+        contentType = "application/json";
+    }
+    else if (format == "arrow")
+    {
+        exportFormat = ExportFormat::Arrow;
+        contentType = Data::kArrowStreamContentType;
+    }
+    else
+    {
+        res.set_content("{\"error\": \"Invalid export format\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    Data::ArrowCompression compression = Data::ArrowCompression::None;
+    std::string compressionParam = req.get_param_value("compression");
+    if (!Data::parseArrowCompression(compressionParam, compression) ||
+        (compression != Data::ArrowCompression::None && exportFormat != ExportFormat::Arrow))
+    {
+        res.set_content("{\"error\": \"Unsupported compression\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    // parallel=<connections> reads primary key ranges side by side; archive=tar sends each range as a file
+    size_t parallel = 1;
+    std::string parallelParam = req.get_param_value("parallel");
+    if (!parallelParam.empty())
+    {
+        auto parsed = std::from_chars(parallelParam.data(), parallelParam.data() + parallelParam.size(), parallel);
+        if (parsed.ec != std::errc() || parsed.ptr != parallelParam.data() + parallelParam.size() || parallel < 1 ||
+            parallel > kMaxExportParallelism)
+        {
+            res.set_content("{\"error\": \"Invalid parallelism\"}", "application/json");
+            res.status = 400;
+            return;
+        }
+    }
+
+    std::string archive = req.get_param_value("archive");
+    if (!archive.empty() && (archive != "tar" || parallel < 2))
+    {
+        res.set_content("{\"error\": \"Invalid archive\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    // Same filter, sort and columns parameters as a data page; a preview does not apply to exports
+    Data::RowFilter filter;
+    if (!readFilter(req, res, filter))
+        return;
+
+    std::vector<Data::SortKey> sortKeys;
+    std::string sortSpec;
+    if (!readSort(req, res, sortKeys, sortSpec))
+        return;
+
+    if (parallel > 1 && !sortKeys.empty())
+    {
+        res.set_content("{\"error\": \"Parallel exports cannot be sorted\"}", "application/json");
+        res.status = 400;
+        return;
+    }
+
+    Data::RowProjection projection;
+    std::string projectionSpec;
+    if (!readProjection(req, res, projection, projectionSpec))
+        return;
+
+    // Progress is reported against the catalog estimate, which is cheap for a whole table only
+    long long estimatedRows = -1;
+    if (!filter.isActive())
+    {
+        Data::CancellationToken estimateCancel(kExportEstimateTimeout);
+        Data::RowCount count;
+        if (db->countRows(schema, table, filter, false, count, estimateCancel))
+            estimatedRows = count.value;
+    }
+
+    std::string sessionId = getSessionId(req);
+    auto &tracker = Core::ExportTracker::getInstance();
+    auto progress = tracker.start(sessionId, table, archive.empty() ? format : format + "." + archive, estimatedRows);
+    if (!progress)
+    {
+        res.set_header("Retry-After", "5");
+        res.set_content("{\"error\": \"Too many exports running\"}", "application/json");
+        res.status = 503;
+        return;
+    }
+
+    // No deadline: the export runs for as long as the client reads, and stops when it goes away
+    auto cancel = std::make_shared<Data::CancellationToken>();
+    size_t watchId = Data::QueryWatchdog::getInstance().watch(cancel, [&req]() { return req.is_connection_closed(); });
+
+    auto fail = [&](const std::string &error) {
+        Data::QueryWatchdog::getInstance().unwatch(watchId);
+        tracker.finish(progress, Core::ExportState::Failed, error);
+        std::string body = "{\"success\": false, \"error\": ";
+        appendJsonString(body, error);
+        res.set_content(body + "}", "application/json");
+    };
+
+    std::string fileName = table + "." + format;
+    size_t requestedColumns = projection.columns.size();
+
+    if (parallel > 1)
+    {
+        std::string keyColumn;
+        std::vector<std::string> bounds;
+        std::string error;
+        if (!db->splitKeyRange(schema, table, parallel * kExportRangesPerWorker, keyColumn, bounds, *cancel, error))
+        {
+            fail(error);
+            return;
+        }
+
+        auto exporter = std::make_shared<ParallelExport>();
+        exporter->format = exportFormat;
+        exporter->compression = compression;
+        exporter->extension = format;
+        exporter->archive = !archive.empty();
+        exporter->db = db;
+        exporter->schema = schema;
+        exporter->table = table;
+        exporter->filter = filter;
+        exporter->keyOrder = {Data::SortKey{keyColumn}};
+        exporter->columns = projection.columns;
+        exporter->requestedColumns = requestedColumns;
+        exporter->cancel = cancel;
+        exporter->progress = progress;
+        exporter->watchId = watchId;
+
+        // Range i holds the keys after bound i-1 up to bound i; the first and last are open ended
+        for (size_t i = 0; i <= bounds.size(); i++)
+        {
+            Data::KeyRange range;
+            range.column = keyColumn;
+            if (i > 0)
+                range.lower = bounds[i - 1];
+            if (i < bounds.size())
+                range.upper = bounds[i];
+            exporter->ranges.push_back(std::move(range));
+        }
+        progress->ranges = exporter->ranges.size();
+        exporter->start(std::min(parallel, exporter->ranges.size()));
+
+        if (exporter->archive)
+        {
+            fileName = table + ".tar";
+            contentType = "application/x-tar";
+        }
+
+        res.set_header("Content-Disposition", "attachment; filename=\"" + fileName + "\"");
+        res.set_header("X-Export-Id", progress->id);
+        res.set_header("Trailer", "X-Export-Rows");
+        res.set_header("Cache-Control", "no-store");
+        res.set_chunked_content_provider(
+            contentType, [exporter](size_t, httplib::DataSink &sink) { return exporter->stream(sink); });
+        return;
+    }
+
+    auto stream = std::make_shared<ExportStream>();
+    stream->writer.format = exportFormat;
+    stream->writer.compression = compression;
+    stream->cancel = cancel;
+    stream->watchId = watchId;
+
+    std::string error;
+    stream->cursor =
+        db->openCursor(schema, table, filter, Data::KeyRange(), sortKeys, projection.columns, *cancel, error);
+    // The first batch is read and encoded before the response starts, so a failure there is still answered
+    // with an error rather than a cut 200 stream; Arrow's schema must hold every later batch as well
+    if (!stream->cursor || (exportFormat == ExportFormat::Arrow && !stream->cursor->settleKinds()) ||
+        !nextExportBatch(*stream, requestedColumns, error))
     {
-        // Check for token in cookies or session storage (via query param for redirect)
-        res.set_content(generateBrowserosoHTML(), "text/html; charset=utf-8");
+        if (stream->cursor && error.empty())
+            error = stream->cursor->error();
+        stream->watchId = 0;
+        fail(cancel->isCancelled() ? cancel->reason() : error);
         return;
     }
-    res.set_content(generateBrowserosoHTML(), "text/html; charset=utf-8");
+    stream->firstBatchRead = true;
+    stream->progress = progress;
+
+    res.set_header("Content-Disposition", "attachment; filename=\"" + fileName + "\"");
+    res.set_header("X-Export-Id", progress->id);
+    res.set_header("Trailer", "X-Export-Rows");
+    res.set_header("Cache-Control", "no-store");
+    res.set_chunked_content_provider(contentType, [stream, requestedColumns](size_t, httplib::DataSink &sink) {
+        return streamExport(*stream, requestedColumns, sink);
+    });
 }
 
-void BrowserosoController::connectDatabase(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::importTable(const httplib::Request &req, httplib::Response &res,
+                                       const httplib::ContentReader &content)
 {
-    // Verify JWT authentication
+    // The body is left unread on every early exit; closing the connection drops it
+    auto reject = [&res](int status, const char *body) {
+        res.set_header("Connection", "close");
+        res.set_content(body, "application/json");
+        res.status = status;
+    };
+
     if (!AuthController::verifyAuth(req, res))
     {
+        res.set_header("Connection", "close");
         return;
     }
 
-    auto &db = getDbConnection(req);
+    auto db = getDbConnection(req);
 
-    std::string connStr = "Data Source=localhost;Initial Catalog=master;Integrated Security=True;"
-                          "Persist Security Info=False;Pooling=False;MultipleActiveResultSets=False;"
-                          "Encrypt=False;TrustServerCertificate=True";
+    if (!db || !db->isConnected())
+    {
+        reject(400, "{\"error\": \"Not connected\"}");
+        return;
+    }
+    if (!serverAvailable(*db, res))
+    {
+        res.set_header("Connection", "close");
+        return;
+    }
 
-    if (!req.body.empty())
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+    if (table.empty())
     {
-        auto pos = req.body.find("\"connectionString\"");
-        if (pos != std::string::npos)
+        reject(400, "{\"error\": \"Table name required\"}");
+        return;
+    }
+
+    // format=csv | ndjson, or taken from the Content-Type of the upload
+    std::string format = req.get_param_value("format");
+    if (format.empty())
+        format = req.get_header_value("Content-Type").find("ndjson") != std::string::npos ? "ndjson" : "csv";
+    auto parser = Data::RowParser::create(format);
+    if (!parser)
+    {
+        reject(400, "{\"error\": \"Invalid import format\"}");
+        return;
+    }
+
+    auto pipeline = std::make_unique<ImportPipeline>();
+
+    // batchSize=<rows> committed per transaction
+    std::string batchParam = req.get_param_value("batchSize");
+    if (!batchParam.empty())
+    {
+        auto parsed = std::from_chars(batchParam.data(), batchParam.data() + batchParam.size(), pipeline->batchRows);
+        if (parsed.ec != std::errc() || parsed.ptr != batchParam.data() + batchParam.size() ||
+            pipeline->batchRows < 1 || pipeline->batchRows > kMaxImportBatchRows)
         {
-            auto start = req.body.find(':', pos) + 1;
-            auto quote1 = req.body.find('"', start);
-            auto quote2 = req.body.find('"', quote1 + 1);
-            if (quote1 != std::string::npos && quote2 != std::string::npos)
-            {
-                connStr = req.body.substr(quote1 + 1, quote2 - quote1 - 1);
-            }
+            reject(400, "{\"error\": \"Invalid batch size\"}");
+            return;
         }
     }
 
-    bool success = db.connect(connStr);
+    std::string onError = req.get_param_value("onError");
+    if (!onError.empty() && onError != "abort" && onError != "continue")
+    {
+        reject(400, "{\"error\": \"Invalid onError\"}");
+        return;
+    }
+    pipeline->stopOnError = onError != "continue";
 
-    std::ostringstream json;
-    json << "{\"success\": " << (success ? "true" : "false") << ",";
-    json << "\"message\": \"" << (success ? "Connected successfully" : "Connection failed") << "\",";
-    json << "\"info\": \"" << db.getConnectionInfo() << "\"}";
+    auto &imports = Core::ImportTracker::getInstance();
+    if (!imports.start())
+    {
+        res.set_header("Retry-After", "5");
+        reject(503, "{\"error\": \"Too many imports running\"}");
+        return;
+    }
+    auto started = std::chrono::steady_clock::now();
 
-    res.set_content(json.str(), "application/json");
-}
+    // No deadline: the import runs for as long as the client uploads, and stops when it goes away
+    pipeline->cancel = std::make_shared<Data::CancellationToken>();
+    pipeline->watchId =
+        Data::QueryWatchdog::getInstance().watch(pipeline->cancel, [&req]() { return req.is_connection_closed(); });
 
-void BrowserosoController::disconnectDatabase(const httplib::Request &req, httplib::Response &res)
-{
-    if (!AuthController::verifyAuth(req, res))
-        return;
+    // The writer is opened with the upload's columns, on its first row
+    std::string error;
+    auto onRow = [&](const std::vector<Data::ParsedCell> &row) {
+        if (!pipeline->writer)
+        {
+            pipeline->writer = db->openWriter(schema, table, parser->columns(), *pipeline->cancel, error);
+            if (!pipeline->writer)
+                return false;
+            pipeline->start(parser->columns());
+        }
 
-    std::string sessionId = getSessionId(req);
-    Data::ConnectionManager::getInstance().removeConnection(sessionId);
-    res.set_content("{\"success\": true, \"message\": \"Disconnected\"}", "application/json");
-}
+        Data::ResultSet &batch = pipeline->next.rows;
+        for (const Data::ParsedCell &cell : row)
+        {
+            if (cell.null)
+                batch.appendNull();
+            else
+                batch.appendValue(cell.value);
+            pipeline->nextBytes += cell.value.size();
+        }
+        bool full = batch.rowCount() >= pipeline->batchRows || pipeline->nextBytes >= kMaxImportBatchBytes;
+        return !full || pipeline->submit();
+    };
 
-void BrowserosoController::getConnectionStatus(const httplib::Request &req, httplib::Response &res)
-{
-    if (!AuthController::verifyAuth(req, res))
-        return;
+    uint64_t bytes = 0;
+    bool read = content([&](const char *data, size_t length) {
+        bytes += length;
+        return parser->feed(std::string_view(data, length), onRow);
+    });
+    if (read && parser->finish(onRow) && pipeline->writer && pipeline->next.rows.rowCount() > 0)
+        read = pipeline->submit();
+    pipeline->close();
 
-    std::string sessionId = getSessionId(req);
-    auto &manager = Data::ConnectionManager::getInstance();
+    if (!parser->error().empty())
+        error = parser->error();
+    else if (pipeline->stopped)
+        error = "Stopped at batch " + std::to_string(pipeline->failed.back().number) + ": " +
+                pipeline->failed.back().error;
+    else if (error.empty() && pipeline->cancel->isCancelled())
+        error = "Import cancelled";
+    else if (error.empty() && !read)
+        error = "Upload interrupted";
+    bool success = error.empty();
+
+    // Committed rows change what the table's cached and prefetched pages show
+    if (pipeline->rows > 0)
+    {
+        Data::PageCache::getInstance().invalidateTable(
+            Data::PageCache::makeTableKey(db->getTargetKey(), schema, table));
+        Data::PagePrefetcher::getInstance().discard(getSessionId(req));
+    }
+
+    Core::ImportTracker::Outcome outcome;
+    outcome.completed = success;
+    outcome.rows = pipeline->rows;
+    outcome.failedRows = pipeline->failedRows;
+    outcome.batches = pipeline->batches;
+    outcome.failedBatches = pipeline->failed.size();
+    outcome.bytes = bytes;
+    outcome.elapsed = std::chrono::steady_clock::now() - started;
+    imports.finish(outcome);
 
-    bool connected = manager.hasConnection(sessionId);
-    std::string info = "Not connected";
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(outcome.elapsed).count();
+    double seconds = std::chrono::duration<double>(outcome.elapsed).count();
 
-    if (connected)
+    std::string body = "{\"success\": ";
+    body += success ? "true" : "false";
+    if (!success)
+    {
+        body += ", \"error\": ";
+        appendJsonString(body, error);
+    }
+    body += ", \"rows\": " + std::to_string(pipeline->rows);
+    body += ", \"failedRows\": " + std::to_string(pipeline->failedRows);
+    body += ", \"batches\": " + std::to_string(pipeline->batches);
+    body += ", \"failedBatches\": [";
+    for (size_t i = 0; i < pipeline->failed.size(); i++)
     {
-        auto &db = manager.getConnection(sessionId);
-        info = db.getConnectionInfo();
+        const auto &failure = pipeline->failed[i];
+        if (i > 0)
+            body += ", ";
+        body += "{\"batch\": " + std::to_string(failure.number);
+        body += ", \"firstRow\": " + std::to_string(failure.firstRow);
+        body += ", \"rows\": " + std::to_string(failure.rows);
+        body += ", \"failedRow\": ";
+        body += failure.failedRow >= 0 ? std::to_string(failure.failedRow) : "null";
+        body += ", \"error\": ";
+        appendJsonString(body, failure.error);
+        body += "}";
     }
+    body += "], \"elapsedMs\": " + std::to_string(elapsedMs);
+    body += ", \"rowsPerSecond\": " +
+            std::to_string(seconds > 0 ? static_cast<uint64_t>(double(pipeline->rows) / seconds) : 0) + "}";
 
-    std::ostringstream json;
-    json << "{\"connected\": " << (connected ? "true" : "false") << ",";
-    json << "\"info\": \"" << info << "\"}";
-    res.set_content(json.str(), "application/json");
+    // Stopped before the end of the upload: the rest of it is still on the connection
+    if (!success)
+        res.set_header("Connection", "close");
+    res.set_header("Cache-Control", "no-store");
+    res.set_content(body, "application/json");
+    // httplib marks a body that was not read to the end as a bad request; the outcome is in the body
+    res.status = 200;
 }
 
-void BrowserosoController::getDatabases(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::editRows(const httplib::Request &req, httplib::Response &res,
+                                    const httplib::ContentReader &content)
 {
     if (!AuthController::verifyAuth(req, res))
-        return;
-
-    auto &db = getDbConnection(req);
-
-    if (!db.isConnected())
     {
-        res.set_content("{\"error\": \"Not connected\"}", "application/json");
-        res.status = 400;
+        res.set_header("Connection", "close");
         return;
     }
 
-    auto databases = db.getDatabases();
-    std::ostringstream json;
-    json << "{\"databases\": [";
-    for (size_t i = 0; i < databases.size(); i++)
+    std::string body;
+    bool tooLarge = false;
+    content([&](const char *data, size_t length) {
+        tooLarge = body.size() + length > kMaxEditBodyBytes;
+        if (!tooLarge)
+            body.append(data, length);
+        return !tooLarge;
+    });
+    if (tooLarge)
     {
-        if (i > 0)
-            json << ",";
-        json << "\"" << databases[i] << "\"";
+        // The rest of the body is left unread; closing the connection drops it
+        res.set_header("Connection", "close");
+        refuseLargeEdit(res);
+        return;
     }
-    json << "]}";
-    res.set_content(json.str(), "application/json");
+    applyEdit(req, res, body);
 }
 
-void BrowserosoController::changeDatabase(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::applyEdit(const httplib::Request &req, httplib::Response &res, const std::string &body)
 {
-    if (!AuthController::verifyAuth(req, res))
-        return;
-
-    auto &db = getDbConnection(req);
+    auto db = getDbConnection(req);
 
-    if (!db.isConnected())
+    if (!db || !db->isConnected())
     {
         res.set_content("{\"error\": \"Not connected\"}", "application/json");
         res.status = 400;
         return;
     }
+    if (!serverAvailable(*db, res))
+        return;
 
-    // Parse database name from request body
-    std::string databaseName;
-    if (!req.body.empty())
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+    if (table.empty())
     {
-        auto pos = req.body.find("\"database\"");
-        if (pos != std::string::npos)
-        {
-            auto start = req.body.find(':', pos) + 1;
-            auto quote1 = req.body.find('"', start);
-            auto quote2 = req.body.find('"', quote1 + 1);
-            if (quote1 != std::string::npos && quote2 != std::string::npos)
-            {
-                databaseName = req.body.substr(quote1 + 1, quote2 - quote1 - 1);
-            }
-        }
+        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        res.status = 400;
+        return;
     }
 
-    if (databaseName.empty())
+    auto changes = std::make_shared<std::vector<Data::RowChange>>();
+    std::string error;
+    if (!readChanges(body, *changes, error))
     {
-        res.set_content("{\"error\": \"Database name required\"}", "application/json");
+        std::string body = "{\"error\": ";
+        appendJsonString(body, error);
+        res.set_content(body + "}", "application/json");
         res.status = 400;
         return;
     }
 
-    bool success = db.useDatabase(databaseName);
-    std::ostringstream json;
-    json << "{\"success\": " << (success ? "true" : "false") << ",";
-    json << "\"message\": \"" << (success ? "Changed to " + databaseName : "Failed to change database") << "\",";
-    json << "\"info\": \"" << db.getConnectionInfo() << "\"}";
-    res.set_content(json.str(), "application/json");
+    std::string sessionId = getSessionId(req);
+    respond(req, res, [=](Data::CancellationToken &cancel) {
+        Data::EditResult result;
+        std::string error;
+        bool applied = db->applyChanges(schema, table, *changes, cancel, result, error);
+        if (!applied && cancel.isCancelled())
+            return cancelledResult(cancel);
+
+        std::string body;
+        if (applied)
+        {
+            // The table's cached and prefetched pages no longer show its rows
+            Data::PageCache::getInstance().invalidateTable(
+                Data::PageCache::makeTableKey(db->getTargetKey(), schema, table));
+            Data::PagePrefetcher::getInstance().discard(sessionId);
+
+            body = "{\"success\": true, \"inserted\": " + std::to_string(result.inserted);
+            body += ", \"updated\": " + std::to_string(result.updated);
+            body += ", \"deleted\": " + std::to_string(result.deleted);
+            body += ", \"statements\": " + std::to_string(result.statements) + "}";
+            return Core::JobResult{200, body};
+        }
+
+        // Nothing was applied: the client fixes or reloads the change and sends the whole edit again
+        body = "{\"success\": false, \"error\": ";
+        appendJsonString(body, error);
+        body += ", \"change\": ";
+        body += result.failedChange >= 0 ? std::to_string(result.failedChange) : "null";
+        body += ", \"conflict\": ";
+        body += result.conflict ? "true" : "false";
+        return Core::JobResult{200, body + "}"};
+    });
 }
 
-void BrowserosoController::getTables(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::watchTable(const httplib::Request &req, httplib::Response &res)
 {
     if (!AuthController::verifyAuth(req, res))
         return;
 
-    auto &db = getDbConnection(req);
+    auto db = getDbConnection(req);
 
-    if (!db.isConnected())
+    if (!db || !db->isConnected())
     {
         res.set_content("{\"error\": \"Not connected\"}", "application/json");
         res.status = 400;
         return;
     }
+    if (!serverAvailable(*db, res))
+        return;
 
-    auto tables = db.getTables();
-    std::ostringstream json;
-    json << "{\"tables\": [";
-    for (size_t i = 0; i < tables.size(); i++)
+    std::string schema = req.get_param_value("schema");
+    std::string table = req.get_param_value("table");
+    if (table.empty())
     {
-        if (i > 0)
-            json << ",";
-        json << "{\"schema\": \"" << tables[i].schema << "\",\"name\": \"" << tables[i].name << "\"}";
+        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        res.status = 400;
+        return;
     }
-    json << "]}";
-    res.set_content(json.str(), "application/json");
+
+    // from=<key>&to=<key> narrow the rows sent to the grid's visible window on the primary key
+    auto stream = std::make_shared<WatchStream>();
+    WatchWindow &window = stream->window;
+    window.hasFrom = req.has_param("from");
+    window.hasTo = req.has_param("to");
+    window.from = req.get_param_value("from");
+    window.to = req.get_param_value("to");
+
+    std::string etag;
+    std::vector<Data::ColumnInfo> columns = db->getColumns(schema, table, etag);
+    if (const Data::ColumnInfo *key = Data::singlePrimaryKey(columns))
+    {
+        window.keyColumn = key->name;
+    }
+    else if (window.hasFrom || window.hasTo)
+    {
+        res.set_content("{\"error\": \"A window needs a table with a single column primary key\"}",
+                        "application/json");
+        res.status = 400;
+        return;
+    }
+
+    Data::CancellationToken cancel(requestTimeout(req));
+    std::string error;
+    stream->watcher = Data::ChangeFeed::getInstance().watch(
+        Data::PageCache::makeTableKey(db->getTargetKey(), schema, table),
+        [&](std::string &openError) { return db->openChangeSource(schema, table, cancel, openError); }, error);
+    if (!stream->watcher)
+    {
+        std::string body = "{\"error\": ";
+        appendJsonString(body, error);
+        res.set_content(body + "}", "application/json");
+        if (error == "Too many watchers")
+        {
+            res.set_header("Retry-After", "5");
+            res.status = 503;
+        }
+        else
+        {
+            res.status = 400;
+        }
+        return;
+    }
+
+    // The stream lasts until the client goes away; the watcher leaves the table with it
+    res.set_header("Cache-Control", "no-store");
+    res.set_chunked_content_provider("text/event-stream", [stream](size_t, httplib::DataSink &sink) {
+        return streamWatch(*stream, sink);
+    });
 }
 
-void BrowserosoController::getTableColumns(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::runBatchRequests(const httplib::Request &req, httplib::Response &res,
+                                            const httplib::ContentReader &content)
 {
     if (!AuthController::verifyAuth(req, res))
+    {
+        res.set_header("Connection", "close");
         return;
+    }
 
-    auto &db = getDbConnection(req);
-
-    if (!db.isConnected())
+    std::string body;
+    bool tooLarge = false;
+    content([&](const char *data, size_t length) {
+        tooLarge = body.size() + length > kMaxBatchBodyBytes;
+        if (!tooLarge)
+            body.append(data, length);
+        return !tooLarge;
+    });
+    if (tooLarge)
     {
-        res.set_content("{\"error\": \"Not connected\"}", "application/json");
-        res.status = 400;
+        // The rest of the body is left unread; closing the connection drops it
+        res.set_header("Connection", "close");
+        res.set_content("{\"error\": \"Batch body larger than " + std::to_string(kMaxBatchBodyBytes) + " bytes\"}",
+                        "application/json");
+        res.status = 413;
         return;
     }
 
-    std::string schema = req.get_param_value("schema");
-    std::string table = req.get_param_value("table");
+    // Requests a batch may hold; streams (export, import, watch) keep their own endpoints
+    static const struct
+    {
+        const char *method;
+        const char *path;
+        httplib::Server::Handler handler;
+    } kBatchRoutes[] = {
+        {"POST", "/api/browseroso/connect", connectDatabase},
+        {"POST", "/api/browseroso/disconnect", disconnectDatabase},
+        {"GET", "/api/browseroso/status", getConnectionStatus},
+        {"GET", "/api/browseroso/databases", getDatabases},
+        {"POST", "/api/browseroso/database", changeDatabase},
+        {"GET", "/api/browseroso/tables", getTables},
+        {"GET", "/api/browseroso/columns", getTableColumns},
+        {"GET", "/api/browseroso/data", getTableData},
+        {"GET", "/api/browseroso/count", getTableCount},
+        {"GET", "/api/browseroso/exports", getExports},
+        {"POST", "/api/browseroso/edit",
+         [](const httplib::Request &req, httplib::Response &res) {
+             if (!AuthController::verifyAuth(req, res))
+                 return;
+             if (req.body.size() > kMaxEditBodyBytes)
+                 refuseLargeEdit(res);
+             else
+                 applyEdit(req, res, req.body);
+         }},
+        {"GET", "/api/browseroso/jobs", getJobResult},
+        {"DELETE", "/api/browseroso/jobs", cancelJob},
+        {"GET", "/api/browseroso/metrics", getMetrics},
+    };
 
-    if (table.empty())
+    std::vector<BatchPart> parts;
+    std::string error;
+    bool valid = readBatch(body, parts, error);
+    for (size_t i = 0; valid && i < parts.size(); i++)
     {
-        res.set_content("{\"error\": \"Table name required\"}", "application/json");
+        BatchPart &part = parts[i];
+        for (const auto &route : kBatchRoutes)
+        {
+            if (part.method == route.method && part.path == route.path)
+                part.handler = route.handler;
+        }
+        if (!part.handler)
+        {
+            error = "Not allowed in a batch: " + part.method + " " + part.path;
+            valid = false;
+        }
+    }
+    if (!valid)
+    {
+        std::string json = "{\"error\": ";
+        appendJsonString(json, error);
+        res.set_content(json + "}", "application/json");
         res.status = 400;
         return;
     }
 
-    auto columns = db.getColumns(schema, table);
+    runBatch(req, parts);
+
+    std::string responses;
+    appendBatchResponses(responses, parts);
+    res.set_content(responses, "application/json");
+}
+
+void BrowserosoController::getExports(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
+
+    auto now = std::chrono::steady_clock::now();
     std::ostringstream json;
-    json << "{\"columns\": [";
-    for (size_t i = 0; i < columns.size(); i++)
+    json << "{\"exports\": [";
+    bool first = true;
+    for (const auto &progress : Core::ExportTracker::getInstance().list(getSessionId(req)))
     {
-        if (i > 0)
-            json << ",";
-        json << "{\"name\": \"" << columns[i].name << "\",";
-        json << "\"type\": \"" << columns[i].type << "\",";
-        json << "\"nullable\": " << (columns[i].nullable ? "true" : "false") << ",";
-        json << "\"isPrimaryKey\": " << (columns[i].isPrimaryKey ? "true" : "false") << "}";
+        // The state is stored last, so once it is not running the end time and error are set
+        Core::ExportState state = progress->state;
+        bool running = state == Core::ExportState::Running;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>((running ? now : progress->finished) -
+                                                                             progress->started);
+
+        json << (first ? "" : ",") << "{\"id\": \"" << progress->id << "\",\"table\": \"" << progress->table
+             << "\",\"format\": \"" << progress->format << "\",\"state\": \"" << Core::exportStateName(state)
+             << "\",\"rows\": " << progress->rows << ",\"bytes\": " << progress->bytes << ",\"estimatedRows\": ";
+        if (progress->estimatedRows >= 0)
+            json << progress->estimatedRows;
+        else
+            json << "null";
+        json << ",\"elapsedMs\": " << elapsed.count();
+        if (progress->ranges > 0)
+        {
+            json << ",\"ranges\": " << progress->ranges << ",\"rangesDone\": " << progress->rangesDone
+                 << ",\"retries\": " << progress->retries;
+        }
+        json << ",\"error\": ";
+
+        std::string error = "null";
+        if (!running && !progress->error.empty())
+        {
+            error.clear();
+            appendJsonString(error, progress->error);
+        }
+        json << error << "}";
+        first = false;
     }
     json << "]}";
     res.set_content(json.str(), "application/json");
 }
 
-void BrowserosoController::getTableData(const httplib::Request &req, httplib::Response &res)
+void BrowserosoController::getJobResult(const httplib::Request &req, httplib::Response &res)
 {
     if (!AuthController::verifyAuth(req, res))
         return;
 
-    auto &db = getDbConnection(req);
-
-    if (!db.isConnected())
+    std::string jobId = req.get_param_value("id");
+    if (jobId.empty())
     {
-        res.set_content("{\"error\": \"Not connected\"}", "application/json");
+        res.set_content("{\"error\": \"Job id required\"}", "application/json");
         res.status = 400;
         return;
     }
 
-    std::string schema = req.get_param_value("schema");
-    std::string table = req.get_param_value("table");
-    std::string filterColumn = req.get_param_value("filterColumn");
-    std::string filterValue = req.get_param_value("filterValue");
+    Core::JobResult result;
+    switch (Core::AsyncJobs::getInstance().wait(jobId, getSessionId(req), kInlineWait, result))
+    {
+    case Core::JobStatus::Done:
+        writeJobResult(res, result);
+        break;
+    case Core::JobStatus::Running:
+        res.status = 202;
+        res.set_header("Location", "/api/browseroso/jobs?id=" + jobId);
+        res.set_content("{\"jobId\": \"" + jobId + "\", \"status\": \"running\"}", "application/json");
+        break;
+    case Core::JobStatus::NotFound:
+        res.set_content("{\"error\": \"Job not found\"}", "application/json");
+        res.status = 404;
+        break;
+    }
+}
 
-    int page = 1, pageSize = 50;
-    if (!req.get_param_value("page").empty())
-        page = std::stoi(req.get_param_value("page"));
-    if (!req.get_param_value("pageSize").empty())
-        pageSize = std::stoi(req.get_param_value("pageSize"));
+void BrowserosoController::cancelJob(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
 
-    if (table.empty())
+    std::string jobId = req.get_param_value("id");
+    if (!Core::AsyncJobs::getInstance().cancel(jobId, getSessionId(req)))
     {
-        res.set_content("{\"error\": \"Table name required\"}", "application/json");
-        res.status = 400;
+        res.set_content("{\"error\": \"Job not found\"}", "application/json");
+        res.status = 404;
         return;
     }
 
-    auto result = db.selectData(schema, table, filterColumn, filterValue, page, pageSize);
+    res.set_content("{\"success\": true, \"message\": \"Job cancelled\"}", "application/json");
+}
 
-    std::ostringstream json;
-    json << "{\"success\": " << (result.success ? "true" : "false") << ",";
+void BrowserosoController::getMetrics(const httplib::Request &req, httplib::Response &res)
+{
+    if (!AuthController::verifyAuth(req, res))
+        return;
 
-    if (!result.success)
-    {
-        std::string escapedError;
-        for (char c : result.error)
-        {
-            if (c == '"')
-                escapedError += "\\\"";
-            else if (c == '\\')
-                escapedError += "\\\\";
-            else if (c == '\n')
-                escapedError += "\\n";
-            else if (c == '\r')
-                escapedError += "\\r";
-            else
-                escapedError += c;
-        }
-        json << "\"error\": \"" << escapedError << "\"}";
-    }
-    else
+    auto sessions = Data::ConnectionManager::getInstance().getStats();
+    auto pool = Data::ConnectionPool::getInstance().getStats();
+    auto cache = Data::PageCache::getInstance().getStats();
+    auto prefetch = Data::PagePrefetcher::getInstance().getStats();
+    auto exports = Core::ExportTracker::getInstance().getStats();
+    auto imports = Core::ImportTracker::getInstance().getStats();
+    auto watches = Data::ChangeFeed::getInstance().getStats();
+
+    std::ostringstream json;
+    json << "{\"sessions\": {";
+    json << "\"live\": " << sessions.live << ",\"max\": " << sessions.maxSessions << ",";
+    json << "\"created\": " << sessions.created << ",\"removed\": " << sessions.removed << ",";
+    json << "\"evicted\": " << sessions.evicted << ",\"reaped\": " << sessions.reaped << "},";
+    json << "\"pool\": {";
+    json << "\"targets\": " << pool.targets << ",\"idle\": " << pool.idle << ",\"leased\": " << pool.leased << ",";
+    json << "\"opened\": " << pool.opened << ",\"discarded\": " << pool.discarded << ",";
+    json << "\"openCircuits\": " << pool.openCircuits << ",\"circuits\": [";
+    for (size_t i = 0; i < pool.circuits.size(); i++)
     {
-        json << "\"totalRows\": " << result.totalRows << ",";
-        json << "\"page\": " << page << ",\"pageSize\": " << pageSize << ",";
-        json << "\"totalPages\": " << ((result.totalRows + pageSize - 1) / pageSize) << ",";
-        json << "\"columns\": [";
-        for (size_t i = 0; i < result.columns.size(); i++)
-        {
-            if (i > 0)
-                json << ",";
-            json << "\"" << result.columns[i] << "\"";
-        }
-        json << "],\"rows\": [";
-        for (size_t r = 0; r < result.rows.size(); r++)
-        {
-            if (r > 0)
-                json << ",";
-            json << "{";
-            for (size_t c = 0; c < result.rows[r].size(); c++)
-            {
-                if (c > 0)
-                    json << ",";
-                std::string escapedValue;
-                for (char ch : result.rows[r][c].second)
-                {
-                    if (ch == '"')
-                        escapedValue += "\\\"";
-                    else if (ch == '\\')
-                        escapedValue += "\\\\";
-                    else if (ch == '\n')
-                        escapedValue += "\\n";
-                    else if (ch == '\r')
-                        escapedValue += "\\r";
-                    else if (ch == '\t')
-                        escapedValue += "\\t";
-                    else
-                        escapedValue += ch;
-                }
-                json << "\"" << result.rows[r][c].first << "\": \"" << escapedValue << "\"";
-            }
-            json << "}";
-        }
-        json << "]}";
+        const auto &circuit = pool.circuits[i];
+        std::string server;
+        appendJsonString(server, circuit.server);
+        std::string lastError;
+        appendJsonString(lastError, circuit.breaker.lastError);
+        json << (i > 0 ? "," : "") << "{\"server\": " << server << ",";
+        json << "\"state\": \"" << Data::CircuitBreaker::stateName(circuit.breaker.state) << "\",";
+        json << "\"calls\": " << circuit.breaker.calls << ",\"failures\": " << circuit.breaker.failures << ",";
+        json << "\"trips\": " << circuit.breaker.trips << ",\"rejected\": " << circuit.breaker.rejected << ",";
+        json << "\"probes\": " << circuit.breaker.probes << ",";
+        json << "\"retryAfterSeconds\": " << circuit.breaker.retryAfterSeconds << ",";
+        json << "\"lastError\": " << lastError << "}";
     }
+    json << "]},";
+
+    // Misses answered by another request's fill did not hit the database either
+    uint64_t served = cache.hits + cache.sharedFills;
+    uint64_t lookups = served + cache.misses;
+    char hitRatio[16];
+    std::snprintf(hitRatio, sizeof(hitRatio), "%.3f", lookups > 0 ? double(served) / double(lookups) : 0.0);
+
+    json << "\"pageCache\": {";
+    json << "\"entries\": " << cache.entries << ",\"bytes\": " << cache.bytes << ",";
+    json << "\"budgetBytes\": " << cache.budgetBytes << ",\"hits\": " << cache.hits << ",";
+    json << "\"misses\": " << cache.misses << ",\"sharedFills\": " << cache.sharedFills << ",";
+    json << "\"hitRatio\": " << hitRatio << ",\"evictions\": " << cache.evictions << ",";
+    json << "\"invalidations\": " << cache.invalidations << "},";
+
+    json << "\"prefetch\": {";
+    json << "\"buffered\": " << prefetch.buffered << ",\"scheduled\": " << prefetch.scheduled << ",";
+    json << "\"used\": " << prefetch.used << ",\"wasted\": " << prefetch.wasted << ",";
+    json << "\"skippedBusy\": " << prefetch.skippedBusy << "},";
+
+    json << "\"exports\": {";
+    json << "\"running\": " << exports.running << ",\"max\": " << exports.maxRunning << ",";
+    json << "\"started\": " << exports.started << ",\"completed\": " << exports.completed << ",";
+    json << "\"failed\": " << exports.failed << ",\"aborted\": " << exports.aborted << ",";
+    json << "\"rejected\": " << exports.rejected << ",\"rows\": " << exports.rows << ",";
+    json << "\"bytes\": " << exports.bytes << ",\"retries\": " << exports.retries << "},";
+
+    // Throughput of the finished imports, over the time they ran
+    char rowsPerSecond[32];
+    std::snprintf(rowsPerSecond, sizeof(rowsPerSecond), "%.0f",
+                  imports.seconds > 0 ? double(imports.rows) / imports.seconds : 0.0);
+
+    json << "\"imports\": {";
+    json << "\"running\": " << imports.running << ",\"max\": " << imports.maxRunning << ",";
+    json << "\"started\": " << imports.started << ",\"completed\": " << imports.completed << ",";
+    json << "\"failed\": " << imports.failed << ",\"rejected\": " << imports.rejected << ",";
+    json << "\"rows\": " << imports.rows << ",\"failedRows\": " << imports.failedRows << ",";
+    json << "\"batches\": " << imports.batches << ",\"failedBatches\": " << imports.failedBatches << ",";
+    json << "\"bytes\": " << imports.bytes << ",\"rowsPerSecond\": " << rowsPerSecond << "},";
 
+    json << "\"watch\": {";
+    json << "\"watchers\": " << watches.watchers << ",\"max\": " << watches.maxWatchers << ",";
+    json << "\"tables\": " << watches.tables << ",\"polls\": " << watches.polls << ",";
+    json << "\"failedPolls\": " << watches.failedPolls << ",\"updates\": " << watches.updates << ",";
+    json << "\"stale\": " << watches.stale << ",\"rejected\": " << watches.rejected << "}}";
     res.set_content(json.str(), "application/json");
 }
 
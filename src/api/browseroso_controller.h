@@ -26,6 +26,15 @@ class BrowserosoController
      */
     static void registerRoutes(httplib::Server &server);
 
+    /// Deadline of table queries when the request has no X-Request-Timeout header
+    static constexpr int kDefaultRequestTimeoutSeconds = 60;
+
+    /**
+     * @brief Set the default deadline of table queries
+     * @param seconds Deadline in seconds (ignored if not positive)
+     */
+    static void setRequestTimeout(int seconds);
+
   private:
     // API Endpoints
     static void getBrowserosoUI(const httplib::Request &req, httplib::Response &res);
@@ -37,6 +46,19 @@ class BrowserosoController
     static void getTables(const httplib::Request &req, httplib::Response &res);
     static void getTableColumns(const httplib::Request &req, httplib::Response &res);
     static void getTableData(const httplib::Request &req, httplib::Response &res);
+    static void getTableCount(const httplib::Request &req, httplib::Response &res);
+    static void exportTable(const httplib::Request &req, httplib::Response &res);
+    static void importTable(const httplib::Request &req, httplib::Response &res,
+                            const httplib::ContentReader &content);
+    static void editRows(const httplib::Request &req, httplib::Response &res, const httplib::ContentReader &content);
+    static void applyEdit(const httplib::Request &req, httplib::Response &res, const std::string &body);
+    static void watchTable(const httplib::Request &req, httplib::Response &res);
+    static void runBatchRequests(const httplib::Request &req, httplib::Response &res,
+                                 const httplib::ContentReader &content);
+    static void getExports(const httplib::Request &req, httplib::Response &res);
+    static void getJobResult(const httplib::Request &req, httplib::Response &res);
+    static void cancelJob(const httplib::Request &req, httplib::Response &res);
+    static void getMetrics(const httplib::Request &req, httplib::Response &res);
 
     // HTML Generation
     static std::string generateBrowserosoHTML();
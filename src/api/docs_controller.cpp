@@ -255,7 +255,8 @@ std::string DocsController::generateOpenAPISpec(const std::string &host)
     json << "      \"HealthResponse\": {\n";
     json << "        \"type\": \"object\",\n";
     json << "        \"properties\": {\n";
-    json << "          \"status\": { \"type\": \"string\", \"enum\": [\"healthy\", \"unhealthy\"] }\n";
+    json << "          \"status\": { \"type\": \"string\", \"enum\": [\"healthy\", \"degraded\"] },\n";
+    json << "          \"openCircuits\": { \"type\": \"integer\" }\n";
     json << "        }\n";
     json << "      },\n";
 
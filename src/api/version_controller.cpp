@@ -5,6 +5,7 @@
 
 #include "version_controller.h"
 #include "core/system_info.h"
+#include "data/connection_pool.h"
 
 #include <ctime>
 #include <iomanip>
@@ -132,12 +133,25 @@ void VersionController::getHealth(const httplib::Request & /*req*/, httplib::Res
     std::ostringstream timestampStream;
     timestampStream << std::put_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
 
+    // Database servers whose circuit is not closed are refused without trying them
+    auto pool = Data::ConnectionPool::getInstance().getStats();
+    std::ostringstream databases;
+    for (const auto &circuit : pool.circuits)
+    {
+        if (circuit.breaker.state == Data::CircuitBreaker::State::Closed)
+            continue;
+        databases << (databases.tellp() > 0 ? ",\n" : "\n") << "        {\"server\": \"" << escapeJson(circuit.server)
+                  << "\", \"state\": \"" << Data::CircuitBreaker::stateName(circuit.breaker.state)
+                  << "\", \"retryAfterSeconds\": " << circuit.breaker.retryAfterSeconds << "}";
+    }
+
     std::ostringstream json;
     json << "{\n"
-         << "    \"status\": \"healthy\",\n"
+         << "    \"status\": \"" << (pool.openCircuits > 0 ? "degraded" : "healthy") << "\",\n"
          << "    \"version\": \"" << escapeJson(sysInfo.getAPIVersion()) << "\",\n"
          << "    \"uptime_seconds\": " << sysInfo.getUptimeSeconds() << ",\n"
-         << "    \"timestamp\": \"" << timestampStream.str() << "\"\n"
+         << "    \"timestamp\": \"" << timestampStream.str() << "\",\n"
+         << "    \"unavailableDatabases\": [" << databases.str() << (pool.openCircuits > 0 ? "\n    ]" : "]") << "\n"
          << "}";
 
     res.set_content(json.str(), "application/json");
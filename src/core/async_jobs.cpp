@@ -0,0 +1,120 @@
+/**
+ * @file async_jobs.cpp
+ * @brief Registry of in-flight requests answered with 202 Accepted implementation
+ */
+
+#include "async_jobs.h"
+
+#include <cstdio>
+#include <random>
+
+namespace Tootega
+{
+namespace Core
+{
+
+// Unguessable job id (128 random bits as hex)
+static std::string generateJobId()
+{
+    static std::mutex generatorMutex;
+    static std::mt19937_64 generator{std::random_device{}()};
+
+    unsigned long long high, low;
+    {
+        std::lock_guard<std::mutex> lock(generatorMutex);
+        high = generator();
+        low = generator();
+    }
+
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%016llx%016llx", high, low);
+    return buffer;
+}
+
+AsyncJobs &AsyncJobs::getInstance()
+{
+    static AsyncJobs instance;
+    return instance;
+}
+
+std::string AsyncJobs::start(const std::string &owner, std::future<JobResult> result, std::function<void()> cancel)
+{
+    std::string id = generateJobId();
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    purgeExpired();
+    m_jobs[id] = Job{owner, result.share(), std::move(cancel), now, now};
+    return id;
+}
+
+JobStatus AsyncJobs::wait(const std::string &id, const std::string &owner, std::chrono::milliseconds timeout,
+                          JobResult &result)
+{
+    std::shared_future<JobResult> future;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end() || it->second.owner != owner)
+            return JobStatus::NotFound;
+        future = it->second.result;
+        it->second.lastPolled = std::chrono::steady_clock::now();
+    }
+
+    // Wait without holding the lock so other jobs can be polled meanwhile
+    if (future.wait_for(timeout) != std::future_status::ready)
+        return JobStatus::Running;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // A concurrent poll may have collected it first
+        if (m_jobs.erase(id) == 0)
+            return JobStatus::NotFound;
+    }
+
+    result = future.get();
+    return JobStatus::Done;
+}
+
+bool AsyncJobs::cancel(const std::string &id, const std::string &owner)
+{
+    std::function<void()> cancelWork;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end() || it->second.owner != owner)
+            return false;
+        cancelWork = std::move(it->second.cancel);
+        m_jobs.erase(it);
+    }
+
+    if (cancelWork)
+        cancelWork();
+    return true;
+}
+
+bool AsyncJobs::isAbandoned(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end())
+        return true;
+    return std::chrono::steady_clock::now() - it->second.lastPolled > kAbandonAfter;
+}
+
+void AsyncJobs::purgeExpired()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = m_jobs.begin(); it != m_jobs.end();)
+    {
+        // Jobs still running are kept; their result is what the client is waiting for
+        bool ready = it->second.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        if (ready && now - it->second.started > kResultTtl)
+            it = m_jobs.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // namespace Core
+} // namespace Tootega
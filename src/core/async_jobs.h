@@ -0,0 +1,106 @@
+/**
+ * @file async_jobs.h
+ * @brief Registry of in-flight requests answered with 202 Accepted
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace Tootega
+{
+namespace Core
+{
+
+/**
+ * @brief Response produced by a job once its work completes
+ */
+struct JobResult
+{
+    int status = 200;
+    std::string body;
+    std::string contentType = "application/json";
+};
+
+enum class JobStatus
+{
+    Done,     // result filled in, job forgotten
+    Running,  // still in flight
+    NotFound, // unknown id, wrong owner or already collected
+};
+
+/**
+ * @class AsyncJobs
+ * @brief Keeps the futures of requests the client chose to poll for
+ *
+ * An HTTP worker that would otherwise block on a slow query hands the future
+ * to this registry, answers 202 with the job id and goes back to serving
+ * other requests. The client then polls with that id; the result is handed
+ * out once and forgotten. A job the client cancels or stops polling is
+ * abandoned and its work cancelled.
+ */
+class AsyncJobs
+{
+  public:
+    /// Results nobody collected are dropped after this long
+    static constexpr auto kResultTtl = std::chrono::minutes(5);
+
+    /// A running job nobody polled for this long is abandoned
+    static constexpr auto kAbandonAfter = std::chrono::seconds(10);
+
+    static AsyncJobs &getInstance();
+
+    /**
+     * @brief Register an in-flight result
+     * @param owner Only this owner may collect the result
+     * @param cancel Stops the work when the job is cancelled
+     * @return Job id to give to the client
+     */
+    std::string start(const std::string &owner, std::future<JobResult> result, std::function<void()> cancel);
+
+    /**
+     * @brief Wait up to @p timeout for a job and collect its result when done
+     */
+    JobStatus wait(const std::string &id, const std::string &owner, std::chrono::milliseconds timeout,
+                   JobResult &result);
+
+    /**
+     * @brief Cancel a job and forget it
+     * @return false if the job does not exist or belongs to someone else
+     */
+    bool cancel(const std::string &id, const std::string &owner);
+
+    /**
+     * @brief True once a job is gone or its client stopped polling for kAbandonAfter
+     */
+    bool isAbandoned(const std::string &id);
+
+    // Delete copy constructor and assignment
+    AsyncJobs(const AsyncJobs &) = delete;
+    AsyncJobs &operator=(const AsyncJobs &) = delete;
+
+  private:
+    AsyncJobs() = default;
+
+    struct Job
+    {
+        std::string owner;
+        std::shared_future<JobResult> result;
+        std::function<void()> cancel;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point lastPolled;
+    };
+
+    void purgeExpired();
+
+    std::map<std::string, Job> m_jobs;
+    std::mutex m_mutex;
+};
+
+} // namespace Core
+} // namespace Tootega
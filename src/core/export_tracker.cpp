@@ -0,0 +1,142 @@
+/**
+ * @file export_tracker.cpp
+ * @brief Registry and progress of the table exports being streamed implementation
+ */
+
+#include "export_tracker.h"
+
+#include <algorithm>
+
+namespace Tootega
+{
+namespace Core
+{
+
+static std::atomic<size_t> s_configuredMaxRunning{ExportTracker::kDefaultMaxRunning};
+
+const char *exportStateName(ExportState state)
+{
+    switch (state)
+    {
+    case ExportState::Completed:
+        return "completed";
+    case ExportState::Failed:
+        return "failed";
+    case ExportState::Aborted:
+        return "aborted";
+    case ExportState::Running:
+        break;
+    }
+    return "running";
+}
+
+ExportTracker &ExportTracker::getInstance()
+{
+    static ExportTracker instance(s_configuredMaxRunning.load());
+    return instance;
+}
+
+void ExportTracker::configure(size_t maxRunning)
+{
+    if (maxRunning > 0)
+        s_configuredMaxRunning = maxRunning;
+}
+
+ExportTracker::ExportTracker(size_t maxRunning) : m_maxRunning(maxRunning)
+{
+}
+
+std::shared_ptr<ExportProgress> ExportTracker::start(const std::string &owner, const std::string &table,
+                                                     const std::string &format, long long estimatedRows)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    purgeFinished();
+
+    if (m_running >= m_maxRunning)
+    {
+        m_rejected++;
+        return nullptr;
+    }
+
+    auto progress = std::make_shared<ExportProgress>();
+    // Ids only need to be unique: progress is looked up by owner
+    progress->id = std::to_string(++m_started);
+    progress->owner = owner;
+    progress->table = table;
+    progress->format = format;
+    progress->estimatedRows = estimatedRows;
+    progress->started = std::chrono::steady_clock::now();
+
+    m_exports.push_back(progress);
+    m_running++;
+    return progress;
+}
+
+void ExportTracker::finish(const std::shared_ptr<ExportProgress> &progress, ExportState state,
+                           const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (progress->state != ExportState::Running)
+        return;
+
+    progress->finished = std::chrono::steady_clock::now();
+    progress->error = error;
+    progress->state = state;
+    m_running--;
+
+    if (state == ExportState::Completed)
+        m_completed++;
+    else if (state == ExportState::Failed)
+        m_failed++;
+    else
+        m_aborted++;
+    m_rows += progress->rows;
+    m_bytes += progress->bytes;
+    m_retries += progress->retries;
+}
+
+std::vector<std::shared_ptr<const ExportProgress>> ExportTracker::list(const std::string &owner)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    purgeFinished();
+
+    std::vector<std::shared_ptr<const ExportProgress>> exports;
+    for (const auto &progress : m_exports)
+    {
+        if (progress->owner == owner)
+            exports.push_back(progress);
+    }
+    return exports;
+}
+
+void ExportTracker::purgeFinished()
+{
+    auto now = std::chrono::steady_clock::now();
+    m_exports.erase(std::remove_if(m_exports.begin(), m_exports.end(),
+                                   [&](const std::shared_ptr<ExportProgress> &progress) {
+                                       return progress->state != ExportState::Running &&
+                                              now - progress->finished > kFinishedTtl;
+                                   }),
+                    m_exports.end());
+}
+
+ExportTracker::Stats ExportTracker::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+    stats.running = m_running;
+    stats.maxRunning = m_maxRunning;
+    stats.started = m_started;
+    stats.completed = m_completed;
+    stats.failed = m_failed;
+    stats.aborted = m_aborted;
+    stats.rejected = m_rejected;
+    stats.rows = m_rows;
+    stats.bytes = m_bytes;
+    stats.retries = m_retries;
+    return stats;
+}
+
+} // namespace Core
+} // namespace Tootega
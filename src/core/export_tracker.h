@@ -0,0 +1,148 @@
+/**
+ * @file export_tracker.h
+ * @brief Registry and progress of the table exports being streamed
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Tootega
+{
+namespace Core
+{
+
+enum class ExportState
+{
+    Running,
+    Completed,
+    Failed,  // the query failed while streaming
+    Aborted, // the client went away or the server is stopping
+};
+
+/**
+ * @brief Name of an export state as reported to clients
+ */
+const char *exportStateName(ExportState state);
+
+/**
+ * @brief Progress of one export
+ *
+ * The counters are updated by the worker streaming the export and read by
+ * progress requests without locking.
+ */
+struct ExportProgress
+{
+    std::string id;
+    std::string owner;
+    std::string table;
+    std::string format;
+    long long estimatedRows = -1; ///< Row count estimate taken when the export started, -1 if unknown
+    std::chrono::steady_clock::time_point started;
+
+    std::atomic<uint64_t> rows{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<ExportState> state{ExportState::Running};
+
+    // Parallel exports only: key ranges read side by side, and reads of a range started again
+    std::atomic<size_t> ranges{0};
+    std::atomic<size_t> rangesDone{0};
+    std::atomic<uint64_t> retries{0};
+
+    // Set once by ExportTracker::finish(), under the tracker's lock
+    std::chrono::steady_clock::time_point finished;
+    std::string error;
+};
+
+/**
+ * @class ExportTracker
+ * @brief Caps the exports running at once and keeps their progress for polling
+ *
+ * An export holds an HTTP worker and a database connection for as long as
+ * the client keeps reading, so only a few run at a time. Finished exports
+ * stay listed for a while so clients can read how they ended.
+ */
+class ExportTracker
+{
+  public:
+    /// Exports running at once when not configured
+    static constexpr size_t kDefaultMaxRunning = 4;
+
+    /// Finished exports stay listed this long
+    static constexpr auto kFinishedTtl = std::chrono::minutes(5);
+
+    struct Stats
+    {
+        size_t running = 0;
+        size_t maxRunning = 0;
+        uint64_t started = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t aborted = 0;
+        uint64_t rejected = 0; ///< Not started because the cap on running exports was reached
+        uint64_t rows = 0;     ///< Rows streamed by finished exports
+        uint64_t bytes = 0;    ///< Bytes streamed by finished exports
+        uint64_t retries = 0;  ///< Key ranges of finished parallel exports read again after a failure
+    };
+
+    static ExportTracker &getInstance();
+
+    /**
+     * @brief Set the cap on running exports; only effective before the first getInstance()
+     */
+    static void configure(size_t maxRunning);
+
+    /**
+     * @brief Register a new export
+     * @param owner Only this owner sees the export's progress
+     * @return nullptr when the cap on running exports is reached
+     */
+    std::shared_ptr<ExportProgress> start(const std::string &owner, const std::string &table,
+                                          const std::string &format, long long estimatedRows);
+
+    /**
+     * @brief Record how an export ended (only the first call counts)
+     */
+    void finish(const std::shared_ptr<ExportProgress> &progress, ExportState state, const std::string &error = "");
+
+    /**
+     * @brief Running and recently finished exports of an owner, oldest first
+     */
+    std::vector<std::shared_ptr<const ExportProgress>> list(const std::string &owner);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    ExportTracker(const ExportTracker &) = delete;
+    ExportTracker &operator=(const ExportTracker &) = delete;
+
+  private:
+    explicit ExportTracker(size_t maxRunning);
+
+    // Expects m_mutex to be held
+    void purgeFinished();
+
+    const size_t m_maxRunning;
+    std::vector<std::shared_ptr<ExportProgress>> m_exports;
+    size_t m_running = 0;
+
+    uint64_t m_started = 0;
+    uint64_t m_completed = 0;
+    uint64_t m_failed = 0;
+    uint64_t m_aborted = 0;
+    uint64_t m_rejected = 0;
+    uint64_t m_rows = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_retries = 0;
+
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Core
+} // namespace Tootega
@@ -0,0 +1,68 @@
+/**
+ * @file import_tracker.cpp
+ * @brief Cap on the bulk imports running at once and their throughput counters implementation
+ */
+
+#include "import_tracker.h"
+
+namespace Tootega
+{
+namespace Core
+{
+
+static std::atomic<size_t> s_configuredMaxRunning{ImportTracker::kDefaultMaxRunning};
+
+ImportTracker &ImportTracker::getInstance()
+{
+    static ImportTracker instance(s_configuredMaxRunning.load());
+    return instance;
+}
+
+void ImportTracker::configure(size_t maxRunning)
+{
+    if (maxRunning > 0)
+        s_configuredMaxRunning = maxRunning;
+}
+
+ImportTracker::ImportTracker(size_t maxRunning) : m_maxRunning(maxRunning)
+{
+    m_stats.maxRunning = maxRunning;
+}
+
+bool ImportTracker::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stats.running >= m_maxRunning)
+    {
+        m_stats.rejected++;
+        return false;
+    }
+    m_stats.running++;
+    m_stats.started++;
+    return true;
+}
+
+void ImportTracker::finish(const Outcome &outcome)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.running--;
+    if (outcome.completed)
+        m_stats.completed++;
+    else
+        m_stats.failed++;
+    m_stats.rows += outcome.rows;
+    m_stats.failedRows += outcome.failedRows;
+    m_stats.batches += outcome.batches;
+    m_stats.failedBatches += outcome.failedBatches;
+    m_stats.bytes += outcome.bytes;
+    m_stats.seconds += std::chrono::duration<double>(outcome.elapsed).count();
+}
+
+ImportTracker::Stats ImportTracker::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+} // namespace Core
+} // namespace Tootega
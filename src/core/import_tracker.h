@@ -0,0 +1,91 @@
+/**
+ * @file import_tracker.h
+ * @brief Cap on the bulk imports running at once and their throughput counters
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace Tootega
+{
+namespace Core
+{
+
+/**
+ * @class ImportTracker
+ * @brief Caps the bulk imports running at once and sums up how they went
+ *
+ * An import holds an HTTP worker, a writer thread and a database
+ * connection for as long as the client uploads, so only a few run at a time.
+ */
+class ImportTracker
+{
+  public:
+    /// Imports running at once when not configured
+    static constexpr size_t kDefaultMaxRunning = 2;
+
+    /**
+     * @brief How one import ended
+     */
+    struct Outcome
+    {
+        bool completed = false; ///< false if the upload was malformed, stopped at a failed batch or cut short
+        uint64_t rows = 0;      ///< Rows committed
+        uint64_t failedRows = 0;
+        uint64_t batches = 0; ///< Batches committed
+        uint64_t failedBatches = 0;
+        uint64_t bytes = 0; ///< Upload bytes read
+        std::chrono::steady_clock::duration elapsed{};
+    };
+
+    struct Stats
+    {
+        size_t running = 0;
+        size_t maxRunning = 0;
+        uint64_t started = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t rejected = 0; ///< Not started because the cap on running imports was reached
+        uint64_t rows = 0;
+        uint64_t failedRows = 0;
+        uint64_t batches = 0;
+        uint64_t failedBatches = 0;
+        uint64_t bytes = 0;
+        double seconds = 0; ///< Time finished imports ran, which their rows are divided by for the throughput
+    };
+
+    static ImportTracker &getInstance();
+
+    /**
+     * @brief Set the cap on running imports; only effective before the first getInstance()
+     */
+    static void configure(size_t maxRunning);
+
+    /**
+     * @brief Count a new import in
+     * @return false when the cap on running imports is reached
+     */
+    bool start();
+
+    void finish(const Outcome &outcome);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    ImportTracker(const ImportTracker &) = delete;
+    ImportTracker &operator=(const ImportTracker &) = delete;
+
+  private:
+    explicit ImportTracker(size_t maxRunning);
+
+    const size_t m_maxRunning;
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Core
+} // namespace Tootega
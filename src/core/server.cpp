@@ -9,6 +9,7 @@
 #include "api/docs_controller.h"
 #include "api/static_controller.h"
 #include "api/version_controller.h"
+#include "data/connection_pool.h"
 
 #include <httplib.h>
 #include <iostream>
@@ -36,7 +37,8 @@ void Server::setupCORS()
     m_server->Options(R"(.*)", [](const httplib::Request & /*req*/, httplib::Response &res) {
         res.set_header("Access-Control-Allow-Origin", "*");
         res.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        res.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization, X-Requested-With");
+        res.set_header("Access-Control-Allow-Headers",
+                       "Content-Type, Authorization, X-Requested-With, Prefer, Cache-Control");
         res.set_header("Access-Control-Max-Age", "86400");
         res.status = 204;
     });
@@ -96,7 +98,9 @@ void Server::setupCORS()
     m_server->set_post_routing_handler([](const httplib::Request & /*req*/, httplib::Response &res) {
         res.set_header("Access-Control-Allow-Origin", "*");
         res.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        res.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization, X-Requested-With");
+        res.set_header("Access-Control-Allow-Headers",
+                       "Content-Type, Authorization, X-Requested-With, Prefer, Cache-Control");
+        res.set_header("Access-Control-Expose-Headers", "Location, X-Cache, X-Export-Id");
     });
 }
 
@@ -104,7 +108,11 @@ void Server::setupRoutes()
 {
     // Health check endpoint
     m_server->Get("/health", [](const httplib::Request & /*req*/, httplib::Response &res) {
-        res.set_content(R"({"status": "healthy"})", "application/json");
+        // Still 200 while a database server is down: this server answers, and balancers should keep it
+        size_t openCircuits = Data::ConnectionPool::getInstance().getStats().openCircuits;
+        std::string json = openCircuits > 0 ? R"({"status": "degraded")" : R"({"status": "healthy")";
+        json += ", \"openCircuits\": " + std::to_string(openCircuits) + "}";
+        res.set_content(json, "application/json");
     });
 
     // Register controllers - ORDER MATTERS!
@@ -120,7 +128,11 @@ void Server::setupRoutes()
     Api::BrowserosoController::registerRoutes(*m_server);
 
     // 404 handler
-    m_server->set_error_handler([](const httplib::Request &req, httplib::Response &res) {
+    httplib::Server::HandlerWithResponse errorHandler = [](const httplib::Request &req, httplib::Response &res) {
+        // Errors reported by an endpoint (400 Not connected, 504 deadline, ...) keep their own status and body
+        if (!res.body.empty())
+            return httplib::Server::HandlerResponse::Unhandled;
+
         std::string json = R"({
     "error": "Not Found",
     "message": "The requested resource was not found",
@@ -130,7 +142,9 @@ void Server::setupRoutes()
 })";
         res.set_content(json, "application/json");
         res.status = 404;
-    });
+        return httplib::Server::HandlerResponse::Handled;
+    };
+    m_server->set_error_handler(errorHandler);
 
     // Exception handler
     m_server->set_exception_handler(
@@ -0,0 +1,620 @@
+/**
+ * @file arrow_ipc.cpp
+ * @brief Apache Arrow IPC stream encoding of result sets implementation
+ */
+
+#include "arrow_ipc.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+#ifdef TOOTEGA_HAS_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef TOOTEGA_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Tootega
+{
+namespace Data
+{
+
+/*
+ * Arrow IPC messages carry their metadata as flatbuffers (Message.fbs,
+ * Schema.fbs). Only a handful of tables are written, so the builder below
+ * covers just what they need instead of pulling in the flatbuffers library:
+ * like the reference builder it fills its buffer back to front, so children
+ * are written before the tables pointing at them. Offsets are kept as
+ * distances from the end of the buffer, which do not move as it grows.
+ * Values are stored in host byte order; the schema declares little endian,
+ * as are all the targets this server builds for.
+ */
+
+namespace
+{
+
+class FlatBuilder
+{
+  public:
+    using Ref = uint32_t;
+
+    size_t size() const
+    {
+        return m_buffer.size() - m_head;
+    }
+
+    /// Pad so the buffer is aligned to @p alignment once @p following more bytes are prepended
+    void align(size_t alignment, size_t following = 0)
+    {
+        m_minAlign = std::max(m_minAlign, alignment);
+        pad((alignment - (size() + following) % alignment) % alignment);
+    }
+
+    template <typename T> void add(T value)
+    {
+        align(sizeof(T));
+        push(&value, sizeof(T));
+    }
+
+    Ref string(const std::string &value)
+    {
+        align(4, value.size() + 1);
+        pad(1);
+        push(value.data(), value.size());
+        push(static_cast<uint32_t>(value.size()));
+        return static_cast<Ref>(size());
+    }
+
+    Ref offsets(const std::vector<Ref> &refs)
+    {
+        align(4, refs.size() * 4);
+        for (size_t i = refs.size(); i-- > 0;)
+            push(offsetTo(refs[i]));
+        push(static_cast<uint32_t>(refs.size()));
+        return static_cast<Ref>(size());
+    }
+
+    /// Vector of structs made of two int64 (FieldNode, Buffer)
+    Ref pairs(const std::vector<std::pair<int64_t, int64_t>> &items)
+    {
+        align(4, items.size() * 16);
+        align(8, items.size() * 16);
+        for (size_t i = items.size(); i-- > 0;)
+        {
+            push(items[i].second);
+            push(items[i].first);
+        }
+        push(static_cast<uint32_t>(items.size()));
+        return static_cast<Ref>(size());
+    }
+
+    void startTable()
+    {
+        m_fields.clear();
+        m_tableStart = size();
+    }
+
+    template <typename T> void addField(uint16_t id, T value)
+    {
+        add(value);
+        m_fields.emplace_back(id, size());
+    }
+
+    void addOffsetField(uint16_t id, Ref ref)
+    {
+        align(4);
+        push(offsetTo(ref));
+        m_fields.emplace_back(id, size());
+    }
+
+    Ref endTable()
+    {
+        add<int32_t>(0);
+        size_t table = size();
+
+        uint16_t slots = 0;
+        for (const auto &field : m_fields)
+            slots = std::max<uint16_t>(slots, field.first + 1);
+        std::vector<uint16_t> vtable(slots, 0);
+        for (const auto &field : m_fields)
+            vtable[field.first] = static_cast<uint16_t>(table - field.second);
+
+        for (size_t i = vtable.size(); i-- > 0;)
+            push(vtable[i]);
+        push(static_cast<uint16_t>(table - m_tableStart));
+        push(static_cast<uint16_t>(4 + 2 * vtable.size()));
+
+        // The table starts with the distance back to its vtable, which was prepended just now
+        int32_t vtableOffset = static_cast<int32_t>(size() - table);
+        std::memcpy(&m_buffer[m_buffer.size() - table], &vtableOffset, sizeof(vtableOffset));
+        return static_cast<Ref>(table);
+    }
+
+    std::string finish(Ref root)
+    {
+        align(std::max<size_t>(m_minAlign, 8), 4);
+        push(offsetTo(root));
+        return std::string(m_buffer.data() + m_head, size());
+    }
+
+  private:
+    uint32_t offsetTo(Ref ref) const
+    {
+        // Measured from where the offset itself is about to be written
+        return static_cast<uint32_t>(size() + 4 - ref);
+    }
+
+    void reserve(size_t bytes)
+    {
+        if (m_head >= bytes)
+            return;
+        size_t used = size();
+        size_t capacity = std::max(m_buffer.size() * 2, used + bytes + 256);
+        std::vector<char> grown(capacity);
+        std::memcpy(grown.data() + capacity - used, m_buffer.data() + m_head, used);
+        m_buffer.swap(grown);
+        m_head = capacity - used;
+    }
+
+    void pad(size_t bytes)
+    {
+        reserve(bytes);
+        m_head -= bytes;
+        std::memset(&m_buffer[m_head], 0, bytes);
+    }
+
+    void push(const void *data, size_t bytes)
+    {
+        reserve(bytes);
+        m_head -= bytes;
+        if (bytes > 0)
+            std::memcpy(&m_buffer[m_head], data, bytes);
+    }
+
+    template <typename T> void push(T value)
+    {
+        push(&value, sizeof(T));
+    }
+
+    std::vector<char> m_buffer;
+    size_t m_head = 0;
+    size_t m_minAlign = 1;
+    size_t m_tableStart = 0;
+    std::vector<std::pair<uint16_t, size_t>> m_fields;
+};
+
+// Schema.fbs / Message.fbs constants
+constexpr int16_t kMetadataV5 = 4;
+constexpr uint8_t kHeaderSchema = 1;
+constexpr uint8_t kHeaderRecordBatch = 3;
+
+enum ArrowType : uint8_t
+{
+    Int = 2,
+    FloatingPoint = 3,
+    Binary = 4,
+    Utf8 = 5,
+    Bool = 6,
+    Date = 8,
+    Timestamp = 10
+};
+
+ArrowType arrowTypeOf(ValueKind kind)
+{
+    switch (kind)
+    {
+    case ValueKind::Integer:
+        return ArrowType::Int;
+    case ValueKind::Float:
+        return ArrowType::FloatingPoint;
+    case ValueKind::Boolean:
+        return ArrowType::Bool;
+    case ValueKind::Date:
+        return ArrowType::Date;
+    case ValueKind::DateTime:
+        return ArrowType::Timestamp;
+    case ValueKind::Binary:
+        return ArrowType::Binary;
+    case ValueKind::Text:
+    case ValueKind::Decimal:
+    case ValueKind::Guid:
+        break;
+    }
+    return ArrowType::Utf8;
+}
+
+FlatBuilder::Ref addTypeTable(FlatBuilder &builder, ArrowType type)
+{
+    builder.startTable();
+    switch (type)
+    {
+    case ArrowType::Int:
+        builder.addField<int32_t>(0, 64); // bitWidth
+        builder.addField<uint8_t>(1, 1);  // is_signed
+        break;
+    case ArrowType::FloatingPoint:
+        builder.addField<int16_t>(0, 2); // DOUBLE
+        break;
+    case ArrowType::Date:
+        builder.addField<int16_t>(0, 0); // DAY
+        break;
+    case ArrowType::Timestamp:
+        builder.addField<int16_t>(0, 2); // MICROSECOND, no time zone
+        break;
+    default:
+        break;
+    }
+    return builder.endTable();
+}
+
+FlatBuilder::Ref addMetadata(FlatBuilder &builder, const ArrowStreamWriter::Metadata &metadata)
+{
+    std::vector<FlatBuilder::Ref> entries;
+    for (const auto &entry : metadata)
+    {
+        FlatBuilder::Ref key = builder.string(entry.first);
+        FlatBuilder::Ref value = builder.string(entry.second);
+        builder.startTable();
+        builder.addOffsetField(0, key);
+        builder.addOffsetField(1, value);
+        entries.push_back(builder.endTable());
+    }
+    return builder.offsets(entries);
+}
+
+std::string finishMessage(FlatBuilder &builder, uint8_t headerType, FlatBuilder::Ref header, int64_t bodyLength)
+{
+    builder.startTable();
+    builder.addField<int16_t>(0, kMetadataV5);
+    builder.addField<uint8_t>(1, headerType);
+    builder.addOffsetField(2, header);
+    builder.addField<int64_t>(3, bodyLength);
+    return builder.finish(builder.endTable());
+}
+
+void appendFrame(std::string &out, const std::string &metadata)
+{
+    // Continuation marker and metadata length; the length includes padding to 8 bytes
+    uint32_t continuation = 0xFFFFFFFF;
+    int32_t length = static_cast<int32_t>((metadata.size() + 7) / 8 * 8);
+    out.append(reinterpret_cast<const char *>(&continuation), 4);
+    out.append(reinterpret_cast<const char *>(&length), 4);
+    out += metadata;
+    out.append(length - metadata.size(), '\0');
+}
+
+template <typename T> void appendScalar(std::string &buffer, T value)
+{
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> bool parseNumber(std::string_view text, T &value)
+{
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+int32_t daysFromCivil(int year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int>(dayOfEra) - 719468;
+}
+
+bool parseDate(std::string_view text, int32_t &days)
+{
+    int year = 0;
+    unsigned month = 0;
+    unsigned day = 0;
+    if (text.size() != 10 || text[4] != '-' || text[7] != '-' || !parseNumber(text.substr(0, 4), year) ||
+        !parseNumber(text.substr(5, 2), month) || !parseNumber(text.substr(8, 2), day) || month < 1 || month > 12 ||
+        day < 1 || day > 31)
+        return false;
+    days = daysFromCivil(year, month, day);
+    return true;
+}
+
+bool parseDateTime(std::string_view text, int64_t &micros)
+{
+    int32_t days = 0;
+    unsigned hour = 0;
+    unsigned minute = 0;
+    unsigned second = 0;
+    if (text.size() < 19 || (text[10] != ' ' && text[10] != 'T') || text[13] != ':' || text[16] != ':' ||
+        !parseDate(text.substr(0, 10), days) || !parseNumber(text.substr(11, 2), hour) ||
+        !parseNumber(text.substr(14, 2), minute) || !parseNumber(text.substr(17, 2), second))
+        return false;
+
+    // Fractions past microseconds (datetime2 has 100 ns ticks) are dropped
+    int64_t fraction = 0;
+    if (text.size() > 19)
+    {
+        std::string_view digits = text.substr(20);
+        if (text[19] != '.' || digits.empty() || digits.size() > 9 ||
+            !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            return false;
+        for (size_t i = 0; i < 6; i++)
+            fraction = fraction * 10 + (i < digits.size() ? digits[i] - '0' : 0);
+    }
+
+    micros = ((static_cast<int64_t>(days) * 24 + hour) * 60 + minute) * 60 + second;
+    micros = micros * 1000000 + fraction;
+    return true;
+}
+
+} // namespace
+
+bool parseArrowCompression(const std::string &name, ArrowCompression &compression)
+{
+    if (name.empty() || name == "none")
+    {
+        compression = ArrowCompression::None;
+        return true;
+    }
+#ifdef TOOTEGA_HAS_LZ4
+    if (name == "lz4")
+    {
+        compression = ArrowCompression::Lz4Frame;
+        return true;
+    }
+#endif
+#ifdef TOOTEGA_HAS_ZSTD
+    if (name == "zstd")
+    {
+        compression = ArrowCompression::Zstd;
+        return true;
+    }
+#endif
+    return false;
+}
+
+ArrowStreamWriter::ArrowStreamWriter(ArrowCompression compression) : m_compression(compression)
+{
+}
+
+void ArrowStreamWriter::writeSchema(std::string &out, const ResultSet &data, size_t columnCount,
+                                    const Metadata &metadata)
+{
+    m_kinds.clear();
+    for (size_t column = 0; column < columnCount; column++)
+        m_kinds.push_back(data.columnKind(column));
+
+    FlatBuilder builder;
+    std::vector<FlatBuilder::Ref> fields;
+    for (size_t column = 0; column < columnCount; column++)
+    {
+        ArrowType type = arrowTypeOf(m_kinds[column]);
+        FlatBuilder::Ref name = builder.string(data.columnName(column));
+        FlatBuilder::Ref typeTable = addTypeTable(builder, type);
+        FlatBuilder::Ref children = builder.offsets({});
+        FlatBuilder::Ref fieldMetadata = addMetadata(builder, {{"browseroso.kind", valueKindName(m_kinds[column])}});
+
+        builder.startTable();
+        builder.addOffsetField(0, name);
+        builder.addField<uint8_t>(1, 1); // nullable
+        builder.addField<uint8_t>(2, type);
+        builder.addOffsetField(3, typeTable);
+        builder.addOffsetField(5, children);
+        builder.addOffsetField(6, fieldMetadata);
+        fields.push_back(builder.endTable());
+    }
+    FlatBuilder::Ref fieldVector = builder.offsets(fields);
+    FlatBuilder::Ref schemaMetadata = addMetadata(builder, metadata);
+
+    builder.startTable();
+    builder.addField<int16_t>(0, 0); // little endian
+    builder.addOffsetField(1, fieldVector);
+    builder.addOffsetField(2, schemaMetadata);
+    FlatBuilder::Ref schema = builder.endTable();
+
+    appendFrame(out, finishMessage(builder, kHeaderSchema, schema, 0));
+}
+
+bool ArrowStreamWriter::writeBatch(std::string &out, const ResultSet &data, std::string &error)
+{
+    m_nodes.clear();
+    m_bufferRegions.clear();
+    m_buffers.resize(std::max<size_t>(m_buffers.size(), 3));
+
+    std::string body;
+    for (size_t column = 0; column < m_kinds.size(); column++)
+    {
+        ValueKind kind = data.columnKind(column);
+        if (arrowTypeOf(kind) != arrowTypeOf(m_kinds[column]))
+        {
+            error = "Column " + data.columnName(column) + " changed from " + valueKindName(m_kinds[column]) +
+                    " to " + valueKindName(kind) + " values";
+            return false;
+        }
+
+        int64_t nullCount = 0;
+        if (!encodeColumn(data, column, nullCount, error))
+            return false;
+        m_nodes.emplace_back(static_cast<int64_t>(data.rowCount()), nullCount);
+
+        // Validity, then values (and offsets before data for the variable length types)
+        size_t bufferCount = arrowTypeOf(kind) == ArrowType::Utf8 || arrowTypeOf(kind) == ArrowType::Binary ? 3 : 2;
+        for (size_t i = 0; i < bufferCount; i++)
+            addBuffer(body, m_buffers[i]);
+    }
+
+    FlatBuilder builder;
+    FlatBuilder::Ref nodes = builder.pairs(m_nodes);
+    FlatBuilder::Ref buffers = builder.pairs(m_bufferRegions);
+    FlatBuilder::Ref compression = 0;
+    if (m_compression != ArrowCompression::None)
+    {
+        builder.startTable();
+        builder.addField<int8_t>(0, m_compression == ArrowCompression::Zstd ? 1 : 0); // ZSTD or LZ4_FRAME
+        builder.addField<int8_t>(1, 0);                                                // BUFFER
+        compression = builder.endTable();
+    }
+
+    builder.startTable();
+    builder.addField<int64_t>(0, static_cast<int64_t>(data.rowCount()));
+    builder.addOffsetField(1, nodes);
+    builder.addOffsetField(2, buffers);
+    if (compression != 0)
+        builder.addOffsetField(3, compression);
+    FlatBuilder::Ref batch = builder.endTable();
+
+    appendFrame(out, finishMessage(builder, kHeaderRecordBatch, batch, static_cast<int64_t>(body.size())));
+    out += body;
+    return true;
+}
+
+void ArrowStreamWriter::writeEnd(std::string &out)
+{
+    uint32_t continuation = 0xFFFFFFFF;
+    uint32_t length = 0;
+    out.append(reinterpret_cast<const char *>(&continuation), 4);
+    out.append(reinterpret_cast<const char *>(&length), 4);
+}
+
+bool ArrowStreamWriter::encodeColumn(const ResultSet &data, size_t column, int64_t &nullCount, std::string &error)
+{
+    size_t rows = data.rowCount();
+    ArrowType type = arrowTypeOf(m_kinds[column]);
+
+    std::string &validity = m_buffers[0];
+    std::string &values = m_buffers[1];
+    std::string &bytes = m_buffers[2];
+    validity.assign((rows + 7) / 8, '\0');
+    values.clear();
+    bytes.clear();
+
+    if (type == ArrowType::Bool)
+        values.assign((rows + 7) / 8, '\0');
+    else if (type == ArrowType::Utf8 || type == ArrowType::Binary)
+        appendScalar<int32_t>(values, 0);
+
+    nullCount = 0;
+    for (size_t row = 0; row < rows; row++)
+    {
+        bool null = data.isNull(row, column);
+        if (null)
+            nullCount++;
+        else
+            validity[row / 8] = static_cast<char>(validity[row / 8] | 1 << (row % 8));
+        std::string_view text = null ? std::string_view() : data.value(row, column);
+
+        bool parsed = true;
+        switch (type)
+        {
+        case ArrowType::Int: {
+            int64_t value = 0;
+            parsed = null || parseNumber(text, value);
+            appendScalar(values, value);
+            break;
+        }
+        case ArrowType::FloatingPoint: {
+            double value = 0;
+            parsed = null || parseNumber(text, value);
+            appendScalar(values, value);
+            break;
+        }
+        case ArrowType::Bool:
+            if (text == "true")
+                values[row / 8] = static_cast<char>(values[row / 8] | 1 << (row % 8));
+            else
+                parsed = null || text == "false";
+            break;
+        case ArrowType::Date: {
+            int32_t days = 0;
+            parsed = null || parseDate(text, days);
+            appendScalar(values, days);
+            break;
+        }
+        case ArrowType::Timestamp: {
+            int64_t micros = 0;
+            parsed = null || parseDateTime(text, micros);
+            appendScalar(values, micros);
+            break;
+        }
+        case ArrowType::Binary:
+            parsed = null || appendHex(bytes, text);
+            appendScalar(values, static_cast<int32_t>(bytes.size()));
+            break;
+        default:
+            bytes.append(text);
+            appendScalar(values, static_cast<int32_t>(bytes.size()));
+            break;
+        }
+
+        if (!parsed)
+        {
+            error = "Column " + data.columnName(column) + " has a value that is not " +
+                    valueKindName(m_kinds[column]) + ": " + std::string(text);
+            return false;
+        }
+        if (bytes.size() > INT32_MAX)
+        {
+            error = "Column " + data.columnName(column) + " holds more than 2 GiB in one batch";
+            return false;
+        }
+    }
+
+    // A column without nulls needs no validity bitmap
+    if (nullCount == 0)
+        validity.clear();
+    return true;
+}
+
+void ArrowStreamWriter::addBuffer(std::string &body, std::string &buffer)
+{
+    size_t offset = body.size();
+    if (m_compression == ArrowCompression::None || buffer.empty())
+    {
+        body += buffer;
+    }
+    else
+    {
+        // Compressed buffers start with their uncompressed length
+        appendScalar<int64_t>(body, static_cast<int64_t>(buffer.size()));
+        size_t compressed = 0;
+#ifdef TOOTEGA_HAS_LZ4
+        if (m_compression == ArrowCompression::Lz4Frame)
+        {
+            m_compressed.resize(LZ4F_compressFrameBound(buffer.size(), nullptr));
+            compressed = LZ4F_compressFrame(&m_compressed[0], m_compressed.size(), buffer.data(), buffer.size(),
+                                            nullptr);
+            if (LZ4F_isError(compressed))
+                compressed = 0;
+        }
+#endif
+#ifdef TOOTEGA_HAS_ZSTD
+        if (m_compression == ArrowCompression::Zstd)
+        {
+            m_compressed.resize(ZSTD_compressBound(buffer.size()));
+            compressed = ZSTD_compress(&m_compressed[0], m_compressed.size(), buffer.data(), buffer.size(), 1);
+            if (ZSTD_isError(compressed))
+                compressed = 0;
+        }
+#endif
+        if (compressed > 0)
+        {
+            body.append(m_compressed.data(), compressed);
+        }
+        else
+        {
+            // A length of -1 marks the buffer as stored uncompressed
+            body.resize(offset);
+            appendScalar<int64_t>(body, -1);
+            body += buffer;
+        }
+    }
+
+    m_bufferRegions.emplace_back(static_cast<int64_t>(offset), static_cast<int64_t>(body.size() - offset));
+    body.append((8 - body.size() % 8) % 8, '\0');
+}
+
+} // namespace Data
+} // namespace Tootega
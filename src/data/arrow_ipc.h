@@ -0,0 +1,90 @@
+/**
+ * @file arrow_ipc.h
+ * @brief Apache Arrow IPC stream encoding of result sets
+ */
+
+#pragma once
+
+#include "result_set.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/// Media type of an Arrow IPC stream
+constexpr const char *kArrowStreamContentType = "application/vnd.apache.arrow.stream";
+
+/**
+ * @brief Codec of the compressed buffers of a record batch
+ */
+enum class ArrowCompression
+{
+    None,
+    Lz4Frame, ///< Needs the server built with liblz4
+    Zstd      ///< Needs the server built with libzstd
+};
+
+/**
+ * @brief Parse a codec name ("none", "lz4", "zstd")
+ * @return false if @p name is not a codec or the codec is not compiled in
+ */
+bool parseArrowCompression(const std::string &name, ArrowCompression &compression);
+
+/**
+ * @class ArrowStreamWriter
+ * @brief Writes result sets as an Arrow IPC stream: a schema, record batches, end of stream
+ *
+ * Columns are typed from their value kinds: Integer as int64, Float as
+ * float64, Boolean as bool, Date as date32, DateTime as timestamp[us] and
+ * Binary as binary; everything else (Decimal and Guid included, to keep
+ * them exact) as utf8. Every field is nullable and carries its value kind
+ * in the "browseroso.kind" metadata. Cells are parsed from the text the
+ * fetch stored, straight into the batch's buffers.
+ */
+class ArrowStreamWriter
+{
+  public:
+    using Metadata = std::vector<std::pair<std::string, std::string>>;
+
+    explicit ArrowStreamWriter(ArrowCompression compression = ArrowCompression::None);
+
+    /**
+     * @brief Append the schema message
+     * @param columnCount Columns of @p data written (the first ones)
+     * @param metadata Key/value pairs attached to the schema
+     */
+    void writeSchema(std::string &out, const ResultSet &data, size_t columnCount, const Metadata &metadata = {});
+
+    /**
+     * @brief Append a record batch with every row of @p data
+     * @return false with @p error set if a column no longer has the schema's type
+     *         or a cell does not parse as it
+     */
+    bool writeBatch(std::string &out, const ResultSet &data, std::string &error);
+
+    /**
+     * @brief Append the end-of-stream marker
+     */
+    static void writeEnd(std::string &out);
+
+  private:
+    bool encodeColumn(const ResultSet &data, size_t column, int64_t &nullCount, std::string &error);
+    void addBuffer(std::string &body, std::string &buffer);
+
+    ArrowCompression m_compression;
+    std::vector<ValueKind> m_kinds;
+
+    // Scratch space of the batch being written, reused across batches
+    std::vector<std::string> m_buffers;
+    std::vector<std::pair<int64_t, int64_t>> m_nodes;
+    std::vector<std::pair<int64_t, int64_t>> m_bufferRegions;
+    std::string m_compressed;
+};
+
+} // namespace Data
+} // namespace Tootega
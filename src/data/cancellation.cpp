@@ -0,0 +1,116 @@
+/**
+ * @file cancellation.cpp
+ * @brief Request deadlines and cancellation implementation
+ */
+
+#include "cancellation.h"
+
+#include <algorithm>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// Registration
+
+CancellationToken::Registration::~Registration()
+{
+    if (m_token)
+        m_token->unregister(m_id);
+}
+
+CancellationToken::Registration::Registration(Registration &&other) noexcept : m_token(other.m_token), m_id(other.m_id)
+{
+    other.m_token = nullptr;
+}
+
+CancellationToken::Registration &CancellationToken::Registration::operator=(Registration &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_token)
+            m_token->unregister(m_id);
+        m_token = other.m_token;
+        m_id = other.m_id;
+        other.m_token = nullptr;
+    }
+    return *this;
+}
+
+// CancellationToken
+
+CancellationToken::CancellationToken(std::chrono::milliseconds timeout) : m_deadline(Clock::now() + timeout)
+{
+}
+
+void CancellationToken::cancel()
+{
+    // Callbacks run under the lock so unregister() can wait for a running one
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cancelled.exchange(true))
+        return;
+
+    for (auto &[id, callback] : m_callbacks)
+    {
+        callback();
+    }
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return m_cancelled.load() || deadlineExceeded();
+}
+
+bool CancellationToken::deadlineExceeded() const
+{
+    return hasDeadline() && Clock::now() >= m_deadline;
+}
+
+std::chrono::milliseconds CancellationToken::remaining(std::chrono::milliseconds limit) const
+{
+    if (!hasDeadline())
+        return limit;
+
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - Clock::now());
+    return std::max(std::chrono::milliseconds(0), std::min(limit, left));
+}
+
+int CancellationToken::remainingSeconds() const
+{
+    if (!hasDeadline())
+        return 0;
+
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - Clock::now()).count();
+    if (left <= 0)
+        return 1;
+    return static_cast<int>((left + 999) / 1000);
+}
+
+std::string CancellationToken::reason() const
+{
+    return deadlineExceeded() ? "Request deadline exceeded" : "Request cancelled";
+}
+
+CancellationToken::Registration CancellationToken::onCancel(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cancelled.load())
+    {
+        callback();
+        return Registration();
+    }
+
+    size_t id = m_nextId++;
+    m_callbacks.emplace(id, std::move(callback));
+    return Registration(this, id);
+}
+
+void CancellationToken::unregister(size_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callbacks.erase(id);
+}
+
+} // namespace Data
+} // namespace Tootega
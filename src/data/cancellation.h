@@ -0,0 +1,128 @@
+/**
+ * @file cancellation.h
+ * @brief Request deadlines and cancellation shared with the queries a request runs
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class CancellationToken
+ * @brief Deadline and cancel flag of one request
+ *
+ * Code that blocks on the database registers a callback (SQLCancel,
+ * sqlite3_interrupt) for as long as it runs; cancel() invokes it from
+ * whichever thread noticed the request is no longer wanted.
+ */
+class CancellationToken
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @class Registration
+     * @brief Keeps a cancel callback registered; unregisters on destruction
+     *
+     * Once the destructor returns the callback is not running and will not run.
+     */
+    class Registration
+    {
+      public:
+        Registration() = default;
+        Registration(CancellationToken *token, size_t id) : m_token(token), m_id(id)
+        {
+        }
+        ~Registration();
+
+        Registration(Registration &&other) noexcept;
+        Registration &operator=(Registration &&other) noexcept;
+
+        Registration(const Registration &) = delete;
+        Registration &operator=(const Registration &) = delete;
+
+      private:
+        CancellationToken *m_token = nullptr;
+        size_t m_id = 0;
+    };
+
+    /**
+     * @brief Token without a deadline
+     */
+    CancellationToken() = default;
+
+    /**
+     * @brief Token expiring @p timeout from now
+     */
+    explicit CancellationToken(std::chrono::milliseconds timeout);
+
+    CancellationToken(const CancellationToken &) = delete;
+    CancellationToken &operator=(const CancellationToken &) = delete;
+
+    /**
+     * @brief Cancel now and run the registered callbacks (idempotent)
+     */
+    void cancel();
+
+    /**
+     * @brief True once cancelled or past the deadline
+     */
+    bool isCancelled() const;
+
+    bool deadlineExceeded() const;
+
+    bool hasDeadline() const
+    {
+        return m_deadline != Clock::time_point::max();
+    }
+
+    Clock::time_point deadline() const
+    {
+        return m_deadline;
+    }
+
+    /**
+     * @brief Time left before the deadline, at most @p limit
+     */
+    std::chrono::milliseconds remaining(std::chrono::milliseconds limit) const;
+
+    /**
+     * @brief Whole seconds left, rounded up, for SQL_ATTR_QUERY_TIMEOUT (0 = no deadline)
+     */
+    int remainingSeconds() const;
+
+    /**
+     * @brief Error message describing why the token was cancelled
+     */
+    std::string reason() const;
+
+    /**
+     * @brief Run @p callback on cancellation while the registration is alive
+     *
+     * The callback runs right away if the token is already cancelled. It may
+     * run on another thread and must not block.
+     */
+    [[nodiscard]] Registration onCancel(std::function<void()> callback);
+
+  private:
+    void unregister(size_t id);
+
+    const Clock::time_point m_deadline = Clock::time_point::max();
+    std::atomic<bool> m_cancelled{false};
+    std::map<size_t, std::function<void()>> m_callbacks;
+    size_t m_nextId = 1;
+    std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
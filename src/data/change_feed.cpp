@@ -0,0 +1,280 @@
+/**
+ * @file change_feed.cpp
+ * @brief Shared polling of watched tables for the rows that changed implementation
+ */
+
+#include "change_feed.h"
+#include "page_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// Deadline of one poll; a slower one fails and the next poll retries
+static constexpr auto kPollTimeout = std::chrono::seconds(30);
+
+// Updates queued for a watcher before its backlog collapses into one stale update
+static constexpr size_t kMaxPendingUpdates = 16;
+
+static std::atomic<size_t> s_configuredMaxWatchers{ChangeFeed::kDefaultMaxWatchers};
+static std::atomic<int> s_configuredPollSeconds{ChangeFeed::kDefaultPollSeconds};
+
+/**
+ * @brief A watched table: its source, its watchers and its poller's stop flag
+ */
+struct ChangeFeed::Table
+{
+    std::string key;
+    std::unique_ptr<ChangeSource> source; ///< Only used by the poller thread
+    std::string method;
+
+    std::thread poller;
+
+    std::vector<Watcher *> watchers;
+    bool stopping = false;
+    bool finished = false; ///< The poller has exited and can be joined at once
+    uint64_t sequence = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+ChangeFeed::Watcher::~Watcher()
+{
+    m_feed.leave(this, m_table);
+}
+
+const std::string &ChangeFeed::Watcher::method() const
+{
+    return m_table->method;
+}
+
+bool ChangeFeed::Watcher::next(Update &update, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_ready.wait_for(lock, timeout, [this]() { return !m_pending.empty(); }))
+        return false;
+
+    update = std::move(m_pending.front());
+    m_pending.pop_front();
+    return true;
+}
+
+void ChangeFeed::Watcher::push(const Update &update)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.size() < kMaxPendingUpdates)
+        {
+            m_pending.push_back(update);
+        }
+        else
+        {
+            auto stale = std::make_shared<ChangeBatch>();
+            stale->stale = true;
+            m_pending.clear();
+            m_pending.push_back(Update{update.sequence, stale, std::string()});
+        }
+    }
+    m_ready.notify_one();
+}
+
+ChangeFeed &ChangeFeed::getInstance()
+{
+    static ChangeFeed instance(s_configuredMaxWatchers.load(), s_configuredPollSeconds.load());
+    return instance;
+}
+
+void ChangeFeed::configure(size_t maxWatchers, int pollSeconds)
+{
+    s_configuredMaxWatchers = maxWatchers;
+    if (pollSeconds > 0)
+        s_configuredPollSeconds = pollSeconds;
+}
+
+ChangeFeed::ChangeFeed(size_t maxWatchers, int pollSeconds) : m_maxWatchers(maxWatchers), m_pollSeconds(pollSeconds)
+{
+}
+
+ChangeFeed::~ChangeFeed()
+{
+    std::vector<std::shared_ptr<Table>> tables;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tables = std::move(m_stopped);
+        for (auto &entry : m_tables)
+            tables.push_back(entry.second);
+        m_tables.clear();
+    }
+
+    for (auto &table : tables)
+    {
+        {
+            std::lock_guard<std::mutex> lock(table->mutex);
+            table->stopping = true;
+        }
+        table->wake.notify_all();
+        if (table->poller.joinable())
+            table->poller.join();
+    }
+}
+
+void ChangeFeed::reapPollers()
+{
+    auto exited = std::partition(m_stopped.begin(), m_stopped.end(), [](const std::shared_ptr<Table> &table) {
+        std::lock_guard<std::mutex> lock(table->mutex);
+        return !table->finished;
+    });
+    for (auto it = exited; it != m_stopped.end(); ++it)
+        (*it)->poller.join();
+    m_stopped.erase(exited, m_stopped.end());
+}
+
+std::shared_ptr<ChangeFeed::Watcher> ChangeFeed::watch(const std::string &tableKey, const Opener &open,
+                                                      std::string &error)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_watchers >= m_maxWatchers)
+        {
+            m_rejected++;
+            error = "Too many watchers";
+            return nullptr;
+        }
+        m_watchers++;
+    }
+
+    // A watcher is attached while the feed is held, so no leave() can stop its table in between
+    std::shared_ptr<Watcher> watcher;
+    auto attach = [&](const std::shared_ptr<Table> &table) {
+        watcher = std::make_shared<Watcher>(*this, table);
+        std::lock_guard<std::mutex> tableLock(table->mutex);
+        table->watchers.push_back(watcher.get());
+    };
+    auto find = [&]() -> std::shared_ptr<Table> {
+        auto it = m_tables.find(tableKey);
+        return it != m_tables.end() ? it->second : nullptr;
+    };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        reapPollers();
+        if (auto table = find())
+        {
+            attach(table);
+            return watcher;
+        }
+    }
+
+    // The source is opened without holding the feed; a table someone else started meanwhile wins
+    auto table = std::make_shared<Table>();
+    table->key = tableKey;
+    table->source = open(error);
+    if (!table->source)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_watchers--;
+        return nullptr;
+    }
+    table->method = table->source->method();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto started = find())
+    {
+        attach(started);
+        return watcher;
+    }
+    m_tables.emplace(tableKey, table);
+    table->poller = std::thread(&ChangeFeed::run, this, table);
+    attach(table);
+    return watcher;
+}
+
+void ChangeFeed::leave(Watcher *watcher, const std::shared_ptr<Table> &table)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_watchers--;
+
+    std::lock_guard<std::mutex> tableLock(table->mutex);
+    table->watchers.erase(std::remove(table->watchers.begin(), table->watchers.end(), watcher),
+                          table->watchers.end());
+    if (!table->watchers.empty())
+        return;
+
+    // The poller finishes the poll it may be running, then exits and is joined by a later watch() or on shutdown
+    table->stopping = true;
+    table->wake.notify_all();
+    auto it = m_tables.find(table->key);
+    if (it != m_tables.end() && it->second == table)
+        m_tables.erase(it);
+    m_stopped.push_back(table);
+}
+
+void ChangeFeed::run(std::shared_ptr<Table> table)
+{
+    bool failing = false;
+    std::unique_lock<std::mutex> lock(table->mutex);
+    while (!table->wake.wait_for(lock, std::chrono::seconds(m_pollSeconds), [&]() { return table->stopping; }))
+    {
+        lock.unlock();
+
+        auto changes = std::make_shared<ChangeBatch>();
+        CancellationToken cancel(kPollTimeout);
+        std::string error;
+        bool polled = table->source->poll(*changes, cancel, error);
+        bool changed =
+            polled && (changes->stale || changes->rows.rowCount() > 0 || changes->deleted.rowCount() > 0);
+
+        // A failure is reported once, not on every poll until the database is back
+        Update update;
+        if (changed)
+        {
+            PageCache::getInstance().invalidateTable(table->key);
+            update.changes = std::move(changes);
+        }
+        else if (!polled && !failing)
+        {
+            update.error = error;
+        }
+        failing = !polled;
+
+        {
+            std::lock_guard<std::mutex> statsLock(m_mutex);
+            m_polls++;
+            m_failedPolls += polled ? 0 : 1;
+            m_updates += changed ? 1 : 0;
+            m_stale += changed && update.changes->stale ? 1 : 0;
+        }
+
+        lock.lock();
+        if (update.changes || !update.error.empty())
+        {
+            update.sequence = ++table->sequence;
+            for (Watcher *watcher : table->watchers)
+                watcher->push(update);
+        }
+    }
+    table->finished = true;
+}
+
+ChangeFeed::Stats ChangeFeed::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.watchers = m_watchers;
+    stats.maxWatchers = m_maxWatchers;
+    stats.tables = m_tables.size();
+    stats.polls = m_polls;
+    stats.failedPolls = m_failedPolls;
+    stats.updates = m_updates;
+    stats.stale = m_stale;
+    stats.rejected = m_rejected;
+    return stats;
+}
+
+} // namespace Data
+} // namespace Tootega
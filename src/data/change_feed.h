@@ -0,0 +1,160 @@
+/**
+ * @file change_feed.h
+ * @brief Shared polling of watched tables for the rows that changed
+ */
+
+#pragma once
+
+#include "data_backend.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class ChangeFeed
+ * @brief Polls each watched table once for all of its watchers
+ *
+ * The first watcher of a table (same target, schema and table) opens its
+ * ChangeSource and starts a poller thread for it; later watchers join that
+ * poller and the last one to leave stops it, so the database load grows
+ * with the tables watched, not with the clients. Changes found drop the
+ * table's cached pages and are queued to every watcher; a watcher that
+ * falls behind gets a single stale update in place of its backlog.
+ */
+class ChangeFeed
+{
+  public:
+    /// Watchers at once when not configured; each holds an HTTP worker
+    static constexpr size_t kDefaultMaxWatchers = 4;
+
+    /// Seconds between two polls of a table when not configured
+    static constexpr int kDefaultPollSeconds = 2;
+
+    /**
+     * @brief What one poll of a table found
+     */
+    struct Update
+    {
+        uint64_t sequence = 0;                      ///< Numbers the table's updates, from 1
+        std::shared_ptr<const ChangeBatch> changes; ///< nullptr when the poll failed
+        std::string error;                          ///< Why the poll failed
+    };
+
+    struct Table;
+
+    /**
+     * @class Watcher
+     * @brief One client following a table; leaves it when destroyed
+     */
+    class Watcher
+    {
+      public:
+        Watcher(ChangeFeed &feed, std::shared_ptr<Table> table) : m_feed(feed), m_table(std::move(table))
+        {
+        }
+        ~Watcher();
+
+        Watcher(const Watcher &) = delete;
+        Watcher &operator=(const Watcher &) = delete;
+
+        /// How the table's changes are found (see ChangeSource::method)
+        const std::string &method() const;
+
+        /**
+         * @brief Wait up to @p timeout for the next update
+         * @return false if none came
+         */
+        bool next(Update &update, std::chrono::milliseconds timeout);
+
+        /// Queue an update, collapsing the backlog into a stale update once it is too long
+        void push(const Update &update);
+
+      private:
+        ChangeFeed &m_feed;
+        std::shared_ptr<Table> m_table;
+
+        std::deque<Update> m_pending;
+        std::mutex m_mutex;
+        std::condition_variable m_ready;
+    };
+
+    /// Opens the source of a table no one watches yet; nullptr with the error set if it cannot
+    using Opener = std::function<std::unique_ptr<ChangeSource>(std::string &error)>;
+
+    struct Stats
+    {
+        size_t watchers = 0;
+        size_t maxWatchers = 0;
+        size_t tables = 0;      ///< Tables polled
+        uint64_t polls = 0;
+        uint64_t failedPolls = 0;
+        uint64_t updates = 0;   ///< Polls that found changes
+        uint64_t stale = 0;     ///< Of which reported the table stale
+        uint64_t rejected = 0;  ///< Watchers refused because the cap was reached
+    };
+
+    static ChangeFeed &getInstance();
+
+    /**
+     * @brief Set the cap on watchers and the poll interval; only effective before the first getInstance()
+     */
+    static void configure(size_t maxWatchers, int pollSeconds);
+
+    int pollSeconds() const
+    {
+        return m_pollSeconds;
+    }
+
+    /**
+     * @brief Start watching a table
+     * @param tableKey Identifies the table (see PageCache::makeTableKey)
+     * @return nullptr with @p error set when the cap on watchers is reached or the source could not be opened
+     */
+    std::shared_ptr<Watcher> watch(const std::string &tableKey, const Opener &open, std::string &error);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    ChangeFeed(const ChangeFeed &) = delete;
+    ChangeFeed &operator=(const ChangeFeed &) = delete;
+
+  private:
+    ChangeFeed(size_t maxWatchers, int pollSeconds);
+    ~ChangeFeed();
+
+    void leave(Watcher *watcher, const std::shared_ptr<Table> &table);
+    void run(std::shared_ptr<Table> table);
+
+    // Join the pollers of stopped tables that have exited; expects m_mutex to be held
+    void reapPollers();
+
+    const size_t m_maxWatchers;
+    const int m_pollSeconds;
+
+    std::unordered_map<std::string, std::shared_ptr<Table>> m_tables;
+    std::vector<std::shared_ptr<Table>> m_stopped; ///< Left by their last watcher, poller not joined yet
+    size_t m_watchers = 0;
+    uint64_t m_polls = 0;
+    uint64_t m_failedPolls = 0;
+    uint64_t m_updates = 0;
+    uint64_t m_stale = 0;
+    uint64_t m_rejected = 0;
+
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
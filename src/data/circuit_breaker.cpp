@@ -0,0 +1,147 @@
+/**
+ * @file circuit_breaker.cpp
+ * @brief Fail-fast state of a database server implementation
+ */
+
+#include "circuit_breaker.h"
+
+#include <algorithm>
+
+namespace Tootega
+{
+namespace Data
+{
+
+bool CircuitBreaker::allow(Clock::time_point now, bool &probe)
+{
+    probe = false;
+    if (m_state == State::Closed)
+        return true;
+
+    probe = startProbe(now);
+    m_rejected++;
+    return false;
+}
+
+bool CircuitBreaker::startProbe(Clock::time_point now)
+{
+    if (m_state != State::Open || now < m_retryAt)
+        return false;
+    m_state = State::HalfOpen;
+    m_probes++;
+    return true;
+}
+
+void CircuitBreaker::record(bool failed, const std::string &error, Clock::time_point now)
+{
+    // Calls that started before the circuit opened do not decide anything any more
+    if (m_state != State::Closed)
+        return;
+
+    int64_t slice = sliceOf(now);
+    Bucket &bucket = m_buckets[static_cast<size_t>(slice) % kBuckets];
+    if (bucket.slice != slice)
+        bucket = Bucket{slice, 0, 0};
+    bucket.calls++;
+    if (!failed)
+        return;
+
+    bucket.failures++;
+    m_lastError = error;
+
+    uint64_t calls = 0;
+    uint64_t failures = 0;
+    countWindow(now, calls, failures);
+    if (calls >= kMinCalls && double(failures) >= kFailureRatio * double(calls))
+        open(now);
+}
+
+void CircuitBreaker::probed(bool succeeded, const std::string &error, Clock::time_point now)
+{
+    if (m_state != State::HalfOpen)
+        return;
+
+    if (succeeded)
+    {
+        m_state = State::Closed;
+        m_buckets.fill(Bucket());
+        m_openFor = kOpenFor;
+        return;
+    }
+
+    m_lastError = error;
+    m_openFor = std::min(m_openFor * 2, kMaxOpenFor);
+    m_state = State::Open;
+    m_retryAt = now + m_openFor;
+}
+
+int64_t CircuitBreaker::sliceOf(Clock::time_point now)
+{
+    return now.time_since_epoch() / (std::chrono::duration_cast<Clock::duration>(kWindow) / kBuckets);
+}
+
+void CircuitBreaker::countWindow(Clock::time_point now, uint64_t &calls, uint64_t &failures) const
+{
+    int64_t slice = sliceOf(now);
+    for (const Bucket &bucket : m_buckets)
+    {
+        if (bucket.slice > slice - static_cast<int64_t>(kBuckets))
+        {
+            calls += bucket.calls;
+            failures += bucket.failures;
+        }
+    }
+}
+
+void CircuitBreaker::open(Clock::time_point now)
+{
+    m_state = State::Open;
+    m_openFor = kOpenFor;
+    m_retryAt = now + m_openFor;
+    m_trips++;
+}
+
+int CircuitBreaker::retryAfterSeconds(Clock::time_point now) const
+{
+    if (m_state == State::Closed)
+        return 0;
+    if (m_state == State::HalfOpen || now >= m_retryAt)
+        return 1;
+    auto left = std::chrono::duration_cast<std::chrono::seconds>(m_retryAt - now).count();
+    return static_cast<int>(std::max<long long>(1, left + 1));
+}
+
+CircuitBreaker::Stats CircuitBreaker::getStats(Clock::time_point now) const
+{
+    Stats stats;
+    stats.state = m_state;
+    countWindow(now, stats.calls, stats.failures);
+    stats.trips = m_trips;
+    stats.rejected = m_rejected;
+    stats.probes = m_probes;
+    stats.retryAfterSeconds = retryAfterSeconds(now);
+    stats.lastError = m_lastError;
+    return stats;
+}
+
+const char *CircuitBreaker::stateName(State state)
+{
+    switch (state)
+    {
+    case State::Closed:
+        return "closed";
+    case State::Open:
+        return "open";
+    case State::HalfOpen:
+        return "halfOpen";
+    }
+    return "closed";
+}
+
+bool CircuitBreaker::isUnreachable(const std::string &error)
+{
+    return error.compare(0, 2, "08") == 0 || error.compare(0, 5, "HYT00") == 0 || error.compare(0, 5, "HYT01") == 0;
+}
+
+} // namespace Data
+} // namespace Tootega
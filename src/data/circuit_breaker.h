@@ -0,0 +1,153 @@
+/**
+ * @file circuit_breaker.h
+ * @brief Fail-fast state of a database server that stopped answering
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class CircuitBreaker
+ * @brief Tracks the recent calls to one database server and stops calling it while it is down
+ *
+ * Closed, calls go through and their outcomes are counted over the last
+ * kWindow; once kMinCalls are in and kFailureRatio of them failed (a login
+ * slower than kSlowCall counts as failed), the circuit opens. Open,
+ * calls are refused at once. When the open time is up, the circuit turns
+ * half-open and a single probe runs, started by the next call or by the
+ * owner's own timer: success closes it, failure opens it again for twice as
+ * long, up to kMaxOpenFor.
+ *
+ * Only failures that say the server cannot be reached count, so a wrong
+ * password does not shut other logins out. Not thread-safe: the
+ * ConnectionPool guards it.
+ */
+class CircuitBreaker
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State
+    {
+        Closed,
+        Open,
+        HalfOpen ///< Open while a probe decides whether to close
+    };
+
+    /// Time the failure ratio is computed over, counted in kBuckets slices
+    static constexpr std::chrono::seconds kWindow = std::chrono::seconds(30);
+    static constexpr size_t kBuckets = 10;
+
+    /// Outcomes needed in the window before it can open the circuit
+    static constexpr size_t kMinCalls = 3;
+
+    /// Share of failed outcomes in the window that opens the circuit
+    static constexpr double kFailureRatio = 0.5;
+
+    /// A login slower than this counts as failed, half the login timeout
+    static constexpr std::chrono::milliseconds kSlowCall = std::chrono::seconds(5);
+
+    /// How long the circuit stays open the first time
+    static constexpr std::chrono::seconds kOpenFor = std::chrono::seconds(5);
+
+    /// Longest the circuit stays open between two probes
+    static constexpr std::chrono::seconds kMaxOpenFor = std::chrono::seconds(60);
+
+    struct Stats
+    {
+        State state = State::Closed;
+        uint64_t calls = 0;    ///< Outcomes in the window
+        uint64_t failures = 0; ///< Of which failed
+        uint64_t trips = 0;  ///< Times the circuit opened
+        uint64_t rejected = 0;
+        uint64_t probes = 0;
+        int retryAfterSeconds = 0; ///< Until the next probe, while not closed
+        std::string lastError;     ///< Last failure counted
+    };
+
+    /**
+     * @brief Whether a call may go to the server; a refused call is counted
+     * @param probe Set when the circuit just turned half-open: the caller runs the probe
+     */
+    bool allow(Clock::time_point now, bool &probe);
+
+    /**
+     * @brief Turn an open circuit whose time is up half-open without a call, for a probe the owner runs itself
+     * @return true when the caller runs the probe
+     */
+    bool startProbe(Clock::time_point now);
+
+    /**
+     * @brief Record the outcome of a call made while the circuit was closed
+     */
+    void record(bool failed, const std::string &error, Clock::time_point now);
+
+    /**
+     * @brief Record the outcome of the probe of a half-open circuit
+     */
+    void probed(bool succeeded, const std::string &error, Clock::time_point now);
+
+    State state() const
+    {
+        return m_state;
+    }
+
+    /// Seconds until the next probe (at least 1), 0 while closed
+    int retryAfterSeconds(Clock::time_point now) const;
+
+    /// When an open circuit is due for its probe
+    Clock::time_point retryAt() const
+    {
+        return m_retryAt;
+    }
+
+    Stats getStats(Clock::time_point now) const;
+
+    /// Name of a state as reported to clients
+    static const char *stateName(State state);
+
+    /**
+     * @brief Whether an error says the server cannot be reached (SQLSTATE 08xxx, HYT00/HYT01)
+     *
+     * Refused logins (28000) or unknown databases are answers of a working server.
+     */
+    static bool isUnreachable(const std::string &error);
+
+  private:
+    struct Bucket
+    {
+        int64_t slice = -1; ///< Which slice of time the counts belong to
+        uint64_t calls = 0;
+        uint64_t failures = 0;
+    };
+
+    static int64_t sliceOf(Clock::time_point now);
+
+    // Outcomes of the slices still within the window
+    void countWindow(Clock::time_point now, uint64_t &calls, uint64_t &failures) const;
+
+    void open(Clock::time_point now);
+
+    State m_state = State::Closed;
+    std::array<Bucket, kBuckets> m_buckets;
+
+    std::chrono::seconds m_openFor = kOpenFor;
+    Clock::time_point m_retryAt;
+
+    uint64_t m_trips = 0;
+    uint64_t m_rejected = 0;
+    uint64_t m_probes = 0;
+    std::string m_lastError;
+};
+
+} // namespace Data
+} // namespace Tootega
@@ -4,725 +4,525 @@
  */
 
 #include "connection_manager.h"
+#include "data_backend.h"
+#include "connection_pool.h"
+#include "sqlserver_backend.h"
 
 #include <algorithm>
-#include <sstream>
+#include <functional>
 #include <stdexcept>
-
-#ifdef PLATFORM_WINDOWS
-#undef UNICODE
-#undef _UNICODE
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#endif
-
-#include <sql.h>
-#include <sqlext.h>
+#include <vector>
 
 namespace Tootega
 {
 namespace Data
 {
 
-/**
- * @brief Convert Windows-1252/Latin-1 string to UTF-8
- */
-static std::string latin1ToUtf8(const std::string &latin1)
-{
-#ifdef PLATFORM_WINDOWS
-    if (latin1.empty())
-        return latin1;
-
-    int wideLen = MultiByteToWideChar(1252, 0, latin1.c_str(), -1, NULL, 0);
-    if (wideLen == 0)
-        return latin1;
-
-    std::wstring wide(wideLen, 0);
-    MultiByteToWideChar(1252, 0, latin1.c_str(), -1, &wide[0], wideLen);
-
-    int utf8Len = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, NULL, 0, NULL, NULL);
-    if (utf8Len == 0)
-        return latin1;
+// How often a request waiting for its session checks whether it was cancelled
+static constexpr auto kLockPollInterval = std::chrono::milliseconds(100);
 
-    std::string utf8(utf8Len, 0);
-    WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, &utf8[0], utf8Len, NULL, NULL);
-
-    if (!utf8.empty() && utf8.back() == '\0')
-        utf8.pop_back();
+// Wait for the session, giving up once the request is cancelled or past its deadline
+static bool lockUnlessCancelled(std::unique_lock<std::timed_mutex> &lock, const CancellationToken &cancel)
+{
+    while (!lock.try_lock_for(kLockPollInterval))
+    {
+        if (cancel.isCancelled())
+            return false;
+    }
+    return true;
+}
 
-    return utf8;
-#else
-    return latin1;
-#endif
+// DatabaseConnection public methods
+DatabaseConnection::DatabaseConnection() : m_backend(createSqlServerBackend())
+{
 }
 
-/**
- * @brief ODBC handle wrapper for RAII
- */
-template <typename HandleType> class OdbcHandle
+DatabaseConnection::~DatabaseConnection() = default;
+
+bool DatabaseConnection::connect(const std::string &connectionString)
 {
-  public:
-    OdbcHandle() : m_handle(SQL_NULL_HANDLE)
-    {
-    }
-    ~OdbcHandle()
-    {
-        free();
-    }
+    std::lock_guard<std::timed_mutex> lock(m_mutex);
 
-    HandleType get() const
+    // The connection string picks the engine; reconnecting may switch engines
+    auto backend = DataBackend::create(connectionString);
+    if (!backend)
     {
-        return m_handle;
-    }
-    HandleType *ptr()
-    {
-        return &m_handle;
+        m_backend->disconnect();
+        updateTargetKey();
+        return false;
     }
 
-    void free()
+    m_backend = std::move(backend);
+    bool connected = m_backend->connect(connectionString);
+    updateTargetKey();
     {
-        if (m_handle != SQL_NULL_HANDLE)
-        {
-            if constexpr (std::is_same_v<HandleType, SQLHENV>)
-            {
-                SQLFreeHandle(SQL_HANDLE_ENV, m_handle);
-            }
-            else if constexpr (std::is_same_v<HandleType, SQLHDBC>)
-            {
-                SQLFreeHandle(SQL_HANDLE_DBC, m_handle);
-            }
-            else if constexpr (std::is_same_v<HandleType, SQLHSTMT>)
-            {
-                SQLFreeHandle(SQL_HANDLE_STMT, m_handle);
-            }
-            m_handle = SQL_NULL_HANDLE;
-        }
+        std::lock_guard<std::mutex> targetLock(m_targetMutex);
+        m_connectionString = connectionString;
     }
+    return connected;
+}
+
+void DatabaseConnection::disconnect()
+{
+    std::lock_guard<std::timed_mutex> lock(m_mutex);
+    m_backend->disconnect();
+    updateTargetKey();
+}
+
+bool DatabaseConnection::isConnected() const
+{
+    std::lock_guard<std::timed_mutex> lock(m_mutex);
+    return m_backend->isConnected();
+}
 
-    operator bool() const
+std::vector<std::string> DatabaseConnection::getDatabases(std::string &etag)
+{
+    std::unique_ptr<DataBackend> backend;
     {
-        return m_handle != SQL_NULL_HANDLE;
+        std::lock_guard<std::timed_mutex> lock(m_mutex);
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->getDatabases(etag);
     }
+    return backend->getDatabases(etag);
+}
 
-  private:
-    HandleType m_handle;
-};
+bool DatabaseConnection::useDatabase(const std::string &databaseName)
+{
+    std::lock_guard<std::timed_mutex> lock(m_mutex);
+    bool changed = m_backend->useDatabase(databaseName);
+    updateTargetKey();
+    return changed;
+}
 
-/**
- * @brief DatabaseConnection implementation
- */
-class DatabaseConnection::Impl
+std::vector<TableInfo> DatabaseConnection::getTables(std::string &etag)
 {
-  public:
-    Impl() : m_connected(false)
+    std::unique_ptr<DataBackend> backend;
     {
+        std::lock_guard<std::timed_mutex> lock(m_mutex);
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->getTables(etag);
     }
+    return backend->getTables(etag);
+}
 
-    ~Impl()
+std::vector<ColumnInfo> DatabaseConnection::getColumns(const std::string &schema, const std::string &tableName,
+                                                       std::string &etag)
+{
+    std::unique_ptr<DataBackend> backend;
     {
-        disconnect();
+        std::lock_guard<std::timed_mutex> lock(m_mutex);
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->getColumns(schema, tableName, etag);
     }
+    return backend->getColumns(schema, tableName, etag);
+}
 
-    bool connect(const std::string &connectionString)
+QueryResult DatabaseConnection::selectData(const std::string &schema, const std::string &tableName,
+                                           const RowFilter &filter, const RowOrder &order,
+                                           const RowProjection &projection, int page, int pageSize,
+                                           CountMode countMode, CancellationToken &cancel)
+{
+    std::unique_ptr<DataBackend> backend;
     {
-        disconnect();
-
-        SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, m_env.ptr());
-        if (!SQL_SUCCEEDED(ret))
+        std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+        if (!lockUnlessCancelled(lock, cancel))
         {
-            m_lastError = "Failed to allocate environment handle";
-            return false;
-        }
-
-        ret = SQLSetEnvAttr(m_env.get(), SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
-        if (!SQL_SUCCEEDED(ret))
-        {
-            m_lastError = "Failed to set ODBC version";
-            return false;
-        }
-
-        ret = SQLAllocHandle(SQL_HANDLE_DBC, m_env.get(), m_dbc.ptr());
-        if (!SQL_SUCCEEDED(ret))
-        {
-            m_lastError = "Failed to allocate connection handle";
-            return false;
+            QueryResult result;
+            result.success = false;
+            result.error = cancel.reason();
+            return result;
         }
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->selectData(schema, tableName, filter, order, projection, page, pageSize, countMode,
+                                         cancel);
+    }
 
-        SQLSetConnectAttr(m_dbc.get(), SQL_LOGIN_TIMEOUT, (SQLPOINTER)10, 0);
-
-        std::string odbcConnStr = convertConnectionString(connectionString);
-
-        SQLCHAR outConnStr[1024];
-        SQLSMALLINT outConnStrLen;
-
-        ret = SQLDriverConnect(m_dbc.get(), NULL, (SQLCHAR *)odbcConnStr.c_str(), SQL_NTS, outConnStr,
-                               sizeof(outConnStr), &outConnStrLen, SQL_DRIVER_NOPROMPT);
+    // The query may run for seconds; the session is free meanwhile
+    return backend->selectData(schema, tableName, filter, order, projection, page, pageSize, countMode, cancel);
+}
 
-        if (!SQL_SUCCEEDED(ret))
-        {
-            m_lastError = getOdbcError(SQL_HANDLE_DBC, m_dbc.get());
+bool DatabaseConnection::countRows(const std::string &schema, const std::string &tableName, const RowFilter &filter,
+                                   bool exact, RowCount &count, CancellationToken &cancel)
+{
+    DataBackend::RowCounter counter;
+    {
+        std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+        if (!lockUnlessCancelled(lock, cancel))
             return false;
-        }
-
-        m_connectionString = connectionString;
-        m_connected = true;
-        return true;
+        counter = m_backend->prepareCount(schema, tableName, filter, exact);
     }
 
-    void disconnect()
+    // The count may scan the table for seconds; the session is free meanwhile
+    return counter && counter(count, cancel);
+}
+
+QueryResult DatabaseConnection::selectByKeys(const std::string &schema, const std::string &tableName,
+                                             const std::vector<std::string> &keyColumns,
+                                             const std::vector<std::vector<std::string>> &keys,
+                                             const RowProjection &projection, CancellationToken &cancel)
+{
+    std::unique_ptr<DataBackend> backend;
     {
-        if (m_connected)
+        std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+        if (!lockUnlessCancelled(lock, cancel))
         {
-            SQLDisconnect(m_dbc.get());
-            m_connected = false;
+            QueryResult result;
+            result.success = false;
+            result.error = cancel.reason();
+            return result;
         }
-        m_dbc.free();
-        m_env.free();
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->selectByKeys(schema, tableName, keyColumns, keys, projection, cancel);
     }
+    return backend->selectByKeys(schema, tableName, keyColumns, keys, projection, cancel);
+}
 
-    bool isConnected() const
+std::unique_ptr<RowCursor> DatabaseConnection::openCursor(const std::string &schema, const std::string &tableName,
+                                                          const RowFilter &filter, const KeyRange &range,
+                                                          const std::vector<SortKey> &sort,
+                                                          const std::vector<std::string> &columns,
+                                                          CancellationToken &cancel, std::string &error)
+{
+    std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+    if (!lockUnlessCancelled(lock, cancel))
     {
-        return m_connected;
+        error = cancel.reason();
+        return nullptr;
     }
+    return m_backend->openCursor(schema, tableName, filter, range, sort, columns, cancel, error);
+}
 
-    std::vector<std::string> getDatabases()
+bool DatabaseConnection::splitKeyRange(const std::string &schema, const std::string &tableName, size_t parts,
+                                       std::string &keyColumn, std::vector<std::string> &bounds,
+                                       CancellationToken &cancel, std::string &error)
+{
+    std::unique_ptr<DataBackend> backend;
     {
-        std::vector<std::string> databases;
-
-        if (!m_connected)
-            return databases;
-
-        OdbcHandle<SQLHSTMT> stmt;
-        SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (!SQL_SUCCEEDED(ret))
-            return databases;
-
-        const char *sql = "SELECT name FROM sys.databases WHERE state_desc = 'ONLINE' ORDER BY name";
-        ret = SQLExecDirect(stmt.get(), (SQLCHAR *)sql, SQL_NTS);
-        if (!SQL_SUCCEEDED(ret))
-            return databases;
-
-        SQLCHAR dbName[256];
-        SQLLEN dbNameLen;
-
-        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+        std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+        if (!lockUnlessCancelled(lock, cancel))
         {
-            SQLGetData(stmt.get(), 1, SQL_C_CHAR, dbName, sizeof(dbName), &dbNameLen);
-            databases.push_back(std::string((char *)dbName));
-        }
-
-        return databases;
-    }
-
-    bool useDatabase(const std::string &databaseName)
-    {
-        if (!m_connected)
-            return false;
-
-        if (!isValidIdentifier(databaseName))
-            return false;
-
-        OdbcHandle<SQLHSTMT> stmt;
-        SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (!SQL_SUCCEEDED(ret))
+            error = cancel.reason();
             return false;
-
-        std::string sql = "USE [" + databaseName + "]";
-        ret = SQLExecDirect(stmt.get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
-
-        if (SQL_SUCCEEDED(ret))
-        {
-            auto pos = m_connectionString.find("Initial Catalog=");
-            if (pos != std::string::npos)
-            {
-                auto end = m_connectionString.find(';', pos);
-                m_connectionString = m_connectionString.substr(0, pos) + "Initial Catalog=" + databaseName +
-                                     m_connectionString.substr(end);
-            }
-            return true;
         }
-
-        return false;
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->splitKeyRange(schema, tableName, parts, keyColumn, bounds, cancel, error);
     }
+    return backend->splitKeyRange(schema, tableName, parts, keyColumn, bounds, cancel, error);
+}
 
-    std::vector<TableInfo> getTables()
+std::unique_ptr<RowWriter> DatabaseConnection::openWriter(const std::string &schema, const std::string &tableName,
+                                                          const std::vector<std::string> &columns,
+                                                          CancellationToken &cancel, std::string &error)
+{
+    std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+    if (!lockUnlessCancelled(lock, cancel))
     {
-        std::vector<TableInfo> tables;
-
-        if (!m_connected)
-            return tables;
-
-        OdbcHandle<SQLHSTMT> stmt;
-        SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (!SQL_SUCCEEDED(ret))
-            return tables;
-
-        ret = SQLTables(stmt.get(), NULL, 0, NULL, 0, NULL, 0, (SQLCHAR *)"TABLE", SQL_NTS);
-        if (!SQL_SUCCEEDED(ret))
-            return tables;
-
-        SQLCHAR schemaName[256], tableName[256];
-        SQLLEN schemaLen, tableLen;
-
-        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
-        {
-            SQLGetData(stmt.get(), 2, SQL_C_CHAR, schemaName, sizeof(schemaName), &schemaLen);
-            SQLGetData(stmt.get(), 3, SQL_C_CHAR, tableName, sizeof(tableName), &tableLen);
-
-            TableInfo info;
-            info.schema = (schemaLen > 0) ? std::string((char *)schemaName) : "dbo";
-            info.name = std::string((char *)tableName);
-
-            if (info.schema != "sys" && info.schema != "INFORMATION_SCHEMA")
-            {
-                tables.push_back(info);
-            }
-        }
-
-        return tables;
+        error = cancel.reason();
+        return nullptr;
     }
+    return m_backend->openWriter(schema, tableName, columns, cancel, error);
+}
 
-    std::vector<ColumnInfo> getColumns(const std::string &schema, const std::string &tableName)
+std::unique_ptr<ChangeSource> DatabaseConnection::openChangeSource(const std::string &schema,
+                                                                   const std::string &tableName,
+                                                                   CancellationToken &cancel, std::string &error)
+{
+    std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+    if (!lockUnlessCancelled(lock, cancel))
     {
-        std::vector<ColumnInfo> columns;
-
-        if (!m_connected)
-            return columns;
-
-        OdbcHandle<SQLHSTMT> stmt;
-        SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (!SQL_SUCCEEDED(ret))
-            return columns;
-
-        ret = SQLColumns(stmt.get(), NULL, 0, (SQLCHAR *)schema.c_str(), SQL_NTS, (SQLCHAR *)tableName.c_str(), SQL_NTS,
-                         NULL, 0);
-
-        if (!SQL_SUCCEEDED(ret))
-            return columns;
-
-        SQLCHAR colName[256], typeName[256];
-        SQLSMALLINT nullable;
-        SQLLEN colNameLen, typeNameLen, nullableLen;
-
-        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
-        {
-            SQLGetData(stmt.get(), 4, SQL_C_CHAR, colName, sizeof(colName), &colNameLen);
-            SQLGetData(stmt.get(), 6, SQL_C_CHAR, typeName, sizeof(typeName), &typeNameLen);
-            SQLGetData(stmt.get(), 11, SQL_C_SSHORT, &nullable, 0, &nullableLen);
-
-            ColumnInfo col;
-            col.name = std::string((char *)colName);
-            col.type = std::string((char *)typeName);
-            col.nullable = (nullable == SQL_NULLABLE);
-            col.isPrimaryKey = false;
-
-            columns.push_back(col);
-        }
-
-        // Get primary keys
-        stmt.free();
-        ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (SQL_SUCCEEDED(ret))
-        {
-            ret = SQLPrimaryKeys(stmt.get(), NULL, 0, (SQLCHAR *)schema.c_str(), SQL_NTS, (SQLCHAR *)tableName.c_str(),
-                                 SQL_NTS);
-
-            if (SQL_SUCCEEDED(ret))
-            {
-                SQLCHAR pkColName[256];
-                SQLLEN pkColNameLen;
-
-                while (SQLFetch(stmt.get()) == SQL_SUCCESS)
-                {
-                    SQLGetData(stmt.get(), 4, SQL_C_CHAR, pkColName, sizeof(pkColName), &pkColNameLen);
-                    std::string pkName((char *)pkColName);
-
-                    for (auto &col : columns)
-                    {
-                        if (col.name == pkName)
-                        {
-                            col.isPrimaryKey = true;
-                            break;
-                        }
-                    }
-                }
-            }
-        }
-
-        return columns;
+        error = cancel.reason();
+        return nullptr;
     }
+    return m_backend->openChangeSource(schema, tableName, cancel, error);
+}
 
-    QueryResult selectData(const std::string &schema, const std::string &tableName, const std::string &filterColumn,
-                           const std::string &filterValue, int page, int pageSize)
+bool DatabaseConnection::applyChanges(const std::string &schema, const std::string &tableName,
+                                      const std::vector<RowChange> &changes, CancellationToken &cancel,
+                                      EditResult &result, std::string &error)
+{
+    std::unique_ptr<DataBackend> backend;
     {
-        QueryResult result;
-        result.success = false;
-        result.totalRows = 0;
-
-        if (!m_connected)
+        std::unique_lock<std::timed_mutex> lock(m_mutex, std::defer_lock);
+        if (!lockUnlessCancelled(lock, cancel))
         {
-            result.error = "Not connected to database";
-            return result;
-        }
-
-        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
-        {
-            result.error = "Invalid table or schema name";
-            return result;
+            error = cancel.reason();
+            return false;
         }
+        backend = m_backend->snapshot();
+        if (!backend)
+            return m_backend->applyChanges(schema, tableName, changes, cancel, result, error);
+    }
 
-        if (!filterColumn.empty() && !isValidIdentifier(filterColumn))
-        {
-            result.error = "Invalid column name";
-            return result;
-        }
+    // Other requests of the session, even other edits, go on while the transaction runs
+    return backend->applyChanges(schema, tableName, changes, cancel, result, error);
+}
 
-        std::string fullTableName = schema.empty() ? "[" + tableName + "]" : "[" + schema + "].[" + tableName + "]";
+std::string DatabaseConnection::getConnectionInfo() const
+{
+    std::lock_guard<std::timed_mutex> lock(m_mutex);
+    return m_backend->getConnectionInfo();
+}
 
-        // First, get total count
-        std::string countSql = "SELECT COUNT(*) FROM " + fullTableName;
-        if (!filterColumn.empty() && !filterValue.empty())
-        {
-            countSql += " WHERE [" + filterColumn + "] LIKE ?";
-        }
+std::string DatabaseConnection::getTargetKey() const
+{
+    std::lock_guard<std::mutex> lock(m_targetMutex);
+    return m_targetKey;
+}
 
-        OdbcHandle<SQLHSTMT> stmt;
-        SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (!SQL_SUCCEEDED(ret))
-        {
-            result.error = "Failed to allocate statement handle";
-            return result;
-        }
+bool DatabaseConnection::checkServer(int &retryAfterSeconds) const
+{
+    std::string connectionString;
+    {
+        std::lock_guard<std::mutex> lock(m_targetMutex);
+        connectionString = m_connectionString;
+    }
+    return connectionString.empty() || ConnectionPool::getInstance().checkCircuit(connectionString, retryAfterSeconds);
+}
 
-        ret = SQLPrepare(stmt.get(), (SQLCHAR *)countSql.c_str(), SQL_NTS);
-        if (!SQL_SUCCEEDED(ret))
-        {
-            result.error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
-            return result;
-        }
+void DatabaseConnection::updateTargetKey()
+{
+    std::string targetKey = m_backend->getTargetKey();
+    std::lock_guard<std::mutex> lock(m_targetMutex);
+    m_targetKey = std::move(targetKey);
+}
 
-        std::string likeValue = "%" + filterValue + "%";
-        if (!filterColumn.empty() && !filterValue.empty())
-        {
-            SQLBindParameter(stmt.get(), 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, likeValue.size(), 0,
-                             (SQLCHAR *)likeValue.c_str(), likeValue.size(), NULL);
-        }
+// ConnectionManager implementation
 
-        ret = SQLExecute(stmt.get());
-        if (SQL_SUCCEEDED(ret) && SQLFetch(stmt.get()) == SQL_SUCCESS)
-        {
-            SQLINTEGER count;
-            SQLGetData(stmt.get(), 1, SQL_C_SLONG, &count, 0, NULL);
-            result.totalRows = count;
-        }
+// How often the reaper looks for idle sessions
+static constexpr auto kReapInterval = std::chrono::seconds(60);
 
-        // Now get the actual data with pagination
-        int offset = (page - 1) * pageSize;
+static std::atomic<size_t> s_configuredMaxSessions{ConnectionManager::kDefaultMaxSessions};
+static std::atomic<int> s_configuredMaxIdleSeconds{ConnectionManager::kDefaultMaxIdleSeconds};
 
-        std::string dataSql = "SELECT * FROM " + fullTableName;
-        if (!filterColumn.empty() && !filterValue.empty())
-        {
-            dataSql += " WHERE [" + filterColumn + "] LIKE ?";
-        }
-        dataSql += " ORDER BY (SELECT NULL) OFFSET " + std::to_string(offset) + " ROWS FETCH NEXT " +
-                   std::to_string(pageSize) + " ROWS ONLY";
+ConnectionManager &ConnectionManager::getInstance()
+{
+    static ConnectionManager instance(s_configuredMaxSessions.load(), s_configuredMaxIdleSeconds.load());
+    return instance;
+}
 
-        stmt.free();
-        ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
-        if (!SQL_SUCCEEDED(ret))
-        {
-            result.error = "Failed to allocate statement handle";
-            return result;
-        }
+void ConnectionManager::configure(size_t maxSessions, int maxIdleSeconds)
+{
+    if (maxSessions > 0)
+        s_configuredMaxSessions = maxSessions;
+    if (maxIdleSeconds > 0)
+        s_configuredMaxIdleSeconds = maxIdleSeconds;
+}
 
-        ret = SQLPrepare(stmt.get(), (SQLCHAR *)dataSql.c_str(), SQL_NTS);
-        if (!SQL_SUCCEEDED(ret))
-        {
-            result.error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
-            return result;
-        }
+ConnectionManager::ConnectionManager(size_t maxSessions, int maxIdleSeconds)
+    : m_maxSessions(maxSessions), m_maxIdleSeconds(maxIdleSeconds)
+{
+    m_reaper = std::thread(&ConnectionManager::reaperLoop, this);
+}
 
-        if (!filterColumn.empty() && !filterValue.empty())
-        {
-            SQLBindParameter(stmt.get(), 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, likeValue.size(), 0,
-                             (SQLCHAR *)likeValue.c_str(), likeValue.size(), NULL);
-        }
+ConnectionManager::~ConnectionManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_reaperMutex);
+        m_stopping = true;
+    }
+    m_reaperWakeup.notify_all();
 
-        ret = SQLExecute(stmt.get());
-        if (!SQL_SUCCEEDED(ret))
-        {
-            result.error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
-            return result;
-        }
+    if (m_reaper.joinable())
+        m_reaper.join();
+}
 
-        // Get column names
-        SQLSMALLINT numCols;
-        SQLNumResultCols(stmt.get(), &numCols);
+ConnectionManager::Shard &ConnectionManager::shardFor(const std::string &sessionId)
+{
+    return m_shards[std::hash<std::string>{}(sessionId) % kShardCount];
+}
 
-        for (SQLSMALLINT i = 1; i <= numCols; i++)
-        {
-            SQLCHAR colName[256];
-            SQLSMALLINT nameLen;
-            SQLDescribeCol(stmt.get(), i, colName, sizeof(colName), &nameLen, NULL, NULL, NULL, NULL);
-            result.columns.push_back(std::string((char *)colName));
-        }
+bool ConnectionManager::evictOldest(std::vector<SessionLease> &evicted)
+{
+    // Each shard's oldest session is at the back of its list; the oldest of those goes
+    Shard *oldestShard = nullptr;
+    auto oldestAccess = std::chrono::steady_clock::time_point::max();
+    for (auto &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.lru.empty())
+            continue;
 
-        // Fetch data
-        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+        auto lastAccess = shard.sessions.find(shard.lru.back())->second.lastAccess;
+        if (lastAccess < oldestAccess)
         {
-            DataRow row;
-            for (SQLSMALLINT i = 1; i <= numCols; i++)
-            {
-                SQLCHAR value[4096];
-                SQLLEN valueLen;
-
-                ret = SQLGetData(stmt.get(), i, SQL_C_CHAR, value, sizeof(value), &valueLen);
-
-                std::string val;
-                if (valueLen == SQL_NULL_DATA)
-                {
-                    val = "NULL";
-                }
-                else if (SQL_SUCCEEDED(ret))
-                {
-                    val = latin1ToUtf8(std::string((char *)value));
-                }
-
-                row.push_back({result.columns[i - 1], val});
-            }
-            result.rows.push_back(row);
+            oldestAccess = lastAccess;
+            oldestShard = &shard;
         }
-
-        result.success = true;
-        return result;
     }
+    if (!oldestShard)
+        return false;
 
-    std::string getConnectionInfo() const
-    {
-        if (!m_connected)
-            return "Not connected";
+    // The shard may have changed since the scan; its current oldest session is close enough
+    std::lock_guard<std::mutex> lock(oldestShard->mutex);
+    if (oldestShard->lru.empty())
+        return true;
 
-        std::string info = "Connected";
+    auto oldest = oldestShard->sessions.find(oldestShard->lru.back());
+    evicted.push_back(std::move(oldest->second.connection));
+    oldestShard->sessions.erase(oldest);
+    oldestShard->lru.pop_back();
+    m_live--;
+    m_evicted++;
+    return true;
+}
 
-        auto pos = m_connectionString.find("Initial Catalog=");
-        if (pos != std::string::npos)
+void ConnectionManager::reserveSlot(std::vector<SessionLease> &evicted)
+{
+    size_t live = m_live.load();
+    while (true)
+    {
+        if (live < m_maxSessions)
         {
-            auto end = m_connectionString.find(';', pos);
-            info += " to " + m_connectionString.substr(pos + 16, end - pos - 16);
+            if (m_live.compare_exchange_weak(live, live + 1))
+                return;
+            continue;
         }
 
-        return info;
+        // Full: free a slot, or wait for the sessions being created by other requests to land in a shard
+        if (!evictOldest(evicted))
+            std::this_thread::yield();
+        live = m_live.load();
     }
+}
 
-  private:
-    std::string convertConnectionString(const std::string &adoConnStr)
-    {
-        std::ostringstream odbc;
-        odbc << "DRIVER={ODBC Driver 17 for SQL Server};";
+SessionLease ConnectionManager::getConnection(const std::string &sessionId)
+{
+    auto &shard = shardFor(sessionId);
 
-        std::istringstream ss(adoConnStr);
-        std::string pair;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
 
-        while (std::getline(ss, pair, ';'))
+        auto it = shard.sessions.find(sessionId);
+        if (it != shard.sessions.end())
         {
-            if (pair.empty())
-                continue;
-
-            auto eqPos = pair.find('=');
-            if (eqPos == std::string::npos)
-                continue;
-
-            std::string key = pair.substr(0, eqPos);
-            std::string value = pair.substr(eqPos + 1);
-
-            key.erase(0, key.find_first_not_of(" \t"));
-            key.erase(key.find_last_not_of(" \t") + 1);
-
-            if (key == "Data Source" || key == "Server")
-            {
-                odbc << "SERVER=" << value << ";";
-            }
-            else if (key == "Initial Catalog" || key == "Database")
-            {
-                odbc << "DATABASE=" << value << ";";
-            }
-            else if (key == "Integrated Security" && (value == "True" || value == "SSPI"))
-            {
-                odbc << "Trusted_Connection=yes;";
-            }
-            else if (key == "User ID" || key == "User Id")
-            {
-                odbc << "UID=" << value << ";";
-            }
-            else if (key == "Password")
-            {
-                odbc << "PWD=" << value << ";";
-            }
-            else if (key == "Encrypt" && value == "False")
-            {
-                odbc << "Encrypt=no;";
-            }
-            else if (key == "TrustServerCertificate" && value == "True")
-            {
-                odbc << "TrustServerCertificate=yes;";
-            }
+            it->second.lastAccess = std::chrono::steady_clock::now();
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPosition);
+            return it->second.connection;
         }
-
-        return odbc.str();
     }
 
-    std::string getOdbcError(SQLSMALLINT handleType, SQLHANDLE handle)
-    {
-        SQLCHAR sqlState[6], message[SQL_MAX_MESSAGE_LENGTH];
-        SQLINTEGER nativeError;
-        SQLSMALLINT messageLen;
-
-        SQLRETURN ret =
-            SQLGetDiagRec(handleType, handle, 1, sqlState, &nativeError, message, sizeof(message), &messageLen);
+    // Evicted connections are released after the shard locks, since closing them talks to the server. The slot is
+    // reserved without holding this shard's lock, because evicting locks the other shards
+    std::vector<SessionLease> evicted;
+    reserveSlot(evicted);
 
-        if (SQL_SUCCEEDED(ret))
-        {
-            return std::string((char *)sqlState) + ": " + std::string((char *)message);
-        }
-        return "Unknown ODBC error";
-    }
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto now = std::chrono::steady_clock::now();
 
-    bool isValidIdentifier(const std::string &name)
+    // Another request for the same session may have created it meanwhile
+    auto it = shard.sessions.find(sessionId);
+    if (it != shard.sessions.end())
     {
-        if (name.empty())
-            return false;
-        for (char c : name)
-        {
-            if (!std::isalnum(c) && c != '_')
-                return false;
-        }
-        return true;
+        m_live--;
+        it->second.lastAccess = now;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPosition);
+        return it->second.connection;
     }
 
-    OdbcHandle<SQLHENV> m_env;
-    OdbcHandle<SQLHDBC> m_dbc;
-    std::string m_connectionString;
-    std::string m_lastError;
-    bool m_connected;
-};
-
-// DatabaseConnection public methods
-DatabaseConnection::DatabaseConnection() : m_impl(std::make_unique<Impl>())
-{
+    shard.lru.push_front(sessionId);
+    Session session;
+    session.connection = std::make_shared<DatabaseConnection>();
+    session.lastAccess = now;
+    session.lruPosition = shard.lru.begin();
+    SessionLease lease = session.connection;
+    shard.sessions.emplace(sessionId, std::move(session));
+    m_created++;
+    return lease;
 }
 
-DatabaseConnection::~DatabaseConnection() = default;
-
-bool DatabaseConnection::connect(const std::string &connectionString)
+SessionLease ConnectionManager::findConnection(const std::string &sessionId)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->connect(connectionString);
-}
+    auto &shard = shardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
 
-void DatabaseConnection::disconnect()
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_impl->disconnect();
-}
-
-bool DatabaseConnection::isConnected() const
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->isConnected();
-}
+    auto it = shard.sessions.find(sessionId);
+    if (it == shard.sessions.end())
+        return nullptr;
 
-std::vector<std::string> DatabaseConnection::getDatabases()
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->getDatabases();
-}
-
-bool DatabaseConnection::useDatabase(const std::string &databaseName)
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->useDatabase(databaseName);
+    it->second.lastAccess = std::chrono::steady_clock::now();
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPosition);
+    return it->second.connection;
 }
 
-std::vector<TableInfo> DatabaseConnection::getTables()
+void ConnectionManager::removeConnection(const std::string &sessionId)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->getTables();
+    SessionLease removed;
+    {
+        auto &shard = shardFor(sessionId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(sessionId);
+        if (it == shard.sessions.end())
+            return;
+
+        removed = std::move(it->second.connection);
+        shard.lru.erase(it->second.lruPosition);
+        shard.sessions.erase(it);
+        m_live--;
+        m_removed++;
+    }
 }
 
-std::vector<ColumnInfo> DatabaseConnection::getColumns(const std::string &schema, const std::string &tableName)
+size_t ConnectionManager::cleanupExpiredSessions(int maxIdleSeconds)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->getColumns(schema, tableName);
-}
+    auto cutoff = std::chrono::steady_clock::now() - std::chrono::seconds(maxIdleSeconds);
+    size_t count = 0;
 
-QueryResult DatabaseConnection::selectData(const std::string &schema, const std::string &tableName,
-                                           const std::string &filterColumn, const std::string &filterValue, int page,
-                                           int pageSize)
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->selectData(schema, tableName, filterColumn, filterValue, page, pageSize);
-}
+    for (auto &shard : m_shards)
+    {
+        std::vector<SessionLease> expired;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
 
-std::string DatabaseConnection::getConnectionInfo() const
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_impl->getConnectionInfo();
-}
+            // Least recently used sessions are at the back
+            while (!shard.lru.empty())
+            {
+                auto it = shard.sessions.find(shard.lru.back());
+                if (it->second.lastAccess > cutoff)
+                    break;
+
+                expired.push_back(std::move(it->second.connection));
+                shard.sessions.erase(it);
+                shard.lru.pop_back();
+                m_live--;
+            }
+        }
+        count += expired.size();
+    }
 
-// ConnectionManager implementation
-ConnectionManager &ConnectionManager::getInstance()
-{
-    static ConnectionManager instance;
-    return instance;
+    m_reaped += count;
+    return count;
 }
 
-DatabaseConnection &ConnectionManager::getConnection(const std::string &sessionId)
+ConnectionManager::Stats ConnectionManager::getStats() const
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    auto it = m_sessions.find(sessionId);
-    if (it == m_sessions.end())
+    Stats stats;
+    for (const auto &shard : m_shards)
     {
-        SessionInfo info;
-        info.connection = std::make_unique<DatabaseConnection>();
-        info.lastAccess = std::chrono::steady_clock::now();
-        auto [newIt, _] = m_sessions.emplace(sessionId, std::move(info));
-        return *newIt->second.connection;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.live += shard.sessions.size();
     }
-
-    it->second.lastAccess = std::chrono::steady_clock::now();
-    return *it->second.connection;
+    stats.maxSessions = m_maxSessions;
+    stats.created = m_created;
+    stats.removed = m_removed;
+    stats.evicted = m_evicted;
+    stats.reaped = m_reaped;
+    return stats;
 }
 
-bool ConnectionManager::hasConnection(const std::string &sessionId) const
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_sessions.find(sessionId);
-    return it != m_sessions.end() && it->second.connection->isConnected();
-}
-
-void ConnectionManager::removeConnection(const std::string &sessionId)
+void ConnectionManager::reaperLoop()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_sessions.erase(sessionId);
-}
-
-void ConnectionManager::cleanupExpiredSessions(int maxIdleSeconds)
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto now = std::chrono::steady_clock::now();
-
-    for (auto it = m_sessions.begin(); it != m_sessions.end();)
+    std::unique_lock<std::mutex> lock(m_reaperMutex);
+    while (!m_reaperWakeup.wait_for(lock, kReapInterval, [this]() { return m_stopping; }))
     {
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - it->second.lastAccess).count();
-        if (elapsed > maxIdleSeconds)
-        {
-            it = m_sessions.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
+        lock.unlock();
+        cleanupExpiredSessions(m_maxIdleSeconds);
+        lock.lock();
     }
 }
 
@@ -5,12 +5,19 @@
 
 #pragma once
 
+#include "data_backend.h"
 #include "database.h"
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <map>
+#include <condition_variable>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace Tootega
 {
@@ -19,6 +26,11 @@ namespace Data
 
 /**
  * @brief Individual database connection for a session
+ *
+ * Serializes access to the session's DataBackend, chosen by the connection string.
+ * Queries only hold the session while they take a snapshot of the backend
+ * (see DataBackend::snapshot) and run on it afterwards, so a session's
+ * requests, such as the parts of a batch, do not wait for each other.
  */
 class DatabaseConnection
 {
@@ -30,53 +42,169 @@ class DatabaseConnection
     void disconnect();
     bool isConnected() const;
 
-    std::vector<std::string> getDatabases();
+    /**
+     * @brief Metadata lookups, served from the shared MetadataCache when possible
+     * @param etag Set to the entity tag of the cached result (empty when it could not be cached)
+     */
+    std::vector<std::string> getDatabases(std::string &etag);
     bool useDatabase(const std::string &databaseName);
-    std::vector<TableInfo> getTables();
-    std::vector<ColumnInfo> getColumns(const std::string &schema, const std::string &tableName);
-    QueryResult selectData(const std::string &schema, const std::string &tableName,
-                           const std::string &filterColumn = "", const std::string &filterValue = "", int page = 1,
-                           int pageSize = 50);
+    std::vector<TableInfo> getTables(std::string &etag);
+    std::vector<ColumnInfo> getColumns(const std::string &schema, const std::string &tableName, std::string &etag);
+
+    /**
+     * @brief Read a page of a table
+     * @param order Sort keys; with a keyset cursor the page starts after it and @p page only labels it
+     * @param projection Columns to read and the preview length of text and binary values
+     * @param cancel Request deadline; also bounds the wait for the session while it is connecting
+     */
+    QueryResult selectData(const std::string &schema, const std::string &tableName, const RowFilter &filter,
+                           const RowOrder &order, const RowProjection &projection, int page, int pageSize,
+                           CountMode countMode, CancellationToken &cancel);
+
+    /**
+     * @brief Get the row count of a table, using the shared count cache
+     * @param exact Require COUNT_BIG(*) instead of a catalog estimate
+     * @return true if a count is available
+     *
+     * The session is only held while the count is prepared, not while it runs.
+     */
+    bool countRows(const std::string &schema, const std::string &tableName, const RowFilter &filter, bool exact,
+                   RowCount &count, CancellationToken &cancel);
+
+    /**
+     * @brief Read the rows a set of keys reference (see DataBackend::selectByKeys)
+     */
+    QueryResult selectByKeys(const std::string &schema, const std::string &tableName,
+                             const std::vector<std::string> &keyColumns,
+                             const std::vector<std::vector<std::string>> &keys, const RowProjection &projection,
+                             CancellationToken &cancel);
+
+    /**
+     * @brief Start reading a table's rows on a connection of the cursor's own (see DataBackend::openCursor)
+     *
+     * The session is only held while the query is prepared, not while the rows are read.
+     */
+    std::unique_ptr<RowCursor> openCursor(const std::string &schema, const std::string &tableName,
+                                          const RowFilter &filter, const KeyRange &range,
+                                          const std::vector<SortKey> &sort, const std::vector<std::string> &columns,
+                                          CancellationToken &cancel, std::string &error);
+
+    /**
+     * @brief Split a table into primary key ranges of about the same size (see DataBackend::splitKeyRange)
+     */
+    bool splitKeyRange(const std::string &schema, const std::string &tableName, size_t parts, std::string &keyColumn,
+                       std::vector<std::string> &bounds, CancellationToken &cancel, std::string &error);
+
+    /**
+     * @brief Start inserting rows into a table on a connection of the writer's own (see DataBackend::openWriter)
+     *
+     * The session is only held while the insert is prepared, not while the rows are written.
+     */
+    std::unique_ptr<RowWriter> openWriter(const std::string &schema, const std::string &tableName,
+                                          const std::vector<std::string> &columns, CancellationToken &cancel,
+                                          std::string &error);
+
+    /**
+     * @brief Start following a table's changes on a connection of the source's own
+     *        (see DataBackend::openChangeSource)
+     */
+    std::unique_ptr<ChangeSource> openChangeSource(const std::string &schema, const std::string &tableName,
+                                                   CancellationToken &cancel, std::string &error);
+
+    /**
+     * @brief Apply a batch of row changes as one transaction (see DataBackend::applyChanges)
+     */
+    bool applyChanges(const std::string &schema, const std::string &tableName, const std::vector<RowChange> &changes,
+                      CancellationToken &cancel, EditResult &result, std::string &error);
+
     std::string getConnectionInfo() const;
 
+    /**
+     * @brief Target of the connection (see DataBackend::getTargetKey)
+     *
+     * Answered without waiting for a query of this session that is running.
+     */
+    std::string getTargetKey() const;
+
+    /**
+     * @brief Whether calls to the session's database server go through (see ConnectionPool::checkCircuit)
+     *
+     * Answered without waiting for a query of this session that is running.
+     */
+    bool checkServer(int &retryAfterSeconds) const;
+
   private:
-    class Impl;
-    std::unique_ptr<Impl> m_impl;
-    mutable std::mutex m_mutex;
+    // Expects m_mutex to be held
+    void updateTargetKey();
+
+    std::unique_ptr<DataBackend> m_backend;
+    mutable std::timed_mutex m_mutex;
+
+    std::string m_targetKey;
+    std::string m_connectionString; ///< Of the last connect()
+    mutable std::mutex m_targetMutex;
 };
 
 /**
- * @brief Session info with connection and last access time
+ * @brief Shared use of a session's connection
+ *
+ * The connection stays alive while any lease exists, even if the session is
+ * removed, evicted or reaped in the meantime.
  */
-struct SessionInfo
-{
-    std::unique_ptr<DatabaseConnection> connection;
-    std::chrono::steady_clock::time_point lastAccess;
-};
+using SessionLease = std::shared_ptr<DatabaseConnection>;
 
 /**
  * @class ConnectionManager
  * @brief Manages database connections per session (stateless per user)
+ *
+ * Sessions are spread over independently locked shards, each keeping its
+ * sessions in LRU order. A registry-wide count enforces the cap: when it is
+ * full the least recently used session across all shards is evicted, and a
+ * background reaper drops sessions idle for too long.
  */
 class ConnectionManager
 {
   public:
+    /// Live session cap when not configured
+    static constexpr size_t kDefaultMaxSessions = 1024;
+
+    /// Idle time after which the reaper drops a session, when not configured
+    static constexpr int kDefaultMaxIdleSeconds = 3600;
+
+    /**
+     * @brief Session counters since startup
+     */
+    struct Stats
+    {
+        size_t live = 0;
+        size_t maxSessions = 0;
+        size_t created = 0;
+        size_t removed = 0; ///< Disconnected by the client
+        size_t evicted = 0; ///< Dropped to stay under the cap
+        size_t reaped = 0;  ///< Dropped after being idle
+    };
+
     /**
-     * @brief Get the singleton instance
+     * @brief Get the singleton instance (starts the reaper on first use)
      */
     static ConnectionManager &getInstance();
 
     /**
-     * @brief Get or create connection for a session
+     * @brief Set the session cap and idle timeout; only effective before the first getInstance()
+     */
+    static void configure(size_t maxSessions, int maxIdleSeconds);
+
+    /**
+     * @brief Get or create the connection of a session
      * @param sessionId Unique session identifier (e.g., from JWT)
-     * @return Reference to the database connection for this session
      */
-    DatabaseConnection &getConnection(const std::string &sessionId);
+    SessionLease getConnection(const std::string &sessionId);
 
     /**
-     * @brief Check if session has an active connection
+     * @brief Get the connection of an existing session
+     * @return nullptr if the session does not exist
      */
-    bool hasConnection(const std::string &sessionId) const;
+    SessionLease findConnection(const std::string &sessionId);
 
     /**
      * @brief Remove connection for a session
@@ -84,21 +212,61 @@ class ConnectionManager
     void removeConnection(const std::string &sessionId);
 
     /**
-     * @brief Clean up expired sessions (called periodically)
-     * @param maxIdleSeconds Maximum idle time before session is removed
+     * @brief Drop sessions idle for more than @p maxIdleSeconds (run periodically by the reaper)
+     * @return Number of sessions dropped
      */
-    void cleanupExpiredSessions(int maxIdleSeconds = 3600);
+    size_t cleanupExpiredSessions(int maxIdleSeconds);
+
+    Stats getStats() const;
 
     // Delete copy constructor and assignment
     ConnectionManager(const ConnectionManager &) = delete;
     ConnectionManager &operator=(const ConnectionManager &) = delete;
 
   private:
-    ConnectionManager() = default;
-    ~ConnectionManager() = default;
+    ConnectionManager(size_t maxSessions, int maxIdleSeconds);
+    ~ConnectionManager();
+
+    static constexpr size_t kShardCount = 16;
+
+    struct Session
+    {
+        SessionLease connection;
+        std::chrono::steady_clock::time_point lastAccess;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    struct Shard
+    {
+        std::unordered_map<std::string, Session> sessions;
+        std::list<std::string> lru; // most recently used first
+        mutable std::mutex mutex;
+    };
+
+    Shard &shardFor(const std::string &sessionId);
+
+    /// Take one slot of the cap for a new session, evicting the oldest sessions into @p evicted while full
+    void reserveSlot(std::vector<SessionLease> &evicted);
+
+    /// Evict the least recently used session of all shards; false if every shard is empty
+    bool evictOldest(std::vector<SessionLease> &evicted);
+
+    void reaperLoop();
+
+    std::array<Shard, kShardCount> m_shards;
+    const size_t m_maxSessions;
+    std::atomic<size_t> m_live{0}; // sessions in the shards plus slots reserved for ones being created
+    const int m_maxIdleSeconds;
+
+    std::atomic<size_t> m_created{0};
+    std::atomic<size_t> m_removed{0};
+    std::atomic<size_t> m_evicted{0};
+    std::atomic<size_t> m_reaped{0};
 
-    std::map<std::string, SessionInfo> m_sessions;
-    mutable std::mutex m_mutex;
+    std::thread m_reaper;
+    bool m_stopping = false;
+    std::condition_variable m_reaperWakeup;
+    std::mutex m_reaperMutex;
 };
 
 } // namespace Data
@@ -0,0 +1,536 @@
+/**
+ * @file connection_pool.cpp
+ * @brief Pool of physical ODBC connections implementation
+ */
+
+#include "connection_pool.h"
+#include "data_backend.h"
+
+#include <cstdint>
+#include <sstream>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// Idle connections older than this are closed instead of reused
+static constexpr int kMaxIdleSeconds = 300;
+
+// The server a connection string logs in to: its Data Source (or Server), which names the circuit
+static std::string serverOf(const std::string &connectionString)
+{
+    std::istringstream ss(connectionString);
+    std::string pair;
+    while (std::getline(ss, pair, ';'))
+    {
+        auto eqPos = pair.find('=');
+        if (eqPos == std::string::npos)
+            continue;
+
+        std::string key = pair.substr(0, eqPos);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t") + 1);
+        if (key == "Data Source" || key == "Server")
+            return pair.substr(eqPos + 1);
+    }
+    return "(default)";
+}
+
+// PooledConnection
+
+PooledConnection::~PooledConnection()
+{
+    if (m_connected)
+    {
+        SQLDisconnect(m_dbc.get());
+        m_connected = false;
+    }
+}
+
+bool PooledConnection::connect(SQLHENV env, const std::string &connectionString, std::string &error)
+{
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_DBC, env, m_dbc.ptr());
+    if (!SQL_SUCCEEDED(ret))
+    {
+        error = "Failed to allocate connection handle";
+        return false;
+    }
+
+    SQLSetConnectAttr(m_dbc.get(), SQL_LOGIN_TIMEOUT, (SQLPOINTER)10, 0);
+
+    std::string odbcConnStr = toOdbcConnectionString(connectionString);
+
+    SQLCHAR outConnStr[1024];
+    SQLSMALLINT outConnStrLen;
+
+    ret = SQLDriverConnect(m_dbc.get(), NULL, (SQLCHAR *)odbcConnStr.c_str(), SQL_NTS, outConnStr, sizeof(outConnStr),
+                           &outConnStrLen, SQL_DRIVER_NOPROMPT);
+    if (!SQL_SUCCEEDED(ret))
+    {
+        error = getOdbcError(SQL_HANDLE_DBC, m_dbc.get());
+        return false;
+    }
+
+    m_connected = true;
+
+    SQLCHAR catalog[256];
+    SQLINTEGER catalogLen = 0;
+    ret = SQLGetConnectAttr(m_dbc.get(), SQL_ATTR_CURRENT_CATALOG, catalog, sizeof(catalog), &catalogLen);
+    if (SQL_SUCCEEDED(ret))
+        m_database = std::string((char *)catalog);
+    m_defaultDatabase = m_database;
+
+    return true;
+}
+
+bool PooledConnection::setDatabase(const std::string &database, std::string &error)
+{
+    if (database.empty() || database == m_database)
+        return true;
+
+    if (!isValidIdentifier(database))
+    {
+        error = "Invalid database name";
+        return false;
+    }
+
+    SQLRETURN ret = SQLSetConnectAttr(m_dbc.get(), SQL_ATTR_CURRENT_CATALOG, (SQLPOINTER)database.c_str(), SQL_NTS);
+    if (!SQL_SUCCEEDED(ret))
+    {
+        // Some drivers refuse to switch catalogs through the attribute
+        OdbcHandle<SQLHSTMT> stmt;
+        ret = SQLAllocHandle(SQL_HANDLE_STMT, m_dbc.get(), stmt.ptr());
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        std::string sql = "USE [" + database + "]";
+        ret = SQLExecDirect(stmt.get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+    }
+
+    m_database = database;
+    return true;
+}
+
+void PooledConnection::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_statementMutex);
+    m_cancelled = true;
+    if (m_activeStatement != SQL_NULL_HANDLE)
+        SQLCancel(m_activeStatement);
+}
+
+void PooledConnection::reset()
+{
+    std::lock_guard<std::mutex> lock(m_statementMutex);
+    m_queryTimeout = 0;
+    m_cancelled = false;
+}
+
+bool PooledConnection::isAlive() const
+{
+    if (!m_connected)
+        return false;
+
+    SQLINTEGER dead = SQL_CD_FALSE;
+    SQLRETURN ret = SQLGetConnectAttr(m_dbc.get(), SQL_ATTR_CONNECTION_DEAD, &dead, 0, NULL);
+
+    // Drivers without SQL_ATTR_CONNECTION_DEAD: assume alive, failures surface on use
+    return !SQL_SUCCEEDED(ret) || dead == SQL_CD_FALSE;
+}
+
+// PooledStatement
+
+PooledStatement::PooledStatement(PooledConnection &connection) : m_connection(connection)
+{
+    std::lock_guard<std::mutex> lock(m_connection.m_statementMutex);
+    if (m_connection.m_cancelled)
+        return;
+
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, m_connection.m_dbc.get(), m_stmt.ptr());
+    if (!SQL_SUCCEEDED(ret))
+        return;
+
+    if (m_connection.m_queryTimeout > 0)
+        SQLSetStmtAttr(m_stmt.get(), SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)(intptr_t)m_connection.m_queryTimeout, 0);
+
+    m_connection.m_activeStatement = m_stmt.get();
+}
+
+PooledStatement::~PooledStatement()
+{
+    std::lock_guard<std::mutex> lock(m_connection.m_statementMutex);
+    if (m_connection.m_activeStatement == m_stmt.get())
+        m_connection.m_activeStatement = SQL_NULL_HANDLE;
+
+    // Freeing closes any open cursor, so a cancelled statement leaves the connection clean
+    m_stmt.free();
+}
+
+// ConnectionLease
+
+ConnectionLease::ConnectionLease(ConnectionPool *pool, std::string key, std::unique_ptr<PooledConnection> connection)
+    : m_pool(pool), m_key(std::move(key)), m_connection(std::move(connection))
+{
+}
+
+ConnectionLease::~ConnectionLease()
+{
+    release();
+}
+
+ConnectionLease::ConnectionLease(ConnectionLease &&other) noexcept
+    : m_pool(other.m_pool), m_key(std::move(other.m_key)), m_connection(std::move(other.m_connection)),
+      m_broken(other.m_broken)
+{
+    other.m_pool = nullptr;
+}
+
+ConnectionLease &ConnectionLease::operator=(ConnectionLease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_pool = other.m_pool;
+        m_key = std::move(other.m_key);
+        m_connection = std::move(other.m_connection);
+        m_broken = other.m_broken;
+        other.m_pool = nullptr;
+    }
+    return *this;
+}
+
+void ConnectionLease::release()
+{
+    if (m_pool && m_connection)
+    {
+        m_pool->giveBack(m_key, std::move(m_connection), m_broken);
+    }
+    m_pool = nullptr;
+    m_connection.reset();
+}
+
+// ConnectionPool
+
+ConnectionPool &ConnectionPool::getInstance()
+{
+    static ConnectionPool instance;
+    return instance;
+}
+
+ConnectionPool::ConnectionPool() : m_maxPerTarget(kMaxPerTarget)
+{
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, m_env.ptr());
+    if (SQL_SUCCEEDED(ret))
+    {
+        ret = SQLSetEnvAttr(m_env.get(), SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
+        if (!SQL_SUCCEEDED(ret))
+            m_env.free();
+    }
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_probeWake.notify_all();
+    if (m_prober.joinable())
+        m_prober.join();
+
+    // Connections must be closed before the environment is freed
+    m_targets.clear();
+}
+
+ConnectionPool::Target &ConnectionPool::targetOf(const std::string &connectionString)
+{
+    Target &target = m_targets[connectionString];
+    if (target.server.empty())
+        target.server = serverOf(connectionString);
+    return target;
+}
+
+bool ConnectionPool::admit(const std::string &server, const std::string &connectionString, std::string &error)
+{
+    CircuitBreaker &circuit = m_circuits[server];
+    std::string &probeWith = m_probeWith[server];
+    if (probeWith.empty())
+        probeWith = connectionString;
+
+    auto now = std::chrono::steady_clock::now();
+    bool probe = false;
+    if (circuit.allow(now, probe))
+        return true;
+
+    if (probe)
+    {
+        m_probes.push_back(connectionString);
+        scheduleProbes();
+    }
+
+    error = "Database server unavailable (circuit open), retry in " +
+            std::to_string(circuit.retryAfterSeconds(now)) + " s";
+    return false;
+}
+
+void ConnectionPool::recordLogin(const std::string &server, bool connected, const std::string &error,
+                                 std::chrono::steady_clock::duration elapsed)
+{
+    bool slow = connected && elapsed > CircuitBreaker::kSlowCall;
+    bool unreachable = !connected && CircuitBreaker::isUnreachable(error);
+
+    // A refused login is the server's answer: it neither counts for nor against the server
+    if (!connected && !unreachable)
+        return;
+
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    CircuitBreaker &circuit = m_circuits[server];
+    circuit.record(slow || unreachable, slow ? "Login took " + std::to_string(milliseconds) + " ms" : error,
+                   std::chrono::steady_clock::now());
+    if (circuit.state() == CircuitBreaker::State::Open)
+        scheduleProbes();
+}
+
+void ConnectionPool::scheduleProbes()
+{
+    // One thread probes for the whole pool; it is started the first time a circuit opens
+    if (!m_prober.joinable())
+        m_prober = std::thread(&ConnectionPool::runProbes, this);
+    m_probeWake.notify_one();
+}
+
+bool ConnectionPool::checkCircuit(const std::string &connectionString, int &retryAfterSeconds)
+{
+    // A server never logged in to (or a file database) has no circuit yet, so nothing refuses it
+    std::string server = serverOf(connectionString);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_circuits.find(server) == m_circuits.end())
+        return true;
+
+    std::string error;
+    if (admit(server, connectionString, error))
+        return true;
+
+    retryAfterSeconds = m_circuits[server].retryAfterSeconds(std::chrono::steady_clock::now());
+    return false;
+}
+
+void ConnectionPool::runProbes()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        // Probes are queued by refused calls, and by this thread once an open circuit is due, so a server no one
+        // calls meanwhile is still found to be back
+        auto now = std::chrono::steady_clock::now();
+        auto due = std::chrono::steady_clock::time_point::max();
+        for (auto &[server, circuit] : m_circuits)
+        {
+            auto probeWith = m_probeWith.find(server);
+            if (probeWith == m_probeWith.end())
+                continue;
+            if (circuit.startProbe(now))
+                m_probes.push_back(probeWith->second);
+            else if (circuit.state() == CircuitBreaker::State::Open)
+                due = std::min(due, circuit.retryAt());
+        }
+
+        if (m_probes.empty() && !m_stopping)
+        {
+            if (due == std::chrono::steady_clock::time_point::max())
+                m_probeWake.wait(lock);
+            else
+                m_probeWake.wait_until(lock, due);
+            continue;
+        }
+        if (m_stopping)
+            return;
+
+        std::string connectionString = std::move(m_probes.front());
+        m_probes.pop_front();
+        std::string server = targetOf(connectionString).server;
+        lock.unlock();
+
+        auto connection = std::make_unique<PooledConnection>();
+        std::string error;
+        auto started = std::chrono::steady_clock::now();
+        bool connected = connection->connect(m_env.get(), connectionString, error);
+        auto elapsed = std::chrono::steady_clock::now() - started;
+
+        // A refused login still reached the server; a slow one did not prove it recovered
+        bool reached = connected ? elapsed <= CircuitBreaker::kSlowCall : !CircuitBreaker::isUnreachable(error);
+        if (connected && !reached)
+            error = "Login took " +
+                    std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + " ms";
+
+        lock.lock();
+        m_circuits[server].probed(reached, error, std::chrono::steady_clock::now());
+
+        // The probe's connection is the first one the recovered server serves
+        Target &target = targetOf(connectionString);
+        if (connected && reached && target.open < m_maxPerTarget)
+        {
+            target.open++;
+            m_opened++;
+            connection->lastUsed = std::chrono::steady_clock::now();
+            target.idle.push_back(std::move(connection));
+            m_available.notify_one();
+        }
+        else if (connection)
+        {
+            lock.unlock();
+            connection.reset(); // disconnect outside the lock
+            lock.lock();
+        }
+    }
+}
+
+ConnectionLease ConnectionPool::acquire(const std::string &connectionString, const std::string &database,
+                                        std::chrono::milliseconds waitTimeout, std::string &error)
+{
+    auto deadline = std::chrono::steady_clock::now() + waitTimeout;
+    std::vector<std::unique_ptr<PooledConnection>> stale;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_env)
+    {
+        error = "Failed to allocate environment handle";
+        return ConnectionLease();
+    }
+
+    while (true)
+    {
+        auto &target = targetOf(connectionString);
+
+        // A server that stopped answering is refused at once instead of holding the caller for the login timeout
+        if (!admit(target.server, connectionString, error))
+            return ConnectionLease();
+
+        auto now = std::chrono::steady_clock::now();
+
+        // Reuse the most recently returned idle connection
+        while (!target.idle.empty())
+        {
+            std::unique_ptr<PooledConnection> connection = std::move(target.idle.back());
+            target.idle.pop_back();
+
+            auto idleSeconds =
+                std::chrono::duration_cast<std::chrono::seconds>(now - connection->lastUsed).count();
+            if (idleSeconds > kMaxIdleSeconds || !connection->isAlive())
+            {
+                target.open--;
+                m_discarded++;
+                stale.push_back(std::move(connection));
+                continue;
+            }
+
+            lock.unlock();
+            stale.clear();
+
+            ConnectionLease lease(this, connectionString, std::move(connection));
+            if (!lease->setDatabase(database, error))
+                return ConnectionLease();
+            return lease;
+        }
+
+        // Open a new one if the target is below its limit
+        if (target.open < m_maxPerTarget)
+        {
+            target.open++;
+            lock.unlock();
+            stale.clear();
+
+            std::string server = target.server;
+            auto connection = std::make_unique<PooledConnection>();
+            auto started = std::chrono::steady_clock::now();
+            bool connected = connection->connect(m_env.get(), connectionString, error);
+            auto elapsed = std::chrono::steady_clock::now() - started;
+
+            {
+                std::lock_guard<std::mutex> relock(m_mutex);
+                recordLogin(server, connected, error, elapsed);
+                if (!connected)
+                {
+                    m_targets[connectionString].open--;
+                    m_available.notify_one();
+                    return ConnectionLease();
+                }
+                m_opened++;
+            }
+
+            ConnectionLease lease(this, connectionString, std::move(connection));
+            if (!lease->setDatabase(database, error))
+                return ConnectionLease();
+            return lease;
+        }
+
+        if (m_available.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            error = "Connection pool exhausted";
+            return ConnectionLease();
+        }
+    }
+}
+
+void ConnectionPool::giveBack(const std::string &key, std::unique_ptr<PooledConnection> connection, bool broken)
+{
+    connection->reset();
+    connection->lastUsed = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto &target = targetOf(key);
+
+    // A lease coming back whole shows the server answering; a broken one, that the connection was lost
+    CircuitBreaker &circuit = m_circuits[target.server];
+    circuit.record(broken, "Connection lost", connection->lastUsed);
+    if (circuit.state() == CircuitBreaker::State::Open)
+        scheduleProbes();
+
+    if (broken)
+    {
+        target.open--;
+        m_discarded++;
+        m_available.notify_one();
+        lock.unlock();
+        connection.reset(); // disconnect outside the lock
+        return;
+    }
+
+    target.idle.push_back(std::move(connection));
+    m_available.notify_one();
+}
+
+ConnectionPool::Stats ConnectionPool::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.targets = m_targets.size();
+    for (const auto &[key, target] : m_targets)
+    {
+        stats.idle += target.idle.size();
+        stats.leased += target.open - target.idle.size();
+    }
+    stats.opened = m_opened;
+    stats.discarded = m_discarded;
+
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &[server, circuit] : m_circuits)
+    {
+        if (circuit.state() != CircuitBreaker::State::Closed)
+            stats.openCircuits++;
+        stats.circuits.push_back({server, circuit.getStats(now)});
+    }
+    return stats;
+}
+
+} // namespace Data
+} // namespace Tootega
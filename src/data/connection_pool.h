@@ -0,0 +1,312 @@
+/**
+ * @file connection_pool.h
+ * @brief Pool of physical ODBC connections shared by all sessions
+ */
+
+#pragma once
+
+#include "circuit_breaker.h"
+#include "odbc_utils.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class PooledConnection
+ * @brief One physical ODBC connection owned by the ConnectionPool
+ */
+class PooledConnection
+{
+  public:
+    PooledConnection() = default;
+    ~PooledConnection();
+
+    PooledConnection(const PooledConnection &) = delete;
+    PooledConnection &operator=(const PooledConnection &) = delete;
+
+    /**
+     * @brief Open the connection
+     * @param env Environment handle shared by the pool
+     * @param connectionString ADO.NET style connection string
+     */
+    bool connect(SQLHENV env, const std::string &connectionString, std::string &error);
+
+    /**
+     * @brief Switch the connection to a database (no-op if already there)
+     */
+    bool setDatabase(const std::string &database, std::string &error);
+
+    /**
+     * @brief Query timeout applied to PooledStatements on this connection (0 = none)
+     */
+    void setQueryTimeout(int seconds)
+    {
+        m_queryTimeout = seconds;
+    }
+
+    /**
+     * @brief Cancel the statement running on this connection
+     *
+     * Safe to call from any thread. Statements allocated afterwards fail
+     * until the connection is reset.
+     */
+    void cancel();
+
+    /**
+     * @brief Restore the defaults before the connection goes back to the pool
+     */
+    void reset();
+
+    /**
+     * @brief Ask the driver whether the connection is still usable
+     */
+    bool isAlive() const;
+
+    SQLHDBC handle() const
+    {
+        return m_dbc.get();
+    }
+
+    const std::string &getDatabase() const
+    {
+        return m_database;
+    }
+
+    /**
+     * @brief Database the connection was using right after login (the connection string's or the login's default)
+     */
+    const std::string &getDefaultDatabase() const
+    {
+        return m_defaultDatabase;
+    }
+
+    std::chrono::steady_clock::time_point lastUsed;
+
+  private:
+    friend class PooledStatement;
+
+    OdbcHandle<SQLHDBC> m_dbc;
+    std::string m_database;
+    std::string m_defaultDatabase;
+    int m_queryTimeout = 0;
+    bool m_connected = false;
+
+    // Statement cancel() targets; guarded so it is never cancelled while being freed
+    SQLHSTMT m_activeStatement = SQL_NULL_HANDLE;
+    bool m_cancelled = false;
+    std::mutex m_statementMutex;
+};
+
+/**
+ * @class PooledStatement
+ * @brief Statement on a pooled connection, with the connection's query timeout applied
+ *
+ * While it exists, PooledConnection::cancel() interrupts it.
+ */
+class PooledStatement
+{
+  public:
+    explicit PooledStatement(PooledConnection &connection);
+    ~PooledStatement();
+
+    PooledStatement(const PooledStatement &) = delete;
+    PooledStatement &operator=(const PooledStatement &) = delete;
+
+    SQLHSTMT get() const
+    {
+        return m_stmt.get();
+    }
+
+    /**
+     * @brief False if the statement could not be allocated or the connection was cancelled
+     */
+    explicit operator bool() const
+    {
+        return static_cast<bool>(m_stmt);
+    }
+
+  private:
+    PooledConnection &m_connection;
+    OdbcHandle<SQLHSTMT> m_stmt;
+};
+
+class ConnectionPool;
+
+/**
+ * @class ConnectionLease
+ * @brief Exclusive, scoped use of a pooled connection
+ *
+ * The connection goes back to the pool when the lease is destroyed, unless it
+ * was marked broken, in which case it is closed.
+ */
+class ConnectionLease
+{
+  public:
+    ConnectionLease() = default;
+    ConnectionLease(ConnectionPool *pool, std::string key, std::unique_ptr<PooledConnection> connection);
+    ~ConnectionLease();
+
+    ConnectionLease(ConnectionLease &&other) noexcept;
+    ConnectionLease &operator=(ConnectionLease &&other) noexcept;
+
+    ConnectionLease(const ConnectionLease &) = delete;
+    ConnectionLease &operator=(const ConnectionLease &) = delete;
+
+    explicit operator bool() const
+    {
+        return m_connection != nullptr;
+    }
+
+    PooledConnection *operator->() const
+    {
+        return m_connection.get();
+    }
+
+    PooledConnection &operator*() const
+    {
+        return *m_connection;
+    }
+
+    /**
+     * @brief Do not return this connection to the pool
+     */
+    void markBroken()
+    {
+        m_broken = true;
+    }
+
+    /**
+     * @brief Return the connection to the pool now
+     */
+    void release();
+
+  private:
+    ConnectionPool *m_pool = nullptr;
+    std::string m_key;
+    std::unique_ptr<PooledConnection> m_connection;
+    bool m_broken = false;
+};
+
+/**
+ * @class ConnectionPool
+ * @brief Keeps idle ODBC connections per connection string and leases them out
+ *
+ * Each database server (the Data Source of the connection strings) has a
+ * CircuitBreaker fed by the logins and the leases returned. While it is
+ * open, acquire() fails at once instead of waiting out the login timeout,
+ * and a thread of the pool probes the server each time the open time is up,
+ * called or not, until it answers again.
+ */
+class ConnectionPool
+{
+  public:
+    /// Cap of open connections per target (connection string)
+    static constexpr size_t kMaxPerTarget = 8;
+
+    /**
+     * @brief Breaker state of one database server
+     */
+    struct ServerCircuit
+    {
+        std::string server;
+        CircuitBreaker::Stats breaker;
+    };
+
+    /**
+     * @brief Pool usage counters
+     */
+    struct Stats
+    {
+        size_t targets = 0;
+        size_t idle = 0;
+        size_t leased = 0;
+        size_t opened = 0;
+        size_t discarded = 0;
+        size_t openCircuits = 0; ///< Servers refused at the moment (open or half-open)
+        std::vector<ServerCircuit> circuits;
+    };
+
+    /**
+     * @brief Get the singleton instance
+     */
+    static ConnectionPool &getInstance();
+
+    /**
+     * @brief Lease a connection for a target, opening one if needed
+     * @param connectionString ADO.NET style connection string (the pool key)
+     * @param database Database the connection must be using (empty = leave as is)
+     * @param waitTimeout How long to wait when the target is at its connection limit
+     * @param error Set when no connection could be leased
+     */
+    ConnectionLease acquire(const std::string &connectionString, const std::string &database,
+                            std::chrono::milliseconds waitTimeout, std::string &error);
+
+    /**
+     * @brief Whether calls to the server of a connection string go through, without leasing anything
+     * @param retryAfterSeconds Set to when the server is probed next if they do not
+     */
+    bool checkCircuit(const std::string &connectionString, int &retryAfterSeconds);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+  private:
+    friend class ConnectionLease;
+
+    ConnectionPool();
+    ~ConnectionPool();
+
+    struct Target
+    {
+        std::vector<std::unique_ptr<PooledConnection>> idle;
+        size_t open = 0;
+        std::string server; ///< Key of the target's circuit
+    };
+
+    void giveBack(const std::string &key, std::unique_ptr<PooledConnection> connection, bool broken);
+
+    // Expects m_mutex to be held
+    Target &targetOf(const std::string &connectionString);
+    bool admit(const std::string &server, const std::string &connectionString, std::string &error);
+
+    // Record a login in the server's circuit; expects m_mutex to be held
+    void recordLogin(const std::string &server, bool connected, const std::string &error,
+                     std::chrono::steady_clock::duration elapsed);
+
+    // Start the prober if needed and let it reschedule; expects m_mutex to be held
+    void scheduleProbes();
+    void runProbes();
+
+    OdbcHandle<SQLHENV> m_env;
+    std::unordered_map<std::string, Target> m_targets;
+    std::unordered_map<std::string, CircuitBreaker> m_circuits;
+
+    std::deque<std::string> m_probes; ///< Connection strings of the servers to probe
+    std::unordered_map<std::string, std::string> m_probeWith; ///< Connection string a server is probed with
+    std::thread m_prober;
+    bool m_stopping = false;
+    std::condition_variable m_probeWake;
+    size_t m_maxPerTarget;
+    size_t m_opened = 0;
+    size_t m_discarded = 0;
+    std::condition_variable m_available;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,152 @@
+/**
+ * @file count_cache.cpp
+ * @brief Shared cache of table row counts implementation
+ */
+
+#include "count_cache.h"
+#include "db_executor.h"
+
+namespace Tootega
+{
+namespace Data
+{
+
+// Entries kept before expired ones are swept on insert
+static constexpr size_t kMaxEntriesBeforePrune = 4096;
+
+CountCache &CountCache::getInstance()
+{
+    static CountCache instance;
+    return instance;
+}
+
+std::string CountCache::makeKey(const std::string &target, const std::string &schema, const std::string &tableName,
+                                const RowFilter &filter)
+{
+    // '\x1f' (unit separator) cannot appear in validated identifiers
+    bool filtered = filter.isActive();
+    std::string key;
+    key.reserve(target.size() + schema.size() + tableName.size() + filter.column.size() + filter.value.size() + 6);
+    key += target;
+    key += '\x1f';
+    key += schema;
+    key += '\x1f';
+    key += tableName;
+    key += '\x1f';
+    if (filtered)
+    {
+        // The mode must be resolved (not Auto): modes match different rows
+        key += filter.column;
+        key += '\x1f';
+        key += static_cast<char>('0' + static_cast<int>(filter.mode));
+        key += '\x1f';
+        key += filter.value;
+    }
+    return key;
+}
+
+bool CountCache::isFresh(const Entry &entry, std::chrono::steady_clock::time_point now) const
+{
+    return entry.valid && now < entry.expires;
+}
+
+bool CountCache::lookup(const std::string &key, RowCount &count, bool &pending)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pending = false;
+
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return false;
+
+    pending = it->second.pending;
+    if (!isFresh(it->second, std::chrono::steady_clock::now()))
+        return false;
+
+    count = it->second.count;
+    return true;
+}
+
+void CountCache::store(const std::string &key, const RowCount &count)
+{
+    auto now = std::chrono::steady_clock::now();
+    int ttl = count.approximate ? kApproximateTtlSeconds : kExactTtlSeconds;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.size() >= kMaxEntriesBeforePrune)
+        pruneExpired(now);
+
+    auto &entry = m_entries[key];
+    entry.count = count;
+    entry.expires = now + std::chrono::seconds(ttl);
+    entry.valid = true;
+    m_changed.notify_all();
+}
+
+void CountCache::computeAsync(const std::string &key, Producer producer)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto &entry = m_entries[key];
+        if (entry.pending)
+            return;
+        entry.pending = true;
+    }
+
+    // Queued on the database pool: a burst of uncached tables waits for workers instead of adding threads
+    DbExecutor::getInstance().post([this, key, producer = std::move(producer)]() {
+        RowCount count;
+        bool ok = false;
+        try
+        {
+            ok = producer(count);
+        }
+        catch (...)
+        {
+            ok = false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto &entry = m_entries[key];
+        entry.pending = false;
+        if (ok)
+        {
+            entry.count = count;
+            entry.expires =
+                std::chrono::steady_clock::now() +
+                std::chrono::seconds(count.approximate ? kApproximateTtlSeconds : kExactTtlSeconds);
+            entry.valid = true;
+        }
+        m_changed.notify_all();
+    });
+}
+
+bool CountCache::waitFor(const std::string &key, RowCount &count, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait_for(lock, timeout, [&]() {
+        auto it = m_entries.find(key);
+        return it == m_entries.end() || !it->second.pending;
+    });
+
+    auto it = m_entries.find(key);
+    if (it == m_entries.end() || !isFresh(it->second, std::chrono::steady_clock::now()))
+        return false;
+
+    count = it->second.count;
+    return true;
+}
+
+void CountCache::pruneExpired(std::chrono::steady_clock::time_point now)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (!it->second.pending && !isFresh(it->second, now))
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,104 @@
+/**
+ * @file count_cache.h
+ * @brief Shared cache of table row counts
+ */
+
+#pragma once
+
+#include "database.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class CountCache
+ * @brief Caches row counts per (connection target, table, filter) with a TTL
+ *
+ * Counts can also be computed in the background: callers start a computation
+ * with computeAsync() and pick the result up later with lookup() or waitFor().
+ */
+class CountCache
+{
+  public:
+    /// Lifetime of exact COUNT_BIG(*) results
+    static constexpr int kExactTtlSeconds = 60;
+
+    /// Lifetime of catalog estimates (cheap to refresh)
+    static constexpr int kApproximateTtlSeconds = 10;
+
+    /// Producer used by computeAsync(); returns false on failure
+    using Producer = std::function<bool(RowCount &)>;
+
+    /**
+     * @brief Get the singleton instance
+     */
+    static CountCache &getInstance();
+
+    /**
+     * @brief Build the cache key for a count
+     * @param target Connection target (see DatabaseConnection::getTargetKey)
+     * @param filter Filter with its mode already resolved
+     */
+    static std::string makeKey(const std::string &target, const std::string &schema, const std::string &tableName,
+                               const RowFilter &filter);
+
+    /**
+     * @brief Look up a cached count
+     * @param pending Set to true when a background computation is in flight
+     * @return true if a valid (non-expired) count was found
+     */
+    bool lookup(const std::string &key, RowCount &count, bool &pending);
+
+    /**
+     * @brief Store a count; the TTL depends on whether it is approximate
+     */
+    void store(const std::string &key, const RowCount &count);
+
+    /**
+     * @brief Start computing a count in the background (no-op if one is already pending)
+     *
+     * The producer is queued on the DbExecutor rather than given a thread of its own.
+     */
+    void computeAsync(const std::string &key, Producer producer);
+
+    /**
+     * @brief Wait for a pending computation to finish
+     * @return true if a valid count is available when the wait ends
+     */
+    bool waitFor(const std::string &key, RowCount &count, std::chrono::milliseconds timeout);
+
+    // Delete copy constructor and assignment
+    CountCache(const CountCache &) = delete;
+    CountCache &operator=(const CountCache &) = delete;
+
+  private:
+    CountCache() = default;
+    ~CountCache() = default;
+
+    struct Entry
+    {
+        RowCount count;
+        std::chrono::steady_clock::time_point expires;
+        bool valid = false;
+        bool pending = false;
+    };
+
+    bool isFresh(const Entry &entry, std::chrono::steady_clock::time_point now) const;
+    void pruneExpired(std::chrono::steady_clock::time_point now);
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::condition_variable m_changed;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
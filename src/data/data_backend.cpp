@@ -0,0 +1,617 @@
+/**
+ * @file data_backend.cpp
+ * @brief Backend selection and helpers shared by all backends
+ */
+
+#include "data_backend.h"
+#include "sqlite_backend.h"
+#include "sqlserver_backend.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// A text cell this long may have been cut by the fetch, so it cannot position a cursor
+static constexpr size_t kMaxKeyValueBytes = 4000;
+
+// Keys an NTILE split samples per range
+static constexpr long long kSampledKeysPerPart = 1000;
+
+static bool equalsIgnoreCase(const std::string &a, const std::string &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return true;
+}
+
+std::unique_ptr<DataBackend> DataBackend::create(const std::string &connectionString)
+{
+    if (equalsIgnoreCase(getConnectionStringValue(connectionString, "Provider"), "SQLite"))
+        return createSqliteBackend();
+
+    return createSqlServerBackend();
+}
+
+bool DataBackend::countRows(const std::string &schema, const std::string &tableName, const RowFilter &filter,
+                            bool exact, RowCount &count, CancellationToken &cancel)
+{
+    RowCounter counter = prepareCount(schema, tableName, filter, exact);
+    return counter && counter(count, cancel);
+}
+
+bool isValidIdentifier(const std::string &name)
+{
+    if (name.empty())
+        return false;
+    for (char c : name)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+            return false;
+    }
+    return true;
+}
+
+const char *filterModeName(FilterMode mode)
+{
+    switch (mode)
+    {
+    case FilterMode::Contains:
+        return "contains";
+    case FilterMode::Prefix:
+        return "prefix";
+    case FilterMode::Exact:
+        return "exact";
+    case FilterMode::FullText:
+        return "fulltext";
+    case FilterMode::Auto:
+        return "auto";
+    }
+    return "contains";
+}
+
+bool parseFilterMode(const std::string &name, FilterMode &mode)
+{
+    static const FilterMode modes[] = {FilterMode::Contains, FilterMode::Prefix, FilterMode::Exact,
+                                       FilterMode::FullText, FilterMode::Auto};
+    for (FilterMode candidate : modes)
+    {
+        if (equalsIgnoreCase(name, filterModeName(candidate)))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Declared types stored as text: (n)(var)char, (n)text, clob, SQLite's untyped columns
+static bool isTextType(const std::string &type)
+{
+    std::string lower;
+    for (char c : type)
+        lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return lower.empty() || lower.find("char") != std::string::npos || lower.find("text") != std::string::npos ||
+           lower.find("clob") != std::string::npos;
+}
+
+static bool isNumber(const std::string &value)
+{
+    size_t i = (value[0] == '-' || value[0] == '+') ? 1 : 0;
+    bool digits = false, point = false;
+    for (; i < value.size(); i++)
+    {
+        if (std::isdigit(static_cast<unsigned char>(value[i])))
+            digits = true;
+        else if (value[i] == '.' && !point)
+            point = true;
+        else
+            return false;
+    }
+    return digits;
+}
+
+FilterMode resolveFilterMode(FilterMode requested, const ColumnInfo *column, const std::string &value)
+{
+    if (requested == FilterMode::FullText)
+        return column && column->isFullTextIndexed ? FilterMode::FullText : FilterMode::Contains;
+    if (requested != FilterMode::Auto)
+        return requested;
+
+    if (!column || value.empty())
+        return FilterMode::Contains;
+
+    // LIKE on a number converts every row to text; equality can seek and is what a number search means
+    if (!isTextType(column->type))
+        return isNumber(value) ? FilterMode::Exact : FilterMode::Contains;
+    if (column->isIndexed)
+        return FilterMode::Prefix;
+    if (column->isFullTextIndexed)
+        return FilterMode::FullText;
+    return FilterMode::Contains;
+}
+
+bool resolveSortOrder(const std::vector<SortKey> &requested, const std::vector<ColumnInfo> &columns,
+                      std::vector<SortKey> &order, bool &unique, std::string &error)
+{
+    auto findColumn = [&](const std::string &name) {
+        return std::find_if(columns.begin(), columns.end(), [&](const ColumnInfo &info) { return info.name == name; });
+    };
+    auto inOrder = [&](const std::string &name) {
+        return std::any_of(order.begin(), order.end(), [&](const SortKey &key) { return key.column == name; });
+    };
+
+    order.clear();
+    for (const SortKey &key : requested)
+    {
+        auto column = findColumn(key.column);
+        if (column == columns.end())
+        {
+            error = "Unknown sort column: " + key.column;
+            return false;
+        }
+        if (inOrder(key.column))
+        {
+            error = "Duplicate sort column: " + key.column;
+            return false;
+        }
+
+        SortKey resolved = key;
+        resolved.indexed = column->isIndexed;
+        order.push_back(resolved);
+    }
+
+    unique = false;
+    for (const ColumnInfo &column : columns)
+    {
+        if (!column.isPrimaryKey)
+            continue;
+        unique = true;
+        if (!inOrder(column.name))
+        {
+            SortKey tiebreaker;
+            tiebreaker.column = column.name;
+            tiebreaker.indexed = column.isIndexed;
+            order.push_back(tiebreaker);
+        }
+    }
+    return true;
+}
+
+bool resolveProjection(const std::vector<std::string> &requested, const std::vector<ColumnInfo> &columns,
+                       const std::vector<SortKey> &order, std::vector<const ColumnInfo *> &projected,
+                       std::string &error)
+{
+    auto findColumn = [&](const std::string &name) -> const ColumnInfo * {
+        auto it =
+            std::find_if(columns.begin(), columns.end(), [&](const ColumnInfo &info) { return info.name == name; });
+        return it == columns.end() ? nullptr : &*it;
+    };
+    auto isProjected = [&](const ColumnInfo *column) {
+        return std::find(projected.begin(), projected.end(), column) != projected.end();
+    };
+
+    projected.clear();
+    if (requested.empty())
+    {
+        for (const ColumnInfo &column : columns)
+            projected.push_back(&column);
+        return true;
+    }
+
+    for (const std::string &name : requested)
+    {
+        const ColumnInfo *column = findColumn(name);
+        if (!column)
+        {
+            error = "Unknown column: " + name;
+            return false;
+        }
+        if (isProjected(column))
+        {
+            error = "Duplicate column: " + name;
+            return false;
+        }
+        projected.push_back(column);
+    }
+
+    for (const SortKey &key : order)
+    {
+        const ColumnInfo *column = findColumn(key.column);
+        if (column && !isProjected(column))
+            projected.push_back(column);
+    }
+    return true;
+}
+
+std::string keysetPredicate(const std::vector<SortKey> &order, const std::vector<KeyValue> &after,
+                            const std::function<std::string(const std::string &)> &quote,
+                            std::vector<std::string> &params)
+{
+    params.clear();
+    if (order.empty() || order.size() != after.size())
+        return std::string();
+
+    // Rows past (strict) or at least at (not strict) the cursor on key i; empty when every row is
+    auto compare = [&](size_t i, bool strict) -> std::string {
+        std::string column = quote(order[i].column);
+        if (!after[i])
+        {
+            if (!order[i].descending)
+                return strict ? column + " IS NOT NULL" : std::string();
+            return strict ? "1 = 0" : column + " IS NULL";
+        }
+
+        params.push_back(*after[i]);
+        if (!order[i].descending)
+            return column + (strict ? " > ?" : " >= ?");
+        return "(" + column + (strict ? " < ?" : " <= ?") + " OR " + column + " IS NULL)";
+    };
+
+    std::string predicate;
+    if (order.size() > 1)
+    {
+        std::string leading = compare(0, false);
+        if (!leading.empty())
+            predicate = leading + " AND ";
+    }
+
+    predicate += "(";
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        if (i > 0)
+            predicate += " OR ";
+        predicate += "(";
+        for (size_t j = 0; j < i; j++)
+        {
+            if (after[j])
+            {
+                predicate += quote(order[j].column) + " = ? AND ";
+                params.push_back(*after[j]);
+            }
+            else
+            {
+                predicate += quote(order[j].column) + " IS NULL AND ";
+            }
+        }
+        predicate += compare(i, true) + ")";
+    }
+    predicate += ")";
+    return predicate;
+}
+
+std::string keyMatchPredicate(const std::vector<std::string> &keyColumns, size_t keyCount,
+                              const std::function<std::string(const std::string &)> &quote)
+{
+    if (keyCount == 0)
+        return "1 = 0";
+
+    std::string predicate;
+    if (keyColumns.size() == 1)
+    {
+        predicate = quote(keyColumns[0]) + " IN (";
+        for (size_t i = 0; i < keyCount; i++)
+            predicate += i == 0 ? "?" : ", ?";
+        return predicate + ")";
+    }
+
+    std::string match;
+    for (size_t c = 0; c < keyColumns.size(); c++)
+        match += (c == 0 ? "(" : " AND ") + quote(keyColumns[c]) + " = ?";
+    match += ")";
+    for (size_t i = 0; i < keyCount; i++)
+        predicate += (i == 0 ? "" : " OR ") + match;
+    return predicate;
+}
+
+const ColumnInfo *singlePrimaryKey(const std::vector<ColumnInfo> &columns)
+{
+    const ColumnInfo *key = nullptr;
+    for (const ColumnInfo &column : columns)
+    {
+        if (!column.isPrimaryKey)
+            continue;
+        if (key)
+            return nullptr;
+        key = &column;
+    }
+    return key;
+}
+
+long long keySampleRate(long long rows, size_t parts)
+{
+    long long sampled = static_cast<long long>(parts) * kSampledKeysPerPart;
+    return std::max(1LL, rows / sampled);
+}
+
+std::string keyRangePredicate(const KeyRange &range, const std::function<std::string(const std::string &)> &quote,
+                              std::vector<std::string> &params)
+{
+    params.clear();
+    if (!range.isActive())
+        return std::string();
+
+    std::string column = quote(range.column);
+    if (range.lower)
+    {
+        params.push_back(*range.lower);
+        if (!range.upper)
+            return column + " > ?";
+        params.push_back(*range.upper);
+        return column + " > ? AND " + column + " <= ?";
+    }
+
+    // NULL keys sort first, so they go with the first slice
+    params.push_back(*range.upper);
+    return "(" + column + " <= ? OR " + column + " IS NULL)";
+}
+
+bool readLastKey(const ResultSet &data, const std::vector<SortKey> &order, std::vector<KeyValue> &values)
+{
+    values.clear();
+    if (data.rowCount() == 0 || order.empty())
+        return false;
+
+    size_t last = data.rowCount() - 1;
+    for (const SortKey &key : order)
+    {
+        size_t column = 0;
+        while (column < data.columnCount() && data.columnName(column) != key.column)
+            column++;
+        if (column == data.columnCount() || data.columnKind(column) == ValueKind::Binary)
+        {
+            values.clear();
+            return false;
+        }
+        if (data.isNull(last, column))
+        {
+            values.emplace_back();
+            continue;
+        }
+
+        std::string_view value = data.value(last, column);
+        if (value.size() >= kMaxKeyValueBytes)
+        {
+            values.clear();
+            return false;
+        }
+        values.emplace_back(std::string(value));
+    }
+    return true;
+}
+
+bool resolveInsertColumns(const std::vector<std::string> &requested, const std::vector<ColumnInfo> &columns,
+                          std::vector<const ColumnInfo *> &targets, std::string &error)
+{
+    if (requested.empty())
+    {
+        error = "No columns to insert";
+        return false;
+    }
+    for (const std::string &name : requested)
+    {
+        if (!isValidIdentifier(name))
+        {
+            error = "Invalid column name: " + name;
+            return false;
+        }
+    }
+    return resolveProjection(requested, columns, {}, targets, error);
+}
+
+bool planEdit(const std::vector<RowChange> &changes, const std::vector<ColumnInfo> &columns,
+              const ColumnInfo *versionColumn, std::vector<EditStatement> &statements, long long &failedChange,
+              std::string &error)
+{
+    auto findColumn = [&](const std::string &name) -> const ColumnInfo * {
+        auto it =
+            std::find_if(columns.begin(), columns.end(), [&](const ColumnInfo &info) { return info.name == name; });
+        return it == columns.end() ? nullptr : &*it;
+    };
+
+    std::vector<const ColumnInfo *> primaryKey;
+    std::string primaryKeyNames;
+    for (const ColumnInfo &column : columns)
+    {
+        if (column.isPrimaryKey)
+        {
+            primaryKeyNames += (primaryKey.empty() ? "" : ", ") + column.name;
+            primaryKey.push_back(&column);
+        }
+    }
+
+    statements.clear();
+    std::vector<std::pair<const ColumnInfo *, const KeyValue *>> values;
+    std::vector<const ColumnInfo *> valueColumns;
+    for (size_t i = 0; i < changes.size(); i++)
+    {
+        const RowChange &change = changes[i];
+        failedChange = static_cast<long long>(i);
+
+        // Values in table order, so the same columns given in another order still share a statement
+        values.clear();
+        for (const ColumnValue &value : change.values)
+        {
+            const ColumnInfo *column = findColumn(value.first);
+            if (!column)
+            {
+                error = "Unknown column: " + value.first;
+                return false;
+            }
+            if (std::any_of(values.begin(), values.end(), [&](const auto &other) { return other.first == column; }))
+            {
+                error = "Duplicate column: " + value.first;
+                return false;
+            }
+            values.emplace_back(column, &value.second);
+        }
+        std::sort(values.begin(), values.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        if (change.kind == ChangeKind::Delete ? !values.empty() : values.empty())
+        {
+            error = change.kind == ChangeKind::Delete ? "A delete takes no values" : "No values to write";
+            return false;
+        }
+
+        if (change.kind == ChangeKind::Insert)
+        {
+            if (!change.key.empty() || change.version)
+            {
+                error = "An insert takes no key or version";
+                return false;
+            }
+        }
+        else
+        {
+            if (primaryKey.empty())
+            {
+                error = "The table has no primary key";
+                return false;
+            }
+            bool wholeKey = change.key.size() == primaryKey.size();
+            for (const ColumnInfo *column : primaryKey)
+            {
+                auto it = std::find_if(change.key.begin(), change.key.end(),
+                                       [&](const ColumnValue &value) { return value.first == column->name; });
+                wholeKey = wholeKey && it != change.key.end();
+            }
+            if (!wholeKey)
+            {
+                error = "The key must give the primary key columns: " + primaryKeyNames;
+                return false;
+            }
+            auto isNull = [](const ColumnValue &value) { return !value.second; };
+            if (std::any_of(change.key.begin(), change.key.end(), isNull))
+            {
+                error = "A primary key value cannot be NULL";
+                return false;
+            }
+            if (change.version && !versionColumn)
+            {
+                error = "The table has no rowversion column";
+                return false;
+            }
+        }
+
+        valueColumns.clear();
+        for (const auto &value : values)
+            valueColumns.push_back(value.first);
+        const ColumnInfo *version = change.version ? versionColumn : nullptr;
+
+        if (statements.empty() || statements.back().kind != change.kind || statements.back().values != valueColumns ||
+            statements.back().version != version)
+        {
+            EditStatement statement;
+            statement.kind = change.kind;
+            statement.values = valueColumns;
+            if (change.kind != ChangeKind::Insert)
+                statement.key = primaryKey;
+            statement.version = version;
+            statement.firstChange = i;
+            for (const ColumnInfo *column : statement.values)
+                statement.params.addColumn(column->name);
+            for (const ColumnInfo *column : statement.key)
+                statement.params.addColumn(column->name);
+            if (version)
+                statement.params.addColumn(version->name);
+            statements.push_back(std::move(statement));
+        }
+
+        ResultSet &params = statements.back().params;
+        auto append = [&](const KeyValue &value) {
+            if (value)
+                params.appendValue(*value);
+            else
+                params.appendNull();
+        };
+        for (const auto &value : values)
+            append(*value.second);
+        for (const ColumnInfo *column : statements.back().key)
+        {
+            append(std::find_if(change.key.begin(), change.key.end(), [&](const ColumnValue &value) {
+                       return value.first == column->name;
+                   })->second);
+        }
+        if (version)
+            append(change.version);
+    }
+
+    failedChange = -1;
+    return true;
+}
+
+std::string editStatementSql(const EditStatement &statement, const std::string &table,
+                             const std::function<std::string(const std::string &)> &quote)
+{
+    std::string sql;
+    if (statement.kind == ChangeKind::Insert)
+    {
+        std::string placeholders;
+        sql = "INSERT INTO " + table + " (";
+        for (size_t i = 0; i < statement.values.size(); i++)
+        {
+            sql += (i > 0 ? ", " : "") + quote(statement.values[i]->name);
+            placeholders += i > 0 ? ", ?" : "?";
+        }
+        return sql + ") VALUES (" + placeholders + ")";
+    }
+
+    if (statement.kind == ChangeKind::Update)
+    {
+        sql = "UPDATE " + table + " SET ";
+        for (size_t i = 0; i < statement.values.size(); i++)
+            sql += (i > 0 ? ", " : "") + quote(statement.values[i]->name) + " = ?";
+    }
+    else
+    {
+        sql = "DELETE FROM " + table;
+    }
+
+    for (size_t i = 0; i < statement.key.size(); i++)
+        sql += (i > 0 ? " AND " : " WHERE ") + quote(statement.key[i]->name) + " = ?";
+    if (statement.version)
+        sql += " AND " + quote(statement.version->name) + " = ?";
+    return sql;
+}
+
+bool decodeHex(std::string_view text, std::string &bytes)
+{
+    bytes.clear();
+    return appendHex(bytes, text);
+}
+
+std::string getConnectionStringValue(const std::string &connectionString, const std::string &key)
+{
+    std::istringstream ss(connectionString);
+    std::string pair;
+
+    while (std::getline(ss, pair, ';'))
+    {
+        auto eqPos = pair.find('=');
+        if (eqPos == std::string::npos)
+            continue;
+
+        std::string name = pair.substr(0, eqPos);
+
+        // Trim whitespace
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+
+        if (equalsIgnoreCase(name, key))
+            return pair.substr(eqPos + 1);
+    }
+
+    return std::string();
+}
+
+} // namespace Data
+} // namespace Tootega
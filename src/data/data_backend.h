@@ -0,0 +1,498 @@
+/**
+ * @file data_backend.h
+ * @brief Interface implemented by each database engine Browseroso can browse
+ */
+
+#pragma once
+
+#include "cancellation.h"
+#include "database.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class RowCursor
+ * @brief Forward-only read of a query's rows, batch by batch, on a connection of its own
+ *
+ * Rows are read as the caller asks for them, so memory stays at one batch
+ * however many rows the query returns. A cursor is used by one thread at a
+ * time and releases its connection once the rows are exhausted.
+ */
+class RowCursor
+{
+  public:
+    virtual ~RowCursor() = default;
+
+    /**
+     * @brief Replace the rows of @p batch with the next ones, at most @p maxRows
+     *
+     * The columns are added to @p batch by the first call.
+     * @return false if the read failed (see error()); the rows are exhausted when @p batch comes back empty
+     */
+    virtual bool fetch(ResultSet &batch, size_t maxRows) = 0;
+
+    /**
+     * @brief Fix the kinds of the columns before the first fetch, so that every batch comes with the same ones
+     *
+     * Formats that write their schema up front (Arrow) call it. Engines that
+     * type their columns have nothing to do; SQLite, which types each value,
+     * reads the rows once for the kind that holds all of them.
+     * @return false if the rows could not be read (see error())
+     */
+    virtual bool settleKinds()
+    {
+        return true;
+    }
+
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+  protected:
+    std::string m_error;
+};
+
+/**
+ * @class RowWriter
+ * @brief Inserts rows into a table, one transaction per batch, on a connection of its own
+ *
+ * Cells are the text a client uploaded; the engine converts them to the
+ * column types, except on binary columns, which take "0x" hex. A writer
+ * is used by one thread at a time and releases its connection when
+ * destroyed.
+ */
+class RowWriter
+{
+  public:
+    virtual ~RowWriter() = default;
+
+    /**
+     * @brief Insert every row of @p batch, its columns in the order the writer was opened with
+     *
+     * The batch is committed as a whole, or rolled back as a whole.
+     * @return false if it was rolled back (see error() and failedRow())
+     */
+    virtual bool write(const ResultSet &batch) = 0;
+
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+    /// Row of the last failed batch the engine rejected, -1 when it does not tell
+    long long failedRow() const
+    {
+        return m_failedRow;
+    }
+
+  protected:
+    std::string m_error;
+    long long m_failedRow = -1;
+};
+
+/**
+ * @brief What a ChangeSource found changed in its table since the previous poll
+ */
+struct ChangeBatch
+{
+    ResultSet rows;     ///< Rows inserted or updated, every column
+    ResultSet deleted;  ///< Primary key values of the rows deleted, where the method sees deletes
+    bool stale = false; ///< The table changed in a way the rows do not show: what clients display must be reread
+};
+
+/**
+ * @class ChangeSource
+ * @brief Finds the rows of a table that changed, poll after poll, from high-water marks
+ *
+ * The marks are set when the source is opened, and each poll reads up to
+ * where they stand at its start, so a change committed during a poll is
+ * left for the next. Like a cursor, a source does not use or hold the
+ * session's connection. It is used by one thread at a time.
+ */
+class ChangeSource
+{
+  public:
+    /// Rows a poll reads at most; past it the poll reports the table stale instead
+    static constexpr size_t kMaxRows = 1000;
+
+    virtual ~ChangeSource() = default;
+
+    /**
+     * @brief How changes are found: "changetracking", "rowversion", "key", "count" or "dataversion"
+     */
+    virtual const char *method() const = 0;
+
+    /**
+     * @brief Read what changed since the previous poll
+     * @return false with @p error set if the poll failed; the marks are kept, so the next poll retries
+     */
+    virtual bool poll(ChangeBatch &changes, CancellationToken &cancel, std::string &error) = 0;
+};
+
+/**
+ * @brief Consecutive changes of an edit that run as one statement over arrays of parameters
+ *
+ * Changes share a statement when they are of the same kind, write the same
+ * columns and all check the row version or all do not.
+ */
+struct EditStatement
+{
+    ChangeKind kind = ChangeKind::Update;
+    std::vector<const ColumnInfo *> values; ///< Columns written (insert, update), in table order
+    std::vector<const ColumnInfo *> key;    ///< Primary key columns matched (update, delete)
+    const ColumnInfo *version = nullptr;    ///< rowversion column matched, when the changes carry the version
+    size_t firstChange = 0;                 ///< Index in the edit of its first change
+    ResultSet params;                       ///< One row per change: the values, then the key, then the version
+};
+
+/**
+ * @class DataBackend
+ * @brief One session's connection to a database engine
+ *
+ * Everything engine specific (connection strings, catalog queries, identifier
+ * quoting, pagination syntax, row count estimates) lives behind this
+ * interface. DatabaseConnection serializes calls, so implementations do not
+ * need to be thread safe.
+ */
+class DataBackend
+{
+  public:
+    virtual ~DataBackend() = default;
+
+    /**
+     * @brief Create the backend a connection string asks for
+     *
+     * "Provider=SQLite;Data Source=<file>" selects the embedded SQLite backend
+     * (see configureSqliteBackend for the files it may open); anything else is
+     * an ADO.NET style SQL Server connection string.
+     * @return nullptr if the requested backend is not compiled in
+     */
+    static std::unique_ptr<DataBackend> create(const std::string &connectionString);
+
+    virtual bool connect(const std::string &connectionString) = 0;
+    virtual void disconnect() = 0;
+    virtual bool isConnected() const = 0;
+
+    /**
+     * @param etag Set to the entity tag of the result (empty if the result cannot be tagged)
+     */
+    virtual std::vector<std::string> getDatabases(std::string &etag) = 0;
+    virtual bool useDatabase(const std::string &databaseName) = 0;
+    virtual std::vector<TableInfo> getTables(std::string &etag) = 0;
+    virtual std::vector<ColumnInfo> getColumns(const std::string &schema, const std::string &tableName,
+                                               std::string &etag) = 0;
+
+    /**
+     * @param order Sort keys, pushed into ORDER BY with the primary key as tiebreaker; with a keyset
+     *              cursor the page is read from after it instead of at an OFFSET
+     * @param projection Columns selected instead of *; a preview cuts long text and binary values in SQL
+     * @param cancel Deadline and cancellation of the request; running queries are interrupted when it fires
+     */
+    virtual QueryResult selectData(const std::string &schema, const std::string &tableName, const RowFilter &filter,
+                                   const RowOrder &order, const RowProjection &projection, int page, int pageSize,
+                                   CountMode countMode, CancellationToken &cancel) = 0;
+
+    /**
+     * @brief Counts rows on a connection of its own, through the shared count cache
+     * @return false if no count is available
+     */
+    using RowCounter = std::function<bool(RowCount &count, CancellationToken &cancel)>;
+
+    /**
+     * @brief Prepare counting the rows of a table, or the rows matching @p filter
+     *
+     * Only the preparation uses the session; the counter does not, so
+     * DatabaseConnection runs it without holding the session while the
+     * count scans the table.
+     *
+     * @param exact Require an exact count instead of a catalog estimate
+     * @return nullptr if not connected or the table or filter column is invalid
+     */
+    virtual RowCounter prepareCount(const std::string &schema, const std::string &tableName, const RowFilter &filter,
+                                    bool exact) = 0;
+
+    /**
+     * @brief Prepare a count and run it at once (see prepareCount)
+     */
+    bool countRows(const std::string &schema, const std::string &tableName, const RowFilter &filter, bool exact,
+                   RowCount &count, CancellationToken &cancel);
+
+    /**
+     * @brief Read the rows of a table whose key is one of @p keys
+     *
+     * Resolves the rows a page's foreign keys reference. Keys are matched
+     * with IN (...) on a single column and (k1 = ? AND k2 = ?) OR ... on
+     * several, at most kMaxKeyParams values per query.
+     *
+     * @param keyColumns Columns the keys are made of
+     * @param keys Values of each key, one per key column
+     * @param projection Previews cut long values as in selectData; every column is read
+     */
+    virtual QueryResult selectByKeys(const std::string &schema, const std::string &tableName,
+                                     const std::vector<std::string> &keyColumns,
+                                     const std::vector<std::vector<std::string>> &keys,
+                                     const RowProjection &projection, CancellationToken &cancel) = 0;
+
+    /**
+     * @brief Start reading every row of a table, or every row matching @p filter
+     *
+     * The cursor does not use or hold the session's connection, so the
+     * session keeps browsing while the rows are consumed.
+     *
+     * @param range Only the rows of this key range (see splitKeyRange)
+     * @param sort Sort keys, with the primary key as tiebreaker; rows come in storage order without any
+     * @param columns Columns to read (all when empty); sort keys left out are read after them
+     * @param cancel Interrupts the cursor's reads when it fires; must outlive the cursor
+     * @return nullptr with @p error set if the query could not be started
+     */
+    virtual std::unique_ptr<RowCursor> openCursor(const std::string &schema, const std::string &tableName,
+                                                  const RowFilter &filter, const KeyRange &range,
+                                                  const std::vector<SortKey> &sort,
+                                                  const std::vector<std::string> &columns, CancellationToken &cancel,
+                                                  std::string &error) = 0;
+
+    /**
+     * @brief Split a table into ranges of its primary key holding about the same number of rows
+     *
+     * The bounds come from the statistics histogram of the key when the
+     * engine keeps one, and from NTILE over the key otherwise.
+     *
+     * @param parts Ranges wanted; fewer come back when the key has fewer distinct values
+     * @param keyColumn Set to the primary key column
+     * @param bounds Set to the ascending upper bounds of every range but the last
+     * @return false with @p error set if the table has no single-column primary key or the query failed
+     */
+    virtual bool splitKeyRange(const std::string &schema, const std::string &tableName, size_t parts,
+                               std::string &keyColumn, std::vector<std::string> &bounds, CancellationToken &cancel,
+                               std::string &error) = 0;
+
+    /**
+     * @brief Start inserting rows into a table
+     *
+     * Like a cursor, the writer does not use or hold the session's connection.
+     *
+     * @param columns Columns of the rows written, in order; the others take their defaults
+     * @param cancel Interrupts the writer's statements when it fires; must outlive the writer
+     * @return nullptr with @p error set if a column is not in the table or the insert could not be prepared
+     */
+    virtual std::unique_ptr<RowWriter> openWriter(const std::string &schema, const std::string &tableName,
+                                                  const std::vector<std::string> &columns, CancellationToken &cancel,
+                                                  std::string &error) = 0;
+
+    /**
+     * @brief Apply an edit's changes to a table as one transaction
+     *
+     * Changes are grouped by planEdit() and each group runs as one
+     * parameterized statement. An update or delete that matches no row (the
+     * row is gone, or its rowversion no longer is the one it was read with)
+     * is a conflict: the whole edit is rolled back, like on any other error.
+     *
+     * @return false with @p error set, and @p result telling where the edit stopped
+     */
+    virtual bool applyChanges(const std::string &schema, const std::string &tableName,
+                              const std::vector<RowChange> &changes, CancellationToken &cancel, EditResult &result,
+                              std::string &error) = 0;
+
+    /**
+     * @brief Start following a table's changes
+     *
+     * The method is the most precise the table allows: change tracking when
+     * it is enabled, a rowversion column, an ever-increasing integer key
+     * (new rows only), or just the row count.
+     *
+     * @return nullptr with @p error set if the table cannot be read
+     */
+    virtual std::unique_ptr<ChangeSource> openChangeSource(const std::string &schema, const std::string &tableName,
+                                                           CancellationToken &cancel, std::string &error) = 0;
+
+    /**
+     * @brief Copy of this backend's target and database that queries on connections of its own
+     *
+     * Like a prepared count, the copy does not use the session: DatabaseConnection
+     * takes it while holding the session and runs the query on it after letting
+     * go, so a long query does not hold up the session's other requests.
+     *
+     * @return nullptr if the query has to run on this backend (not connected, or no connection could be opened)
+     */
+    virtual std::unique_ptr<DataBackend> snapshot() const = 0;
+
+    virtual std::string getConnectionInfo() const = 0;
+
+    /**
+     * @brief Identifies the server, credentials and database this backend reads
+     *
+     * Shared caches key their entries with it, so sessions only share results
+     * when they would see the same rows. Empty when not connected.
+     */
+    virtual std::string getTargetKey() const = 0;
+};
+
+/**
+ * @brief Check that a name only contains [A-Za-z0-9_]
+ *
+ * Names are validated before being quoted into SQL by every backend.
+ */
+bool isValidIdentifier(const std::string &name);
+
+/**
+ * @brief Name of a filter mode as used in the API ("contains", "prefix", "exact", "fulltext", "auto")
+ */
+const char *filterModeName(FilterMode mode);
+
+/**
+ * @brief Parse a filter mode name
+ * @return false if @p name is not a mode
+ */
+bool parseFilterMode(const std::string &name, FilterMode &mode);
+
+/**
+ * @brief The mode a filter actually runs with on a column
+ *
+ * Auto picks an exact match for numbers on a non-text column, a prefix match
+ * on an indexed text column, full-text search on a full-text indexed column,
+ * and a contains match otherwise. FullText falls back to Contains on columns
+ * without a full-text index.
+ *
+ * @param column Metadata of the filtered column (nullptr if unknown)
+ */
+FilterMode resolveFilterMode(FilterMode requested, const ColumnInfo *column, const std::string &value);
+
+/**
+ * @brief The sort a query runs with: the requested keys, then the primary key columns not among them
+ *
+ * Keys are checked against the table's columns and flagged when an index
+ * leads with them. The primary key makes the order total, which keyset
+ * cursors rely on.
+ *
+ * @param unique Set when the order is total (the table has a primary key)
+ * @return false with @p error set if a key is not a column of the table or is repeated
+ */
+bool resolveSortOrder(const std::vector<SortKey> &requested, const std::vector<ColumnInfo> &columns,
+                      std::vector<SortKey> &order, bool &unique, std::string &error);
+
+/**
+ * @brief Columns a query selects: the requested ones (all when none), then the sort keys left out
+ *
+ * Sort keys are kept so the page's last row can position a keyset cursor.
+ *
+ * @param projected Set to pointers into @p columns
+ * @return false with @p error set if a column is not in the table or is repeated
+ */
+bool resolveProjection(const std::vector<std::string> &requested, const std::vector<ColumnInfo> &columns,
+                       const std::vector<SortKey> &order, std::vector<const ColumnInfo *> &projected,
+                       std::string &error);
+
+/**
+ * @brief Predicate selecting the rows after a keyset cursor
+ *
+ * (k1, k2, ...) > (v1, v2, ...) expanded as k1 > v1 OR (k1 = v1 AND k2 > v2)
+ * OR ..., where "after" is < for descending keys. Both engines sort NULLs
+ * first, so after a value a descending key also lets NULLs through, and
+ * after NULL an ascending key takes every value. A leading k1 >= v1 keeps
+ * the query seekable on an index of k1.
+ *
+ * @param quote Quotes a validated identifier for the engine
+ * @param params Set to the values bound to the placeholders, in order
+ */
+std::string keysetPredicate(const std::vector<SortKey> &order, const std::vector<KeyValue> &after,
+                            const std::function<std::string(const std::string &)> &quote,
+                            std::vector<std::string> &params);
+
+/// Values bound by one selectByKeys query; SQL Server takes at most 2100 parameters
+constexpr size_t kMaxKeyParams = 2000;
+
+/**
+ * @brief Predicate matching the rows whose key is one of @p keyCount keys
+ *
+ * k IN (?, ...) for a single column, (k1 = ? AND k2 = ?) OR ... otherwise,
+ * and 1 = 0 without keys; the values are bound key by key, in the order of
+ * @p keyColumns.
+ *
+ * @param quote Quotes a validated identifier for the engine
+ */
+std::string keyMatchPredicate(const std::vector<std::string> &keyColumns, size_t keyCount,
+                              const std::function<std::string(const std::string &)> &quote);
+
+/**
+ * @brief The primary key column of a table keyed by a single column
+ * @return nullptr when the table has no primary key or a composite one
+ */
+const ColumnInfo *singlePrimaryKey(const std::vector<ColumnInfo> &columns);
+
+/**
+ * @brief One in how many rows an NTILE split of @p rows into @p parts samples
+ *
+ * About a thousand keys per part place the bounds within a few percent of
+ * an even split, while the window function only sorts the sample.
+ */
+long long keySampleRate(long long rows, size_t parts);
+
+/**
+ * @brief Predicate selecting the rows of a key range; empty when the range selects every row
+ * @param quote Quotes a validated identifier for the engine
+ * @param params Set to the bounds bound to the placeholders, in order
+ */
+std::string keyRangePredicate(const KeyRange &range, const std::function<std::string(const std::string &)> &quote,
+                              std::vector<std::string> &params);
+
+/**
+ * @brief Sort key values of a page's last row, which a keyset cursor continues after
+ * @return false when the page has no rows or a value cannot be compared back
+ *         (binary, or long enough to have been truncated by the fetch)
+ */
+bool readLastKey(const ResultSet &data, const std::vector<SortKey> &order, std::vector<KeyValue> &values);
+
+/**
+ * @brief Columns an insert writes: every requested one, checked against the table's columns
+ * @param targets Set to pointers into @p columns
+ * @return false with @p error set if none is requested, or one is not in the table or is repeated
+ */
+bool resolveInsertColumns(const std::vector<std::string> &requested, const std::vector<ColumnInfo> &columns,
+                          std::vector<const ColumnInfo *> &targets, std::string &error);
+
+/**
+ * @brief Group an edit's changes into statements, checked against the table's columns
+ *
+ * Updates and deletes must give every primary key column, and nothing else,
+ * as their key.
+ *
+ * @param versionColumn The table's rowversion column, nullptr when it has none
+ * @param failedChange Set to the change in error
+ * @return false with @p error set if a change names a column not in the table, repeats one, misses part of the
+ *         primary key, or carries a version the table has no column for
+ */
+bool planEdit(const std::vector<RowChange> &changes, const std::vector<ColumnInfo> &columns,
+              const ColumnInfo *versionColumn, std::vector<EditStatement> &statements, long long &failedChange,
+              std::string &error);
+
+/**
+ * @brief SQL of an edit statement, with a placeholder per parameter in the order of EditStatement::params
+ * @param table The table, quoted for the engine
+ * @param quote Quotes a validated identifier for the engine
+ */
+std::string editStatementSql(const EditStatement &statement, const std::string &table,
+                             const std::function<std::string(const std::string &)> &quote);
+
+/**
+ * @brief Decode a binary value written as "0x" followed by hex digits
+ * @return false if @p text is not in that form
+ */
+bool decodeHex(std::string_view text, std::string &bytes);
+
+/**
+ * @brief Value of a key in a "Key=Value;Key=Value" connection string (keys compared case-insensitively)
+ */
+std::string getConnectionStringValue(const std::string &connectionString, const std::string &key);
+
+} // namespace Data
+} // namespace Tootega
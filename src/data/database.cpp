@@ -4,114 +4,18 @@
  */
 
 #include "database.h"
+#include "data_backend.h"
+#include "odbc_fetch.h"
+#include "odbc_utils.h"
 
 #include <algorithm>
-#include <sstream>
 #include <stdexcept>
 
-#ifdef PLATFORM_WINDOWS
-// Use ANSI ODBC functions
-#undef UNICODE
-#undef _UNICODE
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#endif
-
-#include <sql.h>
-#include <sqlext.h>
-
 namespace Tootega
 {
 namespace Data
 {
 
-/**
- * @brief Convert Windows-1252/Latin-1 string to UTF-8
- */
-static std::string latin1ToUtf8(const std::string &latin1)
-{
-#ifdef PLATFORM_WINDOWS
-    if (latin1.empty())
-        return latin1;
-
-    // First, convert Latin-1 (CP1252) to wide string
-    int wideLen = MultiByteToWideChar(1252, 0, latin1.c_str(), -1, NULL, 0);
-    if (wideLen == 0)
-        return latin1;
-
-    std::wstring wide(wideLen, 0);
-    MultiByteToWideChar(1252, 0, latin1.c_str(), -1, &wide[0], wideLen);
-
-    // Then convert wide string to UTF-8
-    int utf8Len = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, NULL, 0, NULL, NULL);
-    if (utf8Len == 0)
-        return latin1;
-
-    std::string utf8(utf8Len, 0);
-    WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, &utf8[0], utf8Len, NULL, NULL);
-
-    // Remove null terminator if present
-    if (!utf8.empty() && utf8.back() == '\0')
-        utf8.pop_back();
-
-    return utf8;
-#else
-    return latin1;
-#endif
-}
-
-/**
- * @brief ODBC handle wrapper for RAII
- */
-template <typename HandleType> class OdbcHandle
-{
-  public:
-    OdbcHandle() : m_handle(SQL_NULL_HANDLE)
-    {
-    }
-    ~OdbcHandle()
-    {
-        free();
-    }
-
-    HandleType get() const
-    {
-        return m_handle;
-    }
-    HandleType *ptr()
-    {
-        return &m_handle;
-    }
-
-    void free()
-    {
-        if (m_handle != SQL_NULL_HANDLE)
-        {
-            if constexpr (std::is_same_v<HandleType, SQLHENV>)
-            {
-                SQLFreeHandle(SQL_HANDLE_ENV, m_handle);
-            }
-            else if constexpr (std::is_same_v<HandleType, SQLHDBC>)
-            {
-                SQLFreeHandle(SQL_HANDLE_DBC, m_handle);
-            }
-            else if constexpr (std::is_same_v<HandleType, SQLHSTMT>)
-            {
-                SQLFreeHandle(SQL_HANDLE_STMT, m_handle);
-            }
-            m_handle = SQL_NULL_HANDLE;
-        }
-    }
-
-    operator bool() const
-    {
-        return m_handle != SQL_NULL_HANDLE;
-    }
-
-  private:
-    HandleType m_handle;
-};
-
 /**
  * @brief Database implementation
  */
@@ -159,7 +63,7 @@ class Database::Impl
         SQLSetConnectAttr(m_dbc.get(), SQL_LOGIN_TIMEOUT, (SQLPOINTER)10, 0);
 
         // Build ODBC connection string from ADO.NET style
-        std::string odbcConnStr = convertConnectionString(connectionString);
+        std::string odbcConnStr = toOdbcConnectionString(connectionString);
 
         // Connect
         SQLCHAR outConnStr[1024];
@@ -471,43 +375,7 @@ class Database::Impl
             return result;
         }
 
-        // Get column names
-        SQLSMALLINT numCols;
-        SQLNumResultCols(stmt.get(), &numCols);
-
-        for (SQLSMALLINT i = 1; i <= numCols; i++)
-        {
-            SQLCHAR colName[256];
-            SQLSMALLINT nameLen;
-            SQLDescribeCol(stmt.get(), i, colName, sizeof(colName), &nameLen, NULL, NULL, NULL, NULL);
-            result.columns.push_back(std::string((char *)colName));
-        }
-
-        // Fetch data
-        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
-        {
-            DataRow row;
-            for (SQLSMALLINT i = 1; i <= numCols; i++)
-            {
-                SQLCHAR value[4096];
-                SQLLEN valueLen;
-
-                ret = SQLGetData(stmt.get(), i, SQL_C_CHAR, value, sizeof(value), &valueLen);
-
-                std::string val;
-                if (valueLen == SQL_NULL_DATA)
-                {
-                    val = "NULL";
-                }
-                else if (SQL_SUCCEEDED(ret))
-                {
-                    val = latin1ToUtf8(std::string((char *)value));
-                }
-
-                row.push_back({result.columns[i - 1], val});
-            }
-            result.rows.push_back(row);
-        }
+        fetchResultSet(stmt.get(), result.data);
 
         result.success = true;
         return result;
@@ -532,93 +400,6 @@ class Database::Impl
     }
 
   private:
-    std::string convertConnectionString(const std::string &adoConnStr)
-    {
-        // Convert ADO.NET connection string to ODBC format
-        std::ostringstream odbc;
-        odbc << "DRIVER={ODBC Driver 17 for SQL Server};";
-
-        // Parse key-value pairs
-        std::istringstream ss(adoConnStr);
-        std::string pair;
-
-        while (std::getline(ss, pair, ';'))
-        {
-            if (pair.empty())
-                continue;
-
-            auto eqPos = pair.find('=');
-            if (eqPos == std::string::npos)
-                continue;
-
-            std::string key = pair.substr(0, eqPos);
-            std::string value = pair.substr(eqPos + 1);
-
-            // Trim whitespace
-            key.erase(0, key.find_first_not_of(" \t"));
-            key.erase(key.find_last_not_of(" \t") + 1);
-
-            if (key == "Data Source" || key == "Server")
-            {
-                odbc << "SERVER=" << value << ";";
-            }
-            else if (key == "Initial Catalog" || key == "Database")
-            {
-                odbc << "DATABASE=" << value << ";";
-            }
-            else if (key == "Integrated Security" && (value == "True" || value == "SSPI"))
-            {
-                odbc << "Trusted_Connection=yes;";
-            }
-            else if (key == "User ID" || key == "User Id")
-            {
-                odbc << "UID=" << value << ";";
-            }
-            else if (key == "Password")
-            {
-                odbc << "PWD=" << value << ";";
-            }
-            else if (key == "Encrypt" && value == "False")
-            {
-                odbc << "Encrypt=no;";
-            }
-            else if (key == "TrustServerCertificate" && value == "True")
-            {
-                odbc << "TrustServerCertificate=yes;";
-            }
-        }
-
-        return odbc.str();
-    }
-
-    std::string getOdbcError(SQLSMALLINT handleType, SQLHANDLE handle)
-    {
-        SQLCHAR sqlState[6], message[SQL_MAX_MESSAGE_LENGTH];
-        SQLINTEGER nativeError;
-        SQLSMALLINT messageLen;
-
-        SQLRETURN ret =
-            SQLGetDiagRec(handleType, handle, 1, sqlState, &nativeError, message, sizeof(message), &messageLen);
-
-        if (SQL_SUCCEEDED(ret))
-        {
-            return std::string((char *)sqlState) + ": " + std::string((char *)message);
-        }
-        return "Unknown ODBC error";
-    }
-
-    bool isValidIdentifier(const std::string &name)
-    {
-        if (name.empty())
-            return false;
-        for (char c : name)
-        {
-            if (!std::isalnum(c) && c != '_')
-                return false;
-        }
-        return true;
-    }
-
     OdbcHandle<SQLHENV> m_env;
     OdbcHandle<SQLHDBC> m_dbc;
     std::string m_connectionString;
@@ -5,10 +5,14 @@
 
 #pragma once
 
+#include "result_set.h"
+
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace Tootega
@@ -16,6 +20,17 @@ namespace Tootega
 namespace Data
 {
 
+/**
+ * @brief A foreign key a column is part of; the columns of a composite key share its name
+ */
+struct ColumnReference
+{
+    std::string foreignKey;       ///< Constraint name
+    std::string referencedSchema; ///< Empty on backends without schemas
+    std::string referencedTable;
+    std::string referencedColumn; ///< Column of the referenced table this one matches
+};
+
 /**
  * @brief Represents a database column metadata
  */
@@ -25,6 +40,9 @@ struct ColumnInfo
     std::string type;
     bool nullable;
     bool isPrimaryKey;
+    bool isIndexed = false;         ///< Leading key column of an index (seekable)
+    bool isFullTextIndexed = false; ///< Covered by a full-text index
+    std::vector<ColumnReference> references; ///< Foreign keys the column is part of, any number of them
 };
 
 /**
@@ -38,18 +56,175 @@ struct TableInfo
 };
 
 /**
- * @brief Represents a row of data
+ * @brief How selectData obtains the total row count
+ */
+enum class CountMode
+{
+    Auto,    ///< Catalog estimate when unfiltered, cached COUNT_BIG(*) when filtered
+    Exact,   ///< Always an exact (cached) COUNT_BIG(*)
+    Deferred ///< Count in the background; fetched later through countRows()
+};
+
+/**
+ * @brief How a filter value is matched against its column
  */
-using DataRow = std::vector<std::pair<std::string, std::string>>;
+enum class FilterMode
+{
+    Contains, ///< LIKE '%value%' (scans every row)
+    Prefix,   ///< Starts with the value; can seek an index on the column
+    Exact,    ///< Equal to the value; can seek an index on the column
+    FullText, ///< Full-text search (CONTAINS, FTS5 MATCH) on a full-text indexed column
+    Auto      ///< Cheapest of the above the column supports
+};
+
+/**
+ * @brief Filter of a table query
+ */
+struct RowFilter
+{
+    std::string column;
+    std::string value;
+    FilterMode mode = FilterMode::Contains;
+
+    /// Both a column and a value are needed to filter
+    bool isActive() const
+    {
+        return !column.empty() && !value.empty();
+    }
+};
+
+/**
+ * @brief Sort key of a table query
+ */
+struct SortKey
+{
+    std::string column;
+    bool descending = false;
+    bool indexed = false; ///< Set by the backend: the column leads an index, so rows can be read in order
+};
+
+/// A sort key value of a row, as text (nullopt for NULL)
+using KeyValue = std::optional<std::string>;
+
+/**
+ * @brief Order of a table query and where its page starts
+ */
+struct RowOrder
+{
+    std::vector<SortKey> keys;   ///< Empty for the engine's natural order
+    std::vector<KeyValue> after; ///< Keyset cursor: sort key values of the previous page's last row
+
+    bool isKeyset() const
+    {
+        return !after.empty();
+    }
+};
+
+/**
+ * @brief Slice of a table's rows by a key column: lower < key <= upper
+ *
+ * Rows with a NULL key belong to the slice without a lower bound, so a set
+ * of slices split at the same bounds covers every row exactly once.
+ */
+struct KeyRange
+{
+    std::string column; ///< Empty for every row
+    KeyValue lower;     ///< Exclusive; none to start at the first row
+    KeyValue upper;     ///< Inclusive; none to end at the last row
+
+    bool isActive() const
+    {
+        return !column.empty() && (lower || upper);
+    }
+};
+
+/**
+ * @brief Columns of a table query and how much of each value it reads
+ */
+struct RowProjection
+{
+    std::vector<std::string> columns; ///< Empty for every column
+    int previewLength = 0;            ///< Cut text and binary values to this many characters (0 reads them whole)
+    std::vector<std::string> whole;   ///< Columns a preview still reads whole: keys looked up afterwards
+};
+
+/**
+ * @brief A column a preview cut, and the result column holding each value's full length
+ */
+struct PreviewColumn
+{
+    size_t column = 0;
+    size_t lengthColumn = 0; ///< NULL where the value was read whole
+};
+
+/**
+ * @brief Represents a table row count
+ */
+struct RowCount
+{
+    long long value = 0;
+    bool approximate = false;
+};
+
+/**
+ * @brief Kind of a row change of an edit
+ */
+enum class ChangeKind
+{
+    Insert,
+    Update,
+    Delete
+};
+
+/// A column and the text written to or matched against it (nullopt for NULL)
+using ColumnValue = std::pair<std::string, KeyValue>;
+
+/**
+ * @brief One row change of an edit
+ *
+ * Values are the text the client sent; the engine converts them to the
+ * column types, except on binary columns, which take "0x" hex.
+ */
+struct RowChange
+{
+    ChangeKind kind = ChangeKind::Update;
+    std::vector<ColumnValue> key;    ///< Primary key of the row changed (update, delete)
+    std::vector<ColumnValue> values; ///< Columns written (insert, update)
+    KeyValue version;                ///< rowversion the row was read with, as "0x" hex; none skips the check
+};
+
+/**
+ * @brief What an edit did, or where it stopped
+ */
+struct EditResult
+{
+    size_t inserted = 0;
+    size_t updated = 0;
+    size_t deleted = 0;
+    size_t statements = 0;       ///< Statements executed, each over the changes of a group
+    long long failedChange = -1; ///< Change the edit stopped at, -1 when the engine does not tell
+    bool conflict = false;       ///< The row was not found as read: deleted, or changed since (rowversion)
+};
 
 /**
  * @brief Represents query results
  */
 struct QueryResult
 {
-    std::vector<std::string> columns;
-    std::vector<DataRow> rows;
-    int totalRows;
+    ResultSet data;
+    long long totalRows = 0;
+    bool totalRowsApproximate = false;
+    bool totalRowsPending = false;
+    FilterMode filterMode = FilterMode::Contains; ///< Mode that ran (Auto and unsupported modes resolved)
+    std::vector<SortKey> order;                   ///< Sort that ran: the requested keys, then the primary key
+    std::vector<KeyValue> lastKey;                ///< Sort key values of the last row; empty if no cursor can follow
+    std::vector<PreviewColumn> previews;          ///< Length columns come after every selected column of data
+
+    /// Columns of data selected from the table (the rest hold preview lengths)
+    size_t selectedColumns() const
+    {
+        return data.columnCount() - previews.size();
+    }
     std::string error;
     bool success;
 };
@@ -0,0 +1,98 @@
+/**
+ * @file db_executor.cpp
+ * @brief Dedicated thread pool for blocking database work implementation
+ */
+
+#include "db_executor.h"
+
+#include <atomic>
+
+namespace Tootega
+{
+namespace Data
+{
+
+static std::atomic<size_t> s_configuredThreads{DbExecutor::kDefaultThreads};
+
+DbExecutor &DbExecutor::getInstance()
+{
+    static DbExecutor instance(s_configuredThreads.load());
+    return instance;
+}
+
+void DbExecutor::configure(size_t threads)
+{
+    if (threads > 0)
+        s_configuredThreads = threads;
+}
+
+DbExecutor::DbExecutor(size_t threads)
+{
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++)
+    {
+        m_workers.emplace_back(&DbExecutor::workerLoop, this);
+    }
+}
+
+DbExecutor::~DbExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_available.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+void DbExecutor::post(std::function<void()> work)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(work));
+    }
+    m_available.notify_one();
+}
+
+void DbExecutor::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> work;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_available.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+            // Drain the queue before stopping so no future is left without a value
+            if (m_queue.empty())
+                return;
+
+            work = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy++;
+        }
+
+        work();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy--;
+    }
+}
+
+DbExecutor::Stats DbExecutor::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.threads = m_workers.size();
+    stats.busy = m_busy;
+    stats.queued = m_queue.size();
+    return stats;
+}
+
+} // namespace Data
+} // namespace Tootega
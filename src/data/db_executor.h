@@ -0,0 +1,96 @@
+/**
+ * @file db_executor.h
+ * @brief Dedicated thread pool for blocking database work
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class DbExecutor
+ * @brief Runs database calls off the HTTP worker threads
+ *
+ * ODBC and SQLite calls block the calling thread until the server answers.
+ * Running them here keeps slow queries from occupying HTTP workers, so
+ * /health, static files and other requests stay responsive; callers get a
+ * future and decide how long to wait for it.
+ */
+class DbExecutor
+{
+  public:
+    /// Worker threads when not configured
+    static constexpr size_t kDefaultThreads = 16;
+
+    /**
+     * @brief Snapshot of the executor's load
+     */
+    struct Stats
+    {
+        size_t threads = 0;
+        size_t busy = 0;   ///< Workers running a task
+        size_t queued = 0; ///< Tasks waiting for a worker
+    };
+
+    /**
+     * @brief Get the singleton instance (starts the workers on first use)
+     */
+    static DbExecutor &getInstance();
+
+    /**
+     * @brief Set the number of worker threads; only effective before the first getInstance()
+     */
+    static void configure(size_t threads);
+
+    /**
+     * @brief Queue work and get a future for its result
+     */
+    template <typename Work> auto submit(Work &&work) -> std::future<std::invoke_result_t<std::decay_t<Work>>>
+    {
+        using Result = std::invoke_result_t<std::decay_t<Work>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Work>(work));
+        auto future = task->get_future();
+        post([task]() { (*task)(); });
+        return future;
+    }
+
+    /**
+     * @brief Queue work without a result
+     */
+    void post(std::function<void()> work);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    DbExecutor(const DbExecutor &) = delete;
+    DbExecutor &operator=(const DbExecutor &) = delete;
+
+  private:
+    explicit DbExecutor(size_t threads);
+    ~DbExecutor();
+
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_queue;
+    size_t m_busy = 0;
+    bool m_stopping = false;
+    std::condition_variable m_available;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
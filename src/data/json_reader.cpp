@@ -0,0 +1,310 @@
+/**
+ * @file json_reader.cpp
+ * @brief Pull reader of JSON text, for request bodies and uploads implementation
+ */
+
+#include "json_reader.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace Tootega
+{
+namespace Data
+{
+
+static void appendUtf8(std::string &out, char32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+JsonReader::JsonReader(std::string_view text)
+{
+    reset(text);
+}
+
+void JsonReader::reset(std::string_view text)
+{
+    m_p = text.data();
+    m_end = text.data() + text.size();
+    m_first = false;
+    m_error.clear();
+}
+
+void JsonReader::skipSpace()
+{
+    while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n'))
+        m_p++;
+}
+
+bool JsonReader::peek(char c)
+{
+    skipSpace();
+    return m_p < m_end && *m_p == c;
+}
+
+bool JsonReader::fail(const std::string &message)
+{
+    if (m_error.empty())
+        m_error = message;
+    return false;
+}
+
+bool JsonReader::beginObject()
+{
+    if (failed() || !peek('{'))
+        return fail("Expected a JSON object");
+    m_p++;
+    m_first = true;
+    return true;
+}
+
+bool JsonReader::nextKey(std::string &key)
+{
+    if (failed())
+        return false;
+    if (peek('}'))
+    {
+        m_p++;
+        m_first = false;
+        return false;
+    }
+    if (!m_first)
+    {
+        if (!peek(','))
+            return fail("Expected ',' or '}'");
+        m_p++;
+    }
+    m_first = false;
+
+    if (!peek('"') || !readString(key))
+        return fail("Expected a key");
+    if (!peek(':'))
+        return fail("Expected ':' after key " + key);
+    m_p++;
+    return true;
+}
+
+bool JsonReader::beginArray()
+{
+    if (failed() || !peek('['))
+        return fail("Expected a JSON array");
+    m_p++;
+    m_first = true;
+    return true;
+}
+
+bool JsonReader::nextElement()
+{
+    if (failed())
+        return false;
+    if (peek(']'))
+    {
+        m_p++;
+        m_first = false;
+        return false;
+    }
+    if (!m_first)
+    {
+        if (!peek(','))
+            return fail("Expected ',' or ']'");
+        m_p++;
+    }
+    m_first = false;
+    return true;
+}
+
+bool JsonReader::readValue(std::string &value, bool &null)
+{
+    value.clear();
+    null = false;
+    skipSpace();
+    if (failed() || m_p == m_end)
+        return fail("Expected a value");
+
+    auto literal = [&](const char *word) {
+        size_t size = std::strlen(word);
+        if (static_cast<size_t>(m_end - m_p) < size || std::memcmp(m_p, word, size) != 0)
+            return fail("Invalid value");
+        m_p += size;
+        return true;
+    };
+
+    char c = *m_p;
+    if (c == '"')
+        return readString(value) || fail("Invalid string");
+    if (c == 'n')
+    {
+        null = true;
+        return literal("null");
+    }
+    if (c == 't')
+    {
+        value = "1";
+        return literal("true");
+    }
+    if (c == 'f')
+    {
+        value = "0";
+        return literal("false");
+    }
+    if (c == '{' || c == '[')
+        return readNested(value) || fail("Unterminated object or array");
+
+    const char *start = m_p;
+    while (m_p < m_end && (std::isdigit(static_cast<unsigned char>(*m_p)) || std::strchr("+-.eE", *m_p)))
+        m_p++;
+    value.assign(start, m_p);
+    return !value.empty() || fail("Invalid value");
+}
+
+bool JsonReader::atEnd()
+{
+    skipSpace();
+    return m_p == m_end;
+}
+
+// An object or array, kept as written
+bool JsonReader::readNested(std::string &value)
+{
+    const char *start = m_p;
+    int depth = 0;
+    bool inString = false;
+    for (; m_p < m_end; m_p++)
+    {
+        char c = *m_p;
+        if (inString)
+        {
+            if (c == '\\')
+                m_p++;
+            else if (c == '"')
+                inString = false;
+        }
+        else if (c == '"')
+        {
+            inString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            depth++;
+        }
+        else if ((c == '}' || c == ']') && --depth == 0)
+        {
+            m_p++;
+            value.assign(start, m_p);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JsonReader::readString(std::string &out)
+{
+    out.clear();
+    m_p++;
+    while (m_p < m_end)
+    {
+        const char *run = m_p;
+        while (m_p < m_end && *m_p != '"' && *m_p != '\\')
+            m_p++;
+        out.append(run, m_p);
+        if (m_p == m_end)
+            return false;
+        if (*m_p++ == '"')
+            return true;
+        if (m_p == m_end)
+            return false;
+
+        char escape = *m_p++;
+        switch (escape)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            out += escape;
+            break;
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'u': {
+            unsigned unit = 0;
+            if (!readHex4(unit))
+                return false;
+            char32_t codePoint = unit;
+            if (unit >= 0xD800 && unit <= 0xDBFF && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u')
+            {
+                const char *back = m_p;
+                unsigned low = 0;
+                m_p += 2;
+                if (readHex4(low) && low >= 0xDC00 && low <= 0xDFFF)
+                    codePoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                else
+                    m_p = back;
+            }
+            if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                codePoint = 0xFFFD;
+            appendUtf8(out, codePoint);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+bool JsonReader::readHex4(unsigned &unit)
+{
+    if (m_end - m_p < 4)
+        return false;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = *m_p++;
+        unit <<= 4;
+        if (c >= '0' && c <= '9')
+            unit |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            unit |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            unit |= c - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
+
+} // namespace Data
+} // namespace Tootega
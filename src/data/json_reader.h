@@ -0,0 +1,91 @@
+/**
+ * @file json_reader.h
+ * @brief Pull reader of JSON text, for request bodies and uploads
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class JsonReader
+ * @brief Walks JSON text one token at a time, without building a document
+ *
+ * Values are read as the text a cell stores: strings decoded, numbers kept
+ * as written, booleans as 1 and 0, and nested objects or arrays as their JSON
+ * text. Once a call fails, error() tells why and the reader stays failed.
+ */
+class JsonReader
+{
+  public:
+    explicit JsonReader(std::string_view text = std::string_view());
+
+    /// Start over on other text
+    void reset(std::string_view text);
+
+    /**
+     * @brief Enter the object that comes next
+     * @return false if the next value is not an object
+     */
+    bool beginObject();
+
+    /**
+     * @brief Read the next key of the object entered last
+     * @return false at the end of the object, or if the text is malformed (see failed())
+     */
+    bool nextKey(std::string &key);
+
+    /**
+     * @brief Enter the array that comes next
+     * @return false if the next value is not an array
+     */
+    bool beginArray();
+
+    /**
+     * @brief Move to the next element of the array entered last
+     * @return false at the end of the array, or if the text is malformed (see failed())
+     */
+    bool nextElement();
+
+    /**
+     * @brief Read the next value as cell text, or NULL
+     */
+    bool readValue(std::string &value, bool &null);
+
+    /**
+     * @brief Whether only whitespace is left
+     */
+    bool atEnd();
+
+    bool failed() const
+    {
+        return !m_error.empty();
+    }
+
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+  private:
+    void skipSpace();
+    bool peek(char c);
+    bool fail(const std::string &message);
+    bool readString(std::string &out);
+    bool readNested(std::string &value);
+    bool readHex4(unsigned &unit);
+
+    const char *m_p = nullptr;
+    const char *m_end = nullptr;
+    bool m_first = false; ///< No member or element of the container entered last was read yet
+    std::string m_error;
+};
+
+} // namespace Data
+} // namespace Tootega
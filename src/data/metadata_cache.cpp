@@ -0,0 +1,277 @@
+/**
+ * @file metadata_cache.cpp
+ * @brief Shared cache of schema metadata implementation
+ */
+
+#include "metadata_cache.h"
+#include "connection_pool.h"
+
+namespace Tootega
+{
+namespace Data
+{
+
+// The poller gives up on a busy target rather than waiting for a connection
+static constexpr int kPollLeaseWaitSeconds = 2;
+
+// Database list changes: databases created, dropped, renamed or brought online/offline
+static const char *kServerVersionSql =
+    "SELECT CONVERT(varchar(20), COUNT(*)) + ':' + "
+    "CONVERT(varchar(20), ISNULL(CHECKSUM_AGG(CHECKSUM(name, state)), 0)) FROM sys.databases";
+
+// Object changes: CREATE/DROP changes the count, ALTER bumps modify_date
+static const char *kDatabaseVersionSql =
+    "SELECT CONVERT(varchar(20), COUNT(*)) + ':' + "
+    "ISNULL(CONVERT(varchar(30), MAX(modify_date), 126), '') FROM sys.objects";
+
+MetadataCache &MetadataCache::getInstance()
+{
+    static MetadataCache instance;
+    return instance;
+}
+
+MetadataCache::MetadataCache()
+{
+    // The poller leases from the pool: construct it first so it is destroyed last
+    ConnectionPool::getInstance();
+
+    // Generations restart with the process; the epoch keeps old ETags from matching
+    m_epoch = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+
+    m_poller = std::thread(&MetadataCache::pollLoop, this);
+}
+
+MetadataCache::~MetadataCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    if (m_poller.joinable())
+        m_poller.join();
+}
+
+bool MetadataCache::readVersion(SQLHDBC dbc, bool serverScope, std::string &version)
+{
+    OdbcHandle<SQLHSTMT> stmt;
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, stmt.ptr());
+    if (!SQL_SUCCEEDED(ret))
+        return false;
+
+    ret = SQLExecDirect(stmt.get(), (SQLCHAR *)(serverScope ? kServerVersionSql : kDatabaseVersionSql), SQL_NTS);
+    if (!SQL_SUCCEEDED(ret) || SQLFetch(stmt.get()) != SQL_SUCCESS)
+        return false;
+
+    SQLCHAR value[128];
+    SQLLEN valueLen = 0;
+    ret = SQLGetData(stmt.get(), 1, SQL_C_CHAR, value, sizeof(value), &valueLen);
+    if (!SQL_SUCCEEDED(ret) || valueLen == SQL_NULL_DATA)
+        return false;
+
+    version = std::string((char *)value);
+    return true;
+}
+
+std::string MetadataCache::makeScopeKey(const std::string &connectionString, const std::string &database,
+                                        bool serverScope)
+{
+    // The full string, credentials included: logins that see different catalogs never share a scope.
+    // '\x1f' (unit separator) cannot appear in a validated database name
+    std::string key = connectionString;
+    if (!serverScope)
+    {
+        key += '\x1f';
+        key += database;
+    }
+    return key;
+}
+
+MetadataCache::Scope *MetadataCache::findScope(const std::string &key)
+{
+    auto it = m_scopes.find(key);
+    if (it == m_scopes.end())
+        return nullptr;
+
+    it->second.lastAccess = std::chrono::steady_clock::now();
+    return &it->second;
+}
+
+MetadataCache::Scope &MetadataCache::storeScope(const std::string &connectionString, const std::string &database,
+                                                bool serverScope, const std::string &version)
+{
+    std::string key = makeScopeKey(connectionString, database, serverScope);
+    auto it = m_scopes.find(key);
+    if (it == m_scopes.end())
+    {
+        Scope scope;
+        scope.connectionString = connectionString;
+        scope.database = database;
+        scope.serverScope = serverScope;
+        scope.version = version;
+        scope.generation = ++m_nextGeneration;
+        it = m_scopes.emplace(key, std::move(scope)).first;
+    }
+    else if (it->second.version != version)
+    {
+        // Data read under another version than the cached one: start over from it
+        resetScope(it->second, version);
+    }
+
+    it->second.lastAccess = std::chrono::steady_clock::now();
+    return it->second;
+}
+
+void MetadataCache::resetScope(Scope &scope, const std::string &version)
+{
+    scope.version = version;
+    scope.generation = ++m_nextGeneration;
+    scope.hasDatabases = false;
+    scope.databases.clear();
+    scope.hasTables = false;
+    scope.tables.clear();
+    scope.columns.clear();
+}
+
+std::string MetadataCache::makeETag(const Scope &scope) const
+{
+    return "\"" + m_epoch + "-" + std::to_string(scope.generation) + "\"";
+}
+
+bool MetadataCache::getDatabases(const std::string &connectionString, std::vector<std::string> &databases,
+                                 std::string &etag)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Scope *scope = findScope(makeScopeKey(connectionString, "", true));
+    if (!scope || !scope->hasDatabases)
+        return false;
+
+    databases = scope->databases;
+    etag = makeETag(*scope);
+    return true;
+}
+
+void MetadataCache::storeDatabases(const std::string &connectionString, const std::string &version,
+                                   const std::vector<std::string> &databases, std::string &etag)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Scope &scope = storeScope(connectionString, "", true, version);
+    scope.databases = databases;
+    scope.hasDatabases = true;
+    etag = makeETag(scope);
+}
+
+bool MetadataCache::getTables(const std::string &connectionString, const std::string &database,
+                              std::vector<TableInfo> &tables, std::string &etag)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Scope *scope = findScope(makeScopeKey(connectionString, database, false));
+    if (!scope || !scope->hasTables)
+        return false;
+
+    tables = scope->tables;
+    etag = makeETag(*scope);
+    return true;
+}
+
+void MetadataCache::storeTables(const std::string &connectionString, const std::string &database,
+                                const std::string &version, const std::vector<TableInfo> &tables, std::string &etag)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Scope &scope = storeScope(connectionString, database, false, version);
+    scope.tables = tables;
+    scope.hasTables = true;
+    etag = makeETag(scope);
+}
+
+bool MetadataCache::getColumns(const std::string &connectionString, const std::string &database,
+                               const std::string &schema, const std::string &tableName,
+                               std::vector<ColumnInfo> &columns, std::string &etag)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Scope *scope = findScope(makeScopeKey(connectionString, database, false));
+    if (!scope)
+        return false;
+
+    auto it = scope->columns.find(schema + "." + tableName);
+    if (it == scope->columns.end())
+        return false;
+
+    columns = it->second;
+    etag = makeETag(*scope);
+    return true;
+}
+
+void MetadataCache::storeColumns(const std::string &connectionString, const std::string &database,
+                                 const std::string &version, const std::string &schema, const std::string &tableName,
+                                 const std::vector<ColumnInfo> &columns, std::string &etag)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Scope &scope = storeScope(connectionString, database, false, version);
+    scope.columns[schema + "." + tableName] = columns;
+    etag = makeETag(scope);
+}
+
+void MetadataCache::pollLoop()
+{
+    struct PollTarget
+    {
+        std::string key;
+        std::string connectionString;
+        std::string database;
+        bool serverScope;
+    };
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping)
+    {
+        m_wake.wait_for(lock, std::chrono::seconds(kPollSeconds), [this]() { return m_stopping; });
+        if (m_stopping)
+            break;
+
+        // Drop idle scopes and snapshot the rest, then poll without holding the lock
+        auto now = std::chrono::steady_clock::now();
+        std::vector<PollTarget> targets;
+        for (auto it = m_scopes.begin(); it != m_scopes.end();)
+        {
+            auto idleSeconds = std::chrono::duration_cast<std::chrono::seconds>(now - it->second.lastAccess).count();
+            if (idleSeconds > kIdleSeconds)
+            {
+                it = m_scopes.erase(it);
+                continue;
+            }
+            targets.push_back({it->first, it->second.connectionString, it->second.database, it->second.serverScope});
+            ++it;
+        }
+
+        lock.unlock();
+
+        std::vector<std::pair<std::string, std::string>> versions;
+        for (const auto &target : targets)
+        {
+            std::string error;
+            ConnectionLease lease = ConnectionPool::getInstance().acquire(
+                target.connectionString, target.database, std::chrono::seconds(kPollLeaseWaitSeconds), error);
+            if (!lease)
+                continue;
+
+            std::string version;
+            if (readVersion(lease->handle(), target.serverScope, version))
+                versions.emplace_back(target.key, version);
+            else if (!lease->isAlive())
+                lease.markBroken();
+        }
+
+        lock.lock();
+
+        for (const auto &[key, version] : versions)
+        {
+            auto it = m_scopes.find(key);
+            if (it != m_scopes.end() && it->second.version != version)
+                resetScope(it->second, version);
+        }
+    }
+}
+
+} // namespace Data
+} // namespace Tootega
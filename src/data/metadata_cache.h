@@ -0,0 +1,117 @@
+/**
+ * @file metadata_cache.h
+ * @brief Shared cache of schema metadata (databases, tables, columns)
+ */
+
+#pragma once
+
+#include "database.h"
+#include "odbc_utils.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class MetadataCache
+ * @brief Caches catalog lookups per server and per database
+ *
+ * Each scope (a server for the database list, a database for its tables and
+ * columns) carries a version read from the catalog. A background thread polls
+ * the versions and drops a scope's entries when its version changes, so DDL
+ * made outside this process shows up within one poll interval.
+ *
+ * Every scope also has a generation, exposed as an ETag, that changes whenever
+ * its entries are invalidated.
+ */
+class MetadataCache
+{
+  public:
+    /// Interval between version polls
+    static constexpr int kPollSeconds = 15;
+
+    /// Scopes not read for this long are dropped and no longer polled
+    static constexpr int kIdleSeconds = 600;
+
+    /**
+     * @brief Get the singleton instance
+     */
+    static MetadataCache &getInstance();
+
+    /**
+     * @brief Read the version of a scope from the catalog
+     * @param serverScope true for the database list, false for the current database's objects
+     */
+    static bool readVersion(SQLHDBC dbc, bool serverScope, std::string &version);
+
+    bool getDatabases(const std::string &connectionString, std::vector<std::string> &databases, std::string &etag);
+    void storeDatabases(const std::string &connectionString, const std::string &version,
+                        const std::vector<std::string> &databases, std::string &etag);
+
+    bool getTables(const std::string &connectionString, const std::string &database, std::vector<TableInfo> &tables,
+                   std::string &etag);
+    void storeTables(const std::string &connectionString, const std::string &database, const std::string &version,
+                     const std::vector<TableInfo> &tables, std::string &etag);
+
+    bool getColumns(const std::string &connectionString, const std::string &database, const std::string &schema,
+                    const std::string &tableName, std::vector<ColumnInfo> &columns, std::string &etag);
+    void storeColumns(const std::string &connectionString, const std::string &database, const std::string &version,
+                      const std::string &schema, const std::string &tableName, const std::vector<ColumnInfo> &columns,
+                      std::string &etag);
+
+    // Delete copy constructor and assignment
+    MetadataCache(const MetadataCache &) = delete;
+    MetadataCache &operator=(const MetadataCache &) = delete;
+
+  private:
+    MetadataCache();
+    ~MetadataCache();
+
+    struct Scope
+    {
+        std::string connectionString;
+        std::string database;
+        bool serverScope = false;
+        std::string version;
+        uint64_t generation = 0;
+        std::chrono::steady_clock::time_point lastAccess;
+
+        bool hasDatabases = false;
+        std::vector<std::string> databases;
+        bool hasTables = false;
+        std::vector<TableInfo> tables;
+        std::unordered_map<std::string, std::vector<ColumnInfo>> columns;
+    };
+
+    static std::string makeScopeKey(const std::string &connectionString, const std::string &database,
+                                    bool serverScope);
+
+    Scope *findScope(const std::string &key);
+    Scope &storeScope(const std::string &connectionString, const std::string &database, bool serverScope,
+                      const std::string &version);
+    void resetScope(Scope &scope, const std::string &version);
+    std::string makeETag(const Scope &scope) const;
+
+    void pollLoop();
+
+    std::unordered_map<std::string, Scope> m_scopes;
+    uint64_t m_nextGeneration = 0;
+    std::string m_epoch;
+    bool m_stopping = false;
+    std::condition_variable m_wake;
+    std::mutex m_mutex;
+    std::thread m_poller;
+};
+
+} // namespace Data
+} // namespace Tootega
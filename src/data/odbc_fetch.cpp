@@ -0,0 +1,321 @@
+/**
+ * @file odbc_fetch.cpp
+ * @brief Typed fetching of ODBC result sets implementation
+ */
+
+#include "odbc_fetch.h"
+
+#include <charconv>
+#include <limits>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// Binary and text cells are read in chunks of this size; a longer cell takes more SQLGetData calls, never truncated
+static constexpr size_t kChunkBytes = 4096;
+static constexpr size_t kChunkChars = kChunkBytes / sizeof(char16_t);
+
+static_assert(sizeof(SQLWCHAR) == sizeof(char16_t), "SQL_C_WCHAR must be UTF-16");
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+/**
+ * @brief How one result column is read
+ */
+struct FetchColumn
+{
+    SQLSMALLINT cType;
+    ValueKind kind;
+};
+
+static FetchColumn mapSqlType(SQLSMALLINT sqlType)
+{
+    switch (sqlType)
+    {
+    case SQL_BIT:
+        return {SQL_C_BIT, ValueKind::Boolean};
+    case SQL_TINYINT:
+    case SQL_SMALLINT:
+    case SQL_INTEGER:
+    case SQL_BIGINT:
+        return {SQL_C_SBIGINT, ValueKind::Integer};
+    case SQL_REAL:
+        return {SQL_C_FLOAT, ValueKind::Float};
+    case SQL_FLOAT:
+    case SQL_DOUBLE:
+        return {SQL_C_DOUBLE, ValueKind::Float};
+    case SQL_DECIMAL:
+    case SQL_NUMERIC:
+        return {SQL_C_CHAR, ValueKind::Decimal};
+    case SQL_TYPE_DATE:
+        return {SQL_C_TYPE_DATE, ValueKind::Date};
+    case SQL_TYPE_TIMESTAMP:
+        return {SQL_C_TYPE_TIMESTAMP, ValueKind::DateTime};
+    case SQL_GUID:
+        return {SQL_C_GUID, ValueKind::Guid};
+    case SQL_BINARY:
+    case SQL_VARBINARY:
+    case SQL_LONGVARBINARY:
+        return {SQL_C_BINARY, ValueKind::Binary};
+    default:
+        // Text comes as UTF-16 so the driver converts from the column's code page
+        return {SQL_C_WCHAR, ValueKind::Text};
+    }
+}
+
+// Write an unsigned value as exactly `width` zero-padded digits
+static char *writePadded(char *out, unsigned value, int width)
+{
+    for (int i = width - 1; i >= 0; i--)
+    {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + width;
+}
+
+static char *writeDate(char *out, int year, unsigned month, unsigned day)
+{
+    out = writePadded(out, static_cast<unsigned>(year), 4);
+    *out++ = '-';
+    out = writePadded(out, month, 2);
+    *out++ = '-';
+    return writePadded(out, day, 2);
+}
+
+static char *writeHex(char *out, unsigned long long value, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--)
+    {
+        out[i] = kHexDigits[value & 0xF];
+        value >>= 4;
+    }
+    return out + digits;
+}
+
+/**
+ * @brief Read one cell with its column's C type and append it formatted
+ */
+static SQLRETURN appendCell(SQLHSTMT stmt, SQLUSMALLINT column, const FetchColumn &fetch, ResultSet &data)
+{
+    char text[64];
+    char *end = text;
+    SQLLEN indicator = 0;
+    SQLRETURN ret;
+
+    switch (fetch.kind)
+    {
+    case ValueKind::Boolean:
+    {
+        unsigned char value = 0;
+        ret = SQLGetData(stmt, column, SQL_C_BIT, &value, 0, &indicator);
+        if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+        {
+            data.appendValue(value ? "true" : "false");
+            return SQL_SUCCESS;
+        }
+        break;
+    }
+    case ValueKind::Integer:
+    {
+        SQLBIGINT value = 0;
+        ret = SQLGetData(stmt, column, SQL_C_SBIGINT, &value, 0, &indicator);
+        if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+            end = std::to_chars(text, text + sizeof(text), static_cast<long long>(value)).ptr;
+        break;
+    }
+    case ValueKind::Float:
+    {
+        if (fetch.cType == SQL_C_FLOAT)
+        {
+            // REAL formatted as float, or 0.1 would print as 0.10000000149011612
+            SQLREAL value = 0;
+            ret = SQLGetData(stmt, column, SQL_C_FLOAT, &value, 0, &indicator);
+            if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+                end = std::to_chars(text, text + sizeof(text), static_cast<float>(value)).ptr;
+        }
+        else
+        {
+            SQLDOUBLE value = 0;
+            ret = SQLGetData(stmt, column, SQL_C_DOUBLE, &value, 0, &indicator);
+            if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+                end = std::to_chars(text, text + sizeof(text), static_cast<double>(value)).ptr;
+        }
+        break;
+    }
+    case ValueKind::Date:
+    {
+        SQL_DATE_STRUCT value;
+        ret = SQLGetData(stmt, column, SQL_C_TYPE_DATE, &value, sizeof(value), &indicator);
+        if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+            end = writeDate(text, value.year, value.month, value.day);
+        break;
+    }
+    case ValueKind::DateTime:
+    {
+        SQL_TIMESTAMP_STRUCT value;
+        ret = SQLGetData(stmt, column, SQL_C_TYPE_TIMESTAMP, &value, sizeof(value), &indicator);
+        if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+        {
+            end = writeDate(text, value.year, value.month, value.day);
+            *end++ = ' ';
+            end = writePadded(end, value.hour, 2);
+            *end++ = ':';
+            end = writePadded(end, value.minute, 2);
+            *end++ = ':';
+            end = writePadded(end, value.second, 2);
+            if (value.fraction > 0)
+            {
+                // fraction is in nanoseconds; drop trailing zeros
+                *end++ = '.';
+                end = writePadded(end, value.fraction, 9);
+                while (end[-1] == '0')
+                    end--;
+            }
+        }
+        break;
+    }
+    case ValueKind::Guid:
+    {
+        SQLGUID value;
+        ret = SQLGetData(stmt, column, SQL_C_GUID, &value, sizeof(value), &indicator);
+        if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+        {
+            end = writeHex(text, value.Data1, 8);
+            *end++ = '-';
+            end = writeHex(end, value.Data2, 4);
+            *end++ = '-';
+            end = writeHex(end, value.Data3, 4);
+            *end++ = '-';
+            for (int i = 0; i < 8; i++)
+            {
+                if (i == 2)
+                    *end++ = '-';
+                end = writeHex(end, value.Data4[i], 2);
+            }
+        }
+        break;
+    }
+    case ValueKind::Binary:
+    {
+        // Each call returns the next part of the value; the indicator counts what was left before it
+        unsigned char value[kChunkBytes];
+        ret = SQLGetData(stmt, column, SQL_C_BINARY, value, sizeof(value), &indicator);
+        if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA)
+            break;
+        std::string hex = "0x";
+        while (true)
+        {
+            bool more = indicator == SQL_NO_TOTAL || indicator > SQLLEN(sizeof(value));
+            size_t length = more ? sizeof(value) : static_cast<size_t>(indicator);
+            size_t start = hex.size();
+            hex.resize(start + length * 2);
+            for (size_t i = 0; i < length; i++)
+            {
+                hex[start + i * 2] = kHexDigits[value[i] >> 4];
+                hex[start + i * 2 + 1] = kHexDigits[value[i] & 0xF];
+            }
+            if (!more)
+                break;
+            ret = SQLGetData(stmt, column, SQL_C_BINARY, value, sizeof(value), &indicator);
+            if (!SQL_SUCCEEDED(ret))
+                return ret;
+        }
+        data.appendValue(hex);
+        return SQL_SUCCESS;
+    }
+    case ValueKind::Decimal:
+    {
+        SQLCHAR value[64];
+        ret = SQLGetData(stmt, column, SQL_C_CHAR, value, sizeof(value), &indicator);
+        if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+        {
+            data.appendValue((char *)value);
+            return SQL_SUCCESS;
+        }
+        break;
+    }
+    case ValueKind::Text:
+    {
+        // indicator is in bytes and excludes the terminator the driver writes at the end of every part
+        char16_t value[kChunkChars];
+        ret = SQLGetData(stmt, column, SQL_C_WCHAR, value, sizeof(value), &indicator);
+        if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA)
+            break;
+        bool more = indicator == SQL_NO_TOTAL || indicator >= SQLLEN(sizeof(value));
+        if (!more)
+        {
+            data.appendUtf16(std::u16string_view(value, static_cast<size_t>(indicator) / sizeof(char16_t)));
+            return SQL_SUCCESS;
+        }
+
+        // A longer value is gathered whole before it is transcoded, so no surrogate pair is split between parts
+        std::u16string units(value, kChunkChars - 1);
+        while (more)
+        {
+            ret = SQLGetData(stmt, column, SQL_C_WCHAR, value, sizeof(value), &indicator);
+            if (!SQL_SUCCEEDED(ret))
+                return ret;
+            more = indicator == SQL_NO_TOTAL || indicator >= SQLLEN(sizeof(value));
+            units.append(value, more ? kChunkChars - 1 : static_cast<size_t>(indicator) / sizeof(char16_t));
+        }
+        data.appendUtf16(units);
+        return SQL_SUCCESS;
+    }
+    }
+
+    if (indicator == SQL_NULL_DATA)
+        data.appendNull();
+    else
+        data.appendValue(std::string_view(text, static_cast<size_t>(end - text)));
+    return SQL_SUCCESS;
+}
+
+SQLRETURN fetchResultSet(SQLHSTMT stmt, ResultSet &data)
+{
+    return fetchRows(stmt, data, std::numeric_limits<size_t>::max());
+}
+
+SQLRETURN fetchRows(SQLHSTMT stmt, ResultSet &data, size_t maxRows)
+{
+    SQLSMALLINT numCols = 0;
+    SQLNumResultCols(stmt, &numCols);
+
+    bool describe = data.columnCount() == 0;
+    std::vector<FetchColumn> columns;
+    columns.reserve(numCols);
+
+    for (SQLSMALLINT i = 1; i <= numCols; i++)
+    {
+        SQLCHAR colName[256];
+        SQLSMALLINT nameLen;
+        SQLSMALLINT dataType = SQL_UNKNOWN_TYPE;
+        SQLDescribeCol(stmt, i, colName, sizeof(colName), &nameLen, &dataType, NULL, NULL, NULL);
+
+        columns.push_back(mapSqlType(dataType));
+        if (describe)
+            data.addColumn(std::string((char *)colName), columns.back().kind);
+    }
+
+    for (size_t row = 0; row < maxRows; row++)
+    {
+        // SQL_SUCCESS_WITH_INFO still delivered a row
+        SQLRETURN ret = SQLFetch(stmt);
+        if (!SQL_SUCCEEDED(ret))
+            return ret;
+
+        for (SQLSMALLINT i = 1; i <= numCols; i++)
+        {
+            SQLRETURN cell = appendCell(stmt, i, columns[i - 1], data);
+            if (!SQL_SUCCEEDED(cell))
+                return cell;
+        }
+    }
+    return SQL_SUCCESS;
+}
+
+} // namespace Data
+} // namespace Tootega
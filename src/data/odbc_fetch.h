@@ -0,0 +1,43 @@
+/**
+ * @file odbc_fetch.h
+ * @brief Typed fetching of ODBC result sets into a ResultSet
+ */
+
+#pragma once
+
+#include "odbc_utils.h"
+#include "result_set.h"
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Describe the columns of an executed statement and fetch all its rows
+ *
+ * Each column is read with the C type matching its SQL type (SQL_C_SBIGINT,
+ * SQL_C_DOUBLE, SQL_C_TYPE_TIMESTAMP, SQL_C_GUID, SQL_C_BINARY, ...) and
+ * formatted here rather than by the driver. Types without a native mapping
+ * (decimal, time, xml, sql_variant, ...) are read as text. Long text and
+ * binary values are read whole, in as many SQLGetData calls as they take.
+ *
+ * @return SQL_NO_DATA once every row was read, or the return code of the
+ *         SQLFetch or SQLGetData that failed; @p data then ends with a
+ *         partial row and is to be dropped
+ */
+SQLRETURN fetchResultSet(SQLHSTMT stmt, ResultSet &data);
+
+/**
+ * @brief Fetch at most @p maxRows more rows of an executed statement
+ *
+ * Columns are added to @p data on the first call, when it has none, so
+ * consecutive batches can be read into one cleared ResultSet.
+ *
+ * @return SQL_SUCCESS if rows may follow, SQL_NO_DATA once the result is
+ *         exhausted, or the failed SQLFetch's or SQLGetData's return code
+ */
+SQLRETURN fetchRows(SQLHSTMT stmt, ResultSet &data, size_t maxRows);
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,89 @@
+/**
+ * @file odbc_utils.cpp
+ * @brief Shared ODBC helpers implementation
+ */
+
+#include "odbc_utils.h"
+
+#include <sstream>
+
+namespace Tootega
+{
+namespace Data
+{
+
+std::string toOdbcConnectionString(const std::string &adoConnStr)
+{
+    std::ostringstream odbc;
+    odbc << "DRIVER={ODBC Driver 17 for SQL Server};";
+
+    // Parse key-value pairs
+    std::istringstream ss(adoConnStr);
+    std::string pair;
+
+    while (std::getline(ss, pair, ';'))
+    {
+        if (pair.empty())
+            continue;
+
+        auto eqPos = pair.find('=');
+        if (eqPos == std::string::npos)
+            continue;
+
+        std::string key = pair.substr(0, eqPos);
+        std::string value = pair.substr(eqPos + 1);
+
+        // Trim whitespace
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t") + 1);
+
+        if (key == "Data Source" || key == "Server")
+        {
+            odbc << "SERVER=" << value << ";";
+        }
+        else if (key == "Initial Catalog" || key == "Database")
+        {
+            odbc << "DATABASE=" << value << ";";
+        }
+        else if (key == "Integrated Security" && (value == "True" || value == "SSPI"))
+        {
+            odbc << "Trusted_Connection=yes;";
+        }
+        else if (key == "User ID" || key == "User Id")
+        {
+            odbc << "UID=" << value << ";";
+        }
+        else if (key == "Password")
+        {
+            odbc << "PWD=" << value << ";";
+        }
+        else if (key == "Encrypt" && value == "False")
+        {
+            odbc << "Encrypt=no;";
+        }
+        else if (key == "TrustServerCertificate" && value == "True")
+        {
+            odbc << "TrustServerCertificate=yes;";
+        }
+    }
+
+    return odbc.str();
+}
+
+std::string getOdbcError(SQLSMALLINT handleType, SQLHANDLE handle)
+{
+    SQLCHAR sqlState[6], message[SQL_MAX_MESSAGE_LENGTH];
+    SQLINTEGER nativeError;
+    SQLSMALLINT messageLen;
+
+    SQLRETURN ret = SQLGetDiagRec(handleType, handle, 1, sqlState, &nativeError, message, sizeof(message), &messageLen);
+
+    if (SQL_SUCCEEDED(ret))
+    {
+        return std::string((char *)sqlState) + ": " + std::string((char *)message);
+    }
+    return "Unknown ODBC error";
+}
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,93 @@
+/**
+ * @file odbc_utils.h
+ * @brief Shared ODBC helpers for the data layer
+ */
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+#ifdef PLATFORM_WINDOWS
+// Use ANSI ODBC functions
+#undef UNICODE
+#undef _UNICODE
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include <sql.h>
+#include <sqlext.h>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief ODBC handle wrapper for RAII
+ */
+template <typename HandleType> class OdbcHandle
+{
+  public:
+    OdbcHandle() : m_handle(SQL_NULL_HANDLE)
+    {
+    }
+    ~OdbcHandle()
+    {
+        free();
+    }
+
+    OdbcHandle(const OdbcHandle &) = delete;
+    OdbcHandle &operator=(const OdbcHandle &) = delete;
+
+    HandleType get() const
+    {
+        return m_handle;
+    }
+    HandleType *ptr()
+    {
+        return &m_handle;
+    }
+
+    void free()
+    {
+        if (m_handle != SQL_NULL_HANDLE)
+        {
+            if constexpr (std::is_same_v<HandleType, SQLHENV>)
+            {
+                SQLFreeHandle(SQL_HANDLE_ENV, m_handle);
+            }
+            else if constexpr (std::is_same_v<HandleType, SQLHDBC>)
+            {
+                SQLFreeHandle(SQL_HANDLE_DBC, m_handle);
+            }
+            else if constexpr (std::is_same_v<HandleType, SQLHSTMT>)
+            {
+                SQLFreeHandle(SQL_HANDLE_STMT, m_handle);
+            }
+            m_handle = SQL_NULL_HANDLE;
+        }
+    }
+
+    operator bool() const
+    {
+        return m_handle != SQL_NULL_HANDLE;
+    }
+
+  private:
+    HandleType m_handle;
+};
+
+/**
+ * @brief Convert an ADO.NET style connection string to ODBC format
+ */
+std::string toOdbcConnectionString(const std::string &adoConnStr);
+
+/**
+ * @brief First diagnostic record of a handle as "SQLSTATE: message"
+ */
+std::string getOdbcError(SQLSMALLINT handleType, SQLHANDLE handle);
+
+} // namespace Data
+} // namespace Tootega
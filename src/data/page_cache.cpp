@@ -0,0 +1,243 @@
+/**
+ * @file page_cache.cpp
+ * @brief Shared cache of serialized table data pages implementation
+ */
+
+#include "page_cache.h"
+
+#include <atomic>
+#include <iterator>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// A single page larger than this share of the budget is not cached
+static constexpr size_t kMaxPageShare = 8;
+
+// How often a request waiting on another request's fill checks its own deadline
+static constexpr auto kFillPollInterval = std::chrono::milliseconds(100);
+
+static std::atomic<size_t> s_configuredBudgetBytes{PageCache::kDefaultBudgetBytes};
+static std::atomic<int> s_configuredTtlSeconds{PageCache::kDefaultTtlSeconds};
+
+PageCache &PageCache::getInstance()
+{
+    static PageCache instance(s_configuredBudgetBytes.load(), s_configuredTtlSeconds.load());
+    return instance;
+}
+
+void PageCache::configure(size_t budgetBytes, int ttlSeconds)
+{
+    s_configuredBudgetBytes = budgetBytes;
+    if (ttlSeconds > 0)
+        s_configuredTtlSeconds = ttlSeconds;
+}
+
+PageCache::PageCache(size_t budgetBytes, int ttlSeconds) : m_budgetBytes(budgetBytes), m_ttl(ttlSeconds)
+{
+}
+
+std::string PageCache::makeTableKey(const std::string &target, const std::string &schema, const std::string &table)
+{
+    // '\x1f' (unit separator) cannot appear in validated identifiers
+    std::string key;
+    key.reserve(target.size() + schema.size() + table.size() + 2);
+    key += target;
+    key += '\x1f';
+    key += schema;
+    key += '\x1f';
+    key += table;
+    return key;
+}
+
+std::string PageCache::makeKey(const std::string &tableKey, std::initializer_list<std::string_view> parts)
+{
+    // Parameters are free text (filter values), so each one is length-prefixed
+    std::string key = tableKey;
+    for (std::string_view part : parts)
+    {
+        key += '\x1f';
+        key += std::to_string(part.size());
+        key += ':';
+        key += part;
+    }
+    return key;
+}
+
+bool PageCache::isEnabled() const
+{
+    return m_budgetBytes > 0;
+}
+
+PageCache::Page PageCache::lookup(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return nullptr;
+
+    if (std::chrono::steady_clock::now() >= it->second.expires)
+    {
+        erase(it);
+        return nullptr;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lruPosition);
+    m_hits++;
+    return it->second.page;
+}
+
+bool PageCache::contains(const std::string &key) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    return it != m_entries.end() && std::chrono::steady_clock::now() < it->second.expires;
+}
+
+PageCache::Page PageCache::getOrFill(const std::string &tableKey, const std::string &key, const Filler &fill,
+                                     CancellationToken &cancel)
+{
+    if (!isEnabled())
+        return fill();
+
+    if (Page page = lookup(key))
+        return page;
+
+    std::promise<Page> promise;
+    uint64_t generation;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto flight = m_inFlight.find(key);
+        if (flight != m_inFlight.end())
+        {
+            std::shared_future<Page> pending = flight->second;
+            lock.unlock();
+
+            while (pending.wait_for(cancel.remaining(kFillPollInterval)) != std::future_status::ready)
+            {
+                if (cancel.isCancelled())
+                    return nullptr;
+            }
+
+            if (Page page = pending.get())
+            {
+                std::lock_guard<std::mutex> statsLock(m_mutex);
+                m_sharedFills++;
+                return page;
+            }
+
+            // The other fill failed or was cancelled; this request may still succeed
+            return fill();
+        }
+
+        m_misses++;
+        generation = m_generation;
+        m_inFlight.emplace(key, promise.get_future().share());
+    }
+
+    Page page;
+    try
+    {
+        page = fill();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight.erase(key);
+        promise.set_value(nullptr);
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight.erase(key);
+        if (page)
+            store(tableKey, key, page, generation);
+        if (m_inFlight.empty())
+            m_invalidatedAt.clear();
+    }
+    promise.set_value(page);
+    return page;
+}
+
+void PageCache::store(const std::string &tableKey, const std::string &key, const Page &page, uint64_t generation)
+{
+    auto invalidated = m_invalidatedAt.find(tableKey);
+    if (invalidated != m_invalidatedAt.end() && invalidated->second > generation)
+        return;
+
+    size_t bytes = page->size() + key.size() + tableKey.size();
+    if (bytes > m_budgetBytes / kMaxPageShare)
+        return;
+
+    auto existing = m_entries.find(key);
+    if (existing != m_entries.end())
+        erase(existing);
+
+    while (m_bytes + bytes > m_budgetBytes && !m_lru.empty())
+    {
+        erase(m_entries.find(m_lru.back()));
+        m_evictions++;
+    }
+
+    m_lru.push_front(key);
+    Entry &entry = m_entries[key];
+    entry.page = page;
+    entry.tableKey = tableKey;
+    entry.expires = std::chrono::steady_clock::now() + m_ttl;
+    entry.lruPosition = m_lru.begin();
+    entry.bytes = bytes;
+    m_bytes += bytes;
+}
+
+void PageCache::erase(std::unordered_map<std::string, Entry>::iterator it)
+{
+    m_bytes -= it->second.bytes;
+    m_lru.erase(it->second.lruPosition);
+    m_entries.erase(it);
+}
+
+size_t PageCache::invalidateTable(const std::string &tableKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t dropped = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        auto next = std::next(it);
+        if (it->second.tableKey == tableKey)
+        {
+            erase(it);
+            dropped++;
+        }
+        it = next;
+    }
+
+    // Fills in flight read the table before this point
+    if (!m_inFlight.empty())
+        m_invalidatedAt[tableKey] = ++m_generation;
+
+    m_invalidations++;
+    return dropped;
+}
+
+PageCache::Stats PageCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+    stats.entries = m_entries.size();
+    stats.bytes = m_bytes;
+    stats.budgetBytes = m_budgetBytes;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.sharedFills = m_sharedFills;
+    stats.evictions = m_evictions;
+    stats.invalidations = m_invalidations;
+    return stats;
+}
+
+} // namespace Data
+} // namespace Tootega
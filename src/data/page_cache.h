@@ -0,0 +1,157 @@
+/**
+ * @file page_cache.h
+ * @brief Shared cache of serialized table data pages
+ */
+
+#pragma once
+
+#include "cancellation.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class PageCache
+ * @brief LRU cache of /api/browseroso/data response bodies under a byte budget
+ *
+ * Pages are keyed by connection target (connection string, credentials
+ * included, and database), table and every request parameter that shapes
+ * the response, so sessions with different permissions never share pages.
+ * Concurrent misses on the same key are filled once: the first caller runs
+ * the query and the others wait for its page.
+ */
+class PageCache
+{
+  public:
+    /// Default byte budget (response bodies and keys)
+    static constexpr size_t kDefaultBudgetBytes = 64 * 1024 * 1024;
+
+    /// Default lifetime of a cached page
+    static constexpr int kDefaultTtlSeconds = 30;
+
+    using Page = std::shared_ptr<const std::string>;
+
+    /// Produces a page; returns nullptr when the result must not be cached (errors, cancellation)
+    using Filler = std::function<Page()>;
+
+    struct Stats
+    {
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budgetBytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t sharedFills = 0; ///< Misses answered by another request's fill
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+    };
+
+    static PageCache &getInstance();
+
+    /**
+     * @brief Set the byte budget and TTL (0 budget disables the cache)
+     */
+    static void configure(size_t budgetBytes, int ttlSeconds);
+
+    /**
+     * @brief Key of a table, used for invalidation
+     * @param target Connection target (see DatabaseConnection::getTargetKey)
+     */
+    static std::string makeTableKey(const std::string &target, const std::string &schema, const std::string &table);
+
+    /**
+     * @brief Key of a page: the table key plus the request parameters, in a fixed order
+     */
+    static std::string makeKey(const std::string &tableKey, std::initializer_list<std::string_view> parts);
+
+    bool isEnabled() const;
+
+    /**
+     * @brief Cached page, or nullptr on a miss
+     */
+    Page lookup(const std::string &key);
+
+    /**
+     * @brief True if @p key is cached and fresh; unlike lookup() this counts no hit
+     */
+    bool contains(const std::string &key) const;
+
+    /**
+     * @brief Cached page, else the page of a fill already in flight, else @p fill's page
+     *
+     * A miss runs @p fill on the calling thread and caches its page. When
+     * another request is filling the same key this waits for it, until
+     * @p cancel fires; if that fill produced nothing cacheable, @p fill runs
+     * here instead.
+     *
+     * @return nullptr when @p fill returned nullptr or @p cancel fired while waiting
+     */
+    Page getOrFill(const std::string &tableKey, const std::string &key, const Filler &fill,
+                   CancellationToken &cancel);
+
+    /**
+     * @brief Drop every page of a table, including fills in flight
+     * @return Number of pages dropped
+     */
+    size_t invalidateTable(const std::string &tableKey);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    PageCache(const PageCache &) = delete;
+    PageCache &operator=(const PageCache &) = delete;
+
+  private:
+    PageCache(size_t budgetBytes, int ttlSeconds);
+
+    struct Entry
+    {
+        Page page;
+        std::string tableKey;
+        std::chrono::steady_clock::time_point expires;
+        std::list<std::string>::iterator lruPosition;
+        size_t bytes = 0;
+    };
+
+    // Both expect m_mutex to be held
+    void store(const std::string &tableKey, const std::string &key, const Page &page, uint64_t generation);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+    const size_t m_budgetBytes;
+    const std::chrono::seconds m_ttl;
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::list<std::string> m_lru; // most recently used first
+    size_t m_bytes = 0;
+
+    std::unordered_map<std::string, std::shared_future<Page>> m_inFlight;
+
+    // Fills started before a table's last invalidation are not stored
+    uint64_t m_generation = 0;
+    std::unordered_map<std::string, uint64_t> m_invalidatedAt;
+
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_sharedFills = 0;
+    uint64_t m_evictions = 0;
+    uint64_t m_invalidations = 0;
+
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,318 @@
+/**
+ * @file page_prefetcher.cpp
+ * @brief Speculative loading of the table pages a session is likely to read next implementation
+ */
+
+#include "page_prefetcher.h"
+#include "connection_pool.h"
+#include "db_executor.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// Deadline of a prefetch query; it only ever saves the user a wait, so it gives up early
+static constexpr auto kPrefetchTimeout = std::chrono::seconds(15);
+
+// A buffered page not requested within this time is dropped
+static constexpr auto kBufferTtl = std::chrono::seconds(30);
+
+// How often sessions that stopped paging are forgotten
+static constexpr auto kPurgeInterval = std::chrono::seconds(60);
+
+// How often a request waiting on a prefetch checks its own deadline
+static constexpr auto kWaitPollInterval = std::chrono::milliseconds(100);
+
+static std::atomic<size_t> s_configuredPagesAhead{PagePrefetcher::kDefaultPagesAhead};
+
+// Speculative work only runs on spare capacity: more than half the database
+// threads idle, nothing queued, and an idle pooled connection whenever any
+// connection is leased
+static bool poolsUnderPressure()
+{
+    auto executor = DbExecutor::getInstance().getStats();
+    if (executor.queued > 0 || executor.busy * 2 >= executor.threads)
+        return true;
+
+    auto pool = ConnectionPool::getInstance().getStats();
+    return pool.leased > 0 && pool.idle == 0;
+}
+
+PagePrefetcher &PagePrefetcher::getInstance()
+{
+    static PagePrefetcher instance(s_configuredPagesAhead.load());
+    return instance;
+}
+
+void PagePrefetcher::configure(size_t pagesAhead)
+{
+    s_configuredPagesAhead = std::min(pagesAhead, kMaxPagesAhead);
+}
+
+PagePrefetcher::PagePrefetcher(size_t pagesAhead)
+    : m_pagesAhead(pagesAhead), m_lastPurge(std::chrono::steady_clock::now())
+{
+}
+
+bool PagePrefetcher::isEnabled() const
+{
+    return m_pagesAhead > 0;
+}
+
+std::shared_future<PagePrefetcher::Page> PagePrefetcher::claim(const std::string &sessionId,
+                                                               const std::string &queryKey, const std::string &key)
+{
+    std::vector<std::shared_ptr<CancellationToken>> dropped;
+    std::shared_future<Page> claimed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_sessions.find(sessionId);
+        if (it == m_sessions.end())
+            return claimed;
+
+        Session &session = it->second;
+        auto now = std::chrono::steady_clock::now();
+        session.lastUsed = now;
+
+        auto slot = std::find_if(session.slots.begin(), session.slots.end(),
+                                 [&](const Slot &candidate) { return candidate.key == key; });
+        if (slot != session.slots.end() && slot->started && now < slot->expires)
+        {
+            claimed = slot->result;
+            session.slots.erase(slot);
+            m_buffered--;
+            m_used++;
+        }
+
+        // Whatever the session is reading now, pages of an earlier query will not be asked for
+        auto stale = [&](const Slot &candidate) {
+            return session.queryKey != queryKey || candidate.key == key || now >= candidate.expires;
+        };
+        dropSlots(session, stale, dropped);
+    }
+
+    for (auto &cancel : dropped)
+        cancel->cancel();
+    return claimed;
+}
+
+PagePrefetcher::Page PagePrefetcher::waitFor(const std::shared_future<Page> &pending, CancellationToken &cancel)
+{
+    while (pending.wait_for(cancel.remaining(kWaitPollInterval)) != std::future_status::ready)
+    {
+        if (cancel.isCancelled())
+            return nullptr;
+    }
+    return pending.get();
+}
+
+void PagePrefetcher::prefetch(const std::string &sessionId, const std::string &queryKey, int page, bool lastPage,
+                              const KeyOf &keyOf, Loader load)
+{
+    if (!isEnabled())
+        return;
+
+    std::vector<int> targets;
+    std::vector<std::shared_ptr<CancellationToken>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (now - m_lastPurge >= kPurgeInterval)
+            purgeExpired(dropped);
+
+        Session &session = m_sessions[sessionId];
+        bool sameQuery = session.queryKey == queryKey;
+        int step = sameQuery && session.lastPage > page ? -1 : 1;
+        session.queryKey = queryKey;
+        session.lastPage = page;
+        session.lastUsed = now;
+
+        for (size_t i = 1; i <= m_pagesAhead; i++)
+        {
+            int target = page + step * static_cast<int>(i);
+            if (target < 1 || (step > 0 && lastPage))
+                break;
+            targets.push_back(target);
+        }
+
+        // Pages behind the session or of another query are no longer ahead of it
+        auto behind = [&](const Slot &slot) {
+            return !sameQuery || now >= slot.expires ||
+                   std::find(targets.begin(), targets.end(), slot.page) == targets.end();
+        };
+        dropSlots(session, behind, dropped);
+
+        for (const Slot &slot : session.slots)
+            targets.erase(std::remove(targets.begin(), targets.end(), slot.page), targets.end());
+    }
+
+    for (auto &cancel : dropped)
+        cancel->cancel();
+
+    if (targets.empty())
+        return;
+
+    if (poolsUnderPressure())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_skippedBusy++;
+        return;
+    }
+
+    auto &pageCache = PageCache::getInstance();
+    for (int target : targets)
+    {
+        std::string key = keyOf(target);
+
+        // Another session already paid for it
+        if (pageCache.contains(key))
+            continue;
+
+        auto cancel = std::make_shared<CancellationToken>(kPrefetchTimeout);
+        auto promise = std::make_shared<std::promise<Page>>();
+
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Session &session = m_sessions[sessionId];
+            id = m_nextId++;
+
+            Slot slot;
+            slot.id = id;
+            slot.page = target;
+            slot.key = std::move(key);
+            slot.cancel = cancel;
+            slot.result = promise->get_future().share();
+            slot.expires = std::chrono::steady_clock::now() + kBufferTtl;
+            session.slots.push_back(std::move(slot));
+            m_buffered++;
+            m_scheduled++;
+        }
+
+        DbExecutor::getInstance().post([this, sessionId, id, target, cancel, promise, load]() {
+            if (!markStarted(sessionId, id))
+            {
+                promise->set_value(nullptr);
+                return;
+            }
+
+            Page loaded;
+            try
+            {
+                loaded = load(target, *cancel);
+            }
+            catch (...)
+            {
+                // Nobody is waiting on the error; the request itself will run the query again
+                loaded = nullptr;
+            }
+
+            promise->set_value(loaded);
+            finish(sessionId, id, loaded != nullptr);
+        });
+    }
+}
+
+void PagePrefetcher::discard(const std::string &sessionId)
+{
+    std::vector<std::shared_ptr<CancellationToken>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_sessions.find(sessionId);
+        if (it == m_sessions.end())
+            return;
+
+        dropSlots(it->second, [](const Slot &) { return true; }, dropped);
+        m_sessions.erase(it);
+    }
+
+    for (auto &cancel : dropped)
+        cancel->cancel();
+}
+
+void PagePrefetcher::dropSlots(Session &session, const std::function<bool(const Slot &)> &predicate,
+                               std::vector<std::shared_ptr<CancellationToken>> &dropped)
+{
+    for (auto it = session.slots.begin(); it != session.slots.end();)
+    {
+        if (predicate(*it))
+        {
+            dropped.push_back(it->cancel);
+            it = session.slots.erase(it);
+            m_buffered--;
+            m_wasted++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void PagePrefetcher::purgeExpired(std::vector<std::shared_ptr<CancellationToken>> &dropped)
+{
+    auto now = std::chrono::steady_clock::now();
+    m_lastPurge = now;
+
+    for (auto it = m_sessions.begin(); it != m_sessions.end();)
+    {
+        dropSlots(it->second, [&](const Slot &slot) { return now >= slot.expires; }, dropped);
+
+        // The paging direction is only worth remembering while the session is active
+        if (it->second.slots.empty() && now - it->second.lastUsed >= kBufferTtl)
+            it = m_sessions.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool PagePrefetcher::markStarted(const std::string &sessionId, uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(sessionId);
+    if (it == m_sessions.end())
+        return false;
+
+    for (Slot &slot : it->second.slots)
+    {
+        if (slot.id == id)
+        {
+            slot.started = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PagePrefetcher::finish(const std::string &sessionId, uint64_t id, bool loaded)
+{
+    if (loaded)
+        return;
+
+    // A failed page is not worth keeping; a request for it runs the query itself
+    std::vector<std::shared_ptr<CancellationToken>> dropped;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(sessionId);
+    if (it != m_sessions.end())
+        dropSlots(it->second, [id](const Slot &slot) { return slot.id == id; }, dropped);
+}
+
+PagePrefetcher::Stats PagePrefetcher::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+    stats.buffered = m_buffered;
+    stats.scheduled = m_scheduled;
+    stats.used = m_used;
+    stats.wasted = m_wasted;
+    stats.skippedBusy = m_skippedBusy;
+    return stats;
+}
+
+} // namespace Data
+} // namespace Tootega
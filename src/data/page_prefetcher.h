@@ -0,0 +1,161 @@
+/**
+ * @file page_prefetcher.h
+ * @brief Speculative loading of the table pages a session is likely to read next
+ */
+
+#pragma once
+
+#include "cancellation.h"
+#include "page_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class PagePrefetcher
+ * @brief Loads the pages after (or before) the one just served and buffers them per session
+ *
+ * After a page is answered, the next pages in the direction the session is
+ * paging are loaded on the database thread pool. A request for one of them
+ * takes it from the session's buffer (waiting if it is still loading);
+ * pages of a query the session moved away from are cancelled and dropped.
+ * Nothing is prefetched while the thread pool or the connection pool is busy.
+ * A prefetch only holds the session while it snapshots the backend (see
+ * DatabaseConnection::selectData), so it never holds up the session's own
+ * navigation while its query runs.
+ */
+class PagePrefetcher
+{
+  public:
+    /// Pages loaded ahead per session when not configured
+    static constexpr size_t kDefaultPagesAhead = 1;
+
+    /// Upper bound of the pages loaded ahead per session
+    static constexpr size_t kMaxPagesAhead = 4;
+
+    using Page = PageCache::Page;
+
+    /// Loads a page; returns nullptr when it must not be reused (errors, cancellation)
+    using Loader = std::function<Page(int page, CancellationToken &cancel)>;
+
+    /// Key of a page of the query (see PageCache::makeKey)
+    using KeyOf = std::function<std::string(int page)>;
+
+    struct Stats
+    {
+        size_t buffered = 0;      ///< Pages loaded or loading, over all sessions
+        uint64_t scheduled = 0;   ///< Pages queued for loading
+        uint64_t used = 0;        ///< Requests answered from a session's buffer
+        uint64_t wasted = 0;      ///< Pages dropped without being requested
+        uint64_t skippedBusy = 0; ///< Prefetches not started because the pools were busy
+    };
+
+    static PagePrefetcher &getInstance();
+
+    /**
+     * @brief Set the pages loaded ahead per session (0 disables prefetching)
+     */
+    static void configure(size_t pagesAhead);
+
+    bool isEnabled() const;
+
+    /**
+     * @brief Take a buffered page of the session
+     *
+     * Pages buffered for another query are dropped. A page still queued is
+     * dropped as well, so the caller loads it without waiting for a worker.
+     *
+     * @param queryKey Key of the query without the page (table, filter, page size...)
+     * @return The page's future, or an invalid future when nothing usable is buffered
+     */
+    std::shared_future<Page> claim(const std::string &sessionId, const std::string &queryKey,
+                                   const std::string &key);
+
+    /**
+     * @brief Wait for a claimed page until it is ready or @p cancel fires
+     * @return nullptr if the prefetch failed or @p cancel fired first
+     */
+    static Page waitFor(const std::shared_future<Page> &pending, CancellationToken &cancel);
+
+    /**
+     * @brief Start loading the pages the session will likely read after @p page
+     *
+     * The direction follows the session's last two pages of the same query.
+     *
+     * @param lastPage @p page is known to be the query's last page
+     */
+    void prefetch(const std::string &sessionId, const std::string &queryKey, int page, bool lastPage,
+                  const KeyOf &keyOf, Loader load);
+
+    /**
+     * @brief Cancel and drop every page buffered for a session
+     */
+    void discard(const std::string &sessionId);
+
+    Stats getStats() const;
+
+    // Delete copy constructor and assignment
+    PagePrefetcher(const PagePrefetcher &) = delete;
+    PagePrefetcher &operator=(const PagePrefetcher &) = delete;
+
+  private:
+    explicit PagePrefetcher(size_t pagesAhead);
+
+    struct Slot
+    {
+        uint64_t id = 0;
+        int page = 0;
+        std::string key;
+        bool started = false;
+        std::shared_ptr<CancellationToken> cancel;
+        std::shared_future<Page> result;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Session
+    {
+        std::string queryKey;
+        int lastPage = 0;
+        std::vector<Slot> slots;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    // All expect m_mutex to be held; dropped slots' tokens are appended to @p dropped
+    // so they can be cancelled after the lock is released
+    void dropSlots(Session &session, const std::function<bool(const Slot &)> &predicate,
+                   std::vector<std::shared_ptr<CancellationToken>> &dropped);
+    void purgeExpired(std::vector<std::shared_ptr<CancellationToken>> &dropped);
+
+    // Run by the worker that loads a slot
+    bool markStarted(const std::string &sessionId, uint64_t id);
+    void finish(const std::string &sessionId, uint64_t id, bool loaded);
+
+    const size_t m_pagesAhead;
+
+    std::unordered_map<std::string, Session> m_sessions;
+    size_t m_buffered = 0;
+    uint64_t m_nextId = 1;
+    std::chrono::steady_clock::time_point m_lastPurge;
+
+    uint64_t m_scheduled = 0;
+    uint64_t m_used = 0;
+    uint64_t m_wasted = 0;
+    uint64_t m_skippedBusy = 0;
+
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Data
+} // namespace Tootega
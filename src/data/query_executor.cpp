@@ -0,0 +1,122 @@
+/**
+ * @file query_executor.cpp
+ * @brief Parallel statement executor implementation
+ */
+
+#include "query_executor.h"
+
+#include <algorithm>
+#include <future>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// How long a task waits for a free pooled connection
+static constexpr int kLeaseWaitSeconds = 10;
+
+QueryExecutor::QueryExecutor(std::string connectionString, std::string database, CancellationToken *cancel)
+    : m_connectionString(std::move(connectionString)), m_database(std::move(database)), m_cancel(cancel)
+{
+}
+
+size_t QueryExecutor::add(Task task, int queryTimeoutSeconds)
+{
+    m_entries.push_back({std::move(task), queryTimeoutSeconds});
+    return m_entries.size() - 1;
+}
+
+std::vector<TaskStatus> QueryExecutor::run()
+{
+    std::vector<TaskStatus> statuses(m_entries.size());
+    if (m_entries.empty())
+        return statuses;
+
+    // The calling thread runs the first task itself
+    std::vector<std::future<TaskStatus>> futures;
+    futures.reserve(m_entries.size() - 1);
+    for (size_t i = 1; i < m_entries.size(); i++)
+    {
+        futures.push_back(std::async(std::launch::async, [this, i]() { return runOne(m_entries[i]); }));
+    }
+
+    statuses[0] = runOne(m_entries[0]);
+    for (size_t i = 1; i < m_entries.size(); i++)
+    {
+        statuses[i] = futures[i - 1].get();
+    }
+
+    m_entries.clear();
+    return statuses;
+}
+
+TaskStatus QueryExecutor::runOne(const Entry &entry)
+{
+    TaskStatus status;
+
+    std::chrono::milliseconds leaseWait = std::chrono::seconds(kLeaseWaitSeconds);
+    int queryTimeout = entry.queryTimeoutSeconds;
+    if (m_cancel)
+    {
+        if (m_cancel->isCancelled())
+        {
+            status.cancelled = true;
+            status.error = m_cancel->reason();
+            return status;
+        }
+
+        // Neither waiting for a connection nor the query may outlive the request
+        leaseWait = m_cancel->remaining(leaseWait);
+        if (m_cancel->hasDeadline())
+        {
+            int remaining = m_cancel->remainingSeconds();
+            queryTimeout = queryTimeout > 0 ? std::min(queryTimeout, remaining) : remaining;
+        }
+    }
+
+    ConnectionLease lease =
+        ConnectionPool::getInstance().acquire(m_connectionString, m_database, leaseWait, status.error);
+    if (!lease)
+        return status;
+
+    lease->setQueryTimeout(queryTimeout);
+
+    // Declared after the lease so it is unregistered before the connection goes back
+    CancellationToken::Registration registration;
+    if (m_cancel)
+    {
+        PooledConnection &connection = *lease;
+        registration = m_cancel->onCancel([&connection]() { connection.cancel(); });
+    }
+
+    try
+    {
+        status.success = entry.task(*lease, status.error);
+    }
+    catch (const std::exception &e)
+    {
+        status.success = false;
+        status.error = e.what();
+    }
+
+    if (!status.success)
+    {
+        // HYT00: query timeout expired; 08xxx: the connection itself failed
+        status.timedOut = status.error.compare(0, 5, "HYT00") == 0;
+        if (status.error.compare(0, 2, "08") == 0 || !lease->isAlive())
+            lease.markBroken();
+
+        // HY008 (operation canceled) or a timeout capped by the deadline: report why
+        if (m_cancel && m_cancel->isCancelled())
+        {
+            status.cancelled = true;
+            status.error = m_cancel->reason();
+        }
+    }
+
+    return status;
+}
+
+} // namespace Data
+} // namespace Tootega
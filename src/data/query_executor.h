@@ -0,0 +1,82 @@
+/**
+ * @file query_executor.h
+ * @brief Runs the independent statements of one request in parallel
+ */
+
+#pragma once
+
+#include "cancellation.h"
+#include "connection_pool.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Outcome of one task run by QueryExecutor
+ */
+struct TaskStatus
+{
+    bool success = false;
+    bool timedOut = false;
+    bool cancelled = false;
+    std::string error;
+};
+
+/**
+ * @class QueryExecutor
+ * @brief Runs tasks concurrently, each on its own leased connection, and joins them
+ *
+ * Tasks are independent: a failing or timed-out task does not cancel the
+ * others, so callers can still use partial results.
+ */
+class QueryExecutor
+{
+  public:
+    /**
+     * @brief A unit of work; return false and fill error on failure
+     */
+    using Task = std::function<bool(PooledConnection &connection, std::string &error)>;
+
+    /**
+     * @param connectionString ADO.NET style connection string of the target
+     * @param database Database every leased connection must be using
+     * @param cancel Request the tasks belong to; its deadline caps query timeouts and cancelling it
+     *        cancels the running statements (optional)
+     */
+    QueryExecutor(std::string connectionString, std::string database, CancellationToken *cancel = nullptr);
+
+    /**
+     * @brief Queue a task
+     * @param queryTimeoutSeconds SQL_ATTR_QUERY_TIMEOUT for the task's statements (0 = none)
+     * @return Index of the task's status in the vector returned by run()
+     */
+    size_t add(Task task, int queryTimeoutSeconds = 0);
+
+    /**
+     * @brief Run all queued tasks and wait for them to finish
+     */
+    std::vector<TaskStatus> run();
+
+  private:
+    struct Entry
+    {
+        Task task;
+        int queryTimeoutSeconds;
+    };
+
+    TaskStatus runOne(const Entry &entry);
+
+    std::string m_connectionString;
+    std::string m_database;
+    CancellationToken *m_cancel;
+    std::vector<Entry> m_entries;
+};
+
+} // namespace Data
+} // namespace Tootega
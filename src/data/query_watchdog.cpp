@@ -0,0 +1,83 @@
+/**
+ * @file query_watchdog.cpp
+ * @brief Request deadline and abandonment watchdog implementation
+ */
+
+#include "query_watchdog.h"
+
+namespace Tootega
+{
+namespace Data
+{
+
+QueryWatchdog &QueryWatchdog::getInstance()
+{
+    static QueryWatchdog instance;
+    return instance;
+}
+
+QueryWatchdog::QueryWatchdog()
+{
+    m_thread = std::thread(&QueryWatchdog::checkLoop, this);
+}
+
+QueryWatchdog::~QueryWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+size_t QueryWatchdog::watch(const std::shared_ptr<CancellationToken> &token, std::function<bool()> abandoned)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t id = m_nextId++;
+    m_watches.emplace(id, Watch{token, std::move(abandoned)});
+    return id;
+}
+
+void QueryWatchdog::unwatch(size_t id)
+{
+    // Probes run under the lock, so none is running once this returns
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_watches.erase(id);
+}
+
+void QueryWatchdog::checkLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping)
+    {
+        m_wakeup.wait_for(lock, kCheckInterval);
+        if (m_stopping)
+            break;
+
+        for (auto it = m_watches.begin(); it != m_watches.end();)
+        {
+            auto token = it->second.token.lock();
+            if (!token)
+            {
+                // The request finished and released its token
+                it = m_watches.erase(it);
+                continue;
+            }
+
+            if (token->isCancelled() || (it->second.abandoned && it->second.abandoned()))
+            {
+                token->cancel();
+                it = m_watches.erase(it);
+                continue;
+            }
+
+            ++it;
+        }
+    }
+}
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,77 @@
+/**
+ * @file query_watchdog.h
+ * @brief Background thread that cancels requests past their deadline or abandoned by the client
+ */
+
+#pragma once
+
+#include "cancellation.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @class QueryWatchdog
+ * @brief Cancels watched tokens when their deadline passes or their client goes away
+ *
+ * SQL_ATTR_QUERY_TIMEOUT only bounds each statement on the server; the
+ * watchdog bounds the whole request (queueing, several statements, fetching)
+ * and notices clients that closed the connection or stopped polling.
+ */
+class QueryWatchdog
+{
+  public:
+    /// How often deadlines and clients are checked
+    static constexpr auto kCheckInterval = std::chrono::milliseconds(250);
+
+    static QueryWatchdog &getInstance();
+
+    /**
+     * @brief Watch a token until it is cancelled, destroyed or unwatched
+     * @param abandoned Optional probe; the token is cancelled once it returns true.
+     *        Runs on the watchdog thread, never after unwatch() returns.
+     * @return Id for unwatch()
+     */
+    size_t watch(const std::shared_ptr<CancellationToken> &token, std::function<bool()> abandoned = nullptr);
+
+    /**
+     * @brief Stop watching (no-op if the token was already cancelled)
+     */
+    void unwatch(size_t id);
+
+    // Delete copy constructor and assignment
+    QueryWatchdog(const QueryWatchdog &) = delete;
+    QueryWatchdog &operator=(const QueryWatchdog &) = delete;
+
+  private:
+    QueryWatchdog();
+    ~QueryWatchdog();
+
+    struct Watch
+    {
+        std::weak_ptr<CancellationToken> token;
+        std::function<bool()> abandoned;
+    };
+
+    void checkLoop();
+
+    std::map<size_t, Watch> m_watches;
+    size_t m_nextId = 1;
+    bool m_stopping = false;
+    std::condition_variable m_wakeup;
+    std::mutex m_mutex;
+    std::thread m_thread;
+};
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,157 @@
+/**
+ * @file result_set.cpp
+ * @brief Columnar, arena-backed storage for query results implementation
+ */
+
+#include "result_set.h"
+#include "utf8_transcode.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace Tootega
+{
+namespace Data
+{
+
+const char *valueKindName(ValueKind kind)
+{
+    switch (kind)
+    {
+    case ValueKind::Integer:
+        return "integer";
+    case ValueKind::Float:
+        return "float";
+    case ValueKind::Decimal:
+        return "decimal";
+    case ValueKind::Boolean:
+        return "boolean";
+    case ValueKind::Date:
+        return "date";
+    case ValueKind::DateTime:
+        return "datetime";
+    case ValueKind::Guid:
+        return "guid";
+    case ValueKind::Binary:
+        return "binary";
+    case ValueKind::Text:
+        break;
+    }
+    return "text";
+}
+
+bool appendHex(std::string &bytes, std::string_view text)
+{
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    if (text.size() < 2 || text[0] != '0' || (text[1] != 'x' && text[1] != 'X') || text.size() % 2 != 0)
+        return false;
+    for (size_t i = 2; i < text.size(); i += 2)
+    {
+        int high = nibble(text[i]);
+        int low = nibble(text[i + 1]);
+        if (high < 0 || low < 0)
+            return false;
+        bytes.push_back(static_cast<char>(high << 4 | low));
+    }
+    return true;
+}
+
+void ResultSet::addColumn(std::string name, ValueKind kind)
+{
+    Column column;
+    column.name = std::move(name);
+    column.kind = kind;
+    m_columns.push_back(std::move(column));
+}
+
+void ResultSet::appendValue(std::string_view value)
+{
+    appendCell(value, false);
+}
+
+void ResultSet::appendNull()
+{
+    appendCell(std::string_view(), true);
+}
+
+void ResultSet::appendUtf16(std::u16string_view value)
+{
+    beginCell(utf8MaxLength(value.size()), false);
+
+    size_t start = m_arena.size();
+    m_arena.resize(start + utf8MaxLength(value.size()));
+    size_t length = utf16ToUtf8(value.data(), value.size(), &m_arena[start]);
+    m_arena.resize(start + length);
+
+    endCell();
+}
+
+void ResultSet::clearRows()
+{
+    for (Column &column : m_columns)
+    {
+        column.offsets.clear();
+        column.nulls.clear();
+    }
+    m_arena.clear();
+    m_rowCount = 0;
+    m_nextColumn = 0;
+}
+
+void ResultSet::appendCell(std::string_view value, bool null)
+{
+    beginCell(value.size(), null);
+    m_arena.append(value.data(), value.size());
+    endCell();
+}
+
+void ResultSet::beginCell(size_t maxBytes, bool null)
+{
+    // Offsets are 32-bit; QueryExecutor turns this into a task error
+    if (m_arena.size() + maxBytes > std::numeric_limits<uint32_t>::max())
+        throw std::length_error("ResultSet: arena exceeds 4 GiB");
+
+    Column &column = m_columns[m_nextColumn];
+    size_t row = m_rowCount;
+
+    column.offsets.push_back(static_cast<uint32_t>(m_arena.size()));
+    if (row % 64 == 0)
+        column.nulls.push_back(0);
+    if (null)
+        column.nulls[row / 64] |= uint64_t(1) << (row % 64);
+}
+
+void ResultSet::endCell()
+{
+    if (++m_nextColumn == m_columns.size())
+    {
+        m_nextColumn = 0;
+        m_rowCount++;
+    }
+}
+
+std::string_view ResultSet::value(size_t row, size_t column) const
+{
+    size_t start = m_columns[column].offsets[row];
+    size_t end;
+    if (column + 1 < m_columns.size())
+        end = m_columns[column + 1].offsets[row];
+    else if (row + 1 < m_columns[0].offsets.size())
+        end = m_columns[0].offsets[row + 1];
+    else
+        end = m_arena.size();
+
+    return std::string_view(m_arena.data() + start, end - start);
+}
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,179 @@
+/**
+ * @file result_set.h
+ * @brief Columnar, arena-backed storage for query results
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief How the cells of a column are typed in JSON output
+ *
+ * Cells are always stored as text; the kind tells writers whether that text
+ * is a JSON number/boolean literal or has to be quoted.
+ */
+enum class ValueKind : uint8_t
+{
+    Text,
+    Integer,  ///< Decimal integer text
+    Float,    ///< Shortest round-trip floating point text
+    Decimal,  ///< Exact numeric text from the driver (kept quoted to preserve precision)
+    Boolean,  ///< "true" or "false"
+    Date,     ///< YYYY-MM-DD
+    DateTime, ///< YYYY-MM-DD HH:MM:SS[.fffffffff]
+    Guid,     ///< XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX
+    Binary    ///< 0x followed by hex digits
+};
+
+/**
+ * @brief Name of a value kind as reported to clients
+ */
+const char *valueKindName(ValueKind kind);
+
+/**
+ * @brief Append the bytes of a Binary value ("0x" followed by hex digits) to @p bytes
+ * @return false if @p text is not in that form; what was appended before the bad digit stays
+ */
+bool appendHex(std::string &bytes, std::string_view text);
+
+/**
+ * @class ResultSet
+ * @brief Rows of a query stored column by column
+ *
+ * Column names are stored once. Cell bytes are appended to a single arena in
+ * row-major order; each column keeps the arena offset of its cells and a
+ * bitmap of the NULL ones. A cell ends where the next appended cell starts,
+ * so one 32-bit offset per cell is enough.
+ *
+ * Cells are appended row by row with appendValue()/appendNull(), one call per
+ * column in column order.
+ */
+class ResultSet
+{
+  public:
+    /**
+     * @brief Lightweight view of one row
+     */
+    class Row
+    {
+      public:
+        Row(const ResultSet &set, size_t index) : m_set(&set), m_index(index)
+        {
+        }
+
+        size_t size() const
+        {
+            return m_set->columnCount();
+        }
+
+        bool isNull(size_t column) const
+        {
+            return m_set->isNull(m_index, column);
+        }
+
+        std::string_view value(size_t column) const
+        {
+            return m_set->value(m_index, column);
+        }
+
+      private:
+        const ResultSet *m_set;
+        size_t m_index;
+    };
+
+    /**
+     * @brief Add a column; only valid before the first cell is appended
+     */
+    void addColumn(std::string name, ValueKind kind = ValueKind::Text);
+
+    void appendValue(std::string_view value);
+    void appendNull();
+
+    /**
+     * @brief Append a UTF-16 cell, transcoded to UTF-8 straight into the arena
+     */
+    void appendUtf16(std::u16string_view value);
+
+    /**
+     * @brief Drop every row, keeping the columns and the memory already allocated
+     *
+     * Lets a reader reuse one ResultSet for consecutive batches of a query.
+     */
+    void clearRows();
+
+    size_t columnCount() const
+    {
+        return m_columns.size();
+    }
+
+    size_t rowCount() const
+    {
+        return m_rowCount;
+    }
+
+    const std::string &columnName(size_t column) const
+    {
+        return m_columns[column].name;
+    }
+
+    ValueKind columnKind(size_t column) const
+    {
+        return m_columns[column].kind;
+    }
+
+    /**
+     * @brief Change a column's kind, e.g. when a cell does not fit the declared type
+     */
+    void setColumnKind(size_t column, ValueKind kind)
+    {
+        m_columns[column].kind = kind;
+    }
+
+    bool isNull(size_t row, size_t column) const
+    {
+        return (m_columns[column].nulls[row / 64] >> (row % 64)) & 1;
+    }
+
+    /**
+     * @brief Cell bytes (empty for NULL)
+     */
+    std::string_view value(size_t row, size_t column) const;
+
+    Row row(size_t index) const
+    {
+        return Row(*this, index);
+    }
+
+  private:
+    struct Column
+    {
+        std::string name;
+        ValueKind kind;
+        std::vector<uint32_t> offsets;
+        std::vector<uint64_t> nulls;
+    };
+
+    void appendCell(std::string_view value, bool null);
+
+    // Record the offset and NULL bit of the next cell, which will take at most maxBytes
+    void beginCell(size_t maxBytes, bool null);
+    void endCell();
+
+    std::vector<Column> m_columns;
+    std::string m_arena;
+    size_t m_rowCount = 0;
+    size_t m_nextColumn = 0;
+};
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,354 @@
+/**
+ * @file row_parser.cpp
+ * @brief Incremental parsers of uploaded rows (CSV, NDJSON) implementation
+ */
+
+#include "row_parser.h"
+#include "json_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace Tootega
+{
+namespace Data
+{
+
+bool RowParser::fail(const std::string &message)
+{
+    m_error = "Line " + std::to_string(m_line) + ": " + message;
+    return false;
+}
+
+/**
+ * @brief RFC 4180 CSV: a header record, then one record per row
+ *
+ * An empty unquoted field is NULL and "" an empty string, as the CSV export
+ * writes them. CRLF and LF line breaks are both accepted, and blank lines
+ * skipped. Runs of plain characters are copied at once rather than one by one.
+ */
+class CsvRowParser final : public RowParser
+{
+  public:
+    bool feed(std::string_view input, const RowHandler &onRow) override
+    {
+        // A UTF-8 BOM may come split across chunks: its first bytes are held until they are known to be one or not
+        if (m_atStart)
+        {
+            size_t take = std::min(input.size(), kBom.size() - m_head.size());
+            m_head.append(input.substr(0, take));
+            input.remove_prefix(take);
+            if (m_head.size() < kBom.size() && kBom.substr(0, m_head.size()) == m_head)
+                return true;
+            if (!flushHead(onRow))
+                return false;
+        }
+        return parse(input, onRow);
+    }
+
+    bool finish(const RowHandler &onRow) override
+    {
+        if (m_atStart && !flushHead(onRow))
+            return false;
+        if (m_state == State::Quoted)
+            return fail("Unterminated quoted value");
+        if (m_state == State::FieldStart && m_fieldCount == 0)
+            return true;
+        endField();
+        return endRecord(onRow);
+    }
+
+  private:
+    enum class State
+    {
+        FieldStart,
+        Unquoted,
+        Quoted,
+        QuoteInQuoted ///< A quote inside a quoted value: its end, or the first of a doubled quote
+    };
+
+    static constexpr std::string_view kBom = "\xEF\xBB\xBF";
+
+    // Parse the bytes held at the start, unless they are the BOM
+    bool flushHead(const RowHandler &onRow)
+    {
+        m_atStart = false;
+        std::string head = std::move(m_head);
+        return head == kBom || parse(head, onRow);
+    }
+
+    bool parse(std::string_view input, const RowHandler &onRow)
+    {
+        const char *p = input.data();
+        const char *end = p + input.size();
+        while (p < end)
+        {
+            switch (m_state)
+            {
+            case State::FieldStart:
+                if (*p == '"')
+                {
+                    m_state = State::Quoted;
+                    m_quoted = true;
+                    p++;
+                    break;
+                }
+                m_state = State::Unquoted;
+                [[fallthrough]];
+            case State::Unquoted: {
+                const char *stop = p;
+                while (stop < end && *stop != ',' && *stop != '\n' && *stop != '\r')
+                    stop++;
+                if (!append(p, stop))
+                    return false;
+                p = stop;
+                if (p < end && !separator(*p++, onRow))
+                    return false;
+                break;
+            }
+            case State::Quoted: {
+                auto stop = static_cast<const char *>(std::memchr(p, '"', end - p));
+                if (!stop)
+                    stop = end;
+                if (!append(p, stop))
+                    return false;
+                m_line += std::count(p, stop, '\n');
+                p = stop;
+                if (p < end)
+                {
+                    m_state = State::QuoteInQuoted;
+                    p++;
+                }
+                break;
+            }
+            case State::QuoteInQuoted:
+                if (*p == '"')
+                {
+                    // A doubled quote stands for one
+                    current() += '"';
+                    m_state = State::Quoted;
+                    p++;
+                }
+                else if (*p == ',' || *p == '\n' || *p == '\r')
+                {
+                    if (!separator(*p++, onRow))
+                        return false;
+                }
+                else
+                {
+                    return fail("Unexpected character after a closing quote");
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    std::string &current()
+    {
+        if (m_fields.size() <= m_fieldCount)
+        {
+            m_fields.resize(m_fieldCount + 1);
+            m_nulls.resize(m_fieldCount + 1);
+        }
+        return m_fields[m_fieldCount];
+    }
+
+    bool append(const char *from, const char *to)
+    {
+        std::string &field = current();
+        if (field.size() + (to - from) > kMaxValueBytes)
+            return fail("Value longer than " + std::to_string(kMaxValueBytes) + " bytes");
+        field.append(from, to);
+        return true;
+    }
+
+    void endField()
+    {
+        std::string &field = current();
+        m_nulls[m_fieldCount] = !m_quoted && field.empty();
+        m_fieldCount++;
+        m_quoted = false;
+        m_state = State::FieldStart;
+    }
+
+    // A CR ends the record and the LF after it makes a blank line, which is skipped
+    bool separator(char separator, const RowHandler &onRow)
+    {
+        endField();
+        if (separator == ',')
+            return true;
+        if (!endRecord(onRow))
+            return false;
+        if (separator == '\n')
+            m_line++;
+        return true;
+    }
+
+    bool endRecord(const RowHandler &onRow)
+    {
+        size_t count = m_fieldCount;
+        m_fieldCount = 0;
+        for (size_t i = count; i < m_fields.size(); i++)
+            m_fields[i].clear();
+
+        bool blank = count == 1 && m_nulls[0];
+        if (blank)
+            return true;
+
+        if (m_columns.empty())
+        {
+            m_columns.assign(m_fields.begin(), m_fields.begin() + count);
+            for (size_t i = 0; i < count; i++)
+                m_fields[i].clear();
+            return true;
+        }
+        if (count != m_columns.size())
+            return fail("Expected " + std::to_string(m_columns.size()) + " values, found " + std::to_string(count));
+
+        m_cells.resize(count);
+        for (size_t i = 0; i < count; i++)
+            m_cells[i] = ParsedCell{m_fields[i], m_nulls[i]};
+        m_rows++;
+        bool more = onRow(m_cells);
+        for (size_t i = 0; i < count; i++)
+            m_fields[i].clear();
+        return more;
+    }
+
+    State m_state = State::FieldStart;
+    bool m_quoted = false;
+    bool m_atStart = true; ///< The BOM check is pending
+    std::string m_head;    ///< First bytes while m_atStart
+
+    // Fields of the record being parsed; kept allocated across records
+    std::vector<std::string> m_fields;
+    std::vector<bool> m_nulls;
+    size_t m_fieldCount = 0;
+    std::vector<ParsedCell> m_cells;
+};
+
+/**
+ * @brief Newline delimited JSON: one flat object per line
+ *
+ * The first object names the columns; later objects may leave keys out
+ * (NULL) but not add new ones. Strings are decoded, numbers kept as
+ * written, booleans become 1 and 0, and nested objects or arrays are kept
+ * as JSON text.
+ */
+class NdJsonRowParser final : public RowParser
+{
+  public:
+    bool feed(std::string_view input, const RowHandler &onRow) override
+    {
+        while (!input.empty())
+        {
+            size_t newline = input.find('\n');
+            if (newline == std::string_view::npos)
+            {
+                if (m_pending.size() + input.size() > kMaxValueBytes)
+                    return fail("Line longer than " + std::to_string(kMaxValueBytes) + " bytes");
+                m_pending.append(input);
+                return true;
+            }
+
+            std::string_view line = input.substr(0, newline);
+            if (!m_pending.empty())
+            {
+                m_pending.append(line);
+                line = m_pending;
+            }
+            if (!parseLine(line, onRow))
+                return false;
+            m_pending.clear();
+            m_line++;
+            input.remove_prefix(newline + 1);
+        }
+        return true;
+    }
+
+    bool finish(const RowHandler &onRow) override
+    {
+        if (m_pending.empty())
+            return true;
+        bool parsed = parseLine(m_pending, onRow);
+        m_pending.clear();
+        return parsed;
+    }
+
+  private:
+    bool parseLine(std::string_view line, const RowHandler &onRow)
+    {
+        m_reader.reset(line);
+        if (m_reader.atEnd())
+            return true;
+
+        bool first = m_columns.empty();
+        std::fill(m_nulls.begin(), m_nulls.end(), true);
+
+        if (!m_reader.beginObject())
+            return fail(m_reader.error());
+        while (m_reader.nextKey(m_key))
+        {
+            size_t column;
+            auto known = m_index.find(m_key);
+            if (known != m_index.end())
+            {
+                column = known->second;
+                if (first && !m_nulls[column])
+                    return fail("Duplicate key " + m_key);
+            }
+            else if (first)
+            {
+                column = m_columns.size();
+                m_index.emplace(m_key, column);
+                m_columns.push_back(m_key);
+                m_values.resize(m_columns.size());
+                m_nulls.resize(m_columns.size(), true);
+            }
+            else
+            {
+                return fail("Unknown column " + m_key);
+            }
+
+            bool null = false;
+            if (!m_reader.readValue(m_values[column], null))
+                return fail("Invalid value for " + m_key);
+            m_nulls[column] = null;
+        }
+        if (m_reader.failed())
+            return fail(m_reader.error());
+        if (!m_reader.atEnd())
+            return fail("Unexpected text after the object");
+        if (m_columns.empty())
+            return fail("The first object has no keys");
+
+        m_cells.resize(m_columns.size());
+        for (size_t i = 0; i < m_columns.size(); i++)
+            m_cells[i] = ParsedCell{m_nulls[i] ? std::string_view() : std::string_view(m_values[i]), m_nulls[i]};
+        m_rows++;
+        return onRow(m_cells);
+    }
+
+    std::string m_pending; ///< Start of a line whose end has not arrived yet
+    JsonReader m_reader;
+
+    std::unordered_map<std::string, size_t> m_index;
+    std::string m_key;
+    std::vector<std::string> m_values;
+    std::vector<bool> m_nulls;
+    std::vector<ParsedCell> m_cells;
+};
+
+std::unique_ptr<RowParser> RowParser::create(const std::string &format)
+{
+    if (format == "csv")
+        return std::make_unique<CsvRowParser>();
+    if (format == "ndjson")
+        return std::make_unique<NdJsonRowParser>();
+    return nullptr;
+}
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,94 @@
+/**
+ * @file row_parser.h
+ * @brief Incremental parsers of uploaded rows (CSV, NDJSON)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief One parsed cell: text as uploaded, or NULL
+ */
+struct ParsedCell
+{
+    std::string_view value;
+    bool null = false;
+};
+
+/**
+ * @class RowParser
+ * @brief Parses rows out of an upload fed piece by piece, as the body arrives
+ *
+ * The columns come from the input itself: the header record of a CSV, the
+ * keys of the first object of NDJSON. Each complete row is handed to a
+ * handler with one cell per column, valid only during the call. Memory is
+ * bounded by the longest row, not by the size of the upload.
+ */
+class RowParser
+{
+  public:
+    /// Receives each row; returning false stops the parse
+    using RowHandler = std::function<bool(const std::vector<ParsedCell> &row)>;
+
+    /// A single value longer than this fails the parse
+    static constexpr size_t kMaxValueBytes = 16 * 1024 * 1024;
+
+    virtual ~RowParser() = default;
+
+    /**
+     * @brief Create the parser of a format ("csv", "ndjson")
+     * @return nullptr for an unknown format
+     */
+    static std::unique_ptr<RowParser> create(const std::string &format);
+
+    /**
+     * @brief Parse the next piece of the input
+     * @return false if the input is malformed (see error()) or @p onRow stopped the parse
+     */
+    virtual bool feed(std::string_view input, const RowHandler &onRow) = 0;
+
+    /**
+     * @brief Parse what is left once the input ended (a last row without a line break)
+     */
+    virtual bool finish(const RowHandler &onRow) = 0;
+
+    /// Column names, known once the first row (CSV: the header) is parsed
+    const std::vector<std::string> &columns() const
+    {
+        return m_columns;
+    }
+
+    /// Data rows parsed so far
+    uint64_t rows() const
+    {
+        return m_rows;
+    }
+
+    /// Set when the input was malformed, with the line it was found on
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+  protected:
+    bool fail(const std::string &message);
+
+    std::vector<std::string> m_columns;
+    uint64_t m_rows = 0;
+    uint64_t m_line = 1;
+    std::string m_error;
+};
+
+} // namespace Data
+} // namespace Tootega
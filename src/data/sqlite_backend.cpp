@@ -0,0 +1,1889 @@
+/**
+ * @file sqlite_backend.cpp
+ * @brief Embedded SQLite backend implementation
+ */
+
+#include "sqlite_backend.h"
+
+#ifdef TOOTEGA_HAS_SQLITE
+
+#include "count_cache.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Tootega
+{
+namespace Data
+{
+
+// How long a statement waits on a file locked by another writer
+static constexpr int kBusyTimeoutMs = 5000;
+
+// Longest a follow-up count request waits for a deferred count in flight
+static constexpr std::chrono::milliseconds kDeferredCountWait = std::chrono::seconds(30);
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+// Set at startup by configureSqliteBackend(); no directory refuses every SQLite connection
+static std::mutex s_configMutex;
+static std::filesystem::path s_allowedDirectory;
+static std::atomic<bool> s_writable{false};
+
+/**
+ * @brief Prepared statement wrapper for RAII
+ */
+class SqliteStatement
+{
+  public:
+    SqliteStatement(sqlite3 *db, const std::string &sql)
+    {
+        m_rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &m_stmt, nullptr);
+    }
+
+    ~SqliteStatement()
+    {
+        sqlite3_finalize(m_stmt);
+    }
+
+    SqliteStatement(const SqliteStatement &) = delete;
+    SqliteStatement &operator=(const SqliteStatement &) = delete;
+
+    sqlite3_stmt *get() const
+    {
+        return m_stmt;
+    }
+
+    operator bool() const
+    {
+        return m_rc == SQLITE_OK && m_stmt != nullptr;
+    }
+
+  private:
+    sqlite3_stmt *m_stmt = nullptr;
+    int m_rc;
+};
+
+/**
+ * @brief Interrupts the statements of a connection once a request is cancelled
+ *
+ * SQLite has no query timeout; the progress handler polls the token every
+ * few thousand virtual machine instructions and aborts with SQLITE_INTERRUPT.
+ */
+class SqliteCancelScope
+{
+  public:
+    SqliteCancelScope(sqlite3 *db, CancellationToken &cancel) : m_db(db)
+    {
+        sqlite3_progress_handler(m_db, kProgressInstructions, &SqliteCancelScope::onProgress, &cancel);
+    }
+
+    ~SqliteCancelScope()
+    {
+        sqlite3_progress_handler(m_db, 0, nullptr, nullptr);
+    }
+
+    SqliteCancelScope(const SqliteCancelScope &) = delete;
+    SqliteCancelScope &operator=(const SqliteCancelScope &) = delete;
+
+  private:
+    static constexpr int kProgressInstructions = 10000;
+
+    static int onProgress(void *token)
+    {
+        return static_cast<CancellationToken *>(token)->isCancelled() ? 1 : 0;
+    }
+
+    sqlite3 *m_db;
+};
+
+/**
+ * @brief Quote a name validated with isValidIdentifier()
+ */
+static std::string quoteIdentifier(const std::string &name)
+{
+    return "\"" + name + "\"";
+}
+
+/**
+ * @brief Resolve a Data Source inside the allowed directory
+ * @return false with @p error set if SQLite is not enabled or the file lies outside the directory
+ */
+static bool resolveDataSource(const std::string &dataSource, std::string &path, std::string &error)
+{
+    std::filesystem::path directory;
+    {
+        std::lock_guard<std::mutex> lock(s_configMutex);
+        directory = s_allowedDirectory;
+    }
+    if (directory.empty())
+    {
+        error = "SQLite connections are disabled";
+        return false;
+    }
+
+    // weakly_canonical follows the links of the part that exists, so a link out of the directory is caught
+    std::error_code ec;
+    std::filesystem::path resolved = std::filesystem::weakly_canonical(directory / dataSource, ec);
+    if (ec)
+    {
+        error = "Invalid Data Source";
+        return false;
+    }
+
+    std::filesystem::path relative = resolved.lexically_relative(directory);
+    if (relative.empty() || relative == "." || *relative.begin() == "..")
+    {
+        error = "Data Source outside the SQLite directory";
+        return false;
+    }
+
+    path = resolved.string();
+    return true;
+}
+
+static sqlite3 *openDatabase(const std::string &path, std::string &error)
+{
+    // No SQLite-level mutex: DatabaseConnection already serializes the session
+    int flags = (s_writable ? SQLITE_OPEN_READWRITE : SQLITE_OPEN_READONLY) | SQLITE_OPEN_NOMUTEX;
+    sqlite3 *db = nullptr;
+    int rc = sqlite3_open_v2(path.c_str(), &db, flags, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        error = db ? sqlite3_errmsg(db) : sqlite3_errstr(rc);
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    sqlite3_busy_timeout(db, kBusyTimeoutMs);
+    return db;
+}
+
+/**
+ * @brief Map a declared column type to a value kind, following SQLite's affinity rules
+ */
+static ValueKind kindForDeclaredType(const char *declared)
+{
+    if (!declared)
+        return ValueKind::Text;
+
+    std::string type(declared);
+    for (auto &c : type)
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+
+    if (type.find("INT") != std::string::npos)
+        return ValueKind::Integer;
+    if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos ||
+        type.find("TEXT") != std::string::npos)
+        return ValueKind::Text;
+    if (type.find("BLOB") != std::string::npos)
+        return ValueKind::Binary;
+    if (type.find("REAL") != std::string::npos || type.find("FLOA") != std::string::npos ||
+        type.find("DOUB") != std::string::npos)
+        return ValueKind::Float;
+    if (type.find("BOOL") != std::string::npos)
+        return ValueKind::Boolean;
+    if (type.find("DEC") != std::string::npos || type.find("NUM") != std::string::npos)
+        return ValueKind::Decimal;
+    return ValueKind::Text;
+}
+
+/**
+ * @brief Kind a column of @p kind takes to hold the current value of @p stmt
+ *
+ * SQLite types each value, so a column whose cells do not fit its declared
+ * kind is widened (Integer to Float) or demoted to Text. Only ever moves
+ * towards Text, so the kind that holds every row does not depend on their order.
+ */
+static ValueKind widenedKind(sqlite3_stmt *stmt, int column, ValueKind kind)
+{
+    switch (sqlite3_column_type(stmt, column))
+    {
+    case SQLITE_INTEGER:
+        return kind == ValueKind::Binary ? ValueKind::Text : kind;
+    case SQLITE_FLOAT:
+        if (!std::isfinite(sqlite3_column_double(stmt, column)) || kind == ValueKind::Boolean ||
+            kind == ValueKind::Binary)
+            return ValueKind::Text;
+        return kind == ValueKind::Integer ? ValueKind::Float : kind;
+    case SQLITE_BLOB:
+        return kind == ValueKind::Binary ? kind : ValueKind::Text;
+    case SQLITE_TEXT:
+        return kind == ValueKind::Text || kind == ValueKind::Decimal ? kind : ValueKind::Text;
+    default:
+        return kind;
+    }
+}
+
+/**
+ * @brief Append one cell, widening its column first when the value does not fit (see widenedKind)
+ */
+static void appendCell(sqlite3_stmt *stmt, int column, ResultSet &data)
+{
+    ValueKind kind = widenedKind(stmt, column, data.columnKind(column));
+    if (kind != data.columnKind(column))
+        data.setColumnKind(column, kind);
+    char text[32];
+
+    switch (sqlite3_column_type(stmt, column))
+    {
+    case SQLITE_NULL:
+        data.appendNull();
+        return;
+    case SQLITE_INTEGER:
+    {
+        sqlite3_int64 value = sqlite3_column_int64(stmt, column);
+        if (kind == ValueKind::Boolean)
+        {
+            data.appendValue(value ? "true" : "false");
+            return;
+        }
+
+        char *end = std::to_chars(text, text + sizeof(text), static_cast<long long>(value)).ptr;
+        data.appendValue(std::string_view(text, static_cast<size_t>(end - text)));
+        return;
+    }
+    case SQLITE_FLOAT:
+    {
+        double value = sqlite3_column_double(stmt, column);
+        char *end = std::to_chars(text, text + sizeof(text), value).ptr;
+        data.appendValue(std::string_view(text, static_cast<size_t>(end - text)));
+        return;
+    }
+    case SQLITE_BLOB:
+    {
+        auto bytes = static_cast<const unsigned char *>(sqlite3_column_blob(stmt, column));
+        size_t length = static_cast<size_t>(sqlite3_column_bytes(stmt, column));
+
+        std::string hex(2 + length * 2, '0');
+        hex[1] = 'x';
+        for (size_t i = 0; i < length; i++)
+        {
+            hex[2 + i * 2] = kHexDigits[bytes[i] >> 4];
+            hex[3 + i * 2] = kHexDigits[bytes[i] & 0xF];
+        }
+        data.appendValue(hex);
+        return;
+    }
+    default:
+    {
+        auto chars = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+        size_t length = static_cast<size_t>(sqlite3_column_bytes(stmt, column));
+        data.appendValue(std::string_view(chars ? chars : "", length));
+        return;
+    }
+    }
+}
+
+/**
+ * @brief WHERE predicate of a resolved filter and the value bound to ?1
+ * @return Empty when the filter is not active
+ */
+static std::string filterPredicate(const RowFilter &filter, std::string &param)
+{
+    if (!filter.isActive())
+        return std::string();
+
+    std::string column = quoteIdentifier(filter.column);
+    switch (filter.mode)
+    {
+    case FilterMode::Exact:
+        param = filter.value;
+        return column + " = ?1";
+    case FilterMode::Prefix:
+        // SQLite only seeks an index for LIKE on NOCASE columns; GLOB (case-sensitive) seeks on the default BINARY
+        param.clear();
+        for (char c : filter.value)
+        {
+            if (c == '*' || c == '?' || c == '[')
+                param += std::string("[") + c + "]";
+            else
+                param += c;
+        }
+        param += '*';
+        return column + " GLOB ?1";
+    case FilterMode::FullText:
+        // FTS5 phrase with its last token as a prefix: "value"* (embedded quotes doubled)
+        param = "\"";
+        for (char c : filter.value)
+        {
+            param += c;
+            if (c == '"')
+                param += '"';
+        }
+        param += "\"*";
+        return column + " MATCH ?1";
+    default:
+        param = "%" + filter.value + "%";
+        return column + " LIKE ?1";
+    }
+}
+
+/**
+ * @brief Count rows (no caching)
+ *
+ * Unfiltered, non-exact counts come from sqlite_stat1 when ANALYZE has been
+ * run and are marked approximate; everything else runs COUNT(*).
+ */
+static bool computeRowCount(sqlite3 *db, const std::string &database, const std::string &tableName,
+                            const RowFilter &filter, bool exact, RowCount &count, std::string &error)
+{
+    if (!filter.isActive() && !exact)
+    {
+        // The first number of a stat row is the table's row count; missing table = not analyzed
+        SqliteStatement stat(db, "SELECT stat FROM " + quoteIdentifier(database) +
+                                     ".sqlite_stat1 WHERE tbl = ?1 ORDER BY idx IS NOT NULL LIMIT 1");
+        if (stat)
+        {
+            sqlite3_bind_text(stat.get(), 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(stat.get()) == SQLITE_ROW)
+            {
+                auto text = reinterpret_cast<const char *>(sqlite3_column_text(stat.get(), 0));
+                long long rows = 0;
+                if (text && std::from_chars(text, text + std::char_traits<char>::length(text), rows).ec == std::errc())
+                {
+                    count.value = rows;
+                    count.approximate = true;
+                    return true;
+                }
+            }
+        }
+    }
+
+    std::string sql = "SELECT COUNT(*) FROM " + quoteIdentifier(database) + "." + quoteIdentifier(tableName);
+    std::string filterParam;
+    std::string predicate = filterPredicate(filter, filterParam);
+    if (!predicate.empty())
+        sql += " WHERE " + predicate;
+
+    SqliteStatement stmt(db, sql);
+    if (!stmt)
+    {
+        error = sqlite3_errmsg(db);
+        return false;
+    }
+
+    if (!predicate.empty())
+        sqlite3_bind_text(stmt.get(), 1, filterParam.c_str(), -1, SQLITE_TRANSIENT);
+
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW)
+    {
+        error = sqlite3_errmsg(db);
+        return false;
+    }
+
+    count.value = sqlite3_column_int64(stmt.get(), 0);
+    count.approximate = false;
+    return true;
+}
+
+/**
+ * @brief Forward-only read of a query on a connection of its own to the database file
+ *
+ * The statement stays open between batches. Like any SQLite reader it holds
+ * a shared lock until the rows are exhausted, which keeps writers out in
+ * rollback journal mode (not in WAL mode).
+ */
+class SqliteCursor final : public RowCursor
+{
+  public:
+    SqliteCursor(sqlite3 *db, CancellationToken &cancel) : m_db(db), m_cancel(cancel)
+    {
+        m_cancelScope = std::make_unique<SqliteCancelScope>(m_db, m_cancel);
+    }
+
+    ~SqliteCursor() override
+    {
+        finish();
+    }
+
+    SqliteCursor(const SqliteCursor &) = delete;
+    SqliteCursor &operator=(const SqliteCursor &) = delete;
+
+    /**
+     * @param params Values bound to the placeholders, in order (filter value, then key range bounds)
+     * @param declaredTypes Declared types of the selected columns, by position
+     */
+    bool prepare(const std::string &sql, const std::vector<std::string> &params,
+                 std::vector<std::string> declaredTypes)
+    {
+        m_stmt = std::make_unique<SqliteStatement>(m_db, sql);
+        if (!*m_stmt)
+        {
+            m_error = sqlite3_errmsg(m_db);
+            finish();
+            return false;
+        }
+
+        int number = 1;
+        for (const std::string &value : params)
+            sqlite3_bind_text(m_stmt->get(), number++, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+        m_declaredTypes = std::move(declaredTypes);
+        return true;
+    }
+
+    bool fetch(ResultSet &batch, size_t maxRows) override
+    {
+        batch.clearRows();
+        if (!m_stmt)
+            return m_error.empty();
+
+        int numCols = sqlite3_column_count(m_stmt->get());
+        if (batch.columnCount() == 0)
+        {
+            for (int i = 0; i < numCols; i++)
+            {
+                ValueKind kind = m_kinds.empty() ? declaredKind(i) : m_kinds[i];
+                batch.addColumn(sqlite3_column_name(m_stmt->get(), i), kind);
+            }
+        }
+
+        for (size_t row = 0; row < maxRows; row++)
+        {
+            int rc = sqlite3_step(m_stmt->get());
+            if (rc == SQLITE_DONE)
+            {
+                finish();
+                break;
+            }
+            if (rc != SQLITE_ROW)
+            {
+                m_error = rc == SQLITE_INTERRUPT ? m_cancel.reason() : sqlite3_errmsg(m_db);
+                finish();
+                return false;
+            }
+
+            for (int i = 0; i < numCols; i++)
+            {
+                appendCell(m_stmt->get(), i, batch);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Step through every row once for the kinds that hold them all, then rewind
+     *
+     * Runs in a read transaction that lasts until the cursor closes, so the
+     * rows fetched afterwards are the ones scanned.
+     */
+    bool settleKinds() override
+    {
+        if (!m_stmt)
+            return m_error.empty();
+
+        sqlite3_exec(m_db, "BEGIN", nullptr, nullptr, nullptr);
+
+        int numCols = sqlite3_column_count(m_stmt->get());
+        m_kinds.clear();
+        for (int i = 0; i < numCols; i++)
+            m_kinds.push_back(declaredKind(i));
+
+        int rc;
+        while ((rc = sqlite3_step(m_stmt->get())) == SQLITE_ROW)
+        {
+            for (int i = 0; i < numCols; i++)
+                m_kinds[i] = widenedKind(m_stmt->get(), i, m_kinds[i]);
+        }
+        if (rc != SQLITE_DONE)
+        {
+            m_error = rc == SQLITE_INTERRUPT ? m_cancel.reason() : sqlite3_errmsg(m_db);
+            finish();
+            return false;
+        }
+
+        sqlite3_reset(m_stmt->get());
+        return true;
+    }
+
+  private:
+    ValueKind declaredKind(int column) const
+    {
+        const char *declared = sqlite3_column_decltype(m_stmt->get(), column);
+        if (!declared && static_cast<size_t>(column) < m_declaredTypes.size())
+            declared = m_declaredTypes[column].c_str();
+        return kindForDeclaredType(declared);
+    }
+
+    void finish()
+    {
+        m_stmt.reset();
+        m_cancelScope.reset();
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+
+    sqlite3 *m_db;
+    CancellationToken &m_cancel;
+    std::unique_ptr<SqliteCancelScope> m_cancelScope;
+    std::unique_ptr<SqliteStatement> m_stmt;
+    std::vector<std::string> m_declaredTypes;
+    std::vector<ValueKind> m_kinds; ///< Set by settleKinds()
+};
+
+/**
+ * @class SqliteChangeSource
+ * @brief Changes of a table from PRAGMA data_version and the largest rowid
+ *
+ * data_version moves whenever another connection commits to the database
+ * file, so an unchanged version ends a poll at once. Rows past the previous
+ * largest rowid are new; a commit that added none (an update, a delete, or
+ * a write to another table) makes the table stale. WITHOUT ROWID tables only
+ * have the version to go by.
+ */
+class SqliteChangeSource final : public ChangeSource
+{
+  public:
+    SqliteChangeSource(sqlite3 *db, std::string fullTableName) : m_db(db), m_fullTableName(std::move(fullTableName))
+    {
+    }
+
+    ~SqliteChangeSource() override
+    {
+        m_rowid.reset();
+        sqlite3_close(m_db);
+    }
+
+    SqliteChangeSource(const SqliteChangeSource &) = delete;
+    SqliteChangeSource &operator=(const SqliteChangeSource &) = delete;
+
+    bool start(CancellationToken &cancel, std::string &error)
+    {
+        SqliteCancelScope cancelScope(m_db, cancel);
+        if (!readScalar("PRAGMA data_version", m_version, cancel, error))
+            return false;
+
+        // Preparing fails on a WITHOUT ROWID table, which has no rowid to go by
+        m_rowid = std::make_unique<SqliteStatement>(m_db, "SELECT max(rowid) FROM " + m_fullTableName);
+        if (!*m_rowid)
+            m_rowid.reset();
+        return !m_rowid || readMaxRowid(m_mark, cancel, error);
+    }
+
+    const char *method() const override
+    {
+        return m_rowid ? "key" : "dataversion";
+    }
+
+    bool poll(ChangeBatch &changes, CancellationToken &cancel, std::string &error) override
+    {
+        SqliteCancelScope cancelScope(m_db, cancel);
+        long long version = 0;
+        if (!readScalar("PRAGMA data_version", version, cancel, error))
+            return false;
+        if (version == m_version)
+            return true;
+
+        long long mark = m_mark;
+        if (m_rowid && !readMaxRowid(mark, cancel, error))
+            return false;
+
+        if (mark > m_mark)
+        {
+            SqliteStatement stmt(m_db, "SELECT * FROM " + m_fullTableName +
+                                           " WHERE rowid > ?1 AND rowid <= ?2 ORDER BY rowid LIMIT " +
+                                           std::to_string(kMaxRows + 1));
+            if (!stmt)
+            {
+                error = sqlite3_errmsg(m_db);
+                return false;
+            }
+            sqlite3_bind_int64(stmt.get(), 1, m_mark);
+            sqlite3_bind_int64(stmt.get(), 2, mark);
+
+            int numCols = sqlite3_column_count(stmt.get());
+            for (int i = 0; i < numCols; i++)
+                changes.rows.addColumn(sqlite3_column_name(stmt.get(), i),
+                                       kindForDeclaredType(sqlite3_column_decltype(stmt.get(), i)));
+
+            int rc;
+            while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            {
+                for (int i = 0; i < numCols; i++)
+                    appendCell(stmt.get(), i, changes.rows);
+            }
+            if (rc != SQLITE_DONE)
+            {
+                error = rc == SQLITE_INTERRUPT ? cancel.reason() : sqlite3_errmsg(m_db);
+                return false;
+            }
+        }
+
+        if (changes.rows.rowCount() == 0 || changes.rows.rowCount() > kMaxRows)
+        {
+            changes.rows.clearRows();
+            changes.stale = true;
+        }
+        m_version = version;
+        m_mark = mark;
+        return true;
+    }
+
+  private:
+    bool readScalar(const std::string &sql, long long &value, CancellationToken &cancel, std::string &error)
+    {
+        SqliteStatement stmt(m_db, sql);
+        return stmt && step(stmt, value, cancel, error);
+    }
+
+    bool readMaxRowid(long long &value, CancellationToken &cancel, std::string &error)
+    {
+        return step(*m_rowid, value, cancel, error);
+    }
+
+    // Read the first column of the single row of @p stmt; NULL (an empty table) reads as the smallest value
+    bool step(SqliteStatement &stmt, long long &value, CancellationToken &cancel, std::string &error)
+    {
+        int rc = sqlite3_step(stmt.get());
+        if (rc != SQLITE_ROW)
+        {
+            error = rc == SQLITE_INTERRUPT ? cancel.reason() : sqlite3_errmsg(m_db);
+            sqlite3_reset(stmt.get());
+            return false;
+        }
+        value = sqlite3_column_type(stmt.get(), 0) == SQLITE_NULL ? std::numeric_limits<long long>::min()
+                                                                  : sqlite3_column_int64(stmt.get(), 0);
+        sqlite3_reset(stmt.get());
+        return true;
+    }
+
+    sqlite3 *m_db;
+    const std::string m_fullTableName;
+    std::unique_ptr<SqliteStatement> m_rowid; ///< SELECT max(rowid); none on a WITHOUT ROWID table
+    long long m_version = 0;
+    long long m_mark = 0;
+};
+
+/**
+ * @brief Bind a row of @p params to the placeholders of @p stmt
+ *
+ * Cells are bound as text, which the column's affinity converts, except on
+ * binary columns, which take "0x" hex and are bound decoded as blobs.
+ *
+ * @param bytes Scratch space for decoded blobs
+ * @return SQLITE_OK, or an error code with @p error set for a malformed blob
+ */
+static int bindRow(sqlite3_stmt *stmt, const ResultSet &params, size_t row, const std::vector<bool> &binary,
+                   std::string &bytes, std::string &error)
+{
+    int rc = SQLITE_OK;
+    for (size_t c = 0; c < binary.size() && rc == SQLITE_OK; c++)
+    {
+        int number = static_cast<int>(c + 1);
+        std::string_view text = params.value(row, c);
+        if (params.isNull(row, c))
+        {
+            rc = sqlite3_bind_null(stmt, number);
+        }
+        else if (!binary[c])
+        {
+            rc = sqlite3_bind_text(stmt, number, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+        }
+        else if (decodeHex(text, bytes))
+        {
+            rc = sqlite3_bind_blob(stmt, number, bytes.data(), static_cast<int>(bytes.size()), SQLITE_TRANSIENT);
+        }
+        else
+        {
+            error = "Column " + params.columnName(c) + " takes binary values written as 0x and hex digits";
+            rc = SQLITE_MISMATCH;
+        }
+    }
+    return rc;
+}
+
+/**
+ * @brief Inserts on a connection of its own through one prepared statement, a transaction per batch
+ *
+ * SQLite has no parameter arrays: inside a transaction, resetting and
+ * rebinding the statement is about as cheap per row.
+ */
+class SqliteWriter final : public RowWriter
+{
+  public:
+    /**
+     * @param binary Per column: true for BLOB columns, which take decoded "0x" hex instead of text
+     */
+    SqliteWriter(sqlite3 *db, CancellationToken &cancel, std::vector<bool> binary)
+        : m_db(db), m_cancel(cancel), m_binary(std::move(binary))
+    {
+        m_cancelScope = std::make_unique<SqliteCancelScope>(m_db, m_cancel);
+    }
+
+    ~SqliteWriter() override
+    {
+        // Closing the connection rolls back a transaction left open
+        m_stmt.reset();
+        m_cancelScope.reset();
+        sqlite3_close(m_db);
+    }
+
+    SqliteWriter(const SqliteWriter &) = delete;
+    SqliteWriter &operator=(const SqliteWriter &) = delete;
+
+    bool prepare(const std::string &sql)
+    {
+        m_stmt = std::make_unique<SqliteStatement>(m_db, sql);
+        if (!*m_stmt)
+        {
+            m_error = sqlite3_errmsg(m_db);
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const ResultSet &batch) override
+    {
+        m_error.clear();
+        m_failedRow = -1;
+        if (!exec("BEGIN IMMEDIATE"))
+            return false;
+
+        sqlite3_stmt *stmt = m_stmt->get();
+        for (size_t row = 0; row < batch.rowCount(); row++)
+        {
+            int rc = bindRow(stmt, batch, row, m_binary, m_bytes, m_error);
+            if (rc == SQLITE_OK)
+                rc = sqlite3_step(stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                m_failedRow = static_cast<long long>(row);
+                if (m_error.empty())
+                    m_error = rc == SQLITE_INTERRUPT ? m_cancel.reason() : sqlite3_errmsg(m_db);
+                sqlite3_reset(stmt);
+                exec("ROLLBACK");
+                return false;
+            }
+            sqlite3_reset(stmt);
+        }
+
+        if (!exec("COMMIT"))
+        {
+            exec("ROLLBACK");
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    bool exec(const char *sql)
+    {
+        if (sqlite3_exec(m_db, sql, nullptr, nullptr, nullptr) == SQLITE_OK)
+            return true;
+        if (m_error.empty())
+            m_error = sqlite3_errmsg(m_db);
+        return false;
+    }
+
+    sqlite3 *m_db;
+    CancellationToken &m_cancel;
+    std::unique_ptr<SqliteCancelScope> m_cancelScope;
+    std::unique_ptr<SqliteStatement> m_stmt;
+    std::vector<bool> m_binary;
+    std::string m_bytes;
+};
+
+/**
+ * @brief SQLite session: attached databases (main, ...) double as databases and schemas,
+ * LIMIT/OFFSET pagination, "double quoted" identifiers
+ */
+class SqliteBackend final : public DataBackend
+{
+  public:
+    ~SqliteBackend() override
+    {
+        disconnect();
+    }
+
+    bool connect(const std::string &connectionString) override
+    {
+        disconnect();
+
+        std::string dataSource = getConnectionStringValue(connectionString, "Data Source");
+        if (dataSource.empty())
+        {
+            m_lastError = "Data Source required";
+            return false;
+        }
+        if (!resolveDataSource(dataSource, m_path, m_lastError))
+            return false;
+
+        m_db = openDatabase(m_path, m_lastError);
+        if (!m_db)
+            return false;
+
+        m_lastError.clear();
+        m_currentDatabase = "main";
+        return true;
+    }
+
+    void disconnect() override
+    {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+
+    bool isConnected() const override
+    {
+        return m_db != nullptr;
+    }
+
+    std::unique_ptr<DataBackend> snapshot() const override
+    {
+        // Opened on a connection of its own, like a cursor
+        if (!m_db)
+            return nullptr;
+
+        std::string error;
+        sqlite3 *db = openDatabase(m_path, error);
+        if (!db)
+            return nullptr;
+
+        auto copy = std::make_unique<SqliteBackend>();
+        copy->m_db = db;
+        copy->m_path = m_path;
+        copy->m_currentDatabase = m_currentDatabase;
+        return copy;
+    }
+
+    std::vector<std::string> getDatabases(std::string &etag) override
+    {
+        etag.clear();
+        std::vector<std::string> databases;
+
+        if (!m_db)
+            return databases;
+
+        SqliteStatement stmt(m_db, "PRAGMA database_list");
+        if (!stmt)
+            return databases;
+
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+        {
+            auto name = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 1));
+            if (name && std::string(name) != "temp")
+                databases.push_back(name);
+        }
+
+        return databases;
+    }
+
+    bool useDatabase(const std::string &databaseName) override
+    {
+        if (!m_db || !isValidIdentifier(databaseName))
+            return false;
+
+        std::string etag;
+        for (const auto &name : getDatabases(etag))
+        {
+            if (name == databaseName)
+            {
+                m_currentDatabase = databaseName;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<TableInfo> getTables(std::string &etag) override
+    {
+        std::vector<TableInfo> tables;
+        etag.clear();
+
+        if (!m_db)
+            return tables;
+
+        SqliteStatement stmt(m_db, "SELECT name FROM " + quoteIdentifier(m_currentDatabase) +
+                                       ".sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%' "
+                                       "ORDER BY name");
+        if (!stmt)
+            return tables;
+
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+        {
+            TableInfo info;
+            info.schema = m_currentDatabase;
+            info.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0));
+            tables.push_back(info);
+        }
+
+        etag = makeSchemaETag();
+        return tables;
+    }
+
+    std::vector<ColumnInfo> getColumns(const std::string &schema, const std::string &tableName,
+                                       std::string &etag) override
+    {
+        std::vector<ColumnInfo> columns;
+        etag.clear();
+
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db || !isValidIdentifier(database) || !isValidIdentifier(tableName))
+            return columns;
+
+        SqliteStatement stmt(m_db, "PRAGMA " + quoteIdentifier(database) + ".table_info(" +
+                                       quoteIdentifier(tableName) + ")");
+        if (!stmt)
+            return columns;
+
+        std::unordered_set<std::string> indexed = loadIndexedColumns(database, tableName);
+        std::unordered_map<std::string, std::vector<ColumnReference>> foreignKeys =
+            loadForeignKeys(database, tableName);
+        bool fullText = isFts5Table(database, tableName);
+
+        // cid, name, type, notnull, dflt_value, pk
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+        {
+            auto type = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 2));
+
+            ColumnInfo col;
+            col.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 1));
+            col.type = type ? type : "";
+            col.nullable = sqlite3_column_int(stmt.get(), 3) == 0;
+            col.isPrimaryKey = sqlite3_column_int(stmt.get(), 5) > 0;
+            col.isIndexed = indexed.count(col.name) > 0;
+            col.isFullTextIndexed = fullText;
+
+            auto references = foreignKeys.find(col.name);
+            if (references != foreignKeys.end())
+            {
+                col.references = std::move(references->second);
+                for (ColumnReference &reference : col.references)
+                    reference.referencedSchema = database;
+            }
+            columns.push_back(col);
+        }
+
+        // An INTEGER PRIMARY KEY is the rowid: the table itself is ordered by it
+        size_t keyColumns = 0;
+        for (const auto &col : columns)
+            keyColumns += col.isPrimaryKey ? 1 : 0;
+        for (auto &col : columns)
+        {
+            if (keyColumns == 1 && col.isPrimaryKey && sqlite3_stricmp(col.type.c_str(), "INTEGER") == 0)
+                col.isIndexed = true;
+        }
+
+        etag = makeSchemaETag();
+        return columns;
+    }
+
+    QueryResult selectData(const std::string &schema, const std::string &tableName, const RowFilter &requested,
+                           const RowOrder &requestedOrder, const RowProjection &projection, int page, int pageSize,
+                           CountMode countMode, CancellationToken &cancel) override
+    {
+        QueryResult result;
+        result.success = false;
+
+        if (!m_db)
+        {
+            result.error = "Not connected to database";
+            return result;
+        }
+
+        SqliteCancelScope cancelScope(m_db, cancel);
+
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database))
+        {
+            result.error = "Invalid table or schema name";
+            return result;
+        }
+
+        if (!requested.column.empty() && !isValidIdentifier(requested.column))
+        {
+            result.error = "Invalid column name";
+            return result;
+        }
+
+        RowFilter filter = resolveFilter(database, tableName, requested);
+        result.filterMode = filter.mode;
+        std::string filterParam;
+        std::string predicate = filterPredicate(filter, filterParam);
+
+        bool projected = !projection.columns.empty() || projection.previewLength > 0;
+        std::vector<ColumnInfo> columns;
+        if (!requestedOrder.keys.empty() || projected)
+        {
+            std::string etag;
+            columns = getColumns(database, tableName, etag);
+        }
+
+        std::string orderBy;
+        std::string keyset;
+        std::vector<std::string> keysetParams;
+        bool uniqueOrder = false;
+        if (!requestedOrder.keys.empty())
+        {
+            if (!resolveSortOrder(requestedOrder.keys, columns, result.order, uniqueOrder, result.error))
+                return result;
+            orderBy = orderByList(result.order);
+        }
+
+        if (requestedOrder.isKeyset())
+        {
+            if (uniqueOrder)
+                keyset = keysetPredicate(result.order, requestedOrder.after, quoteIdentifier, keysetParams);
+            if (keyset.empty())
+            {
+                result.error = "Cursor does not match the sort";
+                return result;
+            }
+        }
+
+        // Declared types of the selected columns: SQLite reports none for the cut (substr) ones
+        std::string selectList = "*";
+        std::vector<std::string> declaredTypes;
+        if (projected && !makeSelectList(columns, projection, result, selectList, declaredTypes))
+            return result;
+
+        // Total count: served from the shared cache when possible
+        RowCount count;
+        bool pending = false;
+        std::string countKey = makeCountKey(database, tableName, filter);
+        auto &countCache = CountCache::getInstance();
+
+        if (countCache.lookup(countKey, count, pending) && (countMode != CountMode::Exact || !count.approximate))
+        {
+            result.totalRows = count.value;
+            result.totalRowsApproximate = count.approximate;
+        }
+        else if (countMode == CountMode::Deferred)
+        {
+            startDeferredCount(countKey, database, tableName, filter);
+            result.totalRowsPending = true;
+        }
+        else
+        {
+            std::string error;
+            if (!computeRowCount(m_db, database, tableName, filter, countMode == CountMode::Exact, count, error))
+            {
+                result.error = cancel.isCancelled() ? cancel.reason() : error;
+                return result;
+            }
+            countCache.store(countKey, count);
+            result.totalRows = count.value;
+            result.totalRowsApproximate = count.approximate;
+        }
+
+        // A keyset cursor seeks to the page instead of skipping rows
+        std::string sql =
+            "SELECT " + selectList + " FROM " + quoteIdentifier(database) + "." + quoteIdentifier(tableName);
+        if (!predicate.empty() && !keyset.empty())
+            sql += " WHERE " + predicate + " AND " + keyset;
+        else if (!predicate.empty() || !keyset.empty())
+            sql += " WHERE " + predicate + keyset;
+        if (!orderBy.empty())
+            sql += " ORDER BY " + orderBy;
+        sql += " LIMIT " + std::to_string(pageSize);
+        if (keyset.empty())
+            sql += " OFFSET " + std::to_string((page - 1) * pageSize);
+
+        SqliteStatement stmt(m_db, sql);
+        if (!stmt)
+        {
+            result.error = sqlite3_errmsg(m_db);
+            return result;
+        }
+
+        int param = 1;
+        if (!predicate.empty())
+            sqlite3_bind_text(stmt.get(), param++, filterParam.c_str(), -1, SQLITE_TRANSIENT);
+        for (const std::string &value : keysetParams)
+            sqlite3_bind_text(stmt.get(), param++, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+
+        int numCols = sqlite3_column_count(stmt.get());
+        for (int i = 0; i < numCols; i++)
+        {
+            const char *declared = sqlite3_column_decltype(stmt.get(), i);
+            if (!declared && static_cast<size_t>(i) < declaredTypes.size())
+                declared = declaredTypes[i].c_str();
+            result.data.addColumn(sqlite3_column_name(stmt.get(), i), kindForDeclaredType(declared));
+        }
+
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+        {
+            for (int i = 0; i < numCols; i++)
+            {
+                appendCell(stmt.get(), i, result.data);
+            }
+        }
+
+        if (rc != SQLITE_DONE)
+        {
+            result.error = rc == SQLITE_INTERRUPT ? cancel.reason() : sqlite3_errmsg(m_db);
+            return result;
+        }
+
+        if (uniqueOrder && result.data.rowCount() == static_cast<size_t>(pageSize))
+            readLastKey(result.data, result.order, result.lastKey);
+
+        result.success = true;
+        return result;
+    }
+
+    RowCounter prepareCount(const std::string &schema, const std::string &tableName, const RowFilter &requested,
+                            bool exact) override
+    {
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db || !isValidIdentifier(tableName) || !isValidIdentifier(database) ||
+            (!requested.column.empty() && !isValidIdentifier(requested.column)))
+            return nullptr;
+
+        RowFilter filter = resolveFilter(database, tableName, requested);
+        std::string countKey = makeCountKey(database, tableName, filter);
+        std::string path = m_path;
+
+        return [=](RowCount &count, CancellationToken &cancel) {
+            auto &countCache = CountCache::getInstance();
+            bool pending = false;
+            if (countCache.lookup(countKey, count, pending) && (!exact || !count.approximate))
+                return true;
+
+            // A deferred count for this key is already running: pick up its result
+            if (pending && countCache.waitFor(countKey, count, cancel.remaining(kDeferredCountWait)) &&
+                (!exact || !count.approximate))
+                return true;
+
+            // Counted on a connection of its own, like a cursor
+            std::string error;
+            sqlite3 *db = openDatabase(path, error);
+            if (!db)
+                return false;
+
+            bool counted;
+            {
+                SqliteCancelScope cancelScope(db, cancel);
+                counted = computeRowCount(db, database, tableName, filter, exact, count, error);
+            }
+            sqlite3_close(db);
+            if (!counted)
+                return false;
+
+            countCache.store(countKey, count);
+            return true;
+        };
+    }
+
+    QueryResult selectByKeys(const std::string &schema, const std::string &tableName,
+                             const std::vector<std::string> &keyColumns,
+                             const std::vector<std::vector<std::string>> &keys, const RowProjection &projection,
+                             CancellationToken &cancel) override
+    {
+        QueryResult result;
+        result.success = false;
+
+        if (!m_db)
+        {
+            result.error = "Not connected to database";
+            return result;
+        }
+
+        SqliteCancelScope cancelScope(m_db, cancel);
+
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database))
+        {
+            result.error = "Invalid table or schema name";
+            return result;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(database, tableName, etag);
+        for (const std::string &key : keyColumns)
+        {
+            if (std::none_of(columns.begin(), columns.end(), [&](const ColumnInfo &col) { return col.name == key; }))
+            {
+                result.error = "Column not found: " + key;
+                return result;
+            }
+        }
+        if (keyColumns.empty())
+        {
+            result.error = "No key columns";
+            return result;
+        }
+
+        std::string selectList = "*";
+        std::vector<std::string> declaredTypes;
+        if (projection.previewLength > 0 &&
+            !makeSelectList(columns, projection, result, selectList, declaredTypes))
+            return result;
+
+        // Batches of keys append to the same rows; without keys one query still reads the columns
+        size_t perQuery = std::max<size_t>(1, kMaxKeyParams / keyColumns.size());
+        for (size_t first = 0; first == 0 || first < keys.size(); first += perQuery)
+        {
+            size_t count = std::min(perQuery, keys.size() - first);
+            SqliteStatement stmt(m_db, "SELECT " + selectList + " FROM " + quoteIdentifier(database) + "." +
+                                           quoteIdentifier(tableName) + " WHERE " +
+                                           keyMatchPredicate(keyColumns, count, quoteIdentifier));
+            if (!stmt)
+            {
+                result.error = sqlite3_errmsg(m_db);
+                return result;
+            }
+
+            int param = 1;
+            for (size_t k = first; k < first + count; k++)
+            {
+                for (const std::string &value : keys[k])
+                    sqlite3_bind_text(stmt.get(), param++, value.data(), static_cast<int>(value.size()),
+                                      SQLITE_TRANSIENT);
+            }
+
+            int numCols = sqlite3_column_count(stmt.get());
+            bool describe = result.data.columnCount() == 0;
+            for (int i = 0; describe && i < numCols; i++)
+            {
+                const char *declared = sqlite3_column_decltype(stmt.get(), i);
+                if (!declared && static_cast<size_t>(i) < declaredTypes.size())
+                    declared = declaredTypes[i].c_str();
+                result.data.addColumn(sqlite3_column_name(stmt.get(), i), kindForDeclaredType(declared));
+            }
+
+            int rc;
+            while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            {
+                for (int i = 0; i < numCols; i++)
+                    appendCell(stmt.get(), i, result.data);
+            }
+
+            if (rc != SQLITE_DONE)
+            {
+                result.error = rc == SQLITE_INTERRUPT ? cancel.reason() : sqlite3_errmsg(m_db);
+                return result;
+            }
+        }
+
+        result.success = true;
+        return result;
+    }
+
+    std::unique_ptr<RowCursor> openCursor(const std::string &schema, const std::string &tableName,
+                                          const RowFilter &requested, const KeyRange &range,
+                                          const std::vector<SortKey> &sort,
+                                          const std::vector<std::string> &columnNames, CancellationToken &cancel,
+                                          std::string &error) override
+    {
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db)
+        {
+            error = "Not connected to database";
+            return nullptr;
+        }
+
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database) ||
+            (!requested.column.empty() && !isValidIdentifier(requested.column)) ||
+            (!range.column.empty() && !isValidIdentifier(range.column)))
+        {
+            error = "Invalid table, schema or column name";
+            return nullptr;
+        }
+
+        RowFilter filter = resolveFilter(database, tableName, requested);
+        std::vector<std::string> params(1);
+        std::string predicate = filterPredicate(filter, params[0]);
+        if (predicate.empty())
+            params.clear();
+
+        std::vector<std::string> rangeParams;
+        std::string rangePredicate = keyRangePredicate(range, quoteIdentifier, rangeParams);
+        if (!rangePredicate.empty())
+        {
+            predicate += (predicate.empty() ? "" : " AND ") + rangePredicate;
+            params.insert(params.end(), rangeParams.begin(), rangeParams.end());
+        }
+
+        std::vector<ColumnInfo> columns;
+        if (!sort.empty() || !columnNames.empty())
+        {
+            std::string etag;
+            columns = getColumns(database, tableName, etag);
+        }
+
+        std::vector<SortKey> order;
+        bool uniqueOrder = false;
+        if (!sort.empty() && !resolveSortOrder(sort, columns, order, uniqueOrder, error))
+            return nullptr;
+
+        std::string selectList = "*";
+        std::vector<std::string> declaredTypes;
+        if (!columnNames.empty())
+        {
+            std::vector<const ColumnInfo *> projected;
+            if (!resolveProjection(columnNames, columns, order, projected, error))
+                return nullptr;
+
+            selectList.clear();
+            for (const ColumnInfo *column : projected)
+            {
+                selectList += (selectList.empty() ? "" : ", ") + quoteIdentifier(column->name);
+                declaredTypes.push_back(column->type);
+            }
+        }
+
+        std::string sql =
+            "SELECT " + selectList + " FROM " + quoteIdentifier(database) + "." + quoteIdentifier(tableName);
+        if (!predicate.empty())
+            sql += " WHERE " + predicate;
+        if (!order.empty())
+            sql += " ORDER BY " + orderByList(order);
+
+        // The session's connection stays free for browsing while the rows are read
+        sqlite3 *db = openDatabase(m_path, error);
+        if (!db)
+            return nullptr;
+
+        auto cursor = std::make_unique<SqliteCursor>(db, cancel);
+        if (!cursor->prepare(sql, params, std::move(declaredTypes)))
+        {
+            error = cursor->error();
+            return nullptr;
+        }
+        return cursor;
+    }
+
+    std::unique_ptr<RowWriter> openWriter(const std::string &schema, const std::string &tableName,
+                                          const std::vector<std::string> &columnNames, CancellationToken &cancel,
+                                          std::string &error) override
+    {
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db)
+        {
+            error = "Not connected to database";
+            return nullptr;
+        }
+        if (!s_writable)
+        {
+            error = "SQLite writes are disabled";
+            return nullptr;
+        }
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database))
+        {
+            error = "Invalid table or schema name";
+            return nullptr;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(database, tableName, etag);
+        std::vector<const ColumnInfo *> targets;
+        if (!resolveInsertColumns(columnNames, columns, targets, error))
+            return nullptr;
+
+        std::string columnList;
+        std::string placeholders;
+        std::vector<bool> binary;
+        for (const ColumnInfo *column : targets)
+        {
+            columnList += (binary.empty() ? "" : ", ") + quoteIdentifier(column->name);
+            placeholders += binary.empty() ? "?" : ", ?";
+            binary.push_back(kindForDeclaredType(column->type.c_str()) == ValueKind::Binary);
+        }
+        std::string sql = "INSERT INTO " + quoteIdentifier(database) + "." + quoteIdentifier(tableName) + " (" +
+                          columnList + ") VALUES (" + placeholders + ")";
+
+        // The session's connection stays free for browsing while the rows are written
+        sqlite3 *db = openDatabase(m_path, error);
+        if (!db)
+            return nullptr;
+
+        auto writer = std::make_unique<SqliteWriter>(db, cancel, std::move(binary));
+        if (!writer->prepare(sql))
+        {
+            error = writer->error();
+            return nullptr;
+        }
+        return writer;
+    }
+
+    bool applyChanges(const std::string &schema, const std::string &tableName, const std::vector<RowChange> &changes,
+                      CancellationToken &cancel, EditResult &result, std::string &error) override
+    {
+        result = EditResult();
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db)
+        {
+            error = "Not connected to database";
+            return false;
+        }
+        if (!s_writable)
+        {
+            error = "SQLite writes are disabled";
+            return false;
+        }
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database))
+        {
+            error = "Invalid table or schema name";
+            return false;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(database, tableName, etag);
+        if (columns.empty())
+        {
+            error = "Failed to read the columns of " + tableName;
+            return false;
+        }
+
+        // SQLite has no rowversion: a change carrying a version is refused
+        std::vector<EditStatement> statements;
+        if (!planEdit(changes, columns, nullptr, statements, result.failedChange, error))
+            return false;
+
+        // An edit is a few statements: it runs on the session's connection, which the session lock serializes
+        SqliteCancelScope cancelScope(m_db, cancel);
+        if (sqlite3_exec(m_db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            error = sqlite3_errmsg(m_db);
+            return false;
+        }
+        auto rollback = [&]() { sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr); };
+
+        std::string table = quoteIdentifier(database) + "." + quoteIdentifier(tableName);
+        EditResult applied;
+        std::string bytes;
+        for (const EditStatement &statement : statements)
+        {
+            std::vector<bool> binary;
+            for (const ColumnInfo *column : statement.values)
+                binary.push_back(kindForDeclaredType(column->type.c_str()) == ValueKind::Binary);
+            for (const ColumnInfo *column : statement.key)
+                binary.push_back(kindForDeclaredType(column->type.c_str()) == ValueKind::Binary);
+
+            SqliteStatement stmt(m_db, editStatementSql(statement, table, quoteIdentifier));
+            if (!stmt)
+            {
+                error = sqlite3_errmsg(m_db);
+                result.failedChange = static_cast<long long>(statement.firstChange);
+                rollback();
+                return false;
+            }
+            applied.statements++;
+
+            for (size_t row = 0; row < statement.params.rowCount(); row++)
+            {
+                int rc = bindRow(stmt.get(), statement.params, row, binary, bytes, error);
+                if (rc == SQLITE_OK)
+                    rc = sqlite3_step(stmt.get());
+                if (rc == SQLITE_DONE && statement.kind != ChangeKind::Insert && sqlite3_changes(m_db) == 0)
+                {
+                    result.conflict = true;
+                    error = "Row not found, or changed since it was read";
+                }
+                if (rc != SQLITE_DONE || result.conflict)
+                {
+                    if (error.empty())
+                        error = rc == SQLITE_INTERRUPT ? cancel.reason() : sqlite3_errmsg(m_db);
+                    result.failedChange = static_cast<long long>(statement.firstChange + row);
+                    sqlite3_reset(stmt.get());
+                    rollback();
+                    return false;
+                }
+                sqlite3_reset(stmt.get());
+            }
+
+            size_t count = statement.params.rowCount();
+            if (statement.kind == ChangeKind::Insert)
+                applied.inserted += count;
+            else if (statement.kind == ChangeKind::Update)
+                applied.updated += count;
+            else
+                applied.deleted += count;
+        }
+
+        if (sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            error = sqlite3_errmsg(m_db);
+            rollback();
+            return false;
+        }
+        result = applied;
+        return true;
+    }
+
+    bool splitKeyRange(const std::string &schema, const std::string &tableName, size_t parts, std::string &keyColumn,
+                       std::vector<std::string> &bounds, CancellationToken &cancel, std::string &error) override
+    {
+        bounds.clear();
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db)
+        {
+            error = "Not connected to database";
+            return false;
+        }
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database))
+        {
+            error = "Invalid table or schema name";
+            return false;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(database, tableName, etag);
+        const ColumnInfo *key = singlePrimaryKey(columns);
+        if (!key)
+        {
+            error = "Table has no single-column primary key";
+            return false;
+        }
+        keyColumn = key->name;
+        if (parts < 2)
+            return true;
+
+        RowCount count;
+        if (!countRows(database, tableName, RowFilter(), false, count, cancel))
+            count.value = 0;
+
+        // SQLite keeps no histogram by default: NTILE over a random sample of the key, read from its index
+        std::string column = quoteIdentifier(keyColumn);
+        long long sampleRate = keySampleRate(count.value, parts);
+        std::string sql = "SELECT MAX(k) FROM (SELECT " + column + " AS k, NTILE(" + std::to_string(parts) +
+                          ") OVER (ORDER BY " + column + ") AS part FROM " + quoteIdentifier(database) + "." +
+                          quoteIdentifier(tableName);
+        if (sampleRate > 1)
+            sql += " WHERE random() % " + std::to_string(sampleRate) + " = 0";
+        sql += ") GROUP BY part ORDER BY part";
+
+        SqliteCancelScope cancelScope(m_db, cancel);
+        SqliteStatement stmt(m_db, sql);
+        if (!stmt)
+        {
+            error = sqlite3_errmsg(m_db);
+            return false;
+        }
+
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+        {
+            int type = sqlite3_column_type(stmt.get(), 0);
+            if (type == SQLITE_BLOB)
+            {
+                error = "Binary keys cannot be split into ranges";
+                return false;
+            }
+            if (type != SQLITE_NULL)
+                bounds.emplace_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0)));
+        }
+        if (rc != SQLITE_DONE)
+        {
+            error = rc == SQLITE_INTERRUPT ? cancel.reason() : sqlite3_errmsg(m_db);
+            return false;
+        }
+
+        // The last part's top is the end of the table, which its range leaves open
+        if (!bounds.empty())
+            bounds.pop_back();
+        return true;
+    }
+
+    std::unique_ptr<ChangeSource> openChangeSource(const std::string &schema, const std::string &tableName,
+                                                   CancellationToken &cancel, std::string &error) override
+    {
+        std::string database = schema.empty() ? m_currentDatabase : schema;
+        if (!m_db)
+        {
+            error = "Not connected to database";
+            return nullptr;
+        }
+        if (!isValidIdentifier(tableName) || !isValidIdentifier(database))
+        {
+            error = "Invalid table or schema name";
+            return nullptr;
+        }
+
+        std::string etag;
+        if (getColumns(database, tableName, etag).empty())
+        {
+            error = "Table not found";
+            return nullptr;
+        }
+
+        // data_version only moves for commits of other connections: the source needs one of its own
+        sqlite3 *db = openDatabase(m_path, error);
+        if (!db)
+            return nullptr;
+
+        auto source = std::make_unique<SqliteChangeSource>(db, quoteIdentifier(database) + "." +
+                                                                   quoteIdentifier(tableName));
+        if (!source->start(cancel, error))
+            return nullptr;
+        return source;
+    }
+
+    std::string getConnectionInfo() const override
+    {
+        if (!m_db)
+            return m_lastError.empty() ? "Not connected" : m_lastError;
+
+        return "Connected to " + m_currentDatabase + " (SQLite)";
+    }
+
+    std::string getTargetKey() const override
+    {
+        if (!m_db)
+            return "";
+
+        return "sqlite:" + m_path + "/" + m_currentDatabase;
+    }
+
+  private:
+    std::string makeCountKey(const std::string &database, const std::string &tableName, const RowFilter &filter) const
+    {
+        return CountCache::makeKey("sqlite:" + m_path, database, tableName, filter);
+    }
+
+    static std::string orderByList(const std::vector<SortKey> &order)
+    {
+        std::string orderBy;
+        for (const SortKey &key : order)
+        {
+            orderBy += (orderBy.empty() ? "" : ", ") + quoteIdentifier(key.column);
+            orderBy += key.descending ? " DESC" : "";
+        }
+        return orderBy;
+    }
+
+    /**
+     * @brief SELECT list of a projection
+     *
+     * Previewed columns with text or blob affinity are cut with substr();
+     * their full lengths (characters, bytes for blobs) are selected after
+     * every other column, NULL where nothing was cut. Sort keys are read
+     * whole, as cursors are built from them, and so are the columns the
+     * projection asks for whole.
+     */
+    static bool makeSelectList(const std::vector<ColumnInfo> &columns, const RowProjection &projection,
+                               QueryResult &result, std::string &selectList, std::vector<std::string> &declaredTypes)
+    {
+        std::vector<const ColumnInfo *> projected;
+        if (!resolveProjection(projection.columns, columns, result.order, projected, result.error))
+            return false;
+        if (projected.empty())
+            return true;
+
+        std::string lengths;
+        std::string length = std::to_string(projection.previewLength);
+        selectList.clear();
+        for (size_t i = 0; i < projected.size(); i++)
+        {
+            const ColumnInfo &column = *projected[i];
+            std::string quoted = quoteIdentifier(column.name);
+            declaredTypes.push_back(column.type);
+            if (!selectList.empty())
+                selectList += ", ";
+
+            ValueKind kind = kindForDeclaredType(column.type.c_str());
+            bool sortKey = std::any_of(result.order.begin(), result.order.end(),
+                                       [&](const SortKey &key) { return key.column == column.name; }) ||
+                           std::find(projection.whole.begin(), projection.whole.end(), column.name) !=
+                               projection.whole.end();
+            if (projection.previewLength == 0 || sortKey || (kind != ValueKind::Text && kind != ValueKind::Binary))
+            {
+                selectList += quoted;
+                continue;
+            }
+
+            selectList += "substr(" + quoted + ", 1, " + length + ") AS " + quoted;
+            lengths += ", CASE WHEN length(" + quoted + ") > " + length + " THEN length(" + quoted + ") END";
+
+            PreviewColumn preview;
+            preview.column = i;
+            preview.lengthColumn = projected.size() + result.previews.size();
+            result.previews.push_back(preview);
+        }
+        selectList += lengths;
+        return true;
+    }
+
+    /**
+     * @brief Resolve Auto and FullText against the column's index metadata
+     */
+    RowFilter resolveFilter(const std::string &database, const std::string &tableName, const RowFilter &requested)
+    {
+        RowFilter filter = requested;
+        if (!filter.isActive() || (filter.mode != FilterMode::Auto && filter.mode != FilterMode::FullText))
+            return filter;
+
+        std::string etag;
+        auto columns = getColumns(database, tableName, etag);
+        auto column = std::find_if(columns.begin(), columns.end(),
+                                   [&](const ColumnInfo &info) { return info.name == filter.column; });
+        filter.mode = resolveFilterMode(filter.mode, column != columns.end() ? &*column : nullptr, filter.value);
+        return filter;
+    }
+
+    /**
+     * @brief Columns leading an index of the table
+     */
+    std::unordered_set<std::string> loadIndexedColumns(const std::string &database, const std::string &tableName)
+    {
+        std::unordered_set<std::string> indexed;
+        SqliteStatement stmt(m_db, "SELECT ii.name FROM pragma_index_list(?1, ?2) il "
+                                   "JOIN pragma_index_info(il.name, ?2) ii WHERE ii.seqno = 0");
+        if (!stmt)
+            return indexed;
+
+        sqlite3_bind_text(stmt.get(), 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt.get(), 2, database.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+        {
+            auto name = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0));
+            if (name)
+                indexed.insert(name);
+        }
+        return indexed;
+    }
+
+    /**
+     * @brief The foreign keys of a table, by referencing column
+     *
+     * SQLite does not name foreign keys: they are called <table>_fk<id>. A
+     * reference to the parent's primary key leaves out the columns, which are
+     * then read from the parent. A column in several foreign keys has one
+     * reference per key, in key order.
+     */
+    std::unordered_map<std::string, std::vector<ColumnReference>> loadForeignKeys(const std::string &database,
+                                                                                  const std::string &tableName)
+    {
+        std::unordered_map<std::string, std::vector<ColumnReference>> foreignKeys;
+        SqliteStatement stmt(m_db, "SELECT fk.id, fk.\"from\", fk.\"table\", coalesce(fk.\"to\", pk.name) "
+                                   "FROM pragma_foreign_key_list(?1, ?2) fk "
+                                   "LEFT JOIN pragma_table_info(fk.\"table\", ?2) pk "
+                                   "ON fk.\"to\" IS NULL AND pk.pk = fk.seq + 1 ORDER BY fk.id, fk.seq");
+        if (!stmt)
+            return foreignKeys;
+
+        sqlite3_bind_text(stmt.get(), 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt.get(), 2, database.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+        {
+            auto column = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 1));
+            auto table = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 2));
+            auto referenced = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 3));
+            if (!column || !table || !referenced)
+                continue;
+
+            ColumnReference reference;
+            reference.foreignKey = tableName + "_fk" + std::to_string(sqlite3_column_int(stmt.get(), 0));
+            reference.referencedTable = table;
+            reference.referencedColumn = referenced;
+            foreignKeys[column].push_back(std::move(reference));
+        }
+        return foreignKeys;
+    }
+
+    /**
+     * @brief True for FTS5 virtual tables, whose columns all take MATCH
+     */
+    bool isFts5Table(const std::string &database, const std::string &tableName)
+    {
+        SqliteStatement stmt(m_db, "SELECT sql FROM " + quoteIdentifier(database) +
+                                       ".sqlite_master WHERE type = 'table' AND name = ?1");
+        if (!stmt)
+            return false;
+
+        sqlite3_bind_text(stmt.get(), 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW)
+            return false;
+
+        auto text = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0));
+        std::string sql;
+        for (const char *c = text; c && *c; c++)
+            sql += static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+        return sql.rfind("create virtual table", 0) == 0 && sql.find("using fts5") != std::string::npos;
+    }
+
+    /**
+     * @brief ETag from the file's schema cookie, bumped by SQLite on every schema change
+     */
+    std::string makeSchemaETag()
+    {
+        SqliteStatement stmt(m_db, "PRAGMA " + quoteIdentifier(m_currentDatabase) + ".schema_version");
+        if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW)
+            return std::string();
+
+        return "\"sqlite-" + std::to_string(std::hash<std::string>{}(m_path)) + "-" + m_currentDatabase + "-" +
+               std::to_string(sqlite3_column_int64(stmt.get(), 0)) + "\"";
+    }
+
+    /**
+     * @brief Count in the background on a separate connection to the same file
+     */
+    void startDeferredCount(const std::string &countKey, const std::string &database, const std::string &tableName,
+                            const RowFilter &filter)
+    {
+        std::string path = m_path;
+
+        CountCache::getInstance().computeAsync(countKey, [=](RowCount &count) {
+            std::string error;
+            sqlite3 *db = openDatabase(path, error);
+            if (!db)
+                return false;
+
+            bool ok = computeRowCount(db, database, tableName, filter, false, count, error);
+            sqlite3_close(db);
+            return ok;
+        });
+    }
+
+    sqlite3 *m_db = nullptr;
+    std::string m_path;
+    std::string m_currentDatabase;
+    std::string m_lastError;
+};
+
+std::unique_ptr<DataBackend> createSqliteBackend()
+{
+    return std::make_unique<SqliteBackend>();
+}
+
+bool configureSqliteBackend(const std::string &directory, bool writable)
+{
+    std::error_code ec;
+    std::filesystem::path resolved = std::filesystem::canonical(directory, ec);
+    if (ec || !std::filesystem::is_directory(resolved, ec))
+        return false;
+
+    std::lock_guard<std::mutex> lock(s_configMutex);
+    s_allowedDirectory = resolved;
+    s_writable = writable;
+    return true;
+}
+
+} // namespace Data
+} // namespace Tootega
+
+#else
+
+namespace Tootega
+{
+namespace Data
+{
+
+std::unique_ptr<DataBackend> createSqliteBackend()
+{
+    return nullptr;
+}
+
+bool configureSqliteBackend(const std::string &, bool)
+{
+    return false;
+}
+
+} // namespace Data
+} // namespace Tootega
+
+#endif
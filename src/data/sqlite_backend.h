@@ -0,0 +1,38 @@
+/**
+ * @file sqlite_backend.h
+ * @brief Embedded SQLite backend
+ */
+
+#pragma once
+
+#include "data_backend.h"
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Create a backend for a "Provider=SQLite;Data Source=<file>" connection string
+ *
+ * Runs the Browseroso data path in process against a local file, so it can be
+ * benchmarked and regression tested without a SQL Server.
+ * @return nullptr when built without SQLite (TOOTEGA_HAS_SQLITE undefined)
+ */
+std::unique_ptr<DataBackend> createSqliteBackend();
+
+/**
+ * @brief Allow SQLite connections to the files under @p directory
+ *
+ * Until called with a directory, every SQLite connection is refused: a
+ * client must not open arbitrary files the server process can reach. Data
+ * Sources are resolved (symbolic links included) and refused when they
+ * land outside the directory; relative ones are taken from it.
+ *
+ * @param writable Open the files read-write, for imports and edits; read-only otherwise
+ * @return false if @p directory is not a directory, or the build has no SQLite
+ */
+bool configureSqliteBackend(const std::string &directory, bool writable);
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,2224 @@
+/**
+ * @file sqlserver_backend.cpp
+ * @brief SQL Server backend over ODBC implementation
+ */
+
+#include "sqlserver_backend.h"
+#include "connection_pool.h"
+#include "count_cache.h"
+#include "metadata_cache.h"
+#include "odbc_fetch.h"
+#include "odbc_utils.h"
+#include "query_executor.h"
+#include "utf8_transcode.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Forward-only read of a query on a leased pooled connection
+ *
+ * The statement stays open between batches; the connection goes back to
+ * the pool once the last row is read or the cursor is destroyed.
+ */
+class SqlServerCursor final : public RowCursor
+{
+  public:
+    SqlServerCursor(ConnectionLease lease, CancellationToken &cancel) : m_lease(std::move(lease))
+    {
+        // Reading the whole result may take long; only the cancellation stops it
+        m_lease->setQueryTimeout(0);
+        PooledConnection &connection = *m_lease;
+        m_registration = cancel.onCancel([&connection]() { connection.cancel(); });
+    }
+
+    /**
+     * @param param Filter value bound to the first placeholder (nullptr without a filter)
+     * @param keyParams Key range bounds bound to the placeholders after it
+     */
+    bool execute(const std::string &sql, const std::string *param, const std::vector<std::u16string> &keyParams)
+    {
+        m_stmt = std::make_unique<PooledStatement>(*m_lease);
+        if (!*m_stmt)
+        {
+            m_error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLPrepare(m_stmt->get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
+        SQLUSMALLINT number = 1;
+        if (SQL_SUCCEEDED(ret) && param)
+        {
+            ret = SQLBindParameter(m_stmt->get(), number++, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, param->size(),
+                                   0, (SQLCHAR *)param->c_str(), param->size(), NULL);
+        }
+
+        // The lengths must outlive SQLExecute
+        std::vector<SQLLEN> lengths(keyParams.size());
+        for (size_t i = 0; i < keyParams.size() && SQL_SUCCEEDED(ret); i++)
+        {
+            const std::u16string &value = keyParams[i];
+            lengths[i] = static_cast<SQLLEN>(value.size() * sizeof(char16_t));
+            ret = SQLBindParameter(m_stmt->get(), number++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR,
+                                   std::max<size_t>(value.size(), 1), 0, (SQLPOINTER)value.data(), lengths[i],
+                                   &lengths[i]);
+        }
+        if (SQL_SUCCEEDED(ret))
+            ret = SQLExecute(m_stmt->get());
+
+        if (!SQL_SUCCEEDED(ret))
+        {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    bool fetch(ResultSet &batch, size_t maxRows) override
+    {
+        batch.clearRows();
+        if (!m_stmt)
+            return m_error.empty();
+
+        SQLRETURN ret = fetchRows(m_stmt->get(), batch, maxRows);
+        if (ret == SQL_NO_DATA)
+        {
+            finish();
+        }
+        else if (!SQL_SUCCEEDED(ret))
+        {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    void fail()
+    {
+        m_error = getOdbcError(SQL_HANDLE_STMT, m_stmt->get());
+        // 08xxx: the connection itself failed
+        if (m_error.compare(0, 2, "08") == 0 || !m_lease->isAlive())
+            m_lease.markBroken();
+        finish();
+    }
+
+    void finish()
+    {
+        m_stmt.reset();
+        m_registration = CancellationToken::Registration();
+        m_lease.release();
+    }
+
+    // Destroyed in reverse order: the callback is gone before the statement, the statement before the lease
+    ConnectionLease m_lease;
+    std::unique_ptr<PooledStatement> m_stmt;
+    CancellationToken::Registration m_registration;
+};
+
+/**
+ * @brief A prepared statement executed over arrays of parameters
+ *
+ * The rows of a ResultSet are bound column by column, up to kParamsetRows
+ * of them per SQLExecute (SQL_ATTR_PARAMSET_SIZE), so each round trip runs
+ * the statement for a whole array of rows. Every cell of a column takes the
+ * widest one's room, so a paramset also ends before its buffers pass
+ * kMaxParamsetBytes: a few large cells shrink it instead of multiplying.
+ * Text is sent as UTF-16; binary columns take "0x" hex, sent decoded.
+ */
+class ParamArrayStatement
+{
+  public:
+    /// Rows bound per SQLExecute
+    static constexpr size_t kParamsetRows = 1000;
+
+    /// Buffer bytes bound per SQLExecute, all columns together; a single row may take more
+    static constexpr size_t kMaxParamsetBytes = 8 * 1024 * 1024;
+
+    /**
+     * @param binary Per parameter: true for binary columns
+     */
+    explicit ParamArrayStatement(std::vector<bool> binary) : m_binary(std::move(binary)), m_columns(m_binary.size())
+    {
+    }
+
+    ParamArrayStatement(const ParamArrayStatement &) = delete;
+    ParamArrayStatement &operator=(const ParamArrayStatement &) = delete;
+
+    bool prepare(PooledConnection &connection, const std::string &sql)
+    {
+        m_stmt = std::make_unique<PooledStatement>(connection);
+        if (!*m_stmt)
+        {
+            m_error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        m_statuses.resize(kParamsetRows);
+        SQLRETURN ret = SQLPrepare(m_stmt->get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
+        if (SQL_SUCCEEDED(ret))
+            ret = SQLSetStmtAttr(m_stmt->get(), SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+        if (SQL_SUCCEEDED(ret))
+            ret = SQLSetStmtAttr(m_stmt->get(), SQL_ATTR_PARAM_STATUS_PTR, m_statuses.data(), 0);
+        if (SQL_SUCCEEDED(ret))
+            ret = SQLSetStmtAttr(m_stmt->get(), SQL_ATTR_PARAMS_PROCESSED_PTR, &m_processed, 0);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            m_error = getOdbcError(SQL_HANDLE_STMT, m_stmt->get());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Execute the statement once per row of @p params
+     * @param rowCounts If given, set to the rows each execution affected, when the driver counts them apart;
+     *                  otherwise to one count per SQLExecute
+     * @return false with error() and failedRow() set at the first row that failed
+     */
+    bool execute(const ResultSet &params, std::vector<SQLLEN> *rowCounts)
+    {
+        m_error.clear();
+        m_failedRow = -1;
+        if (rowCounts)
+            rowCounts->clear();
+
+        for (size_t start = 0, count = 0; start < params.rowCount(); start += count)
+        {
+            count = paramsetRows(params, start);
+            if (!bind(params, start, count) || !run(start, count, rowCounts))
+                return false;
+        }
+        return true;
+    }
+
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+    long long failedRow() const
+    {
+        return m_failedRow;
+    }
+
+  private:
+    // Parameter array of a column: count cells of the widest cell's size, and their lengths
+    struct Column
+    {
+        std::vector<char> data;
+        std::vector<SQLLEN> lengths;
+    };
+
+    // Room a cell of @p size takes in a column's array
+    size_t cellBytes(size_t column, size_t size) const
+    {
+        // A UTF-8 cell never has more UTF-16 units than bytes, nor a hex cell more bytes than half its digits
+        return m_binary[column] ? std::max<size_t>(size / 2, 1) : std::max<size_t>(size, 1) * sizeof(char16_t);
+    }
+
+    // Rows from @p start whose arrays fit in kMaxParamsetBytes, at least one and at most kParamsetRows
+    size_t paramsetRows(const ResultSet &params, size_t start)
+    {
+        m_widest.assign(m_columns.size(), 0);
+        size_t end = std::min(params.rowCount(), start + kParamsetRows);
+        for (size_t r = start; r < end; r++)
+        {
+            size_t rowBytes = 0;
+            for (size_t c = 0; c < m_columns.size(); c++)
+                rowBytes += std::max(m_widest[c], cellBytes(c, params.value(r, c).size()));
+            if (r > start && rowBytes * (r - start + 1) > kMaxParamsetBytes)
+                return r - start;
+            for (size_t c = 0; c < m_columns.size(); c++)
+                m_widest[c] = std::max(m_widest[c], cellBytes(c, params.value(r, c).size()));
+        }
+        return end - start;
+    }
+
+    bool bind(const ResultSet &params, size_t start, size_t count)
+    {
+        for (size_t c = 0; c < m_columns.size(); c++)
+        {
+            Column &column = m_columns[c];
+            bool binary = m_binary[c];
+
+            size_t elementBytes = 0;
+            for (size_t r = start; r < start + count; r++)
+                elementBytes = std::max(elementBytes, cellBytes(c, params.value(r, c).size()));
+            size_t width = binary ? elementBytes : elementBytes / sizeof(char16_t);
+            column.data.resize(count * elementBytes);
+            column.lengths.assign(count, SQL_NULL_DATA);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (params.isNull(start + i, c))
+                    continue;
+                std::string_view text = params.value(start + i, c);
+                char *slot = column.data.data() + i * elementBytes;
+                if (binary)
+                {
+                    if (!decodeHex(text, m_bytes))
+                    {
+                        m_failedRow = static_cast<long long>(start + i);
+                        m_error =
+                            "Column " + params.columnName(c) + " takes binary values written as 0x and hex digits";
+                        return false;
+                    }
+                    std::memcpy(slot, m_bytes.data(), m_bytes.size());
+                    column.lengths[i] = static_cast<SQLLEN>(m_bytes.size());
+                }
+                else
+                {
+                    std::u16string units = utf8ToUtf16(text);
+                    std::memcpy(slot, units.data(), units.size() * sizeof(char16_t));
+                    column.lengths[i] = static_cast<SQLLEN>(units.size() * sizeof(char16_t));
+                }
+            }
+
+            SQLSMALLINT valueType = binary ? SQL_C_BINARY : SQL_C_WCHAR;
+            SQLSMALLINT parameterType = binary ? (width > 8000 ? SQL_LONGVARBINARY : SQL_VARBINARY)
+                                               : (width > 4000 ? SQL_WLONGVARCHAR : SQL_WVARCHAR);
+            SQLRETURN ret = SQLBindParameter(m_stmt->get(), static_cast<SQLUSMALLINT>(c + 1), SQL_PARAM_INPUT,
+                                             valueType, parameterType, width, 0, column.data.data(),
+                                             static_cast<SQLLEN>(elementBytes), column.lengths.data());
+            if (!SQL_SUCCEEDED(ret))
+                return fail();
+        }
+
+        SQLRETURN ret = SQLSetStmtAttr(m_stmt->get(), SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)count, 0);
+        return SQL_SUCCEEDED(ret) || fail();
+    }
+
+    bool run(size_t start, size_t count, std::vector<SQLLEN> *rowCounts)
+    {
+        m_processed = 0;
+        SQLRETURN ret = SQLExecute(m_stmt->get());
+        // Each row of the array has its own result (SQL_PARC_BATCH), and the errors of later rows may only
+        // surface with them
+        SQLRETURN more = ret;
+        while (SQL_SUCCEEDED(more))
+        {
+            SQLLEN rows = 0;
+            if (rowCounts && SQL_SUCCEEDED(SQLRowCount(m_stmt->get(), &rows)))
+                rowCounts->push_back(rows);
+            more = SQLMoreResults(m_stmt->get());
+        }
+        if (more != SQL_NO_DATA)
+            ret = more;
+
+        size_t processed = std::min<size_t>(m_processed, count);
+        auto failed = std::find_if(m_statuses.begin(), m_statuses.begin() + processed,
+                                   [](SQLUSMALLINT status) { return status == SQL_PARAM_ERROR; });
+        if (SQL_SUCCEEDED(ret) && failed == m_statuses.begin() + processed)
+            return true;
+
+        if (failed != m_statuses.begin() + processed)
+            m_failedRow = static_cast<long long>(start + (failed - m_statuses.begin()));
+        return fail();
+    }
+
+    bool fail()
+    {
+        m_error = getOdbcError(SQL_HANDLE_STMT, m_stmt->get());
+        SQLFreeStmt(m_stmt->get(), SQL_CLOSE);
+        return false;
+    }
+
+    std::unique_ptr<PooledStatement> m_stmt;
+    std::vector<bool> m_binary;
+    std::vector<Column> m_columns;
+    std::vector<size_t> m_widest;
+    std::vector<SQLUSMALLINT> m_statuses;
+    SQLULEN m_processed = 0;
+    std::string m_bytes;
+    std::string m_error;
+    long long m_failedRow = -1;
+};
+
+/**
+ * @brief A leased pooled connection with autocommit off, for statements that run as one transaction
+ *
+ * The connection goes back to the pool as it came: whatever was not
+ * committed is rolled back and autocommit turned back on. A failure of the
+ * connection itself (SQLSTATE 08xxx) discards it instead.
+ */
+class PooledTransaction
+{
+  public:
+    PooledTransaction(ConnectionLease lease, CancellationToken &cancel) : m_lease(std::move(lease))
+    {
+        // Statements may take long; only the cancellation stops them
+        m_lease->setQueryTimeout(0);
+        PooledConnection &connection = *m_lease;
+        m_registration = cancel.onCancel([&connection]() { connection.cancel(); });
+    }
+
+    ~PooledTransaction()
+    {
+        if (m_lease && m_open)
+        {
+            SQLEndTran(SQL_HANDLE_DBC, m_lease->handle(), SQL_ROLLBACK);
+            SQLSetConnectAttr(m_lease->handle(), SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+        }
+    }
+
+    PooledTransaction(const PooledTransaction &) = delete;
+    PooledTransaction &operator=(const PooledTransaction &) = delete;
+
+    bool begin(std::string &error)
+    {
+        SQLRETURN ret = SQLSetConnectAttr(m_lease->handle(), SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_DBC, m_lease->handle());
+            return false;
+        }
+        m_open = true;
+        return true;
+    }
+
+    /**
+     * @brief Commit or roll back what ran since the last end
+     */
+    bool end(SQLSMALLINT completion, std::string &error)
+    {
+        if (!m_open)
+        {
+            error = "The connection was lost";
+            return false;
+        }
+        if (SQL_SUCCEEDED(SQLEndTran(SQL_HANDLE_DBC, m_lease->handle(), completion)))
+            return true;
+        error = getOdbcError(SQL_HANDLE_DBC, m_lease->handle());
+        return false;
+    }
+
+    /**
+     * @brief After a statement failed with @p error: discard the connection if it is the one that failed
+     * @return false when the connection was discarded
+     */
+    bool checkAlive(const std::string &error)
+    {
+        if (m_open && (error.compare(0, 2, "08") == 0 || !m_lease->isAlive()))
+        {
+            m_open = false;
+            m_lease.markBroken();
+        }
+        return m_open;
+    }
+
+    bool isOpen() const
+    {
+        return m_open;
+    }
+
+    PooledConnection &connection()
+    {
+        return *m_lease;
+    }
+
+  private:
+    // Destroyed in reverse order: the callback is gone before the lease
+    ConnectionLease m_lease;
+    CancellationToken::Registration m_registration;
+    bool m_open = false;
+};
+
+/**
+ * @brief Inserts on a leased pooled connection with arrays of parameters
+ *
+ * Each batch runs the prepared insert over arrays of up to kParamsetRows
+ * rows (see ParamArrayStatement), and ends with a commit or a rollback.
+ */
+class SqlServerWriter final : public RowWriter
+{
+  public:
+    /**
+     * @param binary Per column: true for binary columns, which take decoded "0x" hex instead of text
+     */
+    SqlServerWriter(ConnectionLease lease, CancellationToken &cancel, std::vector<bool> binary)
+        : m_transaction(std::move(lease), cancel), m_insert(std::move(binary))
+    {
+    }
+
+    bool prepare(const std::string &sql)
+    {
+        if (!m_transaction.begin(m_error))
+            return false;
+        if (!m_insert.prepare(m_transaction.connection(), sql))
+        {
+            m_error = m_insert.error();
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const ResultSet &batch) override
+    {
+        m_error.clear();
+        m_failedRow = -1;
+        if (!m_transaction.isOpen())
+        {
+            m_error = "The connection was lost";
+            return false;
+        }
+
+        if (!m_insert.execute(batch, nullptr))
+        {
+            m_error = m_insert.error();
+            m_failedRow = m_insert.failedRow();
+            std::string error;
+            if (m_transaction.checkAlive(m_error))
+                m_transaction.end(SQL_ROLLBACK, error);
+            return false;
+        }
+
+        std::string error;
+        if (!m_transaction.end(SQL_COMMIT, m_error))
+        {
+            m_transaction.end(SQL_ROLLBACK, error);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    // Declared first, destroyed last: the statement is freed before the connection goes back
+    PooledTransaction m_transaction;
+    ParamArrayStatement m_insert;
+};
+
+/**
+ * @brief SQL Server session: a target and a current database, read on pooled connections; T-SQL catalog queries,
+ *        OFFSET/FETCH pagination, [bracket] quoting
+ */
+class SqlServerBackend final : public DataBackend
+{
+  public:
+    SqlServerBackend() : m_connected(false)
+    {
+    }
+
+    ~SqlServerBackend() override
+    {
+        disconnect();
+    }
+
+    bool connect(const std::string &connectionString) override
+    {
+        disconnect();
+
+        // The login is checked on a pooled connection: the session itself holds none, only the target and database
+        std::string database;
+        QueryExecutor executor(connectionString, std::string());
+        executor.add([&](PooledConnection &connection, std::string &) {
+            database = connection.getDefaultDatabase();
+            return true;
+        });
+        TaskStatus status = executor.run()[0];
+        if (!status.success)
+        {
+            m_lastError = status.error;
+            return false;
+        }
+
+        m_connectionString = connectionString;
+        m_currentDatabase = database;
+        m_connected = true;
+        return true;
+    }
+
+    void disconnect() override
+    {
+        m_connected = false;
+        m_currentDatabase.clear();
+    }
+
+    bool isConnected() const override
+    {
+        return m_connected;
+    }
+
+    std::unique_ptr<DataBackend> snapshot() const override
+    {
+        // The session holds no connection, only the target and database: a copy queries on pooled connections too
+        if (!m_connected)
+            return nullptr;
+        return std::make_unique<SqlServerBackend>(*this);
+    }
+
+    std::vector<std::string> getDatabases(std::string &etag) override
+    {
+        std::vector<std::string> databases;
+
+        if (!m_connected)
+            return databases;
+
+        auto &cache = MetadataCache::getInstance();
+        if (cache.getDatabases(m_connectionString, databases, etag))
+            return databases;
+
+        std::string version;
+        bool versioned = false;
+        QueryExecutor executor(m_connectionString, m_currentDatabase);
+        executor.add([&](PooledConnection &connection, std::string &error) {
+            // Read the version first so a change made during the load is caught by the next poll
+            versioned = MetadataCache::readVersion(connection.handle(), true, version);
+
+            PooledStatement stmt(connection);
+            if (!stmt)
+            {
+                error = "Failed to allocate statement handle";
+                return false;
+            }
+
+            const char *sql = "SELECT name FROM sys.databases WHERE state_desc = 'ONLINE' ORDER BY name";
+            SQLRETURN ret = SQLExecDirect(stmt.get(), (SQLCHAR *)sql, SQL_NTS);
+            if (!SQL_SUCCEEDED(ret))
+            {
+                error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+                return false;
+            }
+
+            SQLCHAR dbName[256];
+            SQLLEN dbNameLen;
+
+            while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+            {
+                SQLGetData(stmt.get(), 1, SQL_C_CHAR, dbName, sizeof(dbName), &dbNameLen);
+                databases.push_back(std::string((char *)dbName));
+            }
+            return true;
+        });
+        if (!executor.run()[0].success)
+            return std::vector<std::string>();
+
+        if (versioned)
+            cache.storeDatabases(m_connectionString, version, databases, etag);
+
+        return databases;
+    }
+
+    /**
+     * @brief Make a database the session's current one
+     *
+     * Nothing runs USE on a connection the session keeps: the database is
+     * only remembered, and every connection leased for the session is
+     * switched to it (SQL_ATTR_CURRENT_CATALOG), so any pooled connection
+     * serves any session. One lease checks that the database can be used.
+     */
+    bool useDatabase(const std::string &databaseName) override
+    {
+        if (!m_connected)
+            return false;
+
+        if (!isValidIdentifier(databaseName))
+            return false;
+
+        QueryExecutor executor(m_connectionString, databaseName);
+        executor.add([](PooledConnection &, std::string &) { return true; });
+        if (!executor.run()[0].success)
+            return false;
+
+        m_currentDatabase = databaseName;
+        return true;
+    }
+
+    std::vector<TableInfo> getTables(std::string &etag) override
+    {
+        std::vector<TableInfo> tables;
+
+        if (!m_connected)
+            return tables;
+
+        auto &cache = MetadataCache::getInstance();
+        if (cache.getTables(m_connectionString, m_currentDatabase, tables, etag))
+            return tables;
+
+        std::string version;
+        bool versioned = false;
+        QueryExecutor executor(m_connectionString, m_currentDatabase);
+        executor.add([&](PooledConnection &connection, std::string &error) {
+            versioned = MetadataCache::readVersion(connection.handle(), false, version);
+
+            PooledStatement stmt(connection);
+            if (!stmt)
+            {
+                error = "Failed to allocate statement handle";
+                return false;
+            }
+
+            SQLRETURN ret = SQLTables(stmt.get(), NULL, 0, NULL, 0, NULL, 0, (SQLCHAR *)"TABLE", SQL_NTS);
+            if (!SQL_SUCCEEDED(ret))
+            {
+                error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+                return false;
+            }
+
+            SQLCHAR schemaName[256], tableName[256];
+            SQLLEN schemaLen, tableLen;
+
+            while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+            {
+                SQLGetData(stmt.get(), 2, SQL_C_CHAR, schemaName, sizeof(schemaName), &schemaLen);
+                SQLGetData(stmt.get(), 3, SQL_C_CHAR, tableName, sizeof(tableName), &tableLen);
+
+                TableInfo info;
+                info.schema = (schemaLen > 0) ? std::string((char *)schemaName) : "dbo";
+                info.name = std::string((char *)tableName);
+
+                if (info.schema != "sys" && info.schema != "INFORMATION_SCHEMA")
+                {
+                    tables.push_back(info);
+                }
+            }
+            return true;
+        });
+        if (!executor.run()[0].success)
+            return std::vector<TableInfo>();
+
+        if (versioned)
+            cache.storeTables(m_connectionString, m_currentDatabase, version, tables, etag);
+
+        return tables;
+    }
+
+    std::vector<ColumnInfo> getColumns(const std::string &schema, const std::string &tableName, std::string &etag) override
+    {
+        std::vector<ColumnInfo> columns;
+
+        if (!m_connected)
+            return columns;
+
+        auto &cache = MetadataCache::getInstance();
+        if (cache.getColumns(m_connectionString, m_currentDatabase, schema, tableName, columns, etag))
+            return columns;
+
+        // SQLColumns, SQLPrimaryKeys, SQLForeignKeys and the index catalog are independent: run them side by side
+        std::string version;
+        bool versioned = false;
+        std::unordered_set<std::string> primaryKeys;
+        std::unordered_set<std::string> indexed;
+        std::unordered_set<std::string> fullTextIndexed;
+        std::unordered_map<std::string, std::vector<ColumnReference>> foreignKeys;
+        QueryExecutor executor(m_connectionString, m_currentDatabase);
+        size_t columnsTask = executor.add([&](PooledConnection &connection, std::string &error) {
+            versioned = MetadataCache::readVersion(connection.handle(), false, version);
+            return loadColumns(connection, schema, tableName, columns, error);
+        });
+        size_t keysTask = executor.add([&](PooledConnection &connection, std::string &error) {
+            return loadPrimaryKeys(connection, schema, tableName, primaryKeys, error);
+        });
+        size_t indexesTask = executor.add([&](PooledConnection &connection, std::string &error) {
+            return loadIndexedColumns(connection, quoteTableName(schema, tableName), indexed, fullTextIndexed, error);
+        });
+        size_t foreignKeysTask = executor.add([&](PooledConnection &connection, std::string &error) {
+            return loadForeignKeys(connection, schema, tableName, foreignKeys, error);
+        });
+
+        auto statuses = executor.run();
+        if (!statuses[columnsTask].success)
+            return std::vector<ColumnInfo>();
+
+        // A failed key or index lookup only loses the markers, but is not cached
+        for (auto &col : columns)
+        {
+            col.isPrimaryKey = primaryKeys.count(col.name) > 0;
+            col.isIndexed = indexed.count(col.name) > 0;
+            col.isFullTextIndexed = fullTextIndexed.count(col.name) > 0;
+
+            auto references = foreignKeys.find(col.name);
+            if (references != foreignKeys.end())
+                col.references = std::move(references->second);
+        }
+
+        if (versioned && statuses[keysTask].success && statuses[indexesTask].success &&
+            statuses[foreignKeysTask].success)
+            cache.storeColumns(m_connectionString, m_currentDatabase, version, schema, tableName, columns, etag);
+
+        return columns;
+    }
+
+    QueryResult selectData(const std::string &schema, const std::string &tableName, const RowFilter &requested,
+                           const RowOrder &requestedOrder, const RowProjection &projection, int page, int pageSize,
+                           CountMode countMode, CancellationToken &cancel) override
+    {
+        QueryResult result;
+        result.success = false;
+        result.totalRows = 0;
+
+        if (!m_connected)
+        {
+            result.error = "Not connected to database";
+            return result;
+        }
+
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
+        {
+            result.error = "Invalid table or schema name";
+            return result;
+        }
+
+        if (!requested.column.empty() && !isValidIdentifier(requested.column))
+        {
+            result.error = "Invalid column name";
+            return result;
+        }
+
+        std::string fullTableName = quoteTableName(schema, tableName);
+        RowFilter filter = resolveFilter(schema, tableName, requested);
+        result.filterMode = filter.mode;
+        std::string filterParam;
+        std::string predicate = filterPredicate(filter, filterParam);
+
+        // Sorting and projecting work from the (cached) column metadata
+        bool projected = !projection.columns.empty() || projection.previewLength > 0;
+        std::vector<ColumnInfo> columns;
+        if (!requestedOrder.keys.empty() || projected)
+        {
+            std::string etag;
+            columns = getColumns(schema, tableName, etag);
+        }
+
+        std::string orderBy;
+        std::string keyset;
+        std::vector<std::u16string> keysetParams;
+        bool uniqueOrder = false;
+        if (!requestedOrder.keys.empty())
+        {
+            if (!resolveSortOrder(requestedOrder.keys, columns, result.order, uniqueOrder, result.error))
+                return result;
+            orderBy = orderByList(result.order);
+        }
+
+        if (requestedOrder.isKeyset())
+        {
+            std::vector<std::string> params;
+            keyset = uniqueOrder ? keysetPredicate(result.order, requestedOrder.after, quoteColumn, params) : "";
+            if (keyset.empty())
+            {
+                result.error = "Cursor does not match the sort";
+                return result;
+            }
+
+            // Cursor values are arbitrary text: bound as UTF-16 so they compare exactly as fetched
+            for (const std::string &param : params)
+                keysetParams.push_back(utf8ToUtf16(param));
+        }
+
+        std::string selectList = "*";
+        if (projected && !makeSelectList(columns, projection, result, selectList))
+            return result;
+
+        // Total count: served from the shared cache when possible
+        RowCount count;
+        bool pending = false;
+        bool needCount = false;
+        std::string countKey = makeCountKey(schema, tableName, filter);
+        auto &countCache = CountCache::getInstance();
+
+        if (countCache.lookup(countKey, count, pending) && (countMode != CountMode::Exact || !count.approximate))
+        {
+            result.totalRows = count.value;
+            result.totalRowsApproximate = count.approximate;
+        }
+        else if (countMode == CountMode::Deferred)
+        {
+            startDeferredCount(countKey, schema, tableName, filter, false);
+            result.totalRowsPending = true;
+        }
+        else
+        {
+            needCount = true;
+        }
+
+        // Now get the actual data with pagination; a keyset cursor seeks to the page instead of skipping rows
+        int offset = keyset.empty() ? (page - 1) * pageSize : 0;
+
+        std::string dataSql = "SELECT " + selectList + " FROM " + fullTableName;
+        if (!predicate.empty() && !keyset.empty())
+            dataSql += " WHERE " + predicate + " AND " + keyset;
+        else if (!predicate.empty() || !keyset.empty())
+            dataSql += " WHERE " + predicate + keyset;
+        dataSql += " ORDER BY " + (orderBy.empty() ? std::string("(SELECT NULL)") : orderBy) + " OFFSET " +
+                   std::to_string(offset) + " ROWS FETCH NEXT " + std::to_string(pageSize) + " ROWS ONLY";
+
+        // Count and page run concurrently on separate pooled connections
+        QueryExecutor executor(m_connectionString, m_currentDatabase, &cancel);
+        size_t countTask = 0;
+        if (needCount)
+        {
+            bool exact = countMode == CountMode::Exact;
+            countTask = executor.add(
+                [&](PooledConnection &connection, std::string &error) {
+                    return computeRowCount(connection, fullTableName, filter, exact, count, error);
+                },
+                kCountTimeoutSeconds);
+        }
+        size_t pageTask = executor.add([&](PooledConnection &connection, std::string &error) {
+            return fetchPage(connection, dataSql, predicate.empty() ? nullptr : &filterParam, keysetParams, result,
+                             error);
+        });
+
+        auto statuses = executor.run();
+
+        if (!statuses[pageTask].success)
+        {
+            result.error = statuses[pageTask].error;
+            return result;
+        }
+
+        if (uniqueOrder && result.data.rowCount() == static_cast<size_t>(pageSize))
+            readLastKey(result.data, result.order, result.lastKey);
+
+        if (needCount)
+        {
+            if (statuses[countTask].success)
+            {
+                countCache.store(countKey, count);
+                result.totalRows = count.value;
+                result.totalRowsApproximate = count.approximate;
+            }
+            else
+            {
+                // Still return the rows; the count finishes in the background, as exact as it was asked for
+                if (!statuses[countTask].cancelled)
+                    startDeferredCount(countKey, schema, tableName, filter, countMode == CountMode::Exact);
+                result.totalRowsPending = true;
+            }
+        }
+
+        result.success = true;
+        return result;
+    }
+
+    RowCounter prepareCount(const std::string &schema, const std::string &tableName, const RowFilter &requested,
+                            bool exact) override
+    {
+        if (!m_connected)
+            return nullptr;
+
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)) ||
+            (!requested.column.empty() && !isValidIdentifier(requested.column)))
+            return nullptr;
+
+        RowFilter filter = resolveFilter(schema, tableName, requested);
+        std::string countKey = makeCountKey(schema, tableName, filter);
+        std::string fullTableName = quoteTableName(schema, tableName);
+        std::string connectionString = m_connectionString;
+        std::string database = m_currentDatabase;
+
+        return [=](RowCount &count, CancellationToken &cancel) {
+            auto &countCache = CountCache::getInstance();
+            bool pending = false;
+            if (countCache.lookup(countKey, count, pending) && (!exact || !count.approximate))
+                return true;
+
+            // A deferred count for this key is already running: pick up its result
+            if (pending && countCache.waitFor(countKey, count, cancel.remaining(kDeferredCountWait)) &&
+                (!exact || !count.approximate))
+                return true;
+
+            QueryExecutor executor(connectionString, database, &cancel);
+            executor.add([&](PooledConnection &connection, std::string &error) {
+                return computeRowCount(connection, fullTableName, filter, exact, count, error);
+            });
+            if (!executor.run()[0].success)
+                return false;
+
+            countCache.store(countKey, count);
+            return true;
+        };
+    }
+
+    QueryResult selectByKeys(const std::string &schema, const std::string &tableName,
+                             const std::vector<std::string> &keyColumns,
+                             const std::vector<std::vector<std::string>> &keys, const RowProjection &projection,
+                             CancellationToken &cancel) override
+    {
+        QueryResult result;
+        result.success = false;
+
+        if (!m_connected)
+        {
+            result.error = "Not connected to database";
+            return result;
+        }
+
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
+        {
+            result.error = "Invalid table or schema name";
+            return result;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(schema, tableName, etag);
+        for (const std::string &key : keyColumns)
+        {
+            if (std::none_of(columns.begin(), columns.end(), [&](const ColumnInfo &col) { return col.name == key; }))
+            {
+                result.error = "Column not found: " + key;
+                return result;
+            }
+        }
+        if (keyColumns.empty())
+        {
+            result.error = "No key columns";
+            return result;
+        }
+
+        std::string selectList = "*";
+        if (projection.previewLength > 0 && !makeSelectList(columns, projection, result, selectList))
+            return result;
+
+        // Every batch of keys runs on the same pooled connection, appending to the rows; without keys
+        // one query still reads the columns
+        size_t perQuery = std::max<size_t>(1, kMaxKeyParams / keyColumns.size());
+        QueryExecutor executor(m_connectionString, m_currentDatabase, &cancel);
+        executor.add([&](PooledConnection &connection, std::string &error) {
+            for (size_t first = 0; first == 0 || first < keys.size(); first += perQuery)
+            {
+                size_t count = std::min(perQuery, keys.size() - first);
+                std::string sql = "SELECT " + selectList + " FROM " + quoteTableName(schema, tableName) + " WHERE " +
+                                  keyMatchPredicate(keyColumns, count, quoteColumn);
+
+                // Key values are text read from a page: bound as UTF-16 like cursor values
+                std::vector<std::u16string> params;
+                for (size_t k = first; k < first + count; k++)
+                {
+                    for (const std::string &value : keys[k])
+                        params.push_back(utf8ToUtf16(value));
+                }
+                if (!fetchPage(connection, sql, nullptr, params, result, error))
+                    return false;
+            }
+            return true;
+        });
+
+        auto status = executor.run()[0];
+        if (!status.success)
+        {
+            result.error = status.error;
+            return result;
+        }
+
+        result.success = true;
+        return result;
+    }
+
+    std::unique_ptr<RowCursor> openCursor(const std::string &schema, const std::string &tableName,
+                                          const RowFilter &requested, const KeyRange &range,
+                                          const std::vector<SortKey> &sort,
+                                          const std::vector<std::string> &columnNames, CancellationToken &cancel,
+                                          std::string &error) override
+    {
+        if (!m_connected)
+        {
+            error = "Not connected to database";
+            return nullptr;
+        }
+
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)) ||
+            (!requested.column.empty() && !isValidIdentifier(requested.column)) ||
+            (!range.column.empty() && !isValidIdentifier(range.column)))
+        {
+            error = "Invalid table, schema or column name";
+            return nullptr;
+        }
+
+        RowFilter filter = resolveFilter(schema, tableName, requested);
+        std::string filterParam;
+        std::string filterSql = filterPredicate(filter, filterParam);
+
+        std::vector<std::string> rangeParams;
+        std::string rangeSql = keyRangePredicate(range, quoteColumn, rangeParams);
+        std::vector<std::u16string> keyParams;
+        for (const std::string &param : rangeParams)
+            keyParams.push_back(utf8ToUtf16(param));
+
+        std::string predicate = filterSql;
+        if (!rangeSql.empty())
+            predicate += (predicate.empty() ? "" : " AND ") + rangeSql;
+
+        std::vector<ColumnInfo> columns;
+        if (!sort.empty() || !columnNames.empty())
+        {
+            std::string etag;
+            columns = getColumns(schema, tableName, etag);
+        }
+
+        std::vector<SortKey> order;
+        bool uniqueOrder = false;
+        if (!sort.empty() && !resolveSortOrder(sort, columns, order, uniqueOrder, error))
+            return nullptr;
+
+        std::string selectList = "*";
+        if (!columnNames.empty())
+        {
+            std::vector<const ColumnInfo *> projected;
+            if (!resolveProjection(columnNames, columns, order, projected, error))
+                return nullptr;
+
+            selectList.clear();
+            for (const ColumnInfo *column : projected)
+                selectList += (selectList.empty() ? "" : ", ") + quoteColumn(column->name);
+        }
+
+        std::string sql = "SELECT " + selectList + " FROM " + quoteTableName(schema, tableName);
+        if (!predicate.empty())
+            sql += " WHERE " + predicate;
+        if (!order.empty())
+            sql += " ORDER BY " + orderByList(order);
+
+        ConnectionLease lease = ConnectionPool::getInstance().acquire(m_connectionString, m_currentDatabase,
+                                                                      cancel.remaining(kCursorLeaseWait), error);
+        if (!lease)
+            return nullptr;
+
+        auto cursor = std::make_unique<SqlServerCursor>(std::move(lease), cancel);
+        if (!cursor->execute(sql, filterSql.empty() ? nullptr : &filterParam, keyParams))
+        {
+            error = cancel.isCancelled() ? cancel.reason() : cursor->error();
+            return nullptr;
+        }
+        return cursor;
+    }
+
+    std::unique_ptr<RowWriter> openWriter(const std::string &schema, const std::string &tableName,
+                                          const std::vector<std::string> &columnNames, CancellationToken &cancel,
+                                          std::string &error) override
+    {
+        if (!m_connected)
+        {
+            error = "Not connected to database";
+            return nullptr;
+        }
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
+        {
+            error = "Invalid table or schema name";
+            return nullptr;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(schema, tableName, etag);
+        std::vector<const ColumnInfo *> targets;
+        if (!resolveInsertColumns(columnNames, columns, targets, error))
+            return nullptr;
+
+        std::string columnList;
+        std::string placeholders;
+        std::vector<bool> binary;
+        for (const ColumnInfo *column : targets)
+        {
+            columnList += (binary.empty() ? "" : ", ") + quoteColumn(column->name);
+            placeholders += binary.empty() ? "?" : ", ?";
+            binary.push_back(column->type.find("binary") != std::string::npos || column->type == "image");
+        }
+        std::string sql =
+            "INSERT INTO " + quoteTableName(schema, tableName) + " (" + columnList + ") VALUES (" + placeholders + ")";
+
+        ConnectionLease lease = ConnectionPool::getInstance().acquire(m_connectionString, m_currentDatabase,
+                                                                      cancel.remaining(kCursorLeaseWait), error);
+        if (!lease)
+            return nullptr;
+
+        auto writer = std::make_unique<SqlServerWriter>(std::move(lease), cancel, std::move(binary));
+        if (!writer->prepare(sql))
+        {
+            error = cancel.isCancelled() ? cancel.reason() : writer->error();
+            return nullptr;
+        }
+        return writer;
+    }
+
+    bool applyChanges(const std::string &schema, const std::string &tableName, const std::vector<RowChange> &changes,
+                      CancellationToken &cancel, EditResult &result, std::string &error) override
+    {
+        result = EditResult();
+        if (!m_connected)
+        {
+            error = "Not connected to database";
+            return false;
+        }
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
+        {
+            error = "Invalid table or schema name";
+            return false;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(schema, tableName, etag);
+        if (columns.empty())
+        {
+            error = "Failed to read the columns of " + tableName;
+            return false;
+        }
+
+        // rowversion columns are typed timestamp in the catalog
+        auto versionColumn = std::find_if(columns.begin(), columns.end(), [](const ColumnInfo &column) {
+            return column.type == "timestamp" || column.type == "rowversion";
+        });
+        std::vector<EditStatement> statements;
+        if (!planEdit(changes, columns, versionColumn == columns.end() ? nullptr : &*versionColumn, statements,
+                      result.failedChange, error))
+            return false;
+
+        ConnectionLease lease = ConnectionPool::getInstance().acquire(m_connectionString, m_currentDatabase,
+                                                                      cancel.remaining(kCursorLeaseWait), error);
+        if (!lease)
+            return false;
+        PooledTransaction transaction(std::move(lease), cancel);
+        if (!transaction.begin(error))
+            return false;
+
+        auto isBinary = [](const ColumnInfo *column) {
+            return column->type.find("binary") != std::string::npos || column->type == "image" ||
+                   column->type == "timestamp" || column->type == "rowversion";
+        };
+
+        std::string table = quoteTableName(schema, tableName);
+        // Counted apart until the commit: a rolled back edit changed nothing
+        EditResult applied;
+        std::vector<SQLLEN> rowCounts;
+        for (const EditStatement &statement : statements)
+        {
+            std::vector<bool> binary;
+            for (const ColumnInfo *column : statement.values)
+                binary.push_back(isBinary(column));
+            for (const ColumnInfo *column : statement.key)
+                binary.push_back(isBinary(column));
+            if (statement.version)
+                binary.push_back(true);
+
+            // The whole group is one SQLExecute per kParamsetRows changes
+            ParamArrayStatement array(std::move(binary));
+            if (!array.prepare(transaction.connection(), editStatementSql(statement, table, quoteColumn)) ||
+                !array.execute(statement.params, &rowCounts))
+            {
+                error = cancel.isCancelled() ? cancel.reason() : array.error();
+                if (array.failedRow() >= 0)
+                    result.failedChange = static_cast<long long>(statement.firstChange) + array.failedRow();
+                transaction.checkAlive(error);
+                return false;
+            }
+            applied.statements++;
+
+            size_t count = statement.params.rowCount();
+            size_t rows = 0;
+            for (SQLLEN rowCount : rowCounts)
+                rows += rowCount > 0 ? static_cast<size_t>(rowCount) : 0;
+
+            // An update or delete matches its row by the primary key: no row means it is gone or changed since
+            if (statement.kind != ChangeKind::Insert && rows < count)
+            {
+                result.conflict = true;
+                if (rowCounts.size() == count)
+                {
+                    auto missed = std::find(rowCounts.begin(), rowCounts.end(), 0);
+                    result.failedChange = static_cast<long long>(statement.firstChange + (missed - rowCounts.begin()));
+                }
+                error = "Row not found, or changed since it was read";
+                return false;
+            }
+            if (statement.kind == ChangeKind::Insert)
+                applied.inserted += count;
+            else if (statement.kind == ChangeKind::Update)
+                applied.updated += count;
+            else
+                applied.deleted += count;
+        }
+
+        if (!transaction.end(SQL_COMMIT, error))
+        {
+            transaction.checkAlive(error);
+            return false;
+        }
+        result = applied;
+        return true;
+    }
+
+    bool splitKeyRange(const std::string &schema, const std::string &tableName, size_t parts, std::string &keyColumn,
+                       std::vector<std::string> &bounds, CancellationToken &cancel, std::string &error) override
+    {
+        bounds.clear();
+        if (!m_connected)
+        {
+            error = "Not connected to database";
+            return false;
+        }
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
+        {
+            error = "Invalid table or schema name";
+            return false;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(schema, tableName, etag);
+        const ColumnInfo *key = singlePrimaryKey(columns);
+        if (!key)
+        {
+            error = "Table has no single-column primary key";
+            return false;
+        }
+        if (key->type.find("binary") != std::string::npos || key->type == "image" || key->type == "timestamp")
+        {
+            error = "Binary keys cannot be split into ranges";
+            return false;
+        }
+        keyColumn = key->name;
+        if (parts < 2)
+            return true;
+
+        std::string fullTableName = quoteTableName(schema, tableName);
+        std::string column = quoteColumn(keyColumn);
+        std::string count = std::to_string(parts);
+
+        // Steps of the key index's histogram grouped into parts of about the same cumulative row count;
+        // the top of each part is a bound. Needs SQL Server 2016 SP1 CU2 and statistics on the index
+        std::string histogramSql =
+            "WITH steps AS (SELECT h.step_number, h.range_high_key, "
+            "SUM(h.range_rows + h.equal_rows) OVER (ORDER BY h.step_number ROWS UNBOUNDED PRECEDING) AS below, "
+            "SUM(h.range_rows + h.equal_rows) OVER () AS total "
+            "FROM sys.indexes AS i CROSS APPLY sys.dm_db_stats_histogram(i.object_id, i.index_id) AS h "
+            "WHERE i.object_id = OBJECT_ID(?) AND i.is_primary_key = 1) "
+            "SELECT s.range_high_key FROM steps AS s WHERE s.step_number IN ("
+            "SELECT MAX(step_number) FROM steps WHERE total > 0 GROUP BY FLOOR((below - 1) * " +
+            count + " / total)) ORDER BY s.step_number";
+
+        // Without a histogram: the tops of NTILE parts over a sample of the key. TABLESAMPLE reads only
+        // the sampled pages, where filtering on NEWID() would still read every row; a sparse sample
+        // only gives fewer ranges
+        RowCount rows;
+        if (!countRows(schema, tableName, RowFilter(), false, rows, cancel))
+            rows.value = 0;
+        long long sampleRate = keySampleRate(rows.value, parts);
+        std::string ntileSql = "SELECT MAX(k) FROM (SELECT " + column + " AS k, NTILE(" + count + ") OVER (ORDER BY " +
+                               column + ") AS part FROM " + fullTableName;
+        if (sampleRate > 1)
+            ntileSql += " TABLESAMPLE SYSTEM (" + std::to_string(100.0 / sampleRate) + " PERCENT)";
+        ntileSql += ") AS s GROUP BY part ORDER BY part";
+
+        ResultSet histogram;
+        ResultSet tiles;
+        bool fromHistogram = false;
+        QueryExecutor executor(m_connectionString, m_currentDatabase, &cancel);
+        executor.add([&](PooledConnection &connection, std::string &taskError) {
+            std::string histogramError;
+            if (fetchBounds(connection, histogramSql, &fullTableName, histogram, histogramError) &&
+                histogram.rowCount() > 0)
+            {
+                fromHistogram = true;
+                return true;
+            }
+            return fetchBounds(connection, ntileSql, nullptr, tiles, taskError);
+        });
+
+        TaskStatus status = executor.run()[0];
+        if (!status.success)
+        {
+            error = status.cancelled ? cancel.reason() : status.error;
+            return false;
+        }
+
+        const ResultSet &data = fromHistogram ? histogram : tiles;
+        for (size_t row = 0; row < data.rowCount(); row++)
+        {
+            if (!data.isNull(row, 0))
+                bounds.emplace_back(data.value(row, 0));
+        }
+
+        // The last part's top is the end of the table, which its range leaves open
+        if (!bounds.empty())
+            bounds.pop_back();
+        return true;
+    }
+
+    std::unique_ptr<ChangeSource> openChangeSource(const std::string &schema, const std::string &tableName,
+                                                   CancellationToken &cancel, std::string &error) override
+    {
+        if (!m_connected)
+        {
+            error = "Not connected to database";
+            return nullptr;
+        }
+        if (!isValidIdentifier(tableName) || (!schema.empty() && !isValidIdentifier(schema)))
+        {
+            error = "Invalid table or schema name";
+            return nullptr;
+        }
+
+        std::string etag;
+        std::vector<ColumnInfo> columns = getColumns(schema, tableName, etag);
+        if (columns.empty())
+        {
+            error = "Table not found";
+            return nullptr;
+        }
+
+        auto source = std::make_unique<TableChangeSource>(m_connectionString, m_currentDatabase,
+                                                          quoteTableName(schema, tableName));
+        const ColumnInfo *key = singlePrimaryKey(columns);
+        for (const ColumnInfo &column : columns)
+        {
+            if (column.isPrimaryKey)
+                source->keyColumns.push_back(column.name);
+            if (source->versionColumn.empty() && (column.type == "timestamp" || column.type == "rowversion"))
+                source->versionColumn = column.name;
+        }
+        if (key && (key->type == "int" || key->type == "bigint" || key->type == "smallint" || key->type == "tinyint"))
+            source->integerKey = key->name;
+
+        if (!source->start(cancel, error))
+            return nullptr;
+        return source;
+    }
+
+    std::string getConnectionInfo() const override
+    {
+        if (!m_connected)
+            return "Not connected";
+
+        std::string info = "Connected";
+        if (!m_currentDatabase.empty())
+            info += " to " + m_currentDatabase;
+
+        return info;
+    }
+
+    std::string getTargetKey() const override
+    {
+        if (!m_connected)
+            return "";
+
+        // The whole connection string, not a hash of it: a collision would leak rows across credentials
+        return m_connectionString + "/" + m_currentDatabase;
+    }
+
+  private:
+    // Longest a follow-up count request waits for a deferred count in flight
+    static constexpr std::chrono::milliseconds kDeferredCountWait = std::chrono::seconds(30);
+
+    // Query timeout of the count that runs alongside a page; slower counts are deferred
+    static constexpr int kCountTimeoutSeconds = 5;
+
+    // How long opening a cursor waits for a free pooled connection
+    static constexpr std::chrono::milliseconds kCursorLeaseWait = std::chrono::seconds(10);
+
+    /**
+     * @brief Changes of a table from change tracking, else a rowversion column, else an integer key
+     *
+     * Each poll leases a pooled connection and first reads the mark the
+     * method moves (the change tracking version, MIN_ACTIVE_ROWVERSION(), the
+     * largest key), then the rows past the previous one up to it. The
+     * rowversion mark is the lowest one still held by an open transaction, so
+     * it bounds the rows read exclusively: a row written by a transaction that
+     * has not committed yet is above it and read once it commits, where
+     * @@DBTS would already have moved past it. Every method but change
+     * tracking also compares the row count estimate of the catalog, which
+     * tells that rows were deleted (or, by the key, updated) when the rows
+     * read do not explain it.
+     */
+    class TableChangeSource final : public ChangeSource
+    {
+      public:
+        TableChangeSource(std::string connectionString, std::string database, std::string fullTableName)
+            : m_connectionString(std::move(connectionString)), m_database(std::move(database)),
+              m_fullTableName(std::move(fullTableName))
+        {
+        }
+
+        std::vector<std::string> keyColumns; ///< Primary key columns
+        std::string versionColumn;           ///< rowversion column, if any
+        std::string integerKey;              ///< Single-column integer primary key, if any
+
+        /// Pick the method and set the marks
+        bool start(CancellationToken &cancel, std::string &error)
+        {
+            return withConnection(cancel, error, [&](PooledConnection &connection) {
+                // CHANGE_TRACKING_MIN_VALID_VERSION is NULL unless change tracking is on for the table
+                long long minValid = 0;
+                std::string ignored;
+                if (!keyColumns.empty() &&
+                    queryScalar(connection, "SELECT CHANGE_TRACKING_MIN_VALID_VERSION(OBJECT_ID(?))", &m_fullTableName,
+                                minValid, ignored))
+                    m_method = Method::ChangeTracking;
+                else if (!versionColumn.empty())
+                    m_method = Method::RowVersion;
+                else if (!integerKey.empty())
+                    m_method = Method::Key;
+                else
+                    m_method = Method::Count;
+
+                return readMark(connection, m_mark, error) && readRowCount(connection, m_mark, m_rows, error);
+            });
+        }
+
+        const char *method() const override
+        {
+            switch (m_method)
+            {
+            case Method::ChangeTracking:
+                return "changetracking";
+            case Method::RowVersion:
+                return "rowversion";
+            case Method::Key:
+                return "key";
+            default:
+                return "count";
+            }
+        }
+
+        bool poll(ChangeBatch &changes, CancellationToken &cancel, std::string &error) override
+        {
+            return withConnection(cancel, error, [&](PooledConnection &connection) {
+                long long mark = m_mark;
+                long long rows = m_rows;
+                if (!readMark(connection, mark, error) || !readRowCount(connection, mark, rows, error))
+                    return false;
+
+                if (mark != m_mark && !readChanges(connection, mark, changes, error))
+                    return false;
+
+                size_t read = changes.rows.rowCount() + changes.deleted.rowCount();
+                if (read > kMaxRows)
+                    changes.stale = true;
+                if (m_method == Method::RowVersion && rows < m_rows)
+                    changes.stale = true;
+                if ((m_method == Method::Key || m_method == Method::Count) &&
+                    rows != m_rows + static_cast<long long>(changes.rows.rowCount()))
+                    changes.stale = true;
+                if (changes.stale)
+                {
+                    changes.rows.clearRows();
+                    changes.deleted.clearRows();
+                }
+
+                m_mark = mark;
+                m_rows = rows;
+                return true;
+            });
+        }
+
+      private:
+        enum class Method
+        {
+            ChangeTracking,
+            RowVersion,
+            Key,
+            Count
+        };
+
+        bool withConnection(CancellationToken &cancel, std::string &error,
+                            const std::function<bool(PooledConnection &)> &run)
+        {
+            ConnectionLease lease = ConnectionPool::getInstance().acquire(m_connectionString, m_database,
+                                                                          cancel.remaining(kCursorLeaseWait), error);
+            if (!lease)
+                return false;
+
+            lease->setQueryTimeout(cancel.remainingSeconds());
+            PooledConnection &connection = *lease;
+            auto registration = cancel.onCancel([&connection]() { connection.cancel(); });
+            bool success = run(connection);
+            if (!success && cancel.isCancelled())
+                error = cancel.reason();
+            return success;
+        }
+
+        // The value the method moves forward: the table's row count estimate for Count
+        bool readMark(PooledConnection &connection, long long &mark, std::string &error)
+        {
+            switch (m_method)
+            {
+            case Method::ChangeTracking:
+                return queryScalar(connection, "SELECT CHANGE_TRACKING_CURRENT_VERSION()", nullptr, mark, error);
+            case Method::RowVersion:
+                return queryScalar(connection, "SELECT CAST(MIN_ACTIVE_ROWVERSION() AS bigint)", nullptr, mark,
+                                   error);
+            case Method::Key:
+                return queryScalar(connection,
+                                   "SELECT COALESCE(CAST(MAX(" + quoteColumn(integerKey) +
+                                       ") AS bigint), -9223372036854775807 - 1) FROM " + m_fullTableName,
+                                   nullptr, mark, error);
+            default: {
+                RowCount count;
+                if (!computeRowCount(connection, m_fullTableName, RowFilter(), false, count, error))
+                    return false;
+                mark = count.value;
+                return true;
+            }
+            }
+        }
+
+        // The row count estimate; the mark itself for Count, and not needed by change tracking
+        bool readRowCount(PooledConnection &connection, long long mark, long long &rows, std::string &error)
+        {
+            if (m_method == Method::ChangeTracking)
+                return true;
+            if (m_method == Method::Count)
+            {
+                rows = mark;
+                return true;
+            }
+
+            RowCount count;
+            if (!computeRowCount(connection, m_fullTableName, RowFilter(), false, count, error))
+                return false;
+            rows = count.value;
+            return true;
+        }
+
+        // Rows changed after m_mark up to @p mark (from m_mark and below @p mark for rowversion, whose marks are
+        // the first value not committed yet); one more than kMaxRows tells there are too many
+        bool readChanges(PooledConnection &connection, long long mark, ChangeBatch &changes, std::string &error)
+        {
+            std::string top = "SELECT TOP (" + std::to_string(kMaxRows + 1) + ") ";
+            std::string from = std::to_string(m_mark);
+            std::string to = std::to_string(mark);
+            QueryResult result;
+
+            switch (m_method)
+            {
+            case Method::ChangeTracking: {
+                // Changes older than the retention period are gone: the table has to be reread
+                long long minValid = 0;
+                if (!queryScalar(connection, "SELECT CHANGE_TRACKING_MIN_VALID_VERSION(OBJECT_ID(?))",
+                                 &m_fullTableName, minValid, error))
+                    return false;
+                if (m_mark < minValid)
+                {
+                    changes.stale = true;
+                    return true;
+                }
+
+                std::string since = " FROM CHANGETABLE(CHANGES " + m_fullTableName + ", " + from + ") AS ct";
+                std::string upTo = " WHERE ct.SYS_CHANGE_VERSION <= " + to;
+                std::string join;
+                std::string keys;
+                for (const std::string &key : keyColumns)
+                {
+                    join += (join.empty() ? " ON " : " AND ") + std::string("t.") + quoteColumn(key) + " = ct." +
+                            quoteColumn(key);
+                    keys += (keys.empty() ? "" : ", ") + std::string("ct.") + quoteColumn(key);
+                }
+
+                if (!fetchPage(connection, top + "t.*" + since + " JOIN " + m_fullTableName + " AS t" + join + upTo,
+                               nullptr, {}, result, error))
+                    return false;
+                changes.rows = std::move(result.data);
+
+                QueryResult deleted;
+                if (!fetchPage(connection, top + keys + since + upTo + " AND ct.SYS_CHANGE_OPERATION = 'D'", nullptr,
+                               {}, deleted, error))
+                    return false;
+                changes.deleted = std::move(deleted.data);
+                return true;
+            }
+            case Method::RowVersion: {
+                std::string column = quoteColumn(versionColumn);
+                if (!fetchPage(connection,
+                               top + "* FROM " + m_fullTableName + " WHERE " + column + " >= CAST(" + from +
+                                   " AS binary(8)) AND " + column + " < CAST(" + to + " AS binary(8))",
+                               nullptr, {}, result, error))
+                    return false;
+                changes.rows = std::move(result.data);
+                return true;
+            }
+            case Method::Key: {
+                std::string column = quoteColumn(integerKey);
+                if (!fetchPage(connection,
+                               top + "* FROM " + m_fullTableName + " WHERE " + column + " > " + from + " AND " +
+                                   column + " <= " + to + " ORDER BY " + column,
+                               nullptr, {}, result, error))
+                    return false;
+                changes.rows = std::move(result.data);
+                return true;
+            }
+            default:
+                return true;
+            }
+        }
+
+        const std::string m_connectionString;
+        const std::string m_database;
+        const std::string m_fullTableName;
+        Method m_method = Method::Count;
+        long long m_mark = 0;
+        long long m_rows = 0;
+    };
+
+    std::string makeCountKey(const std::string &schema, const std::string &tableName, const RowFilter &filter) const
+    {
+        return CountCache::makeKey(getTargetKey(), schema, tableName, filter);
+    }
+
+    static std::string quoteTableName(const std::string &schema, const std::string &tableName)
+    {
+        return schema.empty() ? "[" + tableName + "]" : "[" + schema + "].[" + tableName + "]";
+    }
+
+    static std::string quoteColumn(const std::string &column)
+    {
+        return "[" + column + "]";
+    }
+
+    static std::string orderByList(const std::vector<SortKey> &order)
+    {
+        std::string orderBy;
+        for (const SortKey &key : order)
+        {
+            orderBy += (orderBy.empty() ? "" : ", ") + quoteColumn(key.column);
+            orderBy += key.descending ? " DESC" : " ASC";
+        }
+        return orderBy;
+    }
+
+    /**
+     * @brief SELECT list of a projection
+     *
+     * Previewed text and binary columns are cut with SUBSTRING, xml through
+     * nvarchar(max); their full lengths (characters, bytes for binary and
+     * single-byte text) are selected after every other column, NULL where
+     * nothing was cut. Sort keys are read whole, as cursors are built from
+     * them, and so are the columns the projection asks for whole.
+     */
+    static bool makeSelectList(const std::vector<ColumnInfo> &columns, const RowProjection &projection,
+                               QueryResult &result, std::string &selectList)
+    {
+        std::vector<const ColumnInfo *> projected;
+        if (!resolveProjection(projection.columns, columns, result.order, projected, result.error))
+            return false;
+        if (projected.empty())
+            return true;
+
+        std::string lengths;
+        std::string length = std::to_string(projection.previewLength);
+        selectList.clear();
+        for (size_t i = 0; i < projected.size(); i++)
+        {
+            const ColumnInfo &column = *projected[i];
+            std::string quoted = quoteColumn(column.name);
+            if (!selectList.empty())
+                selectList += ", ";
+
+            std::string value = quoted;
+            int unitBytes = 0;
+            bool sortKey = std::any_of(result.order.begin(), result.order.end(),
+                                       [&](const SortKey &key) { return key.column == column.name; }) ||
+                           std::find(projection.whole.begin(), projection.whole.end(), column.name) !=
+                               projection.whole.end();
+            if (projection.previewLength > 0 && !sortKey)
+                unitBytes = previewUnitBytes(column.type, value);
+
+            if (unitBytes == 0)
+            {
+                selectList += quoted;
+                continue;
+            }
+
+            std::string cut = "SUBSTRING(" + value + ", 1, " + length + ")";
+            selectList += cut + " AS " + quoted;
+            lengths += ", CASE WHEN DATALENGTH(" + value + ") > DATALENGTH(" + cut + ") THEN DATALENGTH(" + value +
+                       ")" + (unitBytes > 1 ? " / 2" : "") + " END";
+
+            PreviewColumn preview;
+            preview.column = i;
+            preview.lengthColumn = projected.size() + result.previews.size();
+            result.previews.push_back(preview);
+        }
+        selectList += lengths;
+        return true;
+    }
+
+    /**
+     * @brief Bytes per character of a type a preview cuts, 0 for other types
+     * @param value Set to the expression to cut (xml is cut as nvarchar(max))
+     */
+    static int previewUnitBytes(const std::string &type, std::string &value)
+    {
+        std::string name;
+        for (char c : type.substr(0, type.find(' ')))
+            name += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+        if (name == "xml")
+        {
+            value = "CAST(" + value + " AS nvarchar(max))";
+            return 2;
+        }
+        if (name == "nchar" || name == "nvarchar" || name == "ntext" || name == "sysname")
+            return 2;
+        if (name == "char" || name == "varchar" || name == "text" || name == "binary" || name == "varbinary" ||
+            name == "image")
+            return 1;
+        return 0;
+    }
+
+    /**
+     * @brief Resolve Auto and FullText against the column's index metadata
+     */
+    RowFilter resolveFilter(const std::string &schema, const std::string &tableName, const RowFilter &requested)
+    {
+        RowFilter filter = requested;
+        if (!filter.isActive())
+            return filter;
+
+        // Only the modes depending on indexes need the (cached) column metadata
+        if (filter.mode == FilterMode::Auto || filter.mode == FilterMode::FullText)
+        {
+            std::string etag;
+            auto columns = getColumns(schema, tableName, etag);
+            auto column = std::find_if(columns.begin(), columns.end(),
+                                       [&](const ColumnInfo &info) { return info.name == filter.column; });
+            filter.mode = resolveFilterMode(filter.mode, column != columns.end() ? &*column : nullptr, filter.value);
+        }
+        return filter;
+    }
+
+    /**
+     * @brief WHERE predicate of a resolved filter and the value bound to its parameter
+     * @return Empty when the filter is not active
+     */
+    static std::string filterPredicate(const RowFilter &filter, std::string &param)
+    {
+        if (!filter.isActive())
+            return std::string();
+
+        std::string column = "[" + filter.column + "]";
+        switch (filter.mode)
+        {
+        case FilterMode::Exact:
+            param = filter.value;
+            return column + " = ?";
+        case FilterMode::Prefix:
+            // Wildcards in the value are literal; LIKE 'x%' is sargable
+            param.clear();
+            for (char c : filter.value)
+            {
+                if (c == '%' || c == '_' || c == '[')
+                    param += std::string("[") + c + "]";
+                else
+                    param += c;
+            }
+            param += '%';
+            return column + " LIKE ?";
+        case FilterMode::FullText:
+            // One prefix term: "value*" (embedded quotes doubled)
+            param = "\"";
+            for (char c : filter.value)
+            {
+                param += c;
+                if (c == '"')
+                    param += '"';
+            }
+            param += "*\"";
+            return "CONTAINS(" + column + ", ?)";
+        default:
+            param = "%" + filter.value + "%";
+            return column + " LIKE ?";
+        }
+    }
+
+    /**
+     * @brief Columns leading an index and columns covered by a full-text index
+     */
+    static bool loadIndexedColumns(PooledConnection &connection, const std::string &fullTableName,
+                                   std::unordered_set<std::string> &indexed,
+                                   std::unordered_set<std::string> &fullTextIndexed, std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        const char *sql = "SELECT c.name, "
+                          "CASE WHEN EXISTS (SELECT 1 FROM sys.index_columns ic WHERE ic.object_id = c.object_id "
+                          "AND ic.column_id = c.column_id AND ic.key_ordinal = 1) THEN 1 ELSE 0 END, "
+                          "CASE WHEN EXISTS (SELECT 1 FROM sys.fulltext_index_columns fc WHERE fc.object_id = "
+                          "c.object_id AND fc.column_id = c.column_id) THEN 1 ELSE 0 END "
+                          "FROM sys.columns c WHERE c.object_id = OBJECT_ID(?)";
+
+        SQLRETURN ret = SQLPrepare(stmt.get(), (SQLCHAR *)sql, SQL_NTS);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        SQLBindParameter(stmt.get(), 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, fullTableName.size(), 0,
+                         (SQLCHAR *)fullTableName.c_str(), fullTableName.size(), NULL);
+
+        ret = SQLExecute(stmt.get());
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        SQLCHAR colName[256];
+        SQLINTEGER leading = 0, fullText = 0;
+        SQLLEN colNameLen, leadingLen, fullTextLen;
+
+        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+        {
+            SQLGetData(stmt.get(), 1, SQL_C_CHAR, colName, sizeof(colName), &colNameLen);
+            SQLGetData(stmt.get(), 2, SQL_C_SLONG, &leading, 0, &leadingLen);
+            SQLGetData(stmt.get(), 3, SQL_C_SLONG, &fullText, 0, &fullTextLen);
+
+            if (leading)
+                indexed.insert(std::string((char *)colName));
+            if (fullText)
+                fullTextIndexed.insert(std::string((char *)colName));
+        }
+
+        return true;
+    }
+
+    static bool loadColumns(PooledConnection &connection, const std::string &schema, const std::string &tableName,
+                            std::vector<ColumnInfo> &columns, std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLColumns(stmt.get(), NULL, 0, (SQLCHAR *)schema.c_str(), SQL_NTS,
+                                   (SQLCHAR *)tableName.c_str(), SQL_NTS, NULL, 0);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        SQLCHAR colName[256], typeName[256];
+        SQLSMALLINT nullable;
+        SQLLEN colNameLen, typeNameLen, nullableLen;
+
+        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+        {
+            SQLGetData(stmt.get(), 4, SQL_C_CHAR, colName, sizeof(colName), &colNameLen);
+            SQLGetData(stmt.get(), 6, SQL_C_CHAR, typeName, sizeof(typeName), &typeNameLen);
+            SQLGetData(stmt.get(), 11, SQL_C_SSHORT, &nullable, 0, &nullableLen);
+
+            ColumnInfo col;
+            col.name = std::string((char *)colName);
+            col.type = std::string((char *)typeName);
+            col.nullable = (nullable == SQL_NULLABLE);
+            col.isPrimaryKey = false;
+
+            columns.push_back(col);
+        }
+
+        return true;
+    }
+
+    static bool loadPrimaryKeys(PooledConnection &connection, const std::string &schema, const std::string &tableName,
+                                std::unordered_set<std::string> &primaryKeys, std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLPrimaryKeys(stmt.get(), NULL, 0, (SQLCHAR *)schema.c_str(), SQL_NTS,
+                                       (SQLCHAR *)tableName.c_str(), SQL_NTS);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        SQLCHAR pkColName[256];
+        SQLLEN pkColNameLen;
+
+        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+        {
+            SQLGetData(stmt.get(), 4, SQL_C_CHAR, pkColName, sizeof(pkColName), &pkColNameLen);
+            primaryKeys.insert(std::string((char *)pkColName));
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief The foreign keys of a table, by referencing column
+     *
+     * A column in several foreign keys has one reference per key, in the
+     * order SQLForeignKeys lists them.
+     */
+    static bool loadForeignKeys(PooledConnection &connection, const std::string &schema, const std::string &tableName,
+                                std::unordered_map<std::string, std::vector<ColumnReference>> &foreignKeys,
+                                std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLForeignKeys(stmt.get(), NULL, 0, NULL, 0, NULL, 0, NULL, 0, (SQLCHAR *)schema.c_str(),
+                                       SQL_NTS, (SQLCHAR *)tableName.c_str(), SQL_NTS);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        auto readText = [&](SQLUSMALLINT column) {
+            SQLCHAR text[256];
+            SQLLEN length = 0;
+            SQLRETURN read = SQLGetData(stmt.get(), column, SQL_C_CHAR, text, sizeof(text), &length);
+            return SQL_SUCCEEDED(read) && length != SQL_NULL_DATA ? std::string((char *)text) : std::string();
+        };
+
+        // PKTABLE_SCHEM, PKTABLE_NAME, PKCOLUMN_NAME, FKCOLUMN_NAME and FK_NAME, in column order for SQLGetData
+        while (SQLFetch(stmt.get()) == SQL_SUCCESS)
+        {
+            ColumnReference reference;
+            reference.referencedSchema = readText(2);
+            reference.referencedTable = readText(3);
+            reference.referencedColumn = readText(4);
+            std::string column = readText(8);
+            reference.foreignKey = readText(12);
+            foreignKeys[column].push_back(std::move(reference));
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Run the page query and collect its rows
+     * @param param Filter value bound to the first placeholder (nullptr without a filter)
+     * @param keysetParams Cursor values bound to the placeholders after it
+     */
+    static bool fetchPage(PooledConnection &connection, const std::string &sql, const std::string *param,
+                          const std::vector<std::u16string> &keysetParams, QueryResult &result, std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLPrepare(stmt.get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        SQLUSMALLINT number = 1;
+        if (param)
+        {
+            SQLBindParameter(stmt.get(), number++, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, param->size(), 0,
+                             (SQLCHAR *)param->c_str(), param->size(), NULL);
+        }
+
+        // The lengths must outlive SQLExecute
+        std::vector<SQLLEN> lengths(keysetParams.size());
+        for (size_t i = 0; i < keysetParams.size(); i++)
+        {
+            const std::u16string &value = keysetParams[i];
+            lengths[i] = static_cast<SQLLEN>(value.size() * sizeof(char16_t));
+            SQLBindParameter(stmt.get(), number++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR,
+                             std::max<size_t>(value.size(), 1), 0, (SQLPOINTER)value.data(), lengths[i], &lengths[i]);
+        }
+
+        ret = SQLExecute(stmt.get());
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        ret = fetchResultSet(stmt.get(), result.data);
+        if (ret != SQL_NO_DATA)
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Run a query returning key range bounds in its first column
+     * @param param Bound to the placeholder (nullptr without one)
+     */
+    static bool fetchBounds(PooledConnection &connection, const std::string &sql, const std::string *param,
+                            ResultSet &data, std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLPrepare(stmt.get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
+        if (SQL_SUCCEEDED(ret) && param)
+        {
+            ret = SQLBindParameter(stmt.get(), 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, param->size(), 0,
+                                   (SQLCHAR *)param->c_str(), param->size(), NULL);
+        }
+        if (SQL_SUCCEEDED(ret))
+            ret = SQLExecute(stmt.get());
+
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        ret = fetchResultSet(stmt.get(), data);
+        if (ret != SQL_NO_DATA)
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Count rows on the server (no caching)
+     *
+     * Unfiltered, non-exact counts come from partition metadata and are
+     * marked approximate; everything else runs COUNT_BIG(*).
+     */
+    static bool computeRowCount(PooledConnection &connection, const std::string &fullTableName,
+                                const RowFilter &filter, bool exact, RowCount &count, std::string &error)
+    {
+        if (!filter.isActive() && !exact)
+        {
+            // dm_db_partition_stats needs VIEW DATABASE STATE; sys.partitions only metadata visibility
+            static const char *estimateQueries[] = {
+                "SELECT SUM(row_count) FROM sys.dm_db_partition_stats "
+                "WHERE object_id = OBJECT_ID(?) AND index_id IN (0, 1)",
+                "SELECT SUM(rows) FROM sys.partitions WHERE object_id = OBJECT_ID(?) AND index_id IN (0, 1)"};
+
+            std::string ignored;
+            for (const char *sql : estimateQueries)
+            {
+                if (queryScalar(connection, sql, &fullTableName, count.value, ignored))
+                {
+                    count.approximate = true;
+                    return true;
+                }
+            }
+        }
+
+        std::string sql = "SELECT COUNT_BIG(*) FROM " + fullTableName;
+        std::string filterParam;
+        std::string predicate = filterPredicate(filter, filterParam);
+        if (!predicate.empty())
+            sql += " WHERE " + predicate;
+
+        count.approximate = false;
+        return queryScalar(connection, sql, predicate.empty() ? nullptr : &filterParam, count.value, error);
+    }
+
+    /**
+     * @brief Run a query returning a single BIGINT, with an optional string parameter
+     */
+    static bool queryScalar(PooledConnection &connection, const std::string &sql, const std::string *param,
+                            long long &value, std::string &error)
+    {
+        PooledStatement stmt(connection);
+        if (!stmt)
+        {
+            error = "Failed to allocate statement handle";
+            return false;
+        }
+
+        SQLRETURN ret = SQLPrepare(stmt.get(), (SQLCHAR *)sql.c_str(), SQL_NTS);
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        if (param)
+        {
+            SQLBindParameter(stmt.get(), 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, param->size(), 0,
+                             (SQLCHAR *)param->c_str(), param->size(), NULL);
+        }
+
+        ret = SQLExecute(stmt.get());
+        if (!SQL_SUCCEEDED(ret))
+        {
+            error = getOdbcError(SQL_HANDLE_STMT, stmt.get());
+            return false;
+        }
+
+        if (SQLFetch(stmt.get()) != SQL_SUCCESS)
+        {
+            error = "Query returned no rows";
+            return false;
+        }
+
+        SQLBIGINT scalar = 0;
+        SQLLEN indicator = 0;
+        ret = SQLGetData(stmt.get(), 1, SQL_C_SBIGINT, &scalar, 0, &indicator);
+        if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA)
+        {
+            error = "Query returned NULL";
+            return false;
+        }
+
+        value = scalar;
+        return true;
+    }
+
+    /**
+     * @brief Count in the background on a pooled connection
+     *
+     * The worker leases its own connection so it neither holds this session's
+     * lock nor depends on the session staying alive. Without the page's time
+     * limit, an exact count that timed out is retried here rather than
+     * replaced by a catalog estimate.
+     */
+    void startDeferredCount(const std::string &countKey, const std::string &schema, const std::string &tableName,
+                            const RowFilter &filter, bool exact)
+    {
+        std::string connectionString = m_connectionString;
+        std::string database = m_currentDatabase;
+
+        CountCache::getInstance().computeAsync(countKey, [=](RowCount &count) {
+            std::string fullTableName = quoteTableName(schema, tableName);
+
+            QueryExecutor executor(connectionString, database);
+            executor.add([&](PooledConnection &connection, std::string &error) {
+                return computeRowCount(connection, fullTableName, filter, exact, count, error);
+            });
+            return executor.run()[0].success;
+        });
+    }
+
+    std::string m_connectionString;
+    std::string m_currentDatabase;
+    std::string m_lastError;
+    bool m_connected;
+};
+
+std::unique_ptr<DataBackend> createSqlServerBackend()
+{
+    return std::make_unique<SqlServerBackend>();
+}
+
+} // namespace Data
+} // namespace Tootega
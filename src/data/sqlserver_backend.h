@@ -0,0 +1,24 @@
+/**
+ * @file sqlserver_backend.h
+ * @brief SQL Server backend over ODBC
+ */
+
+#pragma once
+
+#include "data_backend.h"
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Create a backend for an ADO.NET style SQL Server connection string
+ *
+ * Catalog browsing runs on the session's own ODBC connection; data and count
+ * queries run on connections leased from the shared ConnectionPool.
+ */
+std::unique_ptr<DataBackend> createSqlServerBackend();
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,479 @@
+/**
+ * @file utf8_transcode.cpp
+ * @brief UTF-16 / UTF-8 transcoding implementation
+ */
+
+#include "utf8_transcode.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TOOTEGA_UTF_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TOOTEGA_UTF_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Encode the code point at @p in, advancing both pointers
+ */
+static inline void encodeScalar(const char16_t *&in, const char16_t *end, char *&out)
+{
+    char32_t unit = *in++;
+    if (unit < 0x80)
+    {
+        *out++ = static_cast<char>(unit);
+        return;
+    }
+    if (unit < 0x800)
+    {
+        *out++ = static_cast<char>(0xC0 | (unit >> 6));
+        *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+        return;
+    }
+
+    if (unit >= 0xD800 && unit <= 0xDFFF)
+    {
+        if (unit <= 0xDBFF && in < end && *in >= 0xDC00 && *in <= 0xDFFF)
+        {
+            char32_t codePoint = 0x10000 + ((unit - 0xD800) << 10) + (*in++ - 0xDC00);
+            *out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return;
+        }
+        unit = 0xFFFD;
+    }
+
+    *out++ = static_cast<char>(0xE0 | (unit >> 12));
+    *out++ = static_cast<char>(0x80 | ((unit >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+}
+
+/*
+ * Vector kernels encode whole blocks while every unit of a block is below
+ * U+0800 (one or two bytes: ASCII and all Latin accents). At a block holding
+ * a larger unit they encode its ASCII prefix and return the number of units
+ * consumed, leaving the input at a unit >= 0x80 (or at the end) for the scalar
+ * encoder. The last, partial block is copied into a zero-padded block; the
+ * padding encodes to one byte per unit, taken back afterwards. Stores are
+ * block-wide; utf8MaxLength() leaves room past the last one.
+ */
+
+static inline size_t encodeScalarAscii(const char16_t *in, size_t units, char *&out)
+{
+    size_t i = 0;
+    while (i < units && in[i] < 0x80)
+    {
+        out[i] = static_cast<char>(in[i]);
+        i++;
+    }
+    out += i;
+    return i;
+}
+
+static inline unsigned countTrailingZeros(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+#if defined(TOOTEGA_UTF_X86) || defined(TOOTEGA_UTF_NEON)
+
+/**
+ * @brief Shuffles that compact 8 (lead, continuation) byte pairs
+ *
+ * Indexed by a mask with bit i set when unit i takes two bytes; the
+ * continuation byte of ASCII units is dropped.
+ */
+struct PackTable
+{
+    uint8_t shuffle[256][16];
+    uint8_t length[256];
+};
+
+static constexpr PackTable makePackTable()
+{
+    PackTable table{};
+    for (unsigned mask = 0; mask < 256; mask++)
+    {
+        unsigned n = 0;
+        for (unsigned i = 0; i < 8; i++)
+        {
+            table.shuffle[mask][n++] = static_cast<uint8_t>(2 * i);
+            if (mask & (1u << i))
+                table.shuffle[mask][n++] = static_cast<uint8_t>(2 * i + 1);
+        }
+        table.length[mask] = static_cast<uint8_t>(n);
+        for (; n < 16; n++)
+            table.shuffle[mask][n] = 0x80;
+    }
+    return table;
+}
+
+alignas(16) static constexpr PackTable kPackTable = makePackTable();
+
+#endif
+
+#ifdef TOOTEGA_UTF_X86
+
+// SSE2 has no byte shuffle, so only the ASCII prefix of 8 units is taken
+static inline size_t encodeBlockSse2(const char16_t *in, char *&out)
+{
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+    __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    __m128i isAscii = _mm_cmpeq_epi16(_mm_and_si128(block, nonAscii), _mm_setzero_si128());
+
+    // Units above 0x7F saturate to 0xFF; only the ASCII prefix is kept
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(block, block));
+
+    // Two mask bits per unit
+    unsigned ascii = static_cast<unsigned>(_mm_movemask_epi8(isAscii));
+    size_t prefix = ascii == 0xFFFF ? 8 : countTrailingZeros(~ascii) / 2;
+    out += prefix;
+    return prefix;
+}
+
+static inline size_t encodeSse2(const char16_t *in, size_t units, char *&out)
+{
+    // Work on a copy: stores through char * could alias out and force reloads
+    char *dest = out;
+    size_t i = 0;
+    for (; i + 8 <= units; i += 8)
+    {
+        size_t consumed = encodeBlockSse2(in + i, dest);
+        if (consumed < 8)
+        {
+            out = dest;
+            return i + consumed;
+        }
+    }
+
+    size_t tail = units - i;
+    if (tail > 0)
+    {
+        char16_t padded[8] = {};
+        std::memcpy(padded, in + i, tail * sizeof(char16_t));
+        size_t consumed = encodeBlockSse2(padded, dest);
+        if (consumed < 8)
+        {
+            out = dest;
+            return i + consumed;
+        }
+        dest -= 8 - tail;
+    }
+
+    out = dest;
+    return units;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TOOTEGA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TOOTEGA_TARGET_AVX2
+#endif
+
+// Encode 8 units below U+0800 as 1 or 2 bytes each
+TOOTEGA_TARGET_AVX2 static inline char *encodeTwoByteAvx2(__m128i block, char *out)
+{
+    __m128i lead = _mm_or_si128(_mm_srli_epi16(block, 6), _mm_set1_epi16(0x00C0));
+    __m128i cont = _mm_or_si128(_mm_and_si128(block, _mm_set1_epi16(0x003F)), _mm_set1_epi16(0x0080));
+    __m128i pairs = _mm_or_si128(lead, _mm_slli_epi16(cont, 8));
+
+    // ASCII units keep their value in the lead byte
+    __m128i isAscii = _mm_cmplt_epi16(block, _mm_set1_epi16(0x0080));
+    __m128i bytes = _mm_blendv_epi8(pairs, block, isAscii);
+
+    unsigned twoByte = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(isAscii, isAscii))) & 0xFF;
+    __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(kPackTable.shuffle[twoByte]));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(bytes, shuffle));
+    return out + kPackTable.length[twoByte];
+}
+
+// 16 units per block, encoded as two halves of 8
+TOOTEGA_TARGET_AVX2 static inline size_t encodeBlockAvx2(const char16_t *in, char *&out)
+{
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+    __m256i nonAscii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    __m128i low = _mm256_castsi256_si128(block);
+    __m128i high = _mm256_extracti128_si256(block, 1);
+
+    // packus works per 128-bit lane, so pack the two halves explicitly
+    if (_mm256_testz_si256(block, nonAscii))
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(low, high));
+        out += 16;
+        return 16;
+    }
+    if (_mm256_testz_si256(block, _mm256_set1_epi16(static_cast<short>(0xF800))))
+    {
+        out = encodeTwoByteAvx2(low, out);
+        out = encodeTwoByteAvx2(high, out);
+        return 16;
+    }
+
+    // Three-byte unit or surrogate somewhere: take the ASCII prefix only
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(low, high));
+    __m256i isAscii = _mm256_cmpeq_epi16(_mm256_and_si256(block, nonAscii), _mm256_setzero_si256());
+    size_t prefix = countTrailingZeros(~static_cast<unsigned>(_mm256_movemask_epi8(isAscii))) / 2;
+    out += prefix;
+    return prefix;
+}
+
+TOOTEGA_TARGET_AVX2 static inline size_t encodeAvx2(const char16_t *in, size_t units, char *&out)
+{
+    // Work on a copy: stores through char * could alias out and force reloads
+    char *dest = out;
+    size_t i = 0;
+    for (; i + 16 <= units; i += 16)
+    {
+        size_t consumed = encodeBlockAvx2(in + i, dest);
+        if (consumed < 16)
+        {
+            out = dest;
+            return i + consumed;
+        }
+    }
+
+    size_t tail = units - i;
+    if (tail > 0)
+    {
+        char16_t padded[16] = {};
+        std::memcpy(padded, in + i, tail * sizeof(char16_t));
+        size_t consumed = encodeBlockAvx2(padded, dest);
+        if (consumed < 16)
+        {
+            out = dest;
+            return i + consumed;
+        }
+        dest -= 16 - tail;
+    }
+
+    out = dest;
+    return units;
+}
+
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The OS must save the YMM registers (OSXSAVE + AVX, XCR0 bits 1-2)
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // TOOTEGA_UTF_X86
+
+#ifdef TOOTEGA_UTF_NEON
+
+// 8 units per block, the 1-2 byte blocks compacted with a table lookup
+static inline size_t encodeBlockNeon(const char16_t *in, char *&out)
+{
+    static const uint16_t kLaneBits[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+
+    uint16x8_t block = vld1q_u16(reinterpret_cast<const uint16_t *>(in));
+    uint16_t largest = vmaxvq_u16(block);
+
+    if (largest < 0x80)
+    {
+        vst1_u8(reinterpret_cast<uint8_t *>(out), vmovn_u16(block));
+        out += 8;
+        return 8;
+    }
+    if (largest >= 0x800)
+    {
+        // Three-byte unit or surrogate somewhere: take the ASCII prefix only
+        return encodeScalarAscii(in, 8, out);
+    }
+
+    uint16x8_t lead = vorrq_u16(vshrq_n_u16(block, 6), vdupq_n_u16(0x00C0));
+    uint16x8_t cont = vorrq_u16(vandq_u16(block, vdupq_n_u16(0x003F)), vdupq_n_u16(0x0080));
+    uint16x8_t pairs = vorrq_u16(lead, vshlq_n_u16(cont, 8));
+
+    // ASCII units keep their value in the lead byte
+    uint16x8_t isAscii = vcltq_u16(block, vdupq_n_u16(0x0080));
+    uint16x8_t bytes = vbslq_u16(isAscii, block, pairs);
+
+    unsigned twoByte = vaddvq_u16(vbicq_u16(vld1q_u16(kLaneBits), isAscii));
+    uint8x16_t packed = vqtbl1q_u8(vreinterpretq_u8_u16(bytes), vld1q_u8(kPackTable.shuffle[twoByte]));
+    vst1q_u8(reinterpret_cast<uint8_t *>(out), packed);
+    out += kPackTable.length[twoByte];
+    return 8;
+}
+
+static inline size_t encodeNeon(const char16_t *in, size_t units, char *&out)
+{
+    // Work on a copy: stores through char * could alias out and force reloads
+    char *dest = out;
+    size_t i = 0;
+    for (; i + 8 <= units; i += 8)
+    {
+        size_t consumed = encodeBlockNeon(in + i, dest);
+        if (consumed < 8)
+        {
+            out = dest;
+            return i + consumed;
+        }
+    }
+
+    size_t tail = units - i;
+    if (tail > 0)
+    {
+        char16_t padded[8] = {};
+        std::memcpy(padded, in + i, tail * sizeof(char16_t));
+        size_t consumed = encodeBlockNeon(padded, dest);
+        if (consumed < 8)
+        {
+            out = dest;
+            return i + consumed;
+        }
+        dest -= 8 - tail;
+    }
+
+    out = dest;
+    return units;
+}
+
+#endif // TOOTEGA_UTF_NEON
+
+/**
+ * @brief Transcode with @p EncodeBlocks taking everything below U+0800 it can
+ *
+ * Instantiated once per kernel so the kernel is inlined into the loop. The
+ * scalar encoder takes the non-ASCII runs the kernel stops at.
+ */
+template <size_t (*EncodeBlocks)(const char16_t *, size_t, char *&)>
+static inline size_t transcode(const char16_t *in, size_t units, char *out)
+{
+    const char16_t *end = in + units;
+    char *start = out;
+
+    while (in < end)
+    {
+        in += EncodeBlocks(in, static_cast<size_t>(end - in), out);
+
+        // Latin text rarely has more than one or two of these in a row
+        while (in < end && *in >= 0x80)
+            encodeScalar(in, end, out);
+    }
+
+    return static_cast<size_t>(out - start);
+}
+
+using Transcoder = size_t (*)(const char16_t *in, size_t units, char *out);
+
+#ifdef TOOTEGA_UTF_X86
+TOOTEGA_TARGET_AVX2 static size_t transcodeAvx2(const char16_t *in, size_t units, char *out)
+{
+    return transcode<encodeAvx2>(in, units, out);
+}
+#endif
+
+struct KernelChoice
+{
+    Transcoder transcoder;
+    const char *name;
+};
+
+static const KernelChoice &selectKernel()
+{
+    static const KernelChoice choice = []() -> KernelChoice {
+#if defined(TOOTEGA_UTF_X86)
+        if (cpuHasAvx2())
+            return {transcodeAvx2, "avx2"};
+        return {transcode<encodeSse2>, "sse2"};
+#elif defined(TOOTEGA_UTF_NEON)
+        return {transcode<encodeNeon>, "neon"};
+#else
+        return {transcode<encodeScalarAscii>, "scalar"};
+#endif
+    }();
+    return choice;
+}
+
+size_t utf16ToUtf8(const char16_t *in, size_t units, char *out)
+{
+    return selectKernel().transcoder(in, units, out);
+}
+
+std::u16string utf8ToUtf16(std::string_view in)
+{
+    std::u16string out;
+    out.reserve(in.size());
+
+    size_t i = 0;
+    while (i < in.size())
+    {
+        auto lead = static_cast<unsigned char>(in[i]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        char32_t codePoint = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+
+        bool valid = length > 0 && i + length <= in.size();
+        for (size_t k = 1; valid && k < length; k++)
+        {
+            auto next = static_cast<unsigned char>(in[i + k]);
+            valid = (next & 0xC0) == 0x80;
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+
+        // Overlong forms, surrogates and values past U+10FFFF are not characters
+        static constexpr char32_t kMinimum[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (!valid || codePoint < kMinimum[length] || codePoint > 0x10FFFF ||
+            (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+        {
+            out += u'\uFFFD';
+            i++;
+            continue;
+        }
+
+        if (codePoint >= 0x10000)
+        {
+            codePoint -= 0x10000;
+            out += static_cast<char16_t>(0xD800 + (codePoint >> 10));
+            out += static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF));
+        }
+        else
+        {
+            out += static_cast<char16_t>(codePoint);
+        }
+        i += length;
+    }
+    return out;
+}
+
+const char *utf16KernelName()
+{
+    return selectKernel().name;
+}
+
+} // namespace Data
+} // namespace Tootega
@@ -0,0 +1,54 @@
+/**
+ * @file utf8_transcode.h
+ * @brief UTF-16 / UTF-8 transcoding for text exchanged with ODBC
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Tootega
+{
+namespace Data
+{
+
+/**
+ * @brief Output buffer size utf16ToUtf8() needs for @p units UTF-16 code units
+ *
+ * A BMP character takes at most 3 bytes and a surrogate pair (2 units) takes
+ * 4; the extra 32 bytes let the vector kernels store a whole block at the end.
+ */
+constexpr size_t utf8MaxLength(size_t units)
+{
+    return units * 3 + 32;
+}
+
+/**
+ * @brief Convert UTF-16 to UTF-8
+ *
+ * Text below U+0800 (ASCII and the Latin accents) is encoded with AVX2 or
+ * NEON depending on the CPU, ASCII alone with SSE2; everything else goes
+ * through the scalar encoder. Unpaired surrogates are replaced with U+FFFD.
+ *
+ * @param out Must have room for utf8MaxLength(units) bytes; bytes past the
+ *            returned length may be overwritten
+ * @return Number of bytes written
+ */
+size_t utf16ToUtf8(const char16_t *in, size_t units, char *out);
+
+/**
+ * @brief Convert UTF-8 to UTF-16, for values bound as SQL_C_WCHAR parameters
+ *
+ * Scalar only: parameters are short. Invalid sequences are replaced with U+FFFD.
+ */
+std::u16string utf8ToUtf16(std::string_view in);
+
+/**
+ * @brief Name of the ASCII kernel picked for this CPU ("avx2", "sse2", "neon" or "scalar")
+ */
+const char *utf16KernelName();
+
+} // namespace Data
+} // namespace Tootega
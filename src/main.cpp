@@ -13,8 +13,18 @@
 #include <csignal>
 #include <iostream>
 
+#include "api/browseroso_controller.h"
+#include "core/export_tracker.h"
+#include "core/import_tracker.h"
 #include "core/server.h"
 #include "core/system_info.h"
+#include "data/change_feed.h"
+#include "data/connection_manager.h"
+#include "data/db_executor.h"
+#include "data/page_cache.h"
+#include "data/page_prefetcher.h"
+#include "data/sqlite_backend.h"
+#include "data/utf8_transcode.h"
 
 namespace
 {
@@ -63,10 +73,19 @@ int main(int argc, char *argv[])
     std::cout << "  - OS: " << sysInfo.getOSName() << " " << sysInfo.getOSVersion() << std::endl;
     std::cout << "  - Architecture: " << sysInfo.getArchitecture() << std::endl;
     std::cout << "  - Hostname: " << sysInfo.getHostname() << std::endl;
+    std::cout << "  - Text transcoding: " << Tootega::Data::utf16KernelName() << std::endl;
 
     // Parse command line arguments
     std::string host = "0.0.0.0";
     int port = 8080;
+    size_t maxSessions = Tootega::Data::ConnectionManager::kDefaultMaxSessions;
+    int sessionIdleSeconds = Tootega::Data::ConnectionManager::kDefaultMaxIdleSeconds;
+    size_t pageCacheBytes = Tootega::Data::PageCache::kDefaultBudgetBytes;
+    int pageCacheTtlSeconds = Tootega::Data::PageCache::kDefaultTtlSeconds;
+    size_t maxWatchers = Tootega::Data::ChangeFeed::kDefaultMaxWatchers;
+    int watchIntervalSeconds = Tootega::Data::ChangeFeed::kDefaultPollSeconds;
+    std::string sqliteDirectory;
+    bool sqliteWritable = false;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -79,18 +98,106 @@ int main(int argc, char *argv[])
         {
             port = std::stoi(argv[++i]);
         }
+        else if (arg == "--db-threads" && i + 1 < argc)
+        {
+            Tootega::Data::DbExecutor::configure(std::stoul(argv[++i]));
+        }
+        else if (arg == "--request-timeout" && i + 1 < argc)
+        {
+            Tootega::Api::BrowserosoController::setRequestTimeout(std::stoi(argv[++i]));
+        }
+        else if (arg == "--max-sessions" && i + 1 < argc)
+        {
+            maxSessions = std::stoul(argv[++i]);
+        }
+        else if (arg == "--session-idle-timeout" && i + 1 < argc)
+        {
+            sessionIdleSeconds = std::stoi(argv[++i]);
+        }
+        else if (arg == "--page-cache-mb" && i + 1 < argc)
+        {
+            pageCacheBytes = std::stoul(argv[++i]) * 1024 * 1024;
+        }
+        else if (arg == "--page-cache-ttl" && i + 1 < argc)
+        {
+            pageCacheTtlSeconds = std::stoi(argv[++i]);
+        }
+        else if (arg == "--prefetch-pages" && i + 1 < argc)
+        {
+            Tootega::Data::PagePrefetcher::configure(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-exports" && i + 1 < argc)
+        {
+            Tootega::Core::ExportTracker::configure(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-imports" && i + 1 < argc)
+        {
+            Tootega::Core::ImportTracker::configure(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-watchers" && i + 1 < argc)
+        {
+            maxWatchers = std::stoul(argv[++i]);
+        }
+        else if (arg == "--watch-interval" && i + 1 < argc)
+        {
+            watchIntervalSeconds = std::stoi(argv[++i]);
+        }
+        else if (arg == "--sqlite-dir" && i + 1 < argc)
+        {
+            sqliteDirectory = argv[++i];
+        }
+        else if (arg == "--sqlite-writable")
+        {
+            sqliteWritable = true;
+        }
         else if (arg == "--help")
         {
             std::cout << "\nUsage: " << argv[0] << " [options]\n"
                       << "Options:\n"
                       << "  -h, --host <address>  Bind address (default: 0.0.0.0)\n"
                       << "  -p, --port <port>     Port number (default: 8080)\n"
+                      << "  --db-threads <n>      Threads running database queries (default: "
+                      << Tootega::Data::DbExecutor::kDefaultThreads << ")\n"
+                      << "  --request-timeout <s> Deadline of table queries in seconds (default: "
+                      << Tootega::Api::BrowserosoController::kDefaultRequestTimeoutSeconds << ")\n"
+                      << "  --max-sessions <n>    Browseroso sessions kept open (default: "
+                      << Tootega::Data::ConnectionManager::kDefaultMaxSessions << ")\n"
+                      << "  --session-idle-timeout <s>  Close sessions idle this long (default: "
+                      << Tootega::Data::ConnectionManager::kDefaultMaxIdleSeconds << ")\n"
+                      << "  --page-cache-mb <n>   Memory for cached table pages, 0 disables (default: "
+                      << Tootega::Data::PageCache::kDefaultBudgetBytes / (1024 * 1024) << ")\n"
+                      << "  --page-cache-ttl <s>  Lifetime of a cached page (default: "
+                      << Tootega::Data::PageCache::kDefaultTtlSeconds << ")\n"
+                      << "  --prefetch-pages <n>  Table pages loaded ahead per session, 0 disables (default: "
+                      << Tootega::Data::PagePrefetcher::kDefaultPagesAhead << ", max "
+                      << Tootega::Data::PagePrefetcher::kMaxPagesAhead << ")\n"
+                      << "  --max-exports <n>     Table exports streamed at once (default: "
+                      << Tootega::Core::ExportTracker::kDefaultMaxRunning << ")\n"
+                      << "  --max-imports <n>     Bulk imports running at once (default: "
+                      << Tootega::Core::ImportTracker::kDefaultMaxRunning << ")\n"
+                      << "  --max-watchers <n>    Table change feeds streamed at once (default: "
+                      << Tootega::Data::ChangeFeed::kDefaultMaxWatchers << ")\n"
+                      << "  --watch-interval <s>  Seconds between two polls of a watched table (default: "
+                      << Tootega::Data::ChangeFeed::kDefaultPollSeconds << ")\n"
+                      << "  --sqlite-dir <path>   Allow SQLite connections to the files under this directory\n"
+                      << "                        (default: none, SQLite connections refused)\n"
+                      << "  --sqlite-writable     Open SQLite files read-write for imports and edits\n"
                       << "  --help                Show this help message\n"
                       << std::endl;
             return 0;
         }
     }
 
+    Tootega::Data::ConnectionManager::configure(maxSessions, sessionIdleSeconds);
+    Tootega::Data::PageCache::configure(pageCacheBytes, pageCacheTtlSeconds);
+    Tootega::Data::ChangeFeed::configure(maxWatchers, watchIntervalSeconds);
+    if (!sqliteDirectory.empty() && !Tootega::Data::configureSqliteBackend(sqliteDirectory, sqliteWritable))
+    {
+        std::cerr << "[ERROR] Invalid --sqlite-dir (not a directory, or built without SQLite): " << sqliteDirectory
+                  << std::endl;
+        return 1;
+    }
+
     // Create and start server
     try
     {
@@ -1,3 +1,9 @@
+const FILTER_MODE_LABELS = {
+    contains: 'contém',
+    prefix: 'começa com',
+    exact: 'igual a',
+    fulltext: 'texto completo'
+};
 (function () {
     'use strict';
     Auth.requireAuth();
@@ -7,6 +13,32 @@
         const urlWithTab = url + separator + 'tabId=' + encodeURIComponent(tabId);
         return Auth.authFetch(urlWithTab, options);
     }
+    let jobGeneration = 0;
+    let activeJobId = null;
+    function cancelJob(jobId) {
+        tabFetch(`/api/browseroso/jobs?id=${encodeURIComponent(jobId)}`, { method: 'DELETE' }).catch(() => undefined);
+    }
+    async function jobFetch(url) {
+        const generation = ++jobGeneration;
+        if (activeJobId) {
+            cancelJob(activeJobId);
+            activeJobId = null;
+        }
+        let response = await tabFetch(url, { headers: { 'Prefer': 'respond-async' } });
+        while (response.status === 202) {
+            const job = await response.json();
+            if (generation !== jobGeneration) {
+                cancelJob(job.jobId);
+                return null;
+            }
+            activeJobId = job.jobId;
+            response = await tabFetch(`/api/browseroso/jobs?id=${encodeURIComponent(job.jobId)}`);
+        }
+        if (generation !== jobGeneration)
+            return null;
+        activeJobId = null;
+        return response;
+    }
     let isConnected = false;
     let selectedDatabase = null;
     let selectedTable = null;
@@ -15,6 +47,10 @@
     let currentPage = 1;
     let totalPages = 1;
     const pageSize = 50;
+    let sortKeys = [];
+    let nextCursor = null;
+    let currentRows = [];
+    const previewLength = 200;
     const connectBtn = document.getElementById('connectBtn');
     const statusDot = document.getElementById('statusDot');
     const statusText = document.getElementById('statusText');
@@ -24,8 +60,11 @@
     const filterPanel = document.getElementById('filterPanel');
     const filterColumn = document.getElementById('filterColumn');
     const filterValue = document.getElementById('filterValue');
+    const filterMode = document.getElementById('filterMode');
     const btnFilter = document.getElementById('btnFilter');
     const btnClearFilter = document.getElementById('btnClearFilter');
+    const exportFormat = document.getElementById('exportFormat');
+    const btnExport = document.getElementById('btnExport');
     const dataPanel = document.getElementById('dataPanel');
     const pagination = document.getElementById('pagination');
     const paginationInfo = document.getElementById('paginationInfo');
@@ -227,6 +266,7 @@
         selectedSchema = schema;
         selectedTable = table;
         currentPage = 1;
+        sortKeys = [];
         filterPanel.classList.remove('hidden');
         try {
             const response = await tabFetch(`/api/browseroso/columns?schema=${encodeURIComponent(schema)}&table=${encodeURIComponent(table)}`);
@@ -244,7 +284,7 @@
             `;
         }
     }
-    async function loadData() {
+    async function loadData(cursor = null) {
         if (!selectedTable || !selectedSchema)
             return;
         dataPanel.innerHTML = `
@@ -255,20 +295,33 @@
         `;
         const fc = filterColumn.value;
         const fv = filterValue.value;
-        let url = `/api/browseroso/data?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&page=${currentPage}&pageSize=${pageSize}`;
+        let url = `/api/browseroso/data?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&page=${currentPage}&pageSize=${pageSize}&preview=${previewLength}`;
         if (fc && fv) {
-            url += `&filterColumn=${encodeURIComponent(fc)}&filterValue=${encodeURIComponent(fv)}`;
+            url += `&filterColumn=${encodeURIComponent(fc)}&filterValue=${encodeURIComponent(fv)}&filterMode=${encodeURIComponent(filterMode.value)}`;
+        }
+        if (sortKeys.length > 0) {
+            url += `&sort=${encodeURIComponent(sortKeys.map(k => `${k.column}:${k.direction}`).join(','))}`;
+        }
+        if (cursor) {
+            url += `&cursor=${encodeURIComponent(cursor)}`;
         }
         try {
-            const response = await tabFetch(url);
+            const response = await jobFetch(url);
+            if (!response)
+                return;
             const data = await response.json();
             if (!data.success) {
                 dataPanel.innerHTML = `<div class="message message--error">${escapeHtml(data.error)}</div>`;
                 return;
             }
             totalPages = data.totalPages || 1;
+            nextCursor = data.nextCursor || null;
+            sortKeys = data.sort || sortKeys;
             if (data.rows && data.rows.length > 0 && data.columns) {
-                renderTable(data.columns, data.rows, data.totalRows || 0);
+                renderTable(data.columns, data.rows, data.totalRows || 0, !!data.totalRowsApproximate, data.truncated || []);
+                if (data.filterMode) {
+                    paginationInfo.textContent += ` · filtro: ${FILTER_MODE_LABELS[data.filterMode] || data.filterMode}`;
+                }
             }
             else {
                 dataPanel.innerHTML = `
@@ -289,42 +342,95 @@
             `;
         }
     }
-    function renderTable(columnNames, rows, totalRows) {
+    function renderTable(columnNames, rows, totalRows, approximate, truncated) {
+        currentRows = rows;
+        const cut = new Map(truncated.map(t => [`${t.row}:${t.column}`, t.length]));
         let html = '<table class="table"><thead><tr>';
         for (const col of columnNames) {
-            const isPK = columns.some(c => c.name === col && c.isPrimaryKey);
-            html += `<th class="${isPK ? 'table__pk' : ''}">${isPK ? '🔑 ' : ''}${escapeHtml(col)}</th>`;
+            const info = columns.find(c => c.name === col);
+            const isPK = !!info && info.isPrimaryKey;
+            const sorted = sortKeys.find(k => k.column === col);
+            const indexed = sorted && sorted.indexed !== undefined ? sorted.indexed : !!info && info.isIndexed;
+            const arrow = sorted ? (sorted.direction === 'asc' ? ' ▲' : ' ▼') : '';
+            const warning = sorted && !indexed ? ' ⚠' : '';
+            const title = indexed ? 'Ordenar (Shift+clique adiciona)' : 'Sem índice: ordenar por esta coluna lê a tabela inteira';
+            html += `<th class="table__sortable${isPK ? ' table__pk' : ''}" data-column="${escapeHtml(col)}" title="${title}">${isPK ? '🔑 ' : ''}${escapeHtml(col)}${arrow}${warning}</th>`;
         }
         html += '</tr></thead><tbody>';
-        for (const row of rows) {
+        rows.forEach((row, index) => {
             html += '<tr>';
             for (const col of columnNames) {
                 const value = row[col];
-                if (value === null || value === undefined || value === 'NULL') {
+                const fullLength = cut.get(`${index}:${col}`);
+                if (value === null || value === undefined) {
                     html += '<td class="table__null">NULL</td>';
                 }
+                else if (fullLength !== undefined) {
+                    html += `<td class="table__truncated" data-row="${index}" data-column="${escapeHtml(col)}" title="Valor cortado (${fullLength} no total): clique para carregar">${escapeHtml(String(value))}…</td>`;
+                }
                 else {
                     html += `<td title="${escapeHtml(String(value))}">${escapeHtml(String(value))}</td>`;
                 }
             }
             html += '</tr>';
-        }
+        });
         html += '</tbody></table>';
         dataPanel.innerHTML = html;
         pagination.classList.remove('hidden');
-        paginationInfo.textContent = `Mostrando ${(currentPage - 1) * pageSize + 1} - ${Math.min(currentPage * pageSize, totalRows)} de ${totalRows} registros`;
+        paginationInfo.textContent = `Mostrando ${(currentPage - 1) * pageSize + 1} - ${Math.min(currentPage * pageSize, totalRows)} de ${approximate ? '~' : ''}${totalRows} registros`;
         pageInfo.textContent = `Página ${currentPage} de ${totalPages}`;
         btnFirst.disabled = currentPage === 1;
         btnPrev.disabled = currentPage === 1;
         btnNext.disabled = currentPage >= totalPages;
         btnLast.disabled = currentPage >= totalPages;
     }
-    function goToPage(page) {
+    function goToPage(page, cursor = null) {
         if (page < 1)
             page = 1;
         if (page > totalPages)
             page = totalPages;
         currentPage = page;
+        loadData(cursor);
+    }
+    async function loadFullValue(cell) {
+        const keys = columns.filter(c => c.isPrimaryKey);
+        const row = currentRows[Number(cell.dataset.row)];
+        const column = cell.dataset.column;
+        if (!row || !column || !selectedTable || !selectedSchema)
+            return;
+        if (keys.length !== 1) {
+            cell.title = 'Valor cortado: a tabela não tem chave primária simples para carregá-lo';
+            return;
+        }
+        const key = keys[0].name;
+        const url = `/api/browseroso/data?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&pageSize=1&columns=${encodeURIComponent(column)}&filterColumn=${encodeURIComponent(key)}&filterValue=${encodeURIComponent(String(row[key]))}&filterMode=exact`;
+        try {
+            const response = await tabFetch(url);
+            const data = await response.json();
+            if (data.success && data.rows && data.rows.length === 1) {
+                const value = String(data.rows[0][column]);
+                cell.textContent = value;
+                cell.title = value;
+                cell.classList.remove('table__truncated');
+            }
+        }
+        catch {
+        }
+    }
+    function toggleSort(column, append) {
+        const keys = append ? sortKeys.slice() : sortKeys.filter(k => k.column === column);
+        const index = keys.findIndex(k => k.column === column);
+        if (index < 0) {
+            keys.push({ column, direction: 'asc' });
+        }
+        else if (keys[index].direction === 'asc') {
+            keys[index] = { column, direction: 'desc' };
+        }
+        else {
+            keys.splice(index, 1);
+        }
+        sortKeys = keys;
+        currentPage = 1;
         loadData();
     }
     function applyFilter() {
@@ -337,6 +443,26 @@
         currentPage = 1;
         loadData();
     }
+    function exportTable() {
+        if (!selectedTable || !selectedSchema)
+            return;
+        let url = `/api/browseroso/export?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&format=${encodeURIComponent(exportFormat.value)}`;
+        const fc = filterColumn.value;
+        const fv = filterValue.value;
+        if (fc && fv) {
+            url += `&filterColumn=${encodeURIComponent(fc)}&filterValue=${encodeURIComponent(fv)}&filterMode=${encodeURIComponent(filterMode.value)}`;
+        }
+        if (sortKeys.length > 0) {
+            url += `&sort=${encodeURIComponent(sortKeys.map(k => `${k.column}:${k.direction}`).join(','))}`;
+        }
+        url += `&tabId=${encodeURIComponent(tabId)}&token=${encodeURIComponent(Auth.getToken() || '')}`;
+        const link = document.createElement('a');
+        link.href = url;
+        link.download = '';
+        document.body.appendChild(link);
+        link.click();
+        link.remove();
+    }
     async function checkStatus() {
         try {
             const response = await tabFetch('/api/browseroso/status');
@@ -354,14 +480,24 @@
         databaseSelect.addEventListener('change', () => changeDatabase(databaseSelect.value));
         btnFilter.addEventListener('click', applyFilter);
         btnClearFilter.addEventListener('click', clearFilter);
+        btnExport.addEventListener('click', exportTable);
         btnLogout.addEventListener('click', (e) => {
             e.preventDefault();
             Auth.logout();
         });
         btnFirst.addEventListener('click', () => goToPage(1));
         btnPrev.addEventListener('click', () => goToPage(currentPage - 1));
-        btnNext.addEventListener('click', () => goToPage(currentPage + 1));
+        btnNext.addEventListener('click', () => goToPage(currentPage + 1, nextCursor));
         btnLast.addEventListener('click', () => goToPage(totalPages));
+        dataPanel.addEventListener('click', (e) => {
+            const target = e.target;
+            const th = target.closest('th[data-column]');
+            if (th && th.dataset.column)
+                toggleSort(th.dataset.column, e.shiftKey);
+            const td = target.closest('td.table__truncated');
+            if (td)
+                loadFullValue(td);
+        });
         filterValue.addEventListener('keypress', (e) => {
             if (e.key === 'Enter')
                 applyFilter();
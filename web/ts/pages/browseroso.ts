@@ -14,6 +14,19 @@ interface ColumnInfo {
     type: string;
     nullable: boolean;
     isPrimaryKey: boolean;
+    isIndexed?: boolean;
+}
+
+interface SortKey {
+    column: string;
+    direction: 'asc' | 'desc';
+    indexed?: boolean;
+}
+
+interface TruncatedCell {
+    row: number;
+    column: string;
+    length: number;
 }
 
 interface DataResult {
@@ -21,10 +34,23 @@ interface DataResult {
     columns?: string[];
     rows?: Record<string, unknown>[];
     totalRows?: number;
+    totalRowsApproximate?: boolean;
     totalPages?: number;
+    filterMode?: string | null;
+    nextCursor?: string | null;
+    sort?: SortKey[];
+    truncated?: TruncatedCell[];
     error?: string;
 }
 
+// Labels of the filter modes the server reports having run
+const FILTER_MODE_LABELS: Record<string, string> = {
+    contains: 'contém',
+    prefix: 'começa com',
+    exact: 'igual a',
+    fulltext: 'texto completo'
+};
+
 (function () {
     'use strict';
 
@@ -42,6 +68,38 @@ interface DataResult {
         return Auth.authFetch(urlWithTab, options);
     }
 
+    // Slow queries: the server may answer 202 with a job id, which is polled until the result is ready.
+    // Starting a new one cancels the previous job on the server; its caller then gets null.
+    let jobGeneration = 0;
+    let activeJobId: string | null = null;
+
+    function cancelJob(jobId: string): void {
+        tabFetch(`/api/browseroso/jobs?id=${encodeURIComponent(jobId)}`, { method: 'DELETE' }).catch(() => undefined);
+    }
+
+    async function jobFetch(url: string): Promise<Response | null> {
+        const generation = ++jobGeneration;
+        if (activeJobId) {
+            cancelJob(activeJobId);
+            activeJobId = null;
+        }
+
+        let response = await tabFetch(url, { headers: { 'Prefer': 'respond-async' } });
+        while (response.status === 202) {
+            const job: { jobId: string } = await response.json();
+            if (generation !== jobGeneration) {
+                cancelJob(job.jobId);
+                return null;
+            }
+            activeJobId = job.jobId;
+            response = await tabFetch(`/api/browseroso/jobs?id=${encodeURIComponent(job.jobId)}`);
+        }
+
+        if (generation !== jobGeneration) return null;
+        activeJobId = null;
+        return response;
+    }
+
     // State
     let isConnected = false;
     let selectedDatabase: string | null = null;
@@ -51,6 +109,12 @@ interface DataResult {
     let currentPage = 1;
     let totalPages = 1;
     const pageSize = 50;
+    let sortKeys: SortKey[] = [];
+    let nextCursor: string | null = null;
+    let currentRows: Record<string, unknown>[] = [];
+
+    // Long text and binary values are cut to this many characters by the server; a click loads one whole
+    const previewLength = 200;
 
     // DOM Elements
     const connectBtn = document.getElementById('connectBtn') as HTMLButtonElement;
@@ -62,8 +126,11 @@ interface DataResult {
     const filterPanel = document.getElementById('filterPanel') as HTMLElement;
     const filterColumn = document.getElementById('filterColumn') as HTMLSelectElement;
     const filterValue = document.getElementById('filterValue') as HTMLInputElement;
+    const filterMode = document.getElementById('filterMode') as HTMLSelectElement;
     const btnFilter = document.getElementById('btnFilter') as HTMLButtonElement;
     const btnClearFilter = document.getElementById('btnClearFilter') as HTMLButtonElement;
+    const exportFormat = document.getElementById('exportFormat') as HTMLSelectElement;
+    const btnExport = document.getElementById('btnExport') as HTMLButtonElement;
     const dataPanel = document.getElementById('dataPanel') as HTMLElement;
     const pagination = document.getElementById('pagination') as HTMLElement;
     const paginationInfo = document.getElementById('paginationInfo') as HTMLElement;
@@ -306,6 +373,7 @@ interface DataResult {
         selectedSchema = schema;
         selectedTable = table;
         currentPage = 1;
+        sortKeys = [];
 
         // Show filter panel
         filterPanel.classList.remove('hidden');
@@ -333,9 +401,9 @@ interface DataResult {
     }
 
     /**
-     * Load table data
+     * Load table data (cursor: nextCursor of the previous page, read from after its last row)
      */
-    async function loadData(): Promise<void> {
+    async function loadData(cursor: string | null = null): Promise<void> {
         if (!selectedTable || !selectedSchema) return;
 
         dataPanel.innerHTML = `
@@ -348,14 +416,23 @@ interface DataResult {
         const fc = filterColumn.value;
         const fv = filterValue.value;
 
-        let url = `/api/browseroso/data?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&page=${currentPage}&pageSize=${pageSize}`;
+        let url = `/api/browseroso/data?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&page=${currentPage}&pageSize=${pageSize}&preview=${previewLength}`;
 
         if (fc && fv) {
-            url += `&filterColumn=${encodeURIComponent(fc)}&filterValue=${encodeURIComponent(fv)}`;
+            url += `&filterColumn=${encodeURIComponent(fc)}&filterValue=${encodeURIComponent(fv)}&filterMode=${encodeURIComponent(filterMode.value)}`;
+        }
+
+        if (sortKeys.length > 0) {
+            url += `&sort=${encodeURIComponent(sortKeys.map(k => `${k.column}:${k.direction}`).join(','))}`;
+        }
+
+        if (cursor) {
+            url += `&cursor=${encodeURIComponent(cursor)}`;
         }
 
         try {
-            const response = await tabFetch(url);
+            const response = await jobFetch(url);
+            if (!response) return;
             const data: DataResult = await response.json();
 
             if (!data.success) {
@@ -364,9 +441,14 @@ interface DataResult {
             }
 
             totalPages = data.totalPages || 1;
+            nextCursor = data.nextCursor || null;
+            sortKeys = data.sort || sortKeys;
 
             if (data.rows && data.rows.length > 0 && data.columns) {
-                renderTable(data.columns, data.rows, data.totalRows || 0);
+                renderTable(data.columns, data.rows, data.totalRows || 0, !!data.totalRowsApproximate, data.truncated || []);
+                if (data.filterMode) {
+                    paginationInfo.textContent += ` · filtro: ${FILTER_MODE_LABELS[data.filterMode] || data.filterMode}`;
+                }
             } else {
                 dataPanel.innerHTML = `
                     <div class="empty-state">
@@ -389,37 +471,48 @@ interface DataResult {
     /**
      * Render data table
      */
-    function renderTable(columnNames: string[], rows: Record<string, unknown>[], totalRows: number): void {
+    function renderTable(columnNames: string[], rows: Record<string, unknown>[], totalRows: number, approximate: boolean, truncated: TruncatedCell[]): void {
+        currentRows = rows;
+        const cut = new Map(truncated.map(t => [`${t.row}:${t.column}`, t.length]));
         let html = '<table class="table"><thead><tr>';
 
-        // Headers
+        // Headers: click sorts on the server, Shift+click adds a key; unindexed sorts are flagged
         for (const col of columnNames) {
-            const isPK = columns.some(c => c.name === col && c.isPrimaryKey);
-            html += `<th class="${isPK ? 'table__pk' : ''}">${isPK ? '🔑 ' : ''}${escapeHtml(col)}</th>`;
+            const info = columns.find(c => c.name === col);
+            const isPK = !!info && info.isPrimaryKey;
+            const sorted = sortKeys.find(k => k.column === col);
+            const indexed = sorted && sorted.indexed !== undefined ? sorted.indexed : !!info && info.isIndexed;
+            const arrow = sorted ? (sorted.direction === 'asc' ? ' ▲' : ' ▼') : '';
+            const warning = sorted && !indexed ? ' ⚠' : '';
+            const title = indexed ? 'Ordenar (Shift+clique adiciona)' : 'Sem índice: ordenar por esta coluna lê a tabela inteira';
+            html += `<th class="table__sortable${isPK ? ' table__pk' : ''}" data-column="${escapeHtml(col)}" title="${title}">${isPK ? '🔑 ' : ''}${escapeHtml(col)}${arrow}${warning}</th>`;
         }
 
         html += '</tr></thead><tbody>';
 
         // Rows
-        for (const row of rows) {
+        rows.forEach((row, index) => {
             html += '<tr>';
             for (const col of columnNames) {
                 const value = row[col];
-                if (value === null || value === undefined || value === 'NULL') {
+                const fullLength = cut.get(`${index}:${col}`);
+                if (value === null || value === undefined) {
                     html += '<td class="table__null">NULL</td>';
+                } else if (fullLength !== undefined) {
+                    html += `<td class="table__truncated" data-row="${index}" data-column="${escapeHtml(col)}" title="Valor cortado (${fullLength} no total): clique para carregar">${escapeHtml(String(value))}…</td>`;
                 } else {
                     html += `<td title="${escapeHtml(String(value))}">${escapeHtml(String(value))}</td>`;
                 }
             }
             html += '</tr>';
-        }
+        });
 
         html += '</tbody></table>';
         dataPanel.innerHTML = html;
 
         // Update pagination
         pagination.classList.remove('hidden');
-        paginationInfo.textContent = `Mostrando ${(currentPage - 1) * pageSize + 1} - ${Math.min(currentPage * pageSize, totalRows)} de ${totalRows} registros`;
+        paginationInfo.textContent = `Mostrando ${(currentPage - 1) * pageSize + 1} - ${Math.min(currentPage * pageSize, totalRows)} de ${approximate ? '~' : ''}${totalRows} registros`;
         pageInfo.textContent = `Página ${currentPage} de ${totalPages}`;
 
         btnFirst.disabled = currentPage === 1;
@@ -431,10 +524,57 @@ interface DataResult {
     /**
      * Go to page
      */
-    function goToPage(page: number): void {
+    function goToPage(page: number, cursor: string | null = null): void {
         if (page < 1) page = 1;
         if (page > totalPages) page = totalPages;
         currentPage = page;
+        loadData(cursor);
+    }
+
+    /**
+     * Load the whole value of a cell the preview cut, by the row's primary key
+     */
+    async function loadFullValue(cell: HTMLElement): Promise<void> {
+        const keys = columns.filter(c => c.isPrimaryKey);
+        const row = currentRows[Number(cell.dataset.row)];
+        const column = cell.dataset.column;
+        if (!row || !column || !selectedTable || !selectedSchema) return;
+        if (keys.length !== 1) {
+            cell.title = 'Valor cortado: a tabela não tem chave primária simples para carregá-lo';
+            return;
+        }
+
+        const key = keys[0].name;
+        const url = `/api/browseroso/data?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&pageSize=1&columns=${encodeURIComponent(column)}&filterColumn=${encodeURIComponent(key)}&filterValue=${encodeURIComponent(String(row[key]))}&filterMode=exact`;
+        try {
+            const response = await tabFetch(url);
+            const data: DataResult = await response.json();
+            if (data.success && data.rows && data.rows.length === 1) {
+                const value = String(data.rows[0][column]);
+                cell.textContent = value;
+                cell.title = value;
+                cell.classList.remove('table__truncated');
+            }
+        } catch {
+            // Keep the preview
+        }
+    }
+
+    /**
+     * Cycle a column's sort: ascending, descending, unsorted
+     */
+    function toggleSort(column: string, append: boolean): void {
+        const keys = append ? sortKeys.slice() : sortKeys.filter(k => k.column === column);
+        const index = keys.findIndex(k => k.column === column);
+        if (index < 0) {
+            keys.push({ column, direction: 'asc' });
+        } else if (keys[index].direction === 'asc') {
+            keys[index] = { column, direction: 'desc' };
+        } else {
+            keys.splice(index, 1);
+        }
+        sortKeys = keys;
+        currentPage = 1;
         loadData();
     }
 
@@ -456,6 +596,37 @@ interface DataResult {
         loadData();
     }
 
+    /**
+     * Download the table (with the current filter and sort) as a file streamed by the server
+     *
+     * A plain link lets the browser write the rows to disk as they arrive; it cannot send the
+     * Authorization header, so the token goes in the query string.
+     */
+    function exportTable(): void {
+        if (!selectedTable || !selectedSchema) return;
+
+        let url = `/api/browseroso/export?schema=${encodeURIComponent(selectedSchema)}&table=${encodeURIComponent(selectedTable)}&format=${encodeURIComponent(exportFormat.value)}`;
+
+        const fc = filterColumn.value;
+        const fv = filterValue.value;
+        if (fc && fv) {
+            url += `&filterColumn=${encodeURIComponent(fc)}&filterValue=${encodeURIComponent(fv)}&filterMode=${encodeURIComponent(filterMode.value)}`;
+        }
+
+        if (sortKeys.length > 0) {
+            url += `&sort=${encodeURIComponent(sortKeys.map(k => `${k.column}:${k.direction}`).join(','))}`;
+        }
+
+        url += `&tabId=${encodeURIComponent(tabId)}&token=${encodeURIComponent(Auth.getToken() || '')}`;
+
+        const link = document.createElement('a');
+        link.href = url;
+        link.download = '';
+        document.body.appendChild(link);
+        link.click();
+        link.remove();
+    }
+
     /**
      * Check initial connection status
      */
@@ -482,6 +653,7 @@ interface DataResult {
         databaseSelect.addEventListener('change', () => changeDatabase(databaseSelect.value));
         btnFilter.addEventListener('click', applyFilter);
         btnClearFilter.addEventListener('click', clearFilter);
+        btnExport.addEventListener('click', exportTable);
         btnLogout.addEventListener('click', (e) => {
             e.preventDefault();
             Auth.logout();
@@ -490,9 +662,18 @@ interface DataResult {
         // Pagination
         btnFirst.addEventListener('click', () => goToPage(1));
         btnPrev.addEventListener('click', () => goToPage(currentPage - 1));
-        btnNext.addEventListener('click', () => goToPage(currentPage + 1));
+        btnNext.addEventListener('click', () => goToPage(currentPage + 1, nextCursor));
         btnLast.addEventListener('click', () => goToPage(totalPages));
 
+        // Sort by header, load cut values on click
+        dataPanel.addEventListener('click', (e) => {
+            const target = e.target as HTMLElement;
+            const th = target.closest('th[data-column]') as HTMLElement | null;
+            if (th && th.dataset.column) toggleSort(th.dataset.column, e.shiftKey);
+            const td = target.closest('td.table__truncated') as HTMLElement | null;
+            if (td) loadFullValue(td);
+        });
+
         // Filter on Enter
         filterValue.addEventListener('keypress', (e) => {
             if (e.key === 'Enter') applyFilter();